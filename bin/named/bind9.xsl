@@ -918,6 +918,56 @@
                 <xsl:value-of select="taskmgr/thread-model/tasks-ready"/>
               </td>
             </tr>
+            <tr class="odd">
+              <th>Tasks Executed</th>
+              <td>
+                <xsl:value-of select="taskmgr/thread-model/tasks-executed"/>
+              </td>
+            </tr>
+            <tr class="even">
+              <th>Tasks Stolen</th>
+              <td>
+                <xsl:value-of select="taskmgr/thread-model/tasks-stolen"/>
+              </td>
+            </tr>
+          </table>
+          <br/>
+        </xsl:if>
+        <xsl:if test="taskmgr/queues/queue">
+          <h2>Task Queues</h2>
+          <table class="counters">
+            <tr>
+              <th>ID</th>
+              <th>Tasks Ready</th>
+              <th>Max Tasks Ready</th>
+              <th>Tasks Executed</th>
+              <th>Tasks Stolen</th>
+            </tr>
+            <xsl:for-each select="taskmgr/queues/queue">
+              <xsl:variable name="css-class15">
+                <xsl:choose>
+                  <xsl:when test="position() mod 2 = 0">even</xsl:when>
+                  <xsl:otherwise>odd</xsl:otherwise>
+                </xsl:choose>
+              </xsl:variable>
+              <tr class="{$css-class15}">
+                <td>
+                  <xsl:value-of select="id"/>
+                </td>
+                <td>
+                  <xsl:value-of select="tasks-ready"/>
+                </td>
+                <td>
+                  <xsl:value-of select="max-tasks-ready"/>
+                </td>
+                <td>
+                  <xsl:value-of select="tasks-executed"/>
+                </td>
+                <td>
+                  <xsl:value-of select="tasks-stolen"/>
+                </td>
+              </tr>
+            </xsl:for-each>
           </table>
           <br/>
         </xsl:if>
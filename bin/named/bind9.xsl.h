@@ -923,6 +923,56 @@ static char xslmsg[] =
 	" <xsl:value-of select=\"taskmgr/thread-model/tasks-ready\"/>\n"
 	" </td>\n"
 	" </tr>\n"
+	" <tr class=\"odd\">\n"
+	" <th>Tasks Executed</th>\n"
+	" <td>\n"
+	" <xsl:value-of select=\"taskmgr/thread-model/tasks-executed\"/>\n"
+	" </td>\n"
+	" </tr>\n"
+	" <tr class=\"even\">\n"
+	" <th>Tasks Stolen</th>\n"
+	" <td>\n"
+	" <xsl:value-of select=\"taskmgr/thread-model/tasks-stolen\"/>\n"
+	" </td>\n"
+	" </tr>\n"
+	" </table>\n"
+	" <br/>\n"
+	" </xsl:if>\n"
+	" <xsl:if test=\"taskmgr/queues/queue\">\n"
+	" <h2>Task Queues</h2>\n"
+	" <table class=\"counters\">\n"
+	" <tr>\n"
+	" <th>ID</th>\n"
+	" <th>Tasks Ready</th>\n"
+	" <th>Max Tasks Ready</th>\n"
+	" <th>Tasks Executed</th>\n"
+	" <th>Tasks Stolen</th>\n"
+	" </tr>\n"
+	" <xsl:for-each select=\"taskmgr/queues/queue\">\n"
+	" <xsl:variable name=\"css-class15\">\n"
+	" <xsl:choose>\n"
+	" <xsl:when test=\"position() mod 2 = 0\">even</xsl:when>\n"
+	" <xsl:otherwise>odd</xsl:otherwise>\n"
+	" </xsl:choose>\n"
+	" </xsl:variable>\n"
+	" <tr class=\"{$css-class15}\">\n"
+	" <td>\n"
+	" <xsl:value-of select=\"id\"/>\n"
+	" </td>\n"
+	" <td>\n"
+	" <xsl:value-of select=\"tasks-ready\"/>\n"
+	" </td>\n"
+	" <td>\n"
+	" <xsl:value-of select=\"max-tasks-ready\"/>\n"
+	" </td>\n"
+	" <td>\n"
+	" <xsl:value-of select=\"tasks-executed\"/>\n"
+	" </td>\n"
+	" <td>\n"
+	" <xsl:value-of select=\"tasks-stolen\"/>\n"
+	" </td>\n"
+	" </tr>\n"
+	" </xsl:for-each>\n"
 	" </table>\n"
 	" <br/>\n"
 	" </xsl:if>\n"
@@ -93,6 +93,7 @@ options {\n\
 	request-nsid false;\n\
 	reserved-sockets 512;\n\
 	resolver-query-timeout 10;\n\
+	reuseport no;\n\
 	rrset-order { order random; };\n\
 	secroots-file \"named.secroots\";\n\
 	send-cookie true;\n\
@@ -101,7 +102,8 @@ options {\n\
 	server-id none;\n\
 	session-keyalg hmac-sha256;\n\
 #	session-keyfile \"" NAMED_LOCALSTATEDIR "/run/named/session.key\";\n\
-	session-keyname local-ddns;\n"
+	session-keyname local-ddns;\n\
+	sig-cache-size 1M;\n"
 #ifndef WIN32
 "	stacksize default;\n"
 #endif
@@ -153,6 +155,7 @@ options {\n\
 "\
 #	fetch-glue <obsolete>;\n\
 	fetch-quota-params 100 0.1 0.3 0.7;\n\
+	fetch-shards 0;\n\
 	fetches-per-server 0;\n\
 	fetches-per-zone 0;\n\
 	filter-aaaa-on-v4 no;\n\
@@ -190,6 +193,7 @@ options {\n\
 	require-server-cookie no;\n\
 	resolver-nonbackoff-tries 3;\n\
 	resolver-retry-interval 800; /* in milliseconds */\n\
+	response-cache-size 0;\n\
 #	rfc2308-type1 <obsolete>;\n\
 	root-key-sentinel yes;\n\
 	servfail-ttl 1;\n\
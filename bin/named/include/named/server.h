@@ -103,6 +103,9 @@ struct named_server {
 
 	dns_dtenv_t		*dtenv;		/*%< Dnstap environment */
 
+	dns_sigcache_t		*sigcache;	/*%< Verified signatures */
+	size_t			sigcachesize;
+
 	char *			lockfile;
 };
 
@@ -105,6 +105,7 @@
 #endif
 
 LIBISC_EXTERNAL_DATA extern int isc_dscp_check_value;
+LIBISC_EXTERNAL_DATA extern bool isc_socket_iouring;
 LIBDNS_EXTERNAL_DATA extern unsigned int dns_zone_mkey_hour;
 LIBDNS_EXTERNAL_DATA extern unsigned int dns_zone_mkey_day;
 LIBDNS_EXTERNAL_DATA extern unsigned int dns_zone_mkey_month;
@@ -130,6 +131,7 @@ static bool nonearest = false;
 static bool notcp = false;
 static bool fixedlocal = false;
 static bool sigvalinsecs = false;
+static bool legacycompression = false;
 
 /*
  * -4 and -6
@@ -479,6 +481,10 @@ parse_T_opt(char *option) {
 	 *	       simulate remote servers.
 	 * dscp=x:     check that dscp values are as
 	 * 	       expected and assert otherwise.
+	 * iouring:    use io_uring for socket events and I/O
+	 *	       instead of epoll (Linux only).
+	 * legacycompression: compress names in responses
+	 *	       the way older versions did.
 	 */
 	if (!strcmp(option, "clienttest")) {
 		clienttest = true;
@@ -490,8 +496,12 @@ parse_T_opt(char *option) {
 		isc_dscp_check_value = atoi(option + 5);
 	} else if (!strcmp(option, "fixedlocal")) {
 		fixedlocal = true;
+	} else if (!strcmp(option, "iouring")) {
+		isc_socket_iouring = true;
 	} else if (!strcmp(option, "keepstderr")) {
 		named_g_keepstderr = true;
+	} else if (!strcmp(option, "legacycompression")) {
+		legacycompression = true;
 	} else if (!strcmp(option, "noaa")) {
 		noaa = true;
 	} else if (!strcmp(option, "noedns")) {
@@ -825,7 +835,7 @@ create_managers(void) {
 	}
 
 	result = isc_socketmgr_create2(named_g_mctx, &named_g_socketmgr,
-				       maxsocks);
+				       maxsocks, named_g_cpus);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_socketmgr_create() failed: %s",
@@ -1191,6 +1201,8 @@ setup(void) {
 		ns_server_setoption(sctx, NS_SERVER_DISABLE6, true);
 	if (sigvalinsecs)
 		ns_server_setoption(sctx, NS_SERVER_SIGVALINSECS, true);
+	if (legacycompression)
+		ns_server_setoption(sctx, NS_SERVER_LEGACYCOMPRESS, true);
 
 	named_g_server->sctx->delay = delay;
 }
@@ -87,9 +87,11 @@
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/rootns.h>
 #include <dns/rriterator.h>
 #include <dns/secalg.h>
+#include <dns/sigcache.h>
 #include <dns/soa.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
@@ -158,8 +160,21 @@
 #define EXCLBUFFERS 4096
 #endif /* TUNE_LARGE */
 
+/*
+ * With "fetch-shards 0;", the default, each view's resolver gets this many
+ * fetch context buckets per worker thread, and at least RESOLVER_NTASKS.
+ */
+#define RESOLVER_NTASKS_PER_CPU 8
+#define MAX_RESOLVER_NTASKS 65535
+
 #define MAX_TCP_TIMEOUT 65535
 
+/*
+ * Without "cache-shards", each view's cache gets this many shards per
+ * worker thread.
+ */
+#define CACHE_SHARDS_PER_CPU 2
+
 /*%
  * Check an operation for failure.  Assumes that the function
  * using it has a 'result' variable and a 'cleanup' label.
@@ -1716,7 +1731,8 @@ cache_reusable(dns_view_t *originview, dns_view_t *view,
 	    originview->acceptexpired != view->acceptexpired ||
 	    originview->enablevalidation != view->enablevalidation ||
 	    originview->maxcachettl != view->maxcachettl ||
-	    originview->maxncachettl != view->maxncachettl) {
+	    originview->maxncachettl != view->maxncachettl ||
+	    originview->cacheshards != view->cacheshards) {
 		return (false);
 	}
 
@@ -3687,7 +3703,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	named_cache_t *nsc;
 	bool zero_no_soattl;
 	dns_acl_t *clients = NULL, *mapped = NULL, *excluded = NULL;
-	unsigned int query_timeout, ndisp;
+	unsigned int query_timeout, ndisp, nshards;
 	bool old_rpz_ok = false;
 	isc_dscp_t dscp4 = -1, dscp6 = -1;
 	dns_dyndbctx_t *dctx = NULL;
@@ -4100,6 +4116,15 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 	INSIST(result == ISC_R_SUCCESS);
 	view->staleanswersenable = cfg_obj_asboolean(obj);
 
+	obj = NULL;
+	result = named_config_get(maps, "cache-shards", &obj);
+	if (result == ISC_R_SUCCESS)
+		view->cacheshards = cfg_obj_asuint32(obj);
+	else
+		view->cacheshards = CACHE_SHARDS_PER_CPU * named_g_cpus;
+	if (view->cacheshards == 0)
+		view->cacheshards = 1;
+
 	result = dns_viewlist_find(&named_g_server->viewlist, view->name,
 				   view->rdclass, &pview);
 	if (result == ISC_R_SUCCESS) {
@@ -4189,6 +4214,11 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 			}
 		}
 		if (cache == NULL) {
+			char shards[sizeof("4294967295")];
+			char *cacheargv[1] = { shards };
+			const char *cachetype = "rbt";
+			unsigned int cacheargc = 0;
+
 			/*
 			 * Create a cache with the desired name.  This normally
 			 * equals the view name, but may also be a forward
@@ -4200,15 +4230,25 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 			 * We use two separate memory contexts for the
 			 * cache, for the main cache memory and the heap
 			 * memory.
+			 *
+			 * Unless "cache-shards" is 0 or 1, the cache is
+			 * split into shards, so that the workers filling it
+			 * seldom wait for each other.
 			 */
 			CHECK(isc_mem_create(0, 0, &cmctx));
 			isc_mem_setname(cmctx, "cache", NULL);
 			CHECK(isc_mem_create(0, 0, &hmctx));
 			isc_mem_setname(hmctx, "cache_heap", NULL);
+			if (view->cacheshards > 1) {
+				snprintf(shards, sizeof(shards), "%u",
+					 view->cacheshards);
+				cachetype = "shardcache";
+				cacheargc = 1;
+			}
 			CHECK(dns_cache_create(cmctx, hmctx, named_g_taskmgr,
 					       named_g_timermgr, view->rdclass,
-					       cachename, "rbt", 0, NULL,
-					       &cache));
+					       cachename, cachetype,
+					       cacheargc, cacheargv, &cache));
 			isc_mem_detach(&cmctx);
 			isc_mem_detach(&hmctx);
 		}
@@ -4253,8 +4293,6 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 
 	/*
 	 * Resolver.
-	 *
-	 * XXXRTH  Hardwired number of tasks.
 	 */
 	CHECK(get_view_querysource_dispatch(maps, AF_INET, &dispatch4, &dscp4,
 					    (ISC_LIST_PREV(view, link) == NULL)));
@@ -4277,8 +4315,17 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 		CHECK(dns_rdatatypestats_create(mctx, &resquerystats));
 	dns_view_setresquerystats(view, resquerystats);
 
+	obj = NULL;
+	result = named_config_get(maps, "fetch-shards", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	nshards = cfg_obj_asuint32(obj);
+	if (nshards == 0)
+		nshards = ISC_MAX(RESOLVER_NTASKS,
+				  RESOLVER_NTASKS_PER_CPU * named_g_cpus);
+	nshards = ISC_MIN(nshards, MAX_RESOLVER_NTASKS);
+
 	ndisp = 4 * ISC_MIN(named_g_udpdisp, MAX_UDP_DISPATCH);
-	CHECK(dns_view_createresolver(view, named_g_taskmgr, RESOLVER_NTASKS,
+	CHECK(dns_view_createresolver(view, named_g_taskmgr, nshards,
 				      ndisp, named_g_socketmgr,
 				      named_g_timermgr, resopts,
 				      named_g_dispatchmgr,
@@ -5339,6 +5386,24 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist,
 		fail_ttl = 30;
 	dns_view_setfailttl(view, fail_ttl);
 
+	/*
+	 * Set up the cache of rendered authoritative responses.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "response-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asuint64(obj) > 0) {
+		uint64_t respcachesize = cfg_obj_asuint64(obj);
+
+		if (respcachesize > SIZE_MAX)
+			respcachesize = SIZE_MAX;
+		CHECK(dns_respcache_create(view->mctx, (size_t)respcachesize,
+					   &view->respcache));
+	}
+
+	if (named_g_server->sigcache != NULL)
+		dns_sigcache_attach(named_g_server->sigcache, &view->sigcache);
+
 	/*
 	 * Name space to look up redirect information in.
 	 */
@@ -7880,6 +7945,7 @@ load_configuration(const char *filename, named_server_t *server,
 	uint32_t reserved;
 	uint32_t udpsize;
 	uint32_t transfer_message_size;
+	uint64_t sigcachesize;
 	named_cache_t *nsc;
 	named_cachelist_t cachelist, tmpcachelist;
 	ns_altsecret_t *altsecret;
@@ -8184,6 +8250,30 @@ load_configuration(const char *filename, named_server_t *server,
 	ns_server_settimeouts(named_g_server->sctx,
 			      initial, idle, keepalive, advertised);
 
+	/*
+	 * Set up the cache of verified signatures, which all views
+	 * share.  A new size replaces the cache; views still using the
+	 * old one keep it until they go away.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "sig-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	sigcachesize = cfg_obj_asuint64(obj);
+	if (sigcachesize > SIZE_MAX)
+		sigcachesize = SIZE_MAX;
+	if (server->sigcache == NULL ||
+	    server->sigcachesize != (size_t)sigcachesize)
+	{
+		if (server->sigcache != NULL)
+			dns_sigcache_detach(&server->sigcache);
+		if (sigcachesize > 0)
+			CHECKM(dns_sigcache_create(named_g_mctx,
+						   (size_t)sigcachesize,
+						   &server->sigcache),
+			       "creating signature cache");
+		server->sigcachesize = (size_t)sigcachesize;
+	}
+
 	/*
 	 * Configure sets of UDP query source ports.
 	 */
@@ -8333,6 +8423,15 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 	ns_interfacemgr_setbacklog(server->interfacemgr, backlog);
 
+	/*
+	 * Should every UDP dispatch get its own SO_REUSEPORT socket?
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "reuseport", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_interfacemgr_setreuseport(server->interfacemgr,
+				     cfg_obj_asboolean(obj));
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -9614,6 +9713,9 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 
 	server->dtenv = NULL;
 
+	server->sigcache = NULL;
+	server->sigcachesize = 0;
+
 	server->magic = NAMED_SERVER_MAGIC;
 	*serverp = server;
 }
@@ -9628,6 +9730,9 @@ named_server_destroy(named_server_t **serverp) {
 		dns_dt_detach(&server->dtenv);
 #endif /* HAVE_DNSTAP */
 
+	if (server->sigcache != NULL)
+		dns_sigcache_detach(&server->sigcache);
+
 #ifdef USE_DNSRPS
 	dns_dnsrps_server_destroy();
 #endif
@@ -10837,6 +10942,10 @@ named_server_dumprecursing(named_server_t *server) {
 			view->name);
 		dns_resolver_dumpfetches(view->resolver,
 					 isc_statsformat_file, fp);
+		fprintf(fp, ";\n; Fetch context buckets [view: %s]\n;\n",
+			view->name);
+		dns_resolver_dumpshards(view->resolver,
+					isc_statsformat_file, fp);
 	}
 
 	fprintf(fp, "; Dump complete\n");
@@ -13913,7 +14022,8 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	const char *type, *file;
 	char zonename[DNS_NAME_FORMATSIZE];
 	uint32_t serial, signed_serial, nodes;
-	char serbuf[16], sserbuf[16], nodebuf[16];
+	size_t nodememory;
+	char serbuf[16], sserbuf[16], nodebuf[16], nodememorybuf[64];
 	char resignbuf[DNS_NAME_FORMATSIZE + DNS_RDATATYPE_FORMATSIZE + 2];
 	char lbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char xbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
@@ -14001,6 +14111,10 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	/* Database node count */
 	nodes = dns_db_nodecount(hasraw ? rawdb : db);
 	snprintf(nodebuf, sizeof(nodebuf), "%u", nodes);
+	nodememory = dns_db_nodememory(hasraw ? rawdb : db);
+	snprintf(nodememorybuf, sizeof(nodememorybuf),
+		 "%lu bytes (%lu per node)", (unsigned long)nodememory,
+		 (unsigned long)(nodes != 0 ? nodememory / nodes : 0));
 
 	/* Security */
 	secure = dns_db_issecure(db);
@@ -14102,6 +14216,11 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	CHECK(putstr(text, "\nnodes: "));
 	CHECK(putstr(text, nodebuf));
 
+	if (nodememory != 0) {
+		CHECK(putstr(text, "\nnode memory: "));
+		CHECK(putstr(text, nodememorybuf));
+	}
+
 	if (! isc_time_isepoch(&loadtime)) {
 		CHECK(putstr(text, "\nlast loaded: "));
 		CHECK(putstr(text, lbuf));
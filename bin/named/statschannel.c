@@ -314,6 +314,11 @@ init_desc(void) {
 		       "QryUsedStale");
 	SET_NSSTATDESC(prefetch, "queries triggered prefetch", "Prefetch");
 	SET_NSSTATDESC(keytagopt, "Keytag option received", "KeyTagOpt");
+	SET_NSSTATDESC(respcachehit, "responses sent from the response cache",
+		       "RespCacheHit");
+	SET_NSSTATDESC(respcachemiss,
+		       "cacheable queries not found in the response cache",
+		       "RespCacheMiss");
 	INSIST(i == ns_statscounter_max);
 
 	/* Initialize resolver statistics */
@@ -402,6 +407,18 @@ init_desc(void) {
 			"ServerQuota");
 	SET_RESSTATDESC(nextitem, "waited for next item", "NextItem");
 	SET_RESSTATDESC(priming, "priming queries", "Priming");
+	SET_RESSTATDESC(dispsockopen, "query sockets opened",
+			"QuerySockOpen");
+	SET_RESSTATDESC(dispsockreuse, "query sockets reused while bound",
+			"QuerySockReuse");
+	SET_RESSTATDESC(tcpconn, "TCP query connections open",
+			"QueryCurTCPConn");
+	SET_RESSTATDESC(tcpreuse, "queries sent on open TCP connections",
+			"QueryTCPReuse");
+	SET_RESSTATDESC(sigcachehit, "signatures found in the signature cache",
+			"ValSigCacheHit");
+	SET_RESSTATDESC(sigcachemiss, "signatures verified with the DNSKEY",
+			"ValSigCacheMiss");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Time dns_message_parse() on responses of different sizes, like the
+ * messages of a zone transfer: an answer section of A records, each for
+ * a different name, with the names compressed against the question.
+ *
+ * Usage: msgparse_bench [iterations]
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/result.h>
+
+#define DEFAULT_ITERATIONS	200
+
+static unsigned char wire[65535];
+
+/*
+ * Build a response of at most 'size' bytes in 'b', and return the
+ * number of records in it.
+ */
+static unsigned int
+makeresponse(isc_buffer_t *b, unsigned int size) {
+	unsigned char *ancount;
+	unsigned int count = 0;
+	char label[16];
+	size_t len;
+
+	isc_buffer_init(b, wire, size);
+	isc_buffer_putuint16(b, 1);		/* id */
+	isc_buffer_putuint16(b, 0x8400);	/* QR, AA */
+	isc_buffer_putuint16(b, 1);
+	ancount = isc_buffer_used(b);
+	isc_buffer_putuint16(b, 0);
+	isc_buffer_putuint16(b, 0);
+	isc_buffer_putuint16(b, 0);
+
+	/* example. AXFR */
+	isc_buffer_putuint8(b, 7);
+	isc_buffer_putstr(b, "example");
+	isc_buffer_putuint8(b, 0);
+	isc_buffer_putuint16(b, dns_rdatatype_axfr);
+	isc_buffer_putuint16(b, dns_rdataclass_in);
+
+	for (;;) {
+		len = snprintf(label, sizeof(label), "host%u", count);
+		if (isc_buffer_availablelength(b) < 1 + len + 2 + 14)
+			break;
+		isc_buffer_putuint8(b, len);
+		isc_buffer_putstr(b, label);
+		isc_buffer_putuint16(b, 0xc000 | 12);
+		isc_buffer_putuint16(b, dns_rdatatype_a);
+		isc_buffer_putuint16(b, dns_rdataclass_in);
+		isc_buffer_putuint32(b, 3600);
+		isc_buffer_putuint16(b, 4);
+		isc_buffer_putuint32(b, 0x0a000000 + count);
+		count++;
+	}
+
+	ancount[0] = count >> 8;
+	ancount[1] = count & 0xff;
+	return (count);
+}
+
+static void
+bench(isc_mem_t *mctx, unsigned int size, unsigned int iterations) {
+	dns_message_t *msg = NULL;
+	isc_buffer_t b;
+	isc_time_t start, end;
+	unsigned int i, count;
+	uint64_t usecs;
+
+	count = makeresponse(&b, size);
+
+	RUNTIME_CHECK(dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE,
+					 &msg) == ISC_R_SUCCESS);
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (i = 0; i < iterations; i++) {
+		isc_buffer_first(&b);
+		RUNTIME_CHECK(dns_message_parse(msg, &b, 0) == ISC_R_SUCCESS);
+		dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+	}
+	RUNTIME_CHECK(isc_time_now(&end) == ISC_R_SUCCESS);
+	usecs = isc_time_microdiff(&end, &start);
+
+	printf("%6u  %8u  %12.1f  %10.1f\n", isc_buffer_usedlength(&b),
+	       count, (double)usecs / iterations,
+	       (double)usecs * 1000 / iterations / count);
+
+	dns_message_destroy(&msg);
+}
+
+int
+main(int argc, char *argv[]) {
+	static const unsigned int sizes[] = { 512, 4096, 16384, 65535 };
+	isc_mem_t *mctx = NULL;
+	unsigned int i, iterations;
+
+	iterations = (argc > 1) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+	if (iterations < 1)
+		iterations = 1;
+
+	dns_result_register();
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+
+	printf("%u iterations\n", iterations);
+	printf(" bytes   records  usec/message   nsec/record\n");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		bench(mctx, sizes[i], iterations);
+
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
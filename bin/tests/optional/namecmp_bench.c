@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Time dns_name_equal(), dns_name_compare() and dns_name_fullhash() on
+ * names like those a server sees: host names under common suffixes,
+ * service and hashed CDN labels, and reverse lookups, some of them
+ * with their case changed.
+ *
+ * Usage: namecmp_bench [iterations]
+ */
+
+#include <config.h>
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/result.h>
+
+#define DEFAULT_ITERATIONS	200
+#define NNAMES			4096
+
+static dns_fixedname_t fnames[NNAMES], fupper[NNAMES], fsiblings[NNAMES];
+static dns_name_t *names[NNAMES], *upper[NNAMES], *siblings[NNAMES];
+
+static uint32_t seed = 1;
+
+static uint32_t
+next(void) {
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8);
+}
+
+static void
+label(char *text, size_t size, size_t *lenp) {
+	static const char *common[] = { "www", "mail", "api", "cdn", "ns1",
+					"smtp", "_dmarc", "static", "m" };
+	static const char alnum[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+	unsigned int i, n;
+
+	switch (next() % 4) {
+	case 0:
+		*lenp += snprintf(text + *lenp, size - *lenp, "%s.",
+				  common[next() % (sizeof(common) /
+						   sizeof(common[0]))]);
+		break;
+	case 3:
+		/* A hashed label, as CDNs and DKIM selectors use. */
+		n = 16 + next() % 17;
+		goto word;
+	default:
+		n = 3 + next() % 10;
+	word:
+		for (i = 0; i < n; i++)
+			text[(*lenp)++] = alnum[next() % (sizeof(alnum) - 1)];
+		text[(*lenp)++] = '.';
+		text[*lenp] = '\0';
+		break;
+	}
+}
+
+static dns_name_t *
+fromtext(const char *text, dns_fixedname_t *fname) {
+	isc_buffer_t b;
+	dns_name_t *name;
+
+	isc_buffer_constinit(&b, text, strlen(text));
+	isc_buffer_add(&b, strlen(text));
+	name = dns_fixedname_initname(fname);
+	RUNTIME_CHECK(dns_name_fromtext(name, &b, dns_rootname, 0, NULL) ==
+		      ISC_R_SUCCESS);
+	return (name);
+}
+
+/*
+ * Make names[i], a copy of it with some letters in upper case, and a
+ * name that differs from it only in the first label.
+ */
+static void
+makenames(unsigned int i) {
+	static const char *suffixes[] = { "com", "net", "org", "example.com",
+					  "co.uk", "de", "amazonaws.com" };
+	char text[256], sibling[256];
+	size_t len = 0, first, j;
+	unsigned int labels, k;
+
+	if (next() % 8 == 0) {
+		/* An IPv4 reverse lookup. */
+		len = snprintf(text, sizeof(text),
+			       "%u.%u.%u.%u.in-addr.arpa.",
+			       next() % 256, next() % 256, next() % 256,
+			       next() % 256);
+		first = strchr(text, '.') - text;
+	} else {
+		labels = 1 + next() % 3;
+		label(text, sizeof(text), &len);
+		first = len - 1;
+		for (k = 1; k < labels; k++)
+			label(text, sizeof(text), &len);
+		len += snprintf(text + len, sizeof(text) - len, "%s.",
+				suffixes[next() % (sizeof(suffixes) /
+						   sizeof(suffixes[0]))]);
+	}
+	names[i] = fromtext(text, &fnames[i]);
+
+	memmove(sibling, text, len + 1);
+	sibling[first - 1] = (sibling[first - 1] == 'z') ? 'y' : 'z';
+	siblings[i] = fromtext(sibling, &fsiblings[i]);
+
+	for (j = 0; j < len; j++)
+		if (next() % 4 == 0)
+			text[j] = toupper((unsigned char)text[j]);
+	upper[i] = fromtext(text, &fupper[i]);
+}
+
+static double
+nsecs(isc_time_t *start, unsigned int ops) {
+	isc_time_t end;
+
+	RUNTIME_CHECK(isc_time_now(&end) == ISC_R_SUCCESS);
+	return ((double)isc_time_microdiff(&end, start) * 1000 / ops);
+}
+
+int
+main(int argc, char *argv[]) {
+	unsigned int i, n, iterations, count;
+	isc_time_t start;
+	unsigned int hash = 0;
+	int order = 0;
+
+	iterations = (argc > 1) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+	if (iterations < 1)
+		iterations = 1;
+
+	dns_result_register();
+
+	for (i = 0; i < NNAMES; i++)
+		makenames(i);
+
+	printf("%u names, %u iterations\n", NNAMES, iterations);
+	printf("%-32s %10s\n", "", "nsec/op");
+
+	count = 0;
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (n = 0; n < iterations; n++)
+		for (i = 0; i < NNAMES; i++)
+			count += dns_name_equal(names[i], upper[i]);
+	printf("%-32s %10.1f\n", "dns_name_equal (equal)",
+	       nsecs(&start, iterations * NNAMES));
+	RUNTIME_CHECK(count == iterations * NNAMES);
+
+	count = 0;
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (n = 0; n < iterations; n++)
+		for (i = 0; i < NNAMES; i++)
+			count += dns_name_equal(upper[i], siblings[i]);
+	printf("%-32s %10.1f\n", "dns_name_equal (first label)",
+	       nsecs(&start, iterations * NNAMES));
+	RUNTIME_CHECK(count == 0);
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (n = 0; n < iterations; n++)
+		for (i = 0; i < NNAMES; i++)
+			order += dns_name_compare(upper[i], names[i]);
+	printf("%-32s %10.1f\n", "dns_name_compare (equal)",
+	       nsecs(&start, iterations * NNAMES));
+	RUNTIME_CHECK(order == 0);
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (n = 0; n < iterations; n++)
+		for (i = 0; i < NNAMES; i++)
+			order += dns_name_compare(upper[i], siblings[i]);
+	printf("%-32s %10.1f\n", "dns_name_compare (first label)",
+	       nsecs(&start, iterations * NNAMES));
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (n = 0; n < iterations; n++)
+		for (i = 0; i < NNAMES; i++)
+			order += dns_name_compare(names[i],
+						  names[(i + 1) % NNAMES]);
+	printf("%-32s %10.1f\n", "dns_name_compare (random)",
+	       nsecs(&start, iterations * NNAMES));
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (n = 0; n < iterations; n++)
+		for (i = 0; i < NNAMES; i++)
+			hash += dns_name_fullhash(upper[i], false);
+	printf("%-32s %10.1f\n", "dns_name_fullhash",
+	       nsecs(&start, iterations * NNAMES));
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (n = 0; n < iterations; n++)
+		for (i = 0; i < NNAMES; i++)
+			hash += dns_name_hash(upper[i], false);
+	printf("%-32s %10.1f\n", "dns_name_hash",
+	       nsecs(&start, iterations * NNAMES));
+
+	/* Keep the results live. */
+	if (hash == 0 && order == 0)
+		printf("\n");
+
+	return (0);
+}
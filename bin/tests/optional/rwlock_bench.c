@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure how read-locking throughput scales with the number of threads,
+ * for ordinary and reader-biased rwlocks.
+ *
+ * Usage: rwlock_bench [maxthreads [writes-per-million]]
+ */
+
+#include <config.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/print.h>
+#include <isc/rwlock.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#ifdef ISC_PLATFORM_USETHREADS
+
+#define MAXTHREADS	64
+#define LOOPS		2000000
+
+static isc_rwlock_t lock;
+static unsigned int writefreq;
+static unsigned int shared[16];
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+run(void *arg) {
+	unsigned int i, sum = 0;
+
+	UNUSED(arg);
+
+	for (i = 1; i <= LOOPS; i++) {
+		if (writefreq != 0 && i % writefreq == 0) {
+			RWLOCK(&lock, isc_rwlocktype_write);
+			shared[i % 16]++;
+			RWUNLOCK(&lock, isc_rwlocktype_write);
+		} else {
+			RWLOCK(&lock, isc_rwlocktype_read);
+			sum += shared[i % 16];
+			RWUNLOCK(&lock, isc_rwlocktype_read);
+		}
+	}
+
+	return ((isc_threadresult_t)(uintptr_t)sum);
+}
+
+static double
+bench(isc_mem_t *mctx, bool biased, unsigned int nthreads) {
+	isc_thread_t threads[MAXTHREADS];
+	isc_time_t start, end;
+	uint64_t usecs;
+	unsigned int i;
+
+	if (biased)
+		RUNTIME_CHECK(isc_rwlock_initbiased(&lock, mctx, 0, 0) ==
+			      ISC_R_SUCCESS);
+	else
+		RUNTIME_CHECK(isc_rwlock_init(&lock, 0, 0) == ISC_R_SUCCESS);
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (i = 0; i < nthreads; i++)
+		RUNTIME_CHECK(isc_thread_create(run, NULL, &threads[i]) ==
+			      ISC_R_SUCCESS);
+	for (i = 0; i < nthreads; i++)
+		(void)isc_thread_join(threads[i], NULL);
+	RUNTIME_CHECK(isc_time_now(&end) == ISC_R_SUCCESS);
+
+	isc_rwlock_destroy(&lock);
+
+	usecs = isc_time_microdiff(&end, &start);
+	if (usecs == 0)
+		usecs = 1;
+	return ((double)LOOPS * nthreads / usecs);
+}
+
+int
+main(int argc, char *argv[]) {
+	isc_mem_t *mctx = NULL;
+	unsigned int maxthreads, writes, n;
+
+	if (argc > 1)
+		maxthreads = atoi(argv[1]);
+	else
+		maxthreads = isc_os_ncpus();
+	if (maxthreads < 1)
+		maxthreads = 1;
+	if (maxthreads > MAXTHREADS)
+		maxthreads = MAXTHREADS;
+
+	writes = (argc > 2) ? atoi(argv[2]) : 0;
+	writefreq = (writes != 0) ? 1000000 / writes : 0;
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+
+	printf("%u locks per thread, %u writes per million\n", LOOPS, writes);
+	printf("threads  rwlock Mops/s  biased Mops/s\n");
+	n = 1;
+	for (;;) {
+		double plain = bench(mctx, false, n);
+		double biased = bench(mctx, true, n);
+
+		printf("%7u  %13.2f  %13.2f\n", n, plain, biased);
+		if (n == maxthreads)
+			break;
+		n *= 2;
+		if (n > maxthreads)
+			n = maxthreads;
+	}
+
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
+
+#else
+
+int
+main(int argc, char *argv[]) {
+	UNUSED(argc);
+	UNUSED(argv);
+	fprintf(stderr, "This test requires threads.\n");
+	return(1);
+}
+
+#endif
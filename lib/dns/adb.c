@@ -45,6 +45,10 @@
 #include <dns/result.h>
 #include <dns/stats.h>
 
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+#include <stdatomic.h>
+#endif
+
 #define DNS_ADB_MAGIC             ISC_MAGIC('D', 'a', 'd', 'b')
 #define DNS_ADB_VALID(x)          ISC_MAGIC_VALID(x, DNS_ADB_MAGIC)
 #define DNS_ADBNAME_MAGIC         ISC_MAGIC('a', 'd', 'b', 'N')
@@ -231,6 +235,44 @@ struct dns_adblameinfo {
 	ISC_LINK(dns_adblameinfo_t)     plink;
 };
 
+/*%
+ * The SRTT, flags, expiry time and count of active fetches of an entry
+ * change on nearly every response, so where the platform has atomics
+ * they are updated without taking the entry's bucket lock.
+ */
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+typedef atomic_uint adbentry_uint_t;
+#define ENTRY_LOAD(p)		atomic_load_explicit((p), memory_order_relaxed)
+#define ENTRY_STORE(p, v) \
+	atomic_store_explicit((p), (v), memory_order_relaxed)
+#define ENTRY_CAS(p, o, n) \
+	atomic_compare_exchange_strong_explicit((p), (o), (n), \
+						memory_order_relaxed, \
+						memory_order_relaxed)
+#define ENTRY_INCR(p) \
+	atomic_fetch_add_explicit((p), 1, memory_order_relaxed)
+#define ENTRY_LOCK(a, e)	((void)0)
+#define ENTRY_UNLOCK(a, e)	((void)0)
+#else
+typedef unsigned int adbentry_uint_t;
+#define ENTRY_LOAD(p)		(*(p))
+#define ENTRY_STORE(p, v)	(*(p) = (v))
+#define ENTRY_CAS(p, o, n)	entry_cas((p), (o), (n))
+#define ENTRY_INCR(p)		((*(p))++)
+#define ENTRY_LOCK(a, e)	LOCK(&(a)->entrylocks[(e)->lock_bucket])
+#define ENTRY_UNLOCK(a, e)	UNLOCK(&(a)->entrylocks[(e)->lock_bucket])
+
+static inline bool
+entry_cas(unsigned int *p, unsigned int *o, unsigned int n) {
+	if (*p != *o) {
+		*o = *p;
+		return (false);
+	}
+	*p = n;
+	return (true);
+}
+#endif
+
 /*%
  * An address entry.  It holds quite a bit of information about addresses,
  * including edns state (in "flags"), rtt, and of course the address of
@@ -243,8 +285,8 @@ struct dns_adbentry {
 	unsigned int                    refcnt;
 	unsigned int                    nh;
 
-	unsigned int                    flags;
-	unsigned int                    srtt;
+	adbentry_uint_t                 flags;
+	adbentry_uint_t                 srtt;
 	uint16_t			udpsize;
 	unsigned int			completed;
 	unsigned int			timeouts;
@@ -255,7 +297,7 @@ struct dns_adbentry {
 
 	uint8_t			mode;
 	uint32_t			quota;
-	uint32_t			active;
+	adbentry_uint_t			active;
 	double				atr;
 
 	/*
@@ -269,8 +311,8 @@ struct dns_adbentry {
 	unsigned char *			cookie;
 	uint16_t			cookielen;
 
-	isc_stdtime_t                   expires;
-	isc_stdtime_t			lastage;
+	adbentry_uint_t                 expires;
+	adbentry_uint_t			lastage;
 	/*%<
 	 * A nonzero 'expires' field indicates that the entry should
 	 * persist until that time.  This allows entries found
@@ -4121,69 +4163,82 @@ void
 dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		   unsigned int rtt, unsigned int factor)
 {
-	int bucket;
 	isc_stdtime_t now = 0;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 	REQUIRE(factor <= 10);
 
-	bucket = addr->entry->lock_bucket;
-	LOCK(&adb->entrylocks[bucket]);
+	ENTRY_LOCK(adb, addr->entry);
 
-	if (addr->entry->expires == 0 || factor == DNS_ADB_RTTADJAGE)
+	if (ENTRY_LOAD(&addr->entry->expires) == 0 ||
+	    factor == DNS_ADB_RTTADJAGE)
 		isc_stdtime_get(&now);
 	adjustsrtt(addr, rtt, factor, now);
 
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_UNLOCK(adb, addr->entry);
 }
 
 void
 dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now) {
-	int bucket;
-
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	bucket = addr->entry->lock_bucket;
-	LOCK(&adb->entrylocks[bucket]);
-
+	ENTRY_LOCK(adb, addr->entry);
 	adjustsrtt(addr, 0, DNS_ADB_RTTADJAGE, now);
-
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_UNLOCK(adb, addr->entry);
 }
 
+/*
+ * Without atomics the caller must hold the entry's bucket lock.  With
+ * them, concurrent updates are retried until one applies cleanly to the
+ * value it read, and only the caller that moves 'lastage' on ages the
+ * entry for that second.
+ */
 static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now)
 {
+	dns_adbentry_t *entry = addr->entry;
+	unsigned int old_srtt, lastage, expires;
 	uint64_t new_srtt;
 
+	old_srtt = ENTRY_LOAD(&entry->srtt);
 	if (factor == DNS_ADB_RTTADJAGE) {
-		if (addr->entry->lastage != now) {
-			new_srtt = addr->entry->srtt;
+		lastage = ENTRY_LOAD(&entry->lastage);
+		if (lastage == now ||
+		    !ENTRY_CAS(&entry->lastage, &lastage, now))
+		{
+			addr->srtt = old_srtt;
+			goto expires;
+		}
+	}
+
+	do {
+		if (factor == DNS_ADB_RTTADJAGE) {
+			new_srtt = old_srtt;
 			new_srtt <<= 9;
-			new_srtt -= addr->entry->srtt;
+			new_srtt -= old_srtt;
 			new_srtt >>= 9;
-			addr->entry->lastage = now;
 		} else
-			new_srtt = addr->entry->srtt;
-	} else
-		new_srtt = ((uint64_t)addr->entry->srtt / 10 * factor)
-			+ ((uint64_t)rtt / 10 * (10 - factor));
+			new_srtt = ((uint64_t)old_srtt / 10 * factor)
+				+ ((uint64_t)rtt / 10 * (10 - factor));
+	} while (!ENTRY_CAS(&entry->srtt, &old_srtt,
+			    (unsigned int) new_srtt));
 
-	addr->entry->srtt = (unsigned int) new_srtt;
 	addr->srtt = (unsigned int) new_srtt;
 
-	if (addr->entry->expires == 0)
-		addr->entry->expires = now + ADB_ENTRY_WINDOW;
+ expires:
+	expires = 0;
+	(void)ENTRY_CAS(&entry->expires, &expires, now + ADB_ENTRY_WINDOW);
 }
 
 void
 dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		    unsigned int bits, unsigned int mask)
 {
-	int bucket;
+	dns_adbentry_t *entry;
+	unsigned int flags, expires;
 	isc_stdtime_t now;
 
 	REQUIRE(DNS_ADB_VALID(adb));
@@ -4192,13 +4247,23 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	REQUIRE((bits & ENTRY_IS_DEAD) == 0);
 	REQUIRE((mask & ENTRY_IS_DEAD) == 0);
 
-	bucket = addr->entry->lock_bucket;
-	LOCK(&adb->entrylocks[bucket]);
+	entry = addr->entry;
+	ENTRY_LOCK(adb, entry);
+
+	/*
+	 * ENTRY_IS_DEAD is outside 'mask', so a concurrent
+	 * unlink_entry() setting it just makes us go round again.
+	 */
+	flags = ENTRY_LOAD(&entry->flags);
+	while (!ENTRY_CAS(&entry->flags, &flags,
+			  (flags & ~mask) | (bits & mask)))
+		;
 
-	addr->entry->flags = (addr->entry->flags & ~mask) | (bits & mask);
-	if (addr->entry->expires == 0) {
+	if (ENTRY_LOAD(&entry->expires) == 0) {
 		isc_stdtime_get(&now);
-		addr->entry->expires = now + ADB_ENTRY_WINDOW;
+		expires = 0;
+		(void)ENTRY_CAS(&entry->expires, &expires,
+				now + ADB_ENTRY_WINDOW);
 	}
 
 	/*
@@ -4207,7 +4272,7 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 	 */
 	addr->flags = (addr->flags & ~mask) | (bits & mask);
 
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_UNLOCK(adb, entry);
 }
 
 /*
@@ -4782,34 +4847,31 @@ dns_adb_setquota(dns_adb_t *adb, uint32_t quota, uint32_t freq,
 bool
 dns_adbentry_overquota(dns_adbentry_t *entry) {
 	REQUIRE(DNS_ADBENTRY_VALID(entry));
-	return (entry->quota != 0 && entry->active >= entry->quota);
+	return (entry->quota != 0 &&
+		ENTRY_LOAD(&entry->active) >= entry->quota);
 }
 
 void
 dns_adb_beginudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	int bucket;
-
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	bucket = addr->entry->lock_bucket;
-
-	LOCK(&adb->entrylocks[bucket]);
-	addr->entry->active++;
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_LOCK(adb, addr->entry);
+	(void)ENTRY_INCR(&addr->entry->active);
+	ENTRY_UNLOCK(adb, addr->entry);
 }
 
 void
 dns_adb_endudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	int bucket;
+	unsigned int active;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	bucket = addr->entry->lock_bucket;
-
-	LOCK(&adb->entrylocks[bucket]);
-	if (addr->entry->active > 0)
-		addr->entry->active--;
-	UNLOCK(&adb->entrylocks[bucket]);
+	ENTRY_LOCK(adb, addr->entry);
+	active = ENTRY_LOAD(&addr->entry->active);
+	while (active > 0 &&
+	       !ENTRY_CAS(&addr->entry->active, &active, active - 1))
+		;
+	ENTRY_UNLOCK(adb, addr->entry);
 }
@@ -167,6 +167,16 @@ cleaner_shutdown_action(isc_task_t *task, isc_event_t *event);
 static void
 overmem_cleaning_action(isc_task_t *task, isc_event_t *event);
 
+/*%
+ * "rbt" and "shardcache" databases take the heap memory context as their
+ * first argument, and clean themselves.
+ */
+static inline bool
+cache_isrbt(const char *db_type) {
+	return (strcmp(db_type, "rbt") == 0 ||
+		strcmp(db_type, "shardcache") == 0);
+}
+
 static inline isc_result_t
 cache_create_db(dns_cache_t *cache, dns_db_t **db) {
 	isc_result_t result;
@@ -238,11 +248,11 @@ dns_cache_create(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	}
 
 	/*
-	 * For databases of type "rbt" we pass hmctx to dns_db_create()
-	 * via cache->db_argv, followed by the rest of the arguments in
-	 * db_argv (of which there really shouldn't be any).
+	 * For databases of type "rbt" or "shardcache" we pass hmctx to
+	 * dns_db_create() via cache->db_argv, followed by the rest of the
+	 * arguments in db_argv (of which there really shouldn't be any).
 	 */
-	if (strcmp(cache->db_type, "rbt") == 0)
+	if (cache_isrbt(cache->db_type))
 		extra = 1;
 
 	cache->db_argc = db_argc + extra;
@@ -296,7 +306,7 @@ dns_cache_create(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	 * RBT-type cache DB has its own mechanism of cache cleaning and doesn't
 	 * need the control of the generic cleaner.
 	 */
-	if (strcmp(db_type, "rbt") == 0)
+	if (cache_isrbt(db_type))
 		result = cache_cleaner_init(cache, NULL, NULL, &cache->cleaner);
 	else {
 		result = cache_cleaner_init(cache, taskmgr, timermgr,
@@ -371,11 +381,11 @@ cache_free(dns_cache_t *cache) {
 
 	if (cache->db_argv != NULL) {
 		/*
-		 * We don't free db_argv[0] in "rbt" cache databases
-		 * as it's a pointer to hmctx
+		 * We don't free db_argv[0] in "rbt" or "shardcache" cache
+		 * databases as it's a pointer to hmctx
 		 */
 		int extra = 0;
-		if (strcmp(cache->db_type, "rbt") == 0)
+		if (cache_isrbt(cache->db_type))
 			extra = 1;
 		for (i = extra; i < cache->db_argc; i++)
 			if (cache->db_argv[i] != NULL)
@@ -1423,6 +1433,9 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		values[dns_cachestatscounter_deletettl],
 		"cache records deleted due to TTL expiration");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_probation],
+		"cache records not admitted due to memory exhaustion");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db),
 		"cache database nodes");
 	fprintf(fp, "%20" PRIu64 " %s\n",
@@ -1490,6 +1503,8 @@ dns_cache_renderxml(dns_cache_t *cache, xmlTextWriterPtr writer) {
 		   values[dns_cachestatscounter_deletelru], writer));
 	TRY0(renderstat("DeleteTTL",
 		   values[dns_cachestatscounter_deletettl], writer));
+	TRY0(renderstat("NotAdmitted",
+		   values[dns_cachestatscounter_probation], writer));
 
 	TRY0(renderstat("CacheNodes", dns_db_nodecount(cache->db), writer));
 	TRY0(renderstat("CacheBuckets", dns_db_hashsize(cache->db), writer));
@@ -1550,6 +1565,10 @@ dns_cache_renderjson(dns_cache_t *cache, json_object *cstats) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "DeleteTTL", obj);
 
+	obj = json_object_new_int64(values[dns_cachestatscounter_probation]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "NotAdmitted", obj);
+
 	obj = json_object_new_int64(dns_db_nodecount(cache->db));
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CacheNodes", obj);
@@ -138,6 +138,24 @@ static unsigned char tableindex[256] = {
 	0x37, 0x39, 0x2c, 0x3d, 0x35, 0x39, 0x27, 0x2f
 };
 
+/*
+ * A node of the legacy compression table.
+ */
+struct dns_compresslegacy {
+	dns_compresslegacy_t	*next;
+	uint16_t		offset;
+	isc_region_t            r;
+	dns_name_t              name;
+};
+
+/*
+ * The parent offset of the labels nearest the root.  Labels are only
+ * indexed in names that start below 0x4000, so no label is here.
+ */
+#define ROOT		0xffff
+
+#define MAXLABELS	128
+
 /***
  ***	Compression
  ***/
@@ -152,6 +170,15 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 	cctx->count = 0;
 	cctx->allowed = DNS_COMPRESS_ENABLED;
 
+	cctx->buckets = cctx->initialbuckets;
+	cctx->nbuckets = DNS_COMPRESS_INITIALBUCKETS;
+	memset(cctx->buckets, 0, sizeof(cctx->initialbuckets));
+	cctx->nodes = cctx->initialnodes;
+	cctx->size = DNS_COMPRESS_INITIALNODES;
+	cctx->labels = cctx->initiallabels;
+	cctx->labelsused = 0;
+	cctx->labelssize = DNS_COMPRESS_INITIALLABELS;
+
 	memset(&cctx->table[0], 0, sizeof(cctx->table));
 
 	cctx->magic = CCTX_MAGIC;
@@ -159,9 +186,16 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 	return (ISC_R_SUCCESS);
 }
 
+static void
+legacy_free(dns_compress_t *cctx, dns_compresslegacy_t *node) {
+	if ((node->offset & 0x8000) != 0)
+		isc_mem_put(cctx->mctx, node->r.base, node->r.length);
+	isc_mem_put(cctx->mctx, node, sizeof(*node));
+}
+
 void
 dns_compress_invalidate(dns_compress_t *cctx) {
-	dns_compressnode_t *node;
+	dns_compresslegacy_t *node;
 	unsigned int i;
 
 	REQUIRE(VALID_CCTX(cctx));
@@ -170,15 +204,22 @@ dns_compress_invalidate(dns_compress_t *cctx) {
 		while (cctx->table[i] != NULL) {
 			node = cctx->table[i];
 			cctx->table[i] = cctx->table[i]->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count < DNS_COMPRESS_INITIALNODES)
-				continue;
-			isc_mem_put(cctx->mctx, node, sizeof(*node));
+			legacy_free(cctx, node);
 		}
 	}
 
+	if (cctx->buckets != cctx->initialbuckets)
+		isc_mem_put(cctx->mctx, cctx->buckets,
+			    cctx->nbuckets * sizeof(cctx->buckets[0]));
+	if (cctx->nodes != cctx->initialnodes)
+		isc_mem_put(cctx->mctx, cctx->nodes,
+			    cctx->size * sizeof(cctx->nodes[0]));
+	if (cctx->labels != cctx->initiallabels)
+		isc_mem_put(cctx->mctx, cctx->labels, cctx->labelssize);
+	cctx->buckets = NULL;
+	cctx->nodes = NULL;
+	cctx->labels = NULL;
+
 	cctx->magic = 0;
 	cctx->allowed = 0;
 	cctx->edns = -1;
@@ -221,6 +262,17 @@ dns_compress_getsensitive(dns_compress_t *cctx) {
 	return (cctx->allowed & DNS_COMPRESS_CASESENSITIVE);
 }
 
+void
+dns_compress_setlegacy(dns_compress_t *cctx, bool legacy) {
+	REQUIRE(VALID_CCTX(cctx));
+	REQUIRE(cctx->count == 0);
+
+	if (legacy)
+		cctx->allowed |= DNS_COMPRESS_LEGACY;
+	else
+		cctx->allowed &= ~DNS_COMPRESS_LEGACY;
+}
+
 int
 dns_compress_getedns(dns_compress_t *cctx) {
 	REQUIRE(VALID_CCTX(cctx));
@@ -228,35 +280,20 @@ dns_compress_getedns(dns_compress_t *cctx) {
 }
 
 /*
- * Find the longest match of name in the table.
- * If match is found return true. prefix, suffix and offset are updated.
- * If no match is found return false.
+ * Find the longest match of name in the legacy table.
  */
-bool
-dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
-			dns_name_t *prefix, uint16_t *offset)
+static bool
+legacy_findglobal(dns_compress_t *cctx, const dns_name_t *name,
+		  dns_name_t *prefix, uint16_t *offset)
 {
-	dns_name_t tname;
-	dns_compressnode_t *node = NULL;
+	dns_compresslegacy_t *node = NULL;
 	unsigned int labels, i, n;
 	unsigned int numlabels;
 	unsigned char *p;
 
-	REQUIRE(VALID_CCTX(cctx));
-	REQUIRE(dns_name_isabsolute(name) == true);
-	REQUIRE(offset != NULL);
-
-	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
-		return (false);
-
-	if (cctx->count == 0)
-		return (false);
-
 	labels = dns_name_countlabels(name);
 	INSIST(labels > 0);
 
-	dns_name_init(&tname, NULL);
-
 	numlabels = labels > 3U ? 3U : labels;
 	p = name->ndata;
 
@@ -366,6 +403,123 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 	return (true);
 }
 
+/*
+ * Record where each label of 'name' starts, and return the number of
+ * labels, not counting the root label.
+ */
+static inline unsigned int
+labelstarts(const dns_name_t *name, unsigned char *starts) {
+	unsigned int n = 0, pos = 0;
+
+	while (name->ndata[pos] != 0) {
+		starts[n++] = pos;
+		pos += name->ndata[pos] + 1;
+	}
+	return (n);
+}
+
+static inline uint16_t
+labelhash(const unsigned char *label, uint16_t parent) {
+	unsigned int h = 2166136261U ^ parent;
+	unsigned int i, len = label[0] + 1;
+
+	for (i = 0; i < len; i++) {
+		h ^= maptolower[label[i]];
+		h *= 16777619U;
+	}
+	return ((uint16_t)(h ^ (h >> 16)));
+}
+
+static inline bool
+labelequal(dns_compress_t *cctx, const unsigned char *l1,
+	   const unsigned char *l2)
+{
+	unsigned int count = l1[0];
+
+	if (count != l2[0])
+		return (false);
+	if ((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0)
+		return (memcmp(l1 + 1, l2 + 1, count) == 0);
+	while (count > 0) {
+		if (maptolower[l1[count]] != maptolower[l2[count]])
+			return (false);
+		count--;
+	}
+	return (true);
+}
+
+/*
+ * Find the newest node for 'label' below the suffix at 'parent'.
+ */
+static inline dns_compressnode_t *
+findlabel(dns_compress_t *cctx, const unsigned char *label, uint16_t parent) {
+	uint16_t hash = labelhash(label, parent);
+	unsigned int i;
+
+	for (i = cctx->buckets[hash & (cctx->nbuckets - 1)];
+	     i != 0;
+	     i = cctx->nodes[i - 1].next)
+	{
+		dns_compressnode_t *node = &cctx->nodes[i - 1];
+
+		if (node->hash == hash && node->parent == parent &&
+		    labelequal(cctx, cctx->labels + node->label, label))
+			return (node);
+	}
+	return (NULL);
+}
+
+bool
+dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
+			dns_name_t *prefix, uint16_t *offset)
+{
+	unsigned char starts[MAXLABELS];
+	dns_compressnode_t *node;
+	unsigned int n, match = 0;
+	uint16_t parent = ROOT;
+
+	REQUIRE(VALID_CCTX(cctx));
+	REQUIRE(dns_name_isabsolute(name) == true);
+	REQUIRE(offset != NULL);
+
+	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
+		return (false);
+
+	if (cctx->count == 0)
+		return (false);
+
+	if ((cctx->allowed & DNS_COMPRESS_LEGACY) != 0)
+		return (legacy_findglobal(cctx, name, prefix, offset));
+
+	/*
+	 * Walk down from the root one label at a time, for as long as
+	 * the suffix is in the message.
+	 */
+	n = labelstarts(name, starts);
+	while (n > 0) {
+		node = findlabel(cctx, name->ndata + starts[n - 1], parent);
+		if (node == NULL)
+			break;
+		n--;
+		parent = node->offset;
+		if (parent < 0x4000) {
+			match = n + 1;
+			*offset = parent;
+		}
+	}
+
+	if (match == 0)
+		return (false);
+
+	match--;
+	if (match == 0)
+		dns_name_reset(prefix);
+	else
+		dns_name_getlabelsequence(name, 0, match, prefix);
+
+	return (true);
+}
+
 static inline unsigned int
 name_length(const dns_name_t *name) {
 	isc_region_t r;
@@ -373,30 +527,22 @@ name_length(const dns_name_t *name) {
 	return (r.length);
 }
 
-void
-dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
-		 const dns_name_t *prefix, uint16_t offset)
+static void
+legacy_add(dns_compress_t *cctx, const dns_name_t *name,
+	   const dns_name_t *prefix, uint16_t offset)
 {
 	dns_name_t tname, xname;
 	unsigned int start;
 	unsigned int n;
 	unsigned int count;
 	unsigned int i;
-	dns_compressnode_t *node;
+	dns_compresslegacy_t *node;
 	unsigned int length;
 	unsigned int tlength;
 	uint16_t toffset;
 	unsigned char *tmp;
 	isc_region_t r;
 
-	REQUIRE(VALID_CCTX(cctx));
-	REQUIRE(dns_name_isabsolute(name));
-
-	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
-		return;
-
-	if (offset >= 0x4000)
-		return;
 	dns_name_init(&tname, NULL);
 	dns_name_init(&xname, NULL);
 
@@ -439,15 +585,10 @@ dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		/*
 		 * Create a new node and add it.
 		 */
-		if (cctx->count < DNS_COMPRESS_INITIALNODES)
-			node = &cctx->initialnodes[cctx->count];
-		else {
-			node = isc_mem_get(cctx->mctx,
-					   sizeof(dns_compressnode_t));
-			if (node == NULL)
-				break;
-		}
-		node->count = cctx->count++;
+		node = isc_mem_get(cctx->mctx, sizeof(dns_compresslegacy_t));
+		if (node == NULL)
+			break;
+		cctx->count++;
 		/*
 		 * 'node->r.base' becomes 'tmp' when start == 0.
 		 * Record this by setting 0x8000 so it can be freed later.
@@ -472,31 +613,184 @@ dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		isc_mem_put(cctx->mctx, tmp, length);
 }
 
+/*
+ * Make room for one more node with a label of 'length' bytes.
+ */
+static bool
+grow(dns_compress_t *cctx, unsigned int length) {
+	unsigned int i, size;
+
+	if (cctx->labelsused + length > cctx->labelssize) {
+		unsigned char *labels;
+
+		size = cctx->labelssize * 2;
+		labels = isc_mem_get(cctx->mctx, size);
+		if (labels == NULL)
+			return (false);
+		memmove(labels, cctx->labels, cctx->labelsused);
+		if (cctx->labels != cctx->initiallabels)
+			isc_mem_put(cctx->mctx, cctx->labels,
+				    cctx->labelssize);
+		cctx->labels = labels;
+		cctx->labelssize = size;
+	}
+
+	if (cctx->count == cctx->size) {
+		dns_compressnode_t *nodes;
+
+		size = cctx->size * 2;
+		nodes = isc_mem_get(cctx->mctx, size * sizeof(nodes[0]));
+		if (nodes == NULL)
+			return (false);
+		memmove(nodes, cctx->nodes, cctx->count * sizeof(nodes[0]));
+		if (cctx->nodes != cctx->initialnodes)
+			isc_mem_put(cctx->mctx, cctx->nodes,
+				    cctx->size * sizeof(nodes[0]));
+		cctx->nodes = nodes;
+		cctx->size = size;
+	}
+
+	/*
+	 * Keep no more nodes than buckets.  The nodes are put back in
+	 * the order they were added, so the newest node for a suffix
+	 * still comes first.
+	 */
+	if (cctx->count == cctx->nbuckets) {
+		uint16_t *buckets;
+
+		size = cctx->nbuckets * 2;
+		buckets = isc_mem_get(cctx->mctx, size * sizeof(buckets[0]));
+		if (buckets == NULL)
+			return (false);
+		memset(buckets, 0, size * sizeof(buckets[0]));
+		for (i = 0; i < cctx->count; i++) {
+			dns_compressnode_t *node = &cctx->nodes[i];
+			unsigned int b = node->hash & (size - 1);
+
+			node->next = buckets[b];
+			buckets[b] = i + 1;
+		}
+		if (cctx->buckets != cctx->initialbuckets)
+			isc_mem_put(cctx->mctx, cctx->buckets,
+				    cctx->nbuckets * sizeof(buckets[0]));
+		cctx->buckets = buckets;
+		cctx->nbuckets = size;
+	}
+
+	return (true);
+}
+
+void
+dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
+		 const dns_name_t *prefix, uint16_t offset)
+{
+	unsigned char starts[MAXLABELS];
+	const unsigned char *label;
+	dns_compressnode_t *node;
+	unsigned int n, count, length, b;
+	uint16_t parent = ROOT;
+
+	REQUIRE(VALID_CCTX(cctx));
+	REQUIRE(dns_name_isabsolute(name));
+
+	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
+		return;
+
+	if (offset >= 0x4000)
+		return;
+
+	if ((cctx->allowed & DNS_COMPRESS_LEGACY) != 0) {
+		legacy_add(cctx, name, prefix, offset);
+		return;
+	}
+
+	count = dns_name_countlabels(prefix);
+	if (dns_name_isabsolute(prefix))
+		count--;
+	if (count == 0)
+		return;
+
+	/*
+	 * Find the node of the suffix that the prefix was compressed
+	 * against, if any.
+	 */
+	n = labelstarts(name, starts);
+	while (n > count) {
+		node = findlabel(cctx, name->ndata + starts[n - 1], parent);
+		if (node == NULL)
+			return;
+		parent = node->offset;
+		n--;
+	}
+
+	/*
+	 * Then add the labels of the prefix, which were written at
+	 * 'offset', nearest the root first.
+	 */
+	while (n > 0) {
+		label = name->ndata + starts[n - 1];
+		length = label[0] + 1;
+		if (!grow(cctx, length))
+			return;
+
+		node = &cctx->nodes[cctx->count];
+		node->offset = (uint16_t)(offset + starts[n - 1]);
+		node->parent = parent;
+		node->hash = labelhash(label, parent);
+		node->label = cctx->labelsused;
+		memmove(cctx->labels + cctx->labelsused, label, length);
+		cctx->labelsused += length;
+
+		b = node->hash & (cctx->nbuckets - 1);
+		node->next = cctx->buckets[b];
+		cctx->buckets[b] = ++cctx->count;
+
+		parent = node->offset;
+		n--;
+	}
+}
+
 void
 dns_compress_rollback(dns_compress_t *cctx, uint16_t offset) {
 	unsigned int i;
-	dns_compressnode_t *node;
+	dns_compresslegacy_t *node;
 
 	REQUIRE(VALID_CCTX(cctx));
 
 	if (ISC_UNLIKELY((cctx->allowed & DNS_COMPRESS_ENABLED) == 0))
 		return;
 
+	if ((cctx->allowed & DNS_COMPRESS_LEGACY) == 0) {
+		/*
+		 * Names are rolled back whole, and the nodes of later
+		 * names come after those of earlier names, so the nodes
+		 * to remove are the last ones, and each is first in its
+		 * bucket.
+		 */
+		while (cctx->count > 0 &&
+		       cctx->nodes[cctx->count - 1].offset >= offset)
+		{
+			dns_compressnode_t *last;
+
+			last = &cctx->nodes[cctx->count - 1];
+			i = last->hash & (cctx->nbuckets - 1);
+			INSIST(cctx->buckets[i] == cctx->count);
+			cctx->buckets[i] = last->next;
+			cctx->labelsused = last->label;
+			cctx->count--;
+		}
+		return;
+	}
+
 	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
 		node = cctx->table[i];
 		/*
 		 * This relies on nodes with greater offsets being
-		 * closer to the beginning of the list, and the
-		 * items with the greatest offsets being at the end
-		 * of the initialnodes[] array.
+		 * closer to the beginning of the list.
 		 */
 		while (node != NULL && (node->offset & 0x7fff) >= offset) {
 			cctx->table[i] = node->next;
-			if ((node->offset & 0x8000) != 0)
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			if (node->count >= DNS_COMPRESS_INITIALNODES)
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
+			legacy_free(cctx, node);
 			cctx->count--;
 			node = cctx->table[i];
 		}
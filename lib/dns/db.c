@@ -59,12 +59,14 @@ struct dns_dbimplementation {
  */
 
 #include "rbtdb.h"
+#include "shardcache.h"
 
 static ISC_LIST(dns_dbimplementation_t) implementations;
 static isc_rwlock_t implock;
 static isc_once_t once = ISC_ONCE_INIT;
 
 static dns_dbimplementation_t rbtimp;
+static dns_dbimplementation_t shardimp;
 
 static void
 initialize(void) {
@@ -76,8 +78,15 @@ initialize(void) {
 	rbtimp.driverarg = NULL;
 	ISC_LINK_INIT(&rbtimp, link);
 
+	shardimp.name = "shardcache";
+	shardimp.create = dns_shardcache_create;
+	shardimp.mctx = NULL;
+	shardimp.driverarg = NULL;
+	ISC_LINK_INIT(&shardimp, link);
+
 	ISC_LIST_INIT(implementations);
 	ISC_LIST_APPEND(implementations, &rbtimp, link);
+	ISC_LIST_APPEND(implementations, &shardimp, link);
 }
 
 static inline dns_dbimplementation_t *
@@ -845,6 +854,16 @@ dns_db_nodecount(dns_db_t *db) {
 	return ((db->methods->nodecount)(db));
 }
 
+size_t
+dns_db_nodememory(dns_db_t *db) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (db->methods->nodememory == NULL)
+		return (0);
+
+	return ((db->methods->nodememory)(db));
+}
+
 size_t
 dns_db_hashsize(dns_db_t *db) {
 	REQUIRE(DNS_DB_VALID(db));
@@ -28,9 +28,11 @@
 #include <isc/random.h>
 #include <isc/socket.h>
 #include <isc/stats.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/time.h>
+#include <isc/timer.h>
 #include <isc/util.h>
 
 #include <dns/acl.h>
@@ -79,17 +81,14 @@ struct dns_dispatchmgr {
 	unsigned int			buffers;    /*%< allocated buffers */
 	unsigned int			buffersize; /*%< size of each buffer */
 	unsigned int			maxbuffers; /*%< max buffers */
+	unsigned int			nbound;	    /*%< idle bound sockets */
+	unsigned int			maxbound;   /*%< max idle bound sockets */
 
 	/* Locked internally. */
-	isc_mutex_t			depool_lock;
 	isc_mempool_t		       *depool;	/*%< pool for dispatch events */
-	isc_mutex_t			rpool_lock;
 	isc_mempool_t		       *rpool;	/*%< pool for replies */
-	isc_mutex_t			dpool_lock;
 	isc_mempool_t		       *dpool;  /*%< dispatch allocations */
-	isc_mutex_t			bpool_lock;
 	isc_mempool_t		       *bpool;	/*%< pool for buffers */
-	isc_mutex_t			spool_lock;
 	isc_mempool_t		       *spool;	/*%< pool for dispsocks */
 
 	/*%
@@ -155,6 +154,43 @@ struct dns_dispentry {
 #define DNS_DISPATCH_SOCKSQUOTA			3072
 #endif
 
+/*%
+ * Maximum number of dispatch sockets which are kept open and bound to
+ * their port when their transaction ends, in all the dispatches of a
+ * manager together, and never more than an eighth of the sockets the
+ * socket manager allows.  A socket kept this way, in its dispatch's
+ * bound set, is only used again for a transaction with the same server;
+ * a transaction with a server that has none opens a socket on a new
+ * random port.  Each of them holds a file descriptor.
+ *
+ * A bound socket is closed, and its port leaves the set, once it has
+ * been open for DNS_DISPATCH_BOUNDTIME seconds or has been used for
+ * DNS_DISPATCH_BOUNDUSES transactions, whichever comes first.
+ */
+#ifndef DNS_DISPATCH_BOUNDSOCKS
+#ifdef TUNE_LARGE
+#define DNS_DISPATCH_BOUNDSOCKS			2048
+#else
+#define DNS_DISPATCH_BOUNDSOCKS			512
+#endif /* TUNE_LARGE */
+#endif
+
+/*%
+ * Number of buckets of the table in which a dispatch finds its bound
+ * sockets by server address.
+ */
+#ifndef DNS_DISPATCH_BOUNDBUCKETS
+#define DNS_DISPATCH_BOUNDBUCKETS		211
+#endif
+
+#ifndef DNS_DISPATCH_BOUNDTIME
+#define DNS_DISPATCH_BOUNDTIME			30
+#endif
+
+#ifndef DNS_DISPATCH_BOUNDUSES
+#define DNS_DISPATCH_BOUNDUSES			100
+#endif
+
 struct dispsocket {
 	unsigned int			magic;
 	isc_socket_t			*socket;
@@ -167,6 +203,9 @@ struct dispsocket {
 	ISC_LINK(dispsocket_t)		link;
 	unsigned int			bucket;
 	ISC_LINK(dispsocket_t)		blink;
+	ISC_LINK(dispsocket_t)		hlink;	/*%< bound set, by server */
+	isc_stdtime_t			expires; /*%< leaves the bound set */
+	unsigned int			uses;
 };
 
 /*%
@@ -212,7 +251,6 @@ struct dns_dispatch {
 	unsigned int		maxrequests;	/*%< max requests */
 	isc_event_t	       *ctlevent;
 
-	isc_mutex_t		sepool_lock;
 	isc_mempool_t	       *sepool;		/*%< pool for socket events */
 
 	/*% Locked by mgr->lock. */
@@ -228,14 +266,21 @@ struct dns_dispatch {
 				shutdown_out : 1,
 				connected : 1,
 				tcpmsg_valid : 1,
+				idlehold : 1,	/*%< held open while idle */
 				recv_pending : 1; /*%< is a recv() pending? */
 	isc_result_t		shutdown_why;
 	ISC_LIST(dispsocket_t)	activesockets;
 	ISC_LIST(dispsocket_t)	inactivesockets;
 	unsigned int		nsockets;
+	ISC_LIST(dispsocket_t)	boundsockets;	/*%< idle, still bound */
+	dispsocketlist_t	*bound_table;	/*%< boundsockets by server */
+	unsigned int		nbound;
+	isc_stdtime_t		boundsweep;	/*%< next expiry sweep */
 	unsigned int		requests;	/*%< how many requests we have */
 	unsigned int		tcpbuffers;	/*%< allocated buffers */
 	dns_tcpmsg_t		tcpmsg;		/*%< for tcp streams */
+	isc_timer_t		*idletimer;	/*%< releases idlehold */
+	unsigned int		idletime;	/*%< idlehold time (msec) */
 	dns_qid_t		*qid;
 	dispportlist_t		*port_table;	/*%< hold ports 'owned' by us */
 	isc_mempool_t		*portpool;	/*%< port table entries  */
@@ -259,6 +304,9 @@ struct dns_dispatch {
 #define DNS_QID(disp) ((disp)->socktype == isc_sockettype_tcp) ? \
 		       (disp)->qid : (disp)->mgr->qid
 
+#define BOUND_BUCKET(dest) \
+	(isc_sockaddr_hash((dest), false) % DNS_DISPATCH_BOUNDBUCKETS)
+
 /*%
  * Locking a query port buffer is a bit tricky.  We access the buffer without
  * locking until qid is created.  Technically, there is a possibility of race
@@ -278,10 +326,14 @@ static bool destroy_disp_ok(dns_dispatch_t *);
 static void destroy_disp(isc_task_t *task, isc_event_t *event);
 static void destroy_dispsocket(dns_dispatch_t *, dispsocket_t **);
 static void deactivate_dispsocket(dns_dispatch_t *, dispsocket_t *);
+static void flush_boundsockets(dns_dispatch_t *);
 static void udp_exrecv(isc_task_t *, isc_event_t *);
 static void udp_shrecv(isc_task_t *, isc_event_t *);
 static void udp_recv(isc_event_t *, dns_dispatch_t *, dispsocket_t *);
 static void tcp_recv(isc_task_t *, isc_event_t *);
+static void release_idlehold(dns_dispatch_t *);
+static void start_idletimer(dns_dispatch_t *);
+static void idle_timeout(isc_task_t *, isc_event_t *);
 static isc_result_t startrecv(dns_dispatch_t *, dispsocket_t *);
 static uint32_t dns_hash(dns_qid_t *, const isc_sockaddr_t *,
 			     dns_messageid_t, in_port_t);
@@ -298,6 +350,7 @@ static isc_result_t get_udpsocket(dns_dispatchmgr_t *mgr,
 				  dns_dispatch_t *disp,
 				  isc_socketmgr_t *sockmgr,
 				  const isc_sockaddr_t *localaddr,
+				  unsigned int attributes,
 				  isc_socket_t **sockp,
 				  isc_socket_t *dup_socket);
 static isc_result_t dispatch_createudp(dns_dispatchmgr_t *mgr,
@@ -495,6 +548,69 @@ destroy_disp_ok(dns_dispatch_t *disp)
 	return (true);
 }
 
+/*
+ * Drop the reference that keeps an idle TCP connection open.
+ *
+ * The dispatch must be locked.
+ */
+static void
+release_idlehold(dns_dispatch_t *disp) {
+	if (disp->idlehold == 0)
+		return;
+
+	disp->idlehold = 0;
+	INSIST(disp->refcount > 0);
+	disp->refcount--;
+	if (disp->refcount == 0) {
+		if (disp->recv_pending > 0)
+			isc_socket_cancel(disp->socket, disp->task[0],
+					  ISC_SOCKCANCEL_RECV);
+		disp->shutting_down = 1;
+	}
+
+	dispatch_log(disp, LVL(90), "released idle hold: refcount %d",
+		     disp->refcount);
+}
+
+/*
+ * The dispatch must be locked.
+ */
+static void
+start_idletimer(dns_dispatch_t *disp) {
+	isc_interval_t interval;
+	isc_result_t result;
+
+	isc_interval_set(&interval, disp->idletime / 1000,
+			 (disp->idletime % 1000) * 1000000);
+	result = isc_timer_reset(disp->idletimer, isc_timertype_once, NULL,
+				 &interval, true);
+	if (result != ISC_R_SUCCESS)
+		release_idlehold(disp);
+}
+
+/*
+ * The TCP connection has had no requests for disp->idletime.
+ */
+static void
+idle_timeout(isc_task_t *task, isc_event_t *event) {
+	dns_dispatch_t *disp = event->ev_arg;
+	bool killit;
+
+	UNUSED(task);
+
+	REQUIRE(VALID_DISPATCH(disp));
+
+	isc_event_free(&event);
+
+	LOCK(&disp->lock);
+	if (disp->requests == 0)
+		release_idlehold(disp);
+	killit = destroy_disp_ok(disp);
+	UNLOCK(&disp->lock);
+	if (killit)
+		isc_task_send(disp->task[0], &disp->ctlevent);
+}
+
 /*
  * Called when refcount reaches 0 (and safe to destroy).
  *
@@ -523,17 +639,20 @@ destroy_disp(isc_task_t *task, isc_event_t *event) {
 		     "shutting down; detaching from sock %p, task %p",
 		     disp->socket, disp->task[0]); /* XXXX */
 
-	if (disp->sepool != NULL) {
+	if (disp->sepool != NULL)
 		isc_mempool_destroy(&disp->sepool);
-		(void)isc_mutex_destroy(&disp->sepool_lock);
-	}
 
+	if (disp->idletimer != NULL)
+		isc_timer_detach(&disp->idletimer);
+	if (disp->socktype == isc_sockettype_tcp)
+		dec_stats(mgr, dns_resstatscounter_tcpconn);
 	if (disp->socket != NULL)
 		isc_socket_detach(&disp->socket);
 	while ((dispsocket = ISC_LIST_HEAD(disp->inactivesockets)) != NULL) {
 		ISC_LIST_UNLINK(disp->inactivesockets, dispsocket, link);
 		destroy_dispsocket(disp, &dispsocket);
 	}
+	flush_boundsockets(disp);
 	for (i = 0; i < disp->ntasks; i++)
 		isc_task_detach(&disp->task[i]);
 	isc_event_free(&event);
@@ -648,7 +767,179 @@ socket_search(dns_qid_t *qid, const isc_sockaddr_t *dest, in_port_t port,
 }
 
 /*%
- * Make a new socket for a single dispatch with a random port number.
+ * Close a dedicated dispatch socket which is not in use, releasing its
+ * port, and move it to the inactive list for future reuse unless the total
+ * number of sockets are exceeding the maximum.  The socket must not be in
+ * the qid's socket table.
+ * The caller must hold the disp->lock.
+ */
+static void
+close_dispsocket(dns_dispatch_t *disp, dispsocket_t *dispsock) {
+	isc_result_t result;
+
+	deref_portentry(disp, &dispsock->portentry);
+
+	if (disp->nsockets > DNS_DISPATCH_POOLSOCKS) {
+		destroy_dispsocket(disp, &dispsock);
+		return;
+	}
+
+	result = isc_socket_close(dispsock->socket);
+	if (result == ISC_R_SUCCESS)
+		ISC_LIST_APPEND(disp->inactivesockets, dispsock, link);
+	else {
+		/*
+		 * If the underlying system does not allow this
+		 * optimization, destroy this temporary structure (and
+		 * create a new one for a new transaction).
+		 */
+		INSIST(result == ISC_R_NOTIMPLEMENTED);
+		destroy_dispsocket(disp, &dispsock);
+	}
+}
+
+/*%
+ * Remove 'dispsock' from the bound set.
+ * The caller must hold the disp->lock.
+ */
+static void
+unlink_boundsocket(dns_dispatch_t *disp, dispsocket_t *dispsock) {
+	dns_dispatchmgr_t *mgr = disp->mgr;
+
+	ISC_LIST_UNLINK(disp->boundsockets, dispsock, link);
+	ISC_LIST_UNLINK(disp->bound_table[BOUND_BUCKET(&dispsock->host)],
+			dispsock, hlink);
+	INSIST(disp->nbound > 0);
+	disp->nbound--;
+
+	LOCK(&mgr->buffer_lock);
+	INSIST(mgr->nbound > 0);
+	mgr->nbound--;
+	UNLOCK(&mgr->buffer_lock);
+}
+
+/*%
+ * Put 'dispsock', whose transaction has ended, in the bound set for a
+ * later transaction with the same server.  Returns false, and leaves the
+ * socket alone, if it has had its time or its transactions in the set,
+ * or if the manager already keeps as many sockets as it may.
+ * The caller must hold the disp->lock.
+ */
+static bool
+keep_boundsocket(dns_dispatch_t *disp, dispsocket_t *dispsock,
+		 isc_stdtime_t now)
+{
+	dns_dispatchmgr_t *mgr = disp->mgr;
+	bool room;
+
+	if (disp->nsockets > DNS_DISPATCH_POOLSOCKS ||
+	    dispsock->uses >= DNS_DISPATCH_BOUNDUSES ||
+	    now >= dispsock->expires)
+		return (false);
+
+	LOCK(&mgr->buffer_lock);
+	room = (mgr->nbound < mgr->maxbound);
+	if (room)
+		mgr->nbound++;
+	UNLOCK(&mgr->buffer_lock);
+	if (!room)
+		return (false);
+
+	ISC_LIST_APPEND(disp->boundsockets, dispsock, link);
+	ISC_LIST_APPEND(disp->bound_table[BOUND_BUCKET(&dispsock->host)],
+			dispsock, hlink);
+	disp->nbound++;
+	return (true);
+}
+
+/*%
+ * Close the sockets in the bound set which have been open for
+ * DNS_DISPATCH_BOUNDTIME seconds, at most once a second, so that their
+ * ports leave the set even if no transaction picks them.
+ * The caller must hold the disp->lock.
+ */
+static void
+expire_boundsockets(dns_dispatch_t *disp, isc_stdtime_t now) {
+	dispsocket_t *dispsock, *next;
+
+	if (now < disp->boundsweep)
+		return;
+	disp->boundsweep = now + 1;
+
+	for (dispsock = ISC_LIST_HEAD(disp->boundsockets);
+	     dispsock != NULL;
+	     dispsock = next)
+	{
+		next = ISC_LIST_NEXT(dispsock, link);
+		if (dispsock->expires <= now) {
+			unlink_boundsocket(disp, dispsock);
+			close_dispsocket(disp, dispsock);
+		}
+	}
+}
+
+/*%
+ * Take a socket at random from those in the bound set whose last
+ * transaction was with 'dest', and discard anything that arrived for it
+ * while it was idle.  Returns NULL if there is no such socket; then no
+ * socket for 'dest' is left in the set.
+ * The caller must hold the disp->lock.
+ */
+static dispsocket_t *
+get_boundsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
+		unsigned int *bucketp)
+{
+	dispsocketlist_t *list = &disp->bound_table[BOUND_BUCKET(dest)];
+	dispsocket_t *dispsock;
+	dns_qid_t *qid = DNS_QID(disp);
+	unsigned int bucket, n, i;
+	in_port_t port;
+	bool inuse;
+
+	n = 0;
+	for (dispsock = ISC_LIST_HEAD(*list);
+	     dispsock != NULL;
+	     dispsock = ISC_LIST_NEXT(dispsock, hlink))
+	{
+		if (isc_sockaddr_equal(&dispsock->host, dest))
+			n++;
+	}
+
+	while (n > 0) {
+		i = isc_random_uniform(n--);
+		for (dispsock = ISC_LIST_HEAD(*list);
+		     dispsock != NULL;
+		     dispsock = ISC_LIST_NEXT(dispsock, hlink))
+		{
+			if (isc_sockaddr_equal(&dispsock->host, dest) &&
+			    i-- == 0)
+				break;
+		}
+		INSIST(dispsock != NULL);
+		unlink_boundsocket(disp, dispsock);
+		port = dispsock->portentry->port;
+
+		LOCK(&qid->lock);
+		bucket = dns_hash(qid, dest, 0, port);
+		inuse = (socket_search(qid, dest, port, bucket) != NULL);
+		UNLOCK(&qid->lock);
+		if (inuse ||
+		    isc_socket_purge(dispsock->socket) != ISC_R_SUCCESS)
+		{
+			close_dispsocket(disp, dispsock);
+			continue;
+		}
+
+		*bucketp = bucket;
+		return (dispsock);
+	}
+
+	return (NULL);
+}
+
+/*%
+ * Get a socket for a single dispatch with a random port number: a socket
+ * from the bound set last used with 'dest', or else a new one.
  * The caller must hold the disp->lock
  */
 static isc_result_t
@@ -669,6 +960,7 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 	isc_socket_options_t bindoptions;
 	dispportentry_t *portentry = NULL;
 	dns_qid_t *qid;
+	isc_stdtime_t now;
 
 	if (isc_sockaddr_pf(&disp->local) == AF_INET) {
 		nports = disp->mgr->nv4ports;
@@ -680,6 +972,26 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 	if (nports == 0)
 		return (ISC_R_ADDRNOTAVAIL);
 
+	qid = DNS_QID(disp);
+
+	/*
+	 * A bound socket is only used again with the server of its
+	 * previous transactions, and its port was chosen uniformly from
+	 * the whole range when it was opened, below.  So a port that one
+	 * server sees is never used for a transaction with another, and
+	 * it stays in use with its own server for at most
+	 * DNS_DISPATCH_BOUNDTIME seconds and DNS_DISPATCH_BOUNDUSES
+	 * transactions.
+	 */
+	isc_stdtime_get(&now);
+	expire_boundsockets(disp, now);
+	dispsock = get_boundsocket(disp, dest, &bucket);
+	if (dispsock != NULL) {
+		port = dispsock->portentry->port;
+		inc_stats(mgr, dns_resstatscounter_dispsockreuse);
+		goto found;
+	}
+
 	dispsock = ISC_LIST_HEAD(disp->inactivesockets);
 	if (dispsock != NULL) {
 		ISC_LIST_UNLINK(disp->inactivesockets, dispsock, link);
@@ -700,6 +1012,7 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 				&dispsock->task);
 		ISC_LINK_INIT(dispsock, link);
 		ISC_LINK_INIT(dispsock, blink);
+		ISC_LINK_INIT(dispsock, hlink);
 		dispsock->magic = DISPSOCK_MAGIC;
 	}
 
@@ -709,7 +1022,6 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 	 * very likely to fail in bind(2) or connect(2).
 	 */
 	localaddr = disp->local;
-	qid = DNS_QID(disp);
 
 	for (i = 0; i < 64; i++) {
 		port = ports[isc_random_uniform(nports)];
@@ -752,17 +1064,7 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 			break;
 	}
 
-	if (result == ISC_R_SUCCESS) {
-		dispsock->socket = sock;
-		dispsock->host = *dest;
-		dispsock->portentry = portentry;
-		dispsock->bucket = bucket;
-		LOCK(&qid->lock);
-		ISC_LIST_APPEND(qid->sock_table[bucket], dispsock, blink);
-		UNLOCK(&qid->lock);
-		*dispsockp = dispsock;
-		*portp = port;
-	} else {
+	if (result != ISC_R_SUCCESS) {
 		/*
 		 * We could keep it in the inactive list, but since this should
 		 * be an exceptional case and might be resource shortage, we'd
@@ -771,9 +1073,26 @@ get_dispsocket(dns_dispatch_t *disp, const isc_sockaddr_t *dest,
 		if (sock != NULL)
 			isc_socket_detach(&sock);
 		destroy_dispsocket(disp, &dispsock);
+		return (result);
 	}
 
-	return (result);
+	dispsock->socket = sock;
+	dispsock->portentry = portentry;
+	dispsock->expires = now + DNS_DISPATCH_BOUNDTIME;
+	dispsock->uses = 0;
+	inc_stats(mgr, dns_resstatscounter_dispsockopen);
+
+ found:
+	dispsock->host = *dest;
+	dispsock->bucket = bucket;
+	dispsock->uses++;
+	LOCK(&qid->lock);
+	ISC_LIST_APPEND(qid->sock_table[bucket], dispsock, blink);
+	UNLOCK(&qid->lock);
+	*dispsockp = dispsock;
+	*portp = port;
+
+	return (ISC_R_SUCCESS);
 }
 
 /*%
@@ -813,13 +1132,14 @@ destroy_dispsocket(dns_dispatch_t *disp, dispsocket_t **dispsockp) {
 }
 
 /*%
- * Deactivate a dedicated dispatch socket.  Move it to the inactive list for
- * future reuse unless the total number of sockets are exceeding the maximum.
+ * Deactivate a dedicated dispatch socket.  Keep it open and bound to its
+ * port in the bound set for a future transaction with the same server if
+ * possible, or else close it.
  */
 static void
 deactivate_dispsocket(dns_dispatch_t *disp, dispsocket_t *dispsock) {
-	isc_result_t result;
 	dns_qid_t *qid;
+	isc_stdtime_t now;
 
 	/*
 	 * The dispatch must be locked.
@@ -831,30 +1151,28 @@ deactivate_dispsocket(dns_dispatch_t *disp, dispsocket_t *dispsock) {
 	}
 
 	INSIST(dispsock->portentry != NULL);
-	deref_portentry(disp, &dispsock->portentry);
 
-	if (disp->nsockets > DNS_DISPATCH_POOLSOCKS)
-		destroy_dispsocket(disp, &dispsock);
-	else {
-		result = isc_socket_close(dispsock->socket);
+	qid = DNS_QID(disp);
+	LOCK(&qid->lock);
+	ISC_LIST_UNLINK(qid->sock_table[dispsock->bucket], dispsock, blink);
+	UNLOCK(&qid->lock);
 
-		qid = DNS_QID(disp);
-		LOCK(&qid->lock);
-		ISC_LIST_UNLINK(qid->sock_table[dispsock->bucket], dispsock,
-				blink);
-		UNLOCK(&qid->lock);
+	isc_stdtime_get(&now);
+	expire_boundsockets(disp, now);
+	if (!keep_boundsocket(disp, dispsock, now))
+		close_dispsocket(disp, dispsock);
+}
 
-		if (result == ISC_R_SUCCESS)
-			ISC_LIST_APPEND(disp->inactivesockets, dispsock, link);
-		else {
-			/*
-			 * If the underlying system does not allow this
-			 * optimization, destroy this temporary structure (and
-			 * create a new one for a new transaction).
-			 */
-			INSIST(result == ISC_R_NOTIMPLEMENTED);
-			destroy_dispsocket(disp, &dispsock);
-		}
+/*%
+ * Destroy every socket in the bound set.
+ */
+static void
+flush_boundsockets(dns_dispatch_t *disp) {
+	dispsocket_t *dispsock;
+
+	while ((dispsock = ISC_LIST_HEAD(disp->boundsockets)) != NULL) {
+		unlink_boundsocket(disp, dispsock);
+		destroy_dispsocket(disp, &dispsock);
 	}
 }
 
@@ -1481,7 +1799,10 @@ tcp_recv(isc_task_t *task, isc_event_t *ev_in) {
 	(void)startrecv(disp, NULL);
 
 	isc_event_free(&ev_in);
+	killit = destroy_disp_ok(disp);
 	UNLOCK(&disp->lock);
+	if (killit)
+		isc_task_send(disp->task[0], &disp->ctlevent);
 }
 
 /*
@@ -1636,15 +1957,10 @@ destroy_mgr(dns_dispatchmgr_t **mgrp) {
 	if (mgr->spool != NULL)
 		isc_mempool_destroy(&mgr->spool);
 
-	DESTROYLOCK(&mgr->spool_lock);
-	DESTROYLOCK(&mgr->bpool_lock);
-	DESTROYLOCK(&mgr->dpool_lock);
-	DESTROYLOCK(&mgr->rpool_lock);
-	DESTROYLOCK(&mgr->depool_lock);
-
 	if (mgr->qid != NULL)
 		qid_destroy(mctx, &mgr->qid);
 
+	INSIST(mgr->nbound == 0);
 	DESTROYLOCK(&mgr->buffer_lock);
 
 	if (mgr->blackhole != NULL)
@@ -1763,43 +2079,23 @@ dns_dispatchmgr_create(isc_mem_t *mctx, dns_dispatchmgr_t **mgrp)
 	if (result != ISC_R_SUCCESS)
 		goto kill_lock;
 
-	result = isc_mutex_init(&mgr->depool_lock);
-	if (result != ISC_R_SUCCESS)
-		goto kill_buffer_lock;
-
-	result = isc_mutex_init(&mgr->rpool_lock);
-	if (result != ISC_R_SUCCESS)
-		goto kill_depool_lock;
-
-	result = isc_mutex_init(&mgr->dpool_lock);
-	if (result != ISC_R_SUCCESS)
-		goto kill_rpool_lock;
-
-	result = isc_mutex_init(&mgr->bpool_lock);
-	if (result != ISC_R_SUCCESS)
-		goto kill_dpool_lock;
-
-	result = isc_mutex_init(&mgr->spool_lock);
-	if (result != ISC_R_SUCCESS)
-		goto kill_bpool_lock;
-
 	mgr->depool = NULL;
-	if (isc_mempool_create(mgr->mctx, sizeof(dns_dispatchevent_t),
-			       &mgr->depool) != ISC_R_SUCCESS) {
+	if (isc_mempool_createshared(mgr->mctx, sizeof(dns_dispatchevent_t),
+				     &mgr->depool) != ISC_R_SUCCESS) {
 		result = ISC_R_NOMEMORY;
-		goto kill_spool_lock;
+		goto kill_buffer_lock;
 	}
 
 	mgr->rpool = NULL;
-	if (isc_mempool_create(mgr->mctx, sizeof(dns_dispentry_t),
-			       &mgr->rpool) != ISC_R_SUCCESS) {
+	if (isc_mempool_createshared(mgr->mctx, sizeof(dns_dispentry_t),
+				     &mgr->rpool) != ISC_R_SUCCESS) {
 		result = ISC_R_NOMEMORY;
 		goto kill_depool;
 	}
 
 	mgr->dpool = NULL;
-	if (isc_mempool_create(mgr->mctx, sizeof(dns_dispatch_t),
-			       &mgr->dpool) != ISC_R_SUCCESS) {
+	if (isc_mempool_createshared(mgr->mctx, sizeof(dns_dispatch_t),
+				     &mgr->dpool) != ISC_R_SUCCESS) {
 		result = ISC_R_NOMEMORY;
 		goto kill_rpool;
 	}
@@ -1807,24 +2103,23 @@ dns_dispatchmgr_create(isc_mem_t *mctx, dns_dispatchmgr_t **mgrp)
 	isc_mempool_setname(mgr->depool, "dispmgr_depool");
 	isc_mempool_setmaxalloc(mgr->depool, 32768);
 	isc_mempool_setfreemax(mgr->depool, 32768);
-	isc_mempool_associatelock(mgr->depool, &mgr->depool_lock);
 	isc_mempool_setfillcount(mgr->depool, 32);
 
 	isc_mempool_setname(mgr->rpool, "dispmgr_rpool");
 	isc_mempool_setmaxalloc(mgr->rpool, 32768);
 	isc_mempool_setfreemax(mgr->rpool, 32768);
-	isc_mempool_associatelock(mgr->rpool, &mgr->rpool_lock);
 	isc_mempool_setfillcount(mgr->rpool, 32);
 
 	isc_mempool_setname(mgr->dpool, "dispmgr_dpool");
 	isc_mempool_setmaxalloc(mgr->dpool, 32768);
 	isc_mempool_setfreemax(mgr->dpool, 32768);
-	isc_mempool_associatelock(mgr->dpool, &mgr->dpool_lock);
 	isc_mempool_setfillcount(mgr->dpool, 32);
 
 	mgr->buffers = 0;
 	mgr->buffersize = 0;
 	mgr->maxbuffers = 0;
+	mgr->nbound = 0;
+	mgr->maxbound = DNS_DISPATCH_BOUNDSOCKS;
 	mgr->bpool = NULL;
 	mgr->spool = NULL;
 	mgr->qid = NULL;
@@ -1861,16 +2156,6 @@ dns_dispatchmgr_create(isc_mem_t *mctx, dns_dispatchmgr_t **mgrp)
 	isc_mempool_destroy(&mgr->rpool);
  kill_depool:
 	isc_mempool_destroy(&mgr->depool);
- kill_spool_lock:
-	DESTROYLOCK(&mgr->spool_lock);
- kill_bpool_lock:
-	DESTROYLOCK(&mgr->bpool_lock);
- kill_dpool_lock:
-	DESTROYLOCK(&mgr->dpool_lock);
- kill_rpool_lock:
-	DESTROYLOCK(&mgr->rpool_lock);
- kill_depool_lock:
-	DESTROYLOCK(&mgr->depool_lock);
  kill_buffer_lock:
 	DESTROYLOCK(&mgr->buffer_lock);
  kill_lock:
@@ -2026,7 +2311,8 @@ dns_dispatchmgr_setudp(dns_dispatchmgr_t *mgr,
 			mgr->maxbuffers = maxbuffers;
 		}
 	} else {
-		result = isc_mempool_create(mgr->mctx, buffersize, &mgr->bpool);
+		result = isc_mempool_createshared(mgr->mctx, buffersize,
+						  &mgr->bpool);
 		if (result != ISC_R_SUCCESS) {
 			UNLOCK(&mgr->buffer_lock);
 			return (result);
@@ -2034,7 +2320,6 @@ dns_dispatchmgr_setudp(dns_dispatchmgr_t *mgr,
 		isc_mempool_setname(mgr->bpool, "dispmgr_bpool");
 		isc_mempool_setmaxalloc(mgr->bpool, maxbuffers);
 		isc_mempool_setfreemax(mgr->bpool, maxbuffers);
-		isc_mempool_associatelock(mgr->bpool, &mgr->bpool_lock);
 		isc_mempool_setfillcount(mgr->bpool, 32);
 	}
 
@@ -2049,15 +2334,14 @@ dns_dispatchmgr_setudp(dns_dispatchmgr_t *mgr,
 		UNLOCK(&mgr->buffer_lock);
 		return (ISC_R_SUCCESS);
 	}
-	result = isc_mempool_create(mgr->mctx, sizeof(dispsocket_t),
-				    &mgr->spool);
+	result = isc_mempool_createshared(mgr->mctx, sizeof(dispsocket_t),
+					  &mgr->spool);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup;
 
 	isc_mempool_setname(mgr->spool, "dispmgr_spool");
 	isc_mempool_setmaxalloc(mgr->spool, maxrequests);
 	isc_mempool_setfreemax(mgr->spool, maxrequests);
-	isc_mempool_associatelock(mgr->spool, &mgr->spool_lock);
 	isc_mempool_setfillcount(mgr->spool, 32);
 
 	result = qid_allocate(mgr, buckets, increment, &mgr->qid, true);
@@ -2080,7 +2364,8 @@ dns_dispatchmgr_setudp(dns_dispatchmgr_t *mgr,
 void
 dns_dispatchmgr_destroy(dns_dispatchmgr_t **mgrp) {
 	dns_dispatchmgr_t *mgr;
-	bool killit;
+	dns_dispatch_t *disp;
+	bool killit, killdisp;
 
 	REQUIRE(mgrp != NULL);
 	REQUIRE(VALID_DISPATCHMGR(*mgrp));
@@ -2090,6 +2375,29 @@ dns_dispatchmgr_destroy(dns_dispatchmgr_t **mgrp) {
 
 	LOCK(&mgr->lock);
 	mgr->state |= MGR_SHUTTINGDOWN;
+
+	/*
+	 * Close TCP connections that are only being kept for reuse.
+	 * Dispatches that were already detached have sent their control
+	 * event, or will when their last receive completes, so only
+	 * those whose hold is dropped here are destroyed here.
+	 */
+	for (disp = ISC_LIST_HEAD(mgr->list);
+	     disp != NULL;
+	     disp = ISC_LIST_NEXT(disp, link))
+	{
+		LOCK(&disp->lock);
+		killdisp = false;
+		if (disp->idlehold != 0) {
+			release_idlehold(disp);
+			killdisp = (disp->ctlevent != NULL &&
+				    destroy_disp_ok(disp));
+		}
+		UNLOCK(&disp->lock);
+		if (killdisp)
+			isc_task_send(disp->task[0], &disp->ctlevent);
+	}
+
 	killit = destroy_mgr_ok(mgr);
 	UNLOCK(&mgr->lock);
 
@@ -2369,6 +2677,9 @@ dispatch_allocate(dns_dispatchmgr_t *mgr, unsigned int maxrequests,
 	disp->shutdown_out = 0;
 	disp->connected = 0;
 	disp->tcpmsg_valid = 0;
+	disp->idlehold = 0;
+	disp->idletimer = NULL;
+	disp->idletime = 0;
 	disp->shutdown_why = ISC_R_UNEXPECTED;
 	disp->requests = 0;
 	disp->tcpbuffers = 0;
@@ -2376,6 +2687,10 @@ dispatch_allocate(dns_dispatchmgr_t *mgr, unsigned int maxrequests,
 	ISC_LIST_INIT(disp->activesockets);
 	ISC_LIST_INIT(disp->inactivesockets);
 	disp->nsockets = 0;
+	ISC_LIST_INIT(disp->boundsockets);
+	disp->bound_table = NULL;
+	disp->nbound = 0;
+	disp->boundsweep = 0;
 	disp->port_table = NULL;
 	disp->portpool = NULL;
 	disp->dscp = -1;
@@ -2448,6 +2763,13 @@ dispatch_free(dns_dispatch_t **dispp) {
 			    DNS_DISPATCH_PORTTABLESIZE);
 	}
 
+	if (disp->bound_table != NULL) {
+		INSIST(disp->nbound == 0);
+		isc_mem_put(mgr->mctx, disp->bound_table,
+			    sizeof(disp->bound_table[0]) *
+			    DNS_DISPATCH_BOUNDBUCKETS);
+	}
+
 	if (disp->portpool != NULL)
 		isc_mempool_destroy(&disp->portpool);
 
@@ -2547,6 +2869,7 @@ dns_dispatch_createtcp(dns_dispatchmgr_t *mgr, isc_socket_t *sock,
 	ISC_LIST_APPEND(mgr->list, disp, link);
 	UNLOCK(&mgr->lock);
 
+	inc_stats(mgr, dns_resstatscounter_tcpconn);
 	mgr_log(mgr, LVL(90), "created TCP dispatcher %p", disp);
 	dispatch_log(disp, LVL(90), "created task %p", disp->task[0]);
 	*dispp = disp;
@@ -2646,6 +2969,47 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 	return (match ? ISC_R_SUCCESS : ISC_R_NOTFOUND);
 }
 
+isc_result_t
+dns_dispatch_setidle(dns_dispatch_t *disp, isc_timermgr_t *timermgr,
+		     unsigned int idle)
+{
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_DISPATCH(disp));
+	REQUIRE(disp->socktype == isc_sockettype_tcp);
+	REQUIRE(timermgr != NULL);
+
+	LOCK(&disp->lock);
+	INSIST(disp->refcount > (unsigned int)disp->idlehold);
+
+	if (idle == 0 || disp->shutting_down == 1) {
+		release_idlehold(disp);
+		goto unlock;
+	}
+
+	if (disp->idletimer == NULL) {
+		result = isc_timer_create(timermgr, isc_timertype_inactive,
+					  NULL, NULL, disp->task[0],
+					  idle_timeout, disp,
+					  &disp->idletimer);
+		if (result != ISC_R_SUCCESS)
+			goto unlock;
+	}
+
+	disp->idletime = idle;
+	if (disp->idlehold == 0) {
+		disp->idlehold = 1;
+		disp->refcount++;
+		dispatch_log(disp, LVL(90), "holding open for %u ms", idle);
+	}
+	if (disp->requests == 0)
+		start_idletimer(disp);
+
+ unlock:
+	UNLOCK(&disp->lock);
+	return (result);
+}
+
 isc_result_t
 dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 		    isc_taskmgr_t *taskmgr, const isc_sockaddr_t *localaddr,
@@ -2684,7 +3048,9 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	/*
 	 * See if we have a dispatcher that matches.
 	 */
-	if (dup_dispatch == NULL) {
+	if (dup_dispatch == NULL &&
+	    (attributes & DNS_DISPATCHATTR_REUSEPORT) == 0)
+	{
 		result = dispatch_find(mgr, localaddr, attributes, mask, &disp);
 		if (result == ISC_R_SUCCESS) {
 			disp->refcount++;
@@ -2758,7 +3124,8 @@ dns_dispatch_getudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 static isc_result_t
 get_udpsocket(dns_dispatchmgr_t *mgr, dns_dispatch_t *disp,
 	      isc_socketmgr_t *sockmgr, const isc_sockaddr_t *localaddr,
-	      isc_socket_t **sockp, isc_socket_t *dup_socket)
+	      unsigned int attributes, isc_socket_t **sockp,
+	      isc_socket_t *dup_socket)
 {
 	unsigned int i, j;
 	isc_socket_t *held[DNS_DISPATCH_HELD];
@@ -2814,9 +3181,17 @@ get_udpsocket(dns_dispatchmgr_t *mgr, dns_dispatch_t *disp,
 		 * choosing one.
 		 */
 	} else {
-		/* Allow to reuse address for non-random ports. */
-		result = open_socket(sockmgr, localaddr,
-				     ISC_SOCKET_REUSEADDRESS, &sock,
+		unsigned int options = ISC_SOCKET_REUSEADDRESS;
+
+		/*
+		 * Allow to reuse address for non-random ports, and
+		 * share the port with sibling listeners if asked to.
+		 */
+		if ((attributes & DNS_DISPATCHATTR_REUSEPORT) != 0) {
+			INSIST(dup_socket == NULL);
+			options |= ISC_SOCKET_REUSEPORT;
+		}
+		result = open_socket(sockmgr, localaddr, options, &sock,
 				     dup_socket);
 
 		if (result == ISC_R_SUCCESS)
@@ -2872,6 +3247,7 @@ dispatch_createudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	isc_result_t result;
 	dns_dispatch_t *disp;
 	isc_socket_t *sock = NULL;
+	unsigned int maxsocks;
 	int i = 0;
 
 	/*
@@ -2885,8 +3261,8 @@ dispatch_createudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	disp->socktype = isc_sockettype_udp;
 
 	if ((attributes & DNS_DISPATCHATTR_EXCLUSIVE) == 0) {
-		result = get_udpsocket(mgr, disp, sockmgr, localaddr, &sock,
-				       dup_socket);
+		result = get_udpsocket(mgr, disp, sockmgr, localaddr,
+				       attributes, &sock, dup_socket);
 		if (result != ISC_R_SUCCESS)
 			goto deallocate_dispatch;
 
@@ -2926,6 +3302,23 @@ dispatch_createudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 		for (i = 0; i < DNS_DISPATCH_PORTTABLESIZE; i++)
 			ISC_LIST_INIT(disp->port_table[i]);
 
+		disp->bound_table = isc_mem_get(mgr->mctx,
+						sizeof(disp->bound_table[0]) *
+						DNS_DISPATCH_BOUNDBUCKETS);
+		if (disp->bound_table == NULL)
+			goto deallocate_dispatch;
+		for (i = 0; i < DNS_DISPATCH_BOUNDBUCKETS; i++)
+			ISC_LIST_INIT(disp->bound_table[i]);
+
+		if (isc_socketmgr_getmaxsockets(sockmgr, &maxsocks) ==
+		    ISC_R_SUCCESS)
+		{
+			LOCK(&mgr->buffer_lock);
+			if (mgr->maxbound > maxsocks / 8)
+				mgr->maxbound = maxsocks / 8;
+			UNLOCK(&mgr->buffer_lock);
+		}
+
 		result = isc_mempool_create(mgr->mctx, sizeof(dispportentry_t),
 					    &disp->portpool);
 		if (result != ISC_R_SUCCESS)
@@ -2963,21 +3356,16 @@ dispatch_createudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	}
 
 	disp->sepool = NULL;
-	if (isc_mempool_create(mgr->mctx, sizeof(isc_socketevent_t),
-			       &disp->sepool) != ISC_R_SUCCESS)
+	if (isc_mempool_createshared(mgr->mctx, sizeof(isc_socketevent_t),
+				     &disp->sepool) != ISC_R_SUCCESS)
 	{
 		result = ISC_R_NOMEMORY;
 		goto kill_ctlevent;
 	}
 
-	result = isc_mutex_init(&disp->sepool_lock);
-	if (result != ISC_R_SUCCESS)
-		goto kill_sepool;
-
 	isc_mempool_setname(disp->sepool, "disp_sepool");
 	isc_mempool_setmaxalloc(disp->sepool, 32768);
 	isc_mempool_setfreemax(disp->sepool, 32768);
-	isc_mempool_associatelock(disp->sepool, &disp->sepool_lock);
 	isc_mempool_setfillcount(disp->sepool, 16);
 
 	attributes &= ~DNS_DISPATCHATTR_TCP;
@@ -3001,8 +3389,6 @@ dispatch_createudp(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
 	/*
 	 * Error returns.
 	 */
- kill_sepool:
-	isc_mempool_destroy(&disp->sepool);
  kill_ctlevent:
 	isc_event_free(&disp->ctlevent);
  kill_task:
@@ -3440,8 +3826,11 @@ dns_dispatch_removeresponse(dns_dispentry_t **resp,
 	isc_mempool_put(disp->mgr->rpool, res);
 	if (disp->shutting_down == 1)
 		do_cancel(disp);
-	else
+	else {
 		(void)startrecv(disp, NULL);
+		if (disp->requests == 0 && disp->idlehold == 1)
+			start_idletimer(disp);
+	}
 
 	killit = destroy_disp_ok(disp);
 	UNLOCK(&disp->lock);
@@ -3455,6 +3844,11 @@ do_cancel(dns_dispatch_t *disp) {
 	dns_dispentry_t *resp;
 	dns_qid_t *qid;
 
+	/*
+	 * A broken connection is not worth keeping open.
+	 */
+	release_idlehold(disp);
+
 	if (disp->shutdown_out == 1)
 		return;
 
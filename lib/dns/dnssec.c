@@ -22,6 +22,7 @@
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/serial.h>
+#include <isc/sha2.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -39,6 +40,7 @@
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #include <dns/result.h>
+#include <dns/sigcache.h>
 #include <dns/stats.h>
 #include <dns/tsig.h>		/* for DNS_TSIG_FUDGE */
 
@@ -364,24 +366,92 @@ cleanup_signature:
 	return (ret);
 }
 
+/*
+ * Compute the signature cache digest for verifying 'sigrdata' with 'key'
+ * over the RRset whose envelope is 'env' and whose sorted rdata are
+ * 'rdatas'.  Every variable length part is preceded by its length.
+ */
+static isc_result_t
+sigcache_digest(dst_key_t *key, unsigned int maxbits, dns_rdata_t *sigrdata,
+		isc_region_t *env, dns_rdata_t *rdatas, int nrdatas,
+		unsigned char *digest)
+{
+	isc_result_t ret;
+	isc_sha256_t sha256;
+	isc_buffer_t keybuf, lenbuf;
+	isc_region_t r;
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	unsigned char len[4];
+	int i;
+
+	isc_buffer_init(&keybuf, keydata, sizeof(keydata));
+	ret = dst_key_todns(key, &keybuf);
+	if (ret != ISC_R_SUCCESS)
+		return (ret);
+
+	isc_sha256_init(&sha256);
+
+	isc_buffer_init(&lenbuf, len, sizeof(len));
+	isc_buffer_putuint32(&lenbuf, maxbits);
+	isc_sha256_update(&sha256, len, 4);
+
+	isc_buffer_usedregion(&keybuf, &r);
+	isc_buffer_init(&lenbuf, len, sizeof(len));
+	isc_buffer_putuint16(&lenbuf, (uint16_t)r.length);
+	isc_sha256_update(&sha256, len, 2);
+	isc_sha256_update(&sha256, r.base, r.length);
+
+	isc_buffer_init(&lenbuf, len, sizeof(len));
+	isc_buffer_putuint16(&lenbuf, (uint16_t)sigrdata->length);
+	isc_sha256_update(&sha256, len, 2);
+	isc_sha256_update(&sha256, sigrdata->data, sigrdata->length);
+
+	/* The envelope starts with a name, so it delimits itself. */
+	isc_sha256_update(&sha256, env->base, env->length);
+
+	for (i = 0; i < nrdatas; i++) {
+		if (i > 0 && dns_rdata_compare(&rdatas[i], &rdatas[i-1]) == 0)
+			continue;
+		isc_buffer_init(&lenbuf, len, sizeof(len));
+		isc_buffer_putuint16(&lenbuf, (uint16_t)rdatas[i].length);
+		isc_sha256_update(&sha256, len, 2);
+		isc_sha256_update(&sha256, rdatas[i].data, rdatas[i].length);
+	}
+
+	isc_sha256_final(digest, &sha256);
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		  bool ignoretime, unsigned int maxbits,
 		  isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild)
+{
+	return (dns_dnssec_verify2(name, set, key, ignoretime, maxbits, mctx,
+				   sigrdata, wild, NULL, NULL));
+}
+
+isc_result_t
+dns_dnssec_verify2(const dns_name_t *name, dns_rdataset_t *set,
+		   dst_key_t *key, bool ignoretime, unsigned int maxbits,
+		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild,
+		   dns_sigcache_t *sigcache, bool *cachedp)
 {
 	dns_rdata_rrsig_t sig;
 	dns_fixedname_t fnewname;
-	isc_region_t r;
+	isc_region_t r, envr;
 	isc_buffer_t envbuf;
 	dns_rdata_t *rdatas;
 	int nrdatas, i;
 	isc_stdtime_t now;
 	isc_result_t ret;
 	unsigned char data[300];
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
 	dst_context_t *ctx = NULL;
 	int labels = 0;
 	uint32_t flags;
 	bool downcase = false;
+	bool cached = false;
 
 	REQUIRE(name != NULL);
 	REQUIRE(set != NULL);
@@ -389,6 +459,9 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	REQUIRE(mctx != NULL);
 	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
 
+	if (cachedp != NULL)
+		*cachedp = false;
+
 	ret = dns_rdata_tostruct(sigrdata, &sig, NULL);
 	if (ret != ISC_R_SUCCESS)
 		return (ret);
@@ -456,19 +529,6 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		return (DNS_R_KEYUNAUTHORIZED);
 	}
 
- again:
-	ret = dst_context_create(key, mctx, DNS_LOGCATEGORY_DNSSEC,
-				 false, maxbits, &ctx);
-	if (ret != ISC_R_SUCCESS)
-		goto cleanup_struct;
-
-	/*
-	 * Digest the SIG rdata (not including the signature).
-	 */
-	ret = digest_sig(ctx, downcase, sigrdata, &sig);
-	if (ret != ISC_R_SUCCESS)
-		goto cleanup_context;
-
 	/*
 	 * If the name is an expanded wildcard, use the wildcard name.
 	 */
@@ -500,9 +560,37 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 
 	ret = rdataset_to_sortedarray(set, mctx, &rdatas, &nrdatas);
 	if (ret != ISC_R_SUCCESS)
-		goto cleanup_context;
+		goto cleanup_struct;
 
-	isc_buffer_usedregion(&envbuf, &r);
+	isc_buffer_usedregion(&envbuf, &envr);
+
+	/*
+	 * A signature found in the cache has been verified before, so
+	 * skip the public key operation.
+	 */
+	if (sigcache != NULL) {
+		ret = sigcache_digest(key, maxbits, sigrdata, &envr,
+				      rdatas, nrdatas, digest);
+		if (ret != ISC_R_SUCCESS)
+			goto cleanup_array;
+		if (dns_sigcache_find(sigcache, digest)) {
+			cached = true;
+			goto cleanup_array;
+		}
+	}
+
+ again:
+	ret = dst_context_create(key, mctx, DNS_LOGCATEGORY_DNSSEC,
+				 false, maxbits, &ctx);
+	if (ret != ISC_R_SUCCESS)
+		goto cleanup_array;
+
+	/*
+	 * Digest the SIG rdata (not including the signature).
+	 */
+	ret = digest_sig(ctx, downcase, sigrdata, &sig);
+	if (ret != ISC_R_SUCCESS)
+		goto cleanup_context;
 
 	for (i = 0; i < nrdatas; i++) {
 		uint16_t len;
@@ -518,9 +606,9 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		/*
 		 * Digest the envelope.
 		 */
-		ret = dst_context_adddata(ctx, &r);
+		ret = dst_context_adddata(ctx, &envr);
 		if (ret != ISC_R_SUCCESS)
-			goto cleanup_array;
+			goto cleanup_context;
 
 		/*
 		 * Digest the rdata length.
@@ -535,10 +623,10 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		 */
 		ret = dst_context_adddata(ctx, &lenr);
 		if (ret != ISC_R_SUCCESS)
-			goto cleanup_array;
+			goto cleanup_context;
 		ret = dns_rdata_digest(&rdatas[i], digest_callback, ctx);
 		if (ret != ISC_R_SUCCESS)
-			goto cleanup_array;
+			goto cleanup_context;
 	}
 
 	r.base = sig.signature;
@@ -555,14 +643,16 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	} else if (ret == ISC_R_SUCCESS)
 		inc_stat(dns_dnssecstats_asis);
 
-cleanup_array:
-	isc_mem_put(mctx, rdatas, nrdatas * sizeof(dns_rdata_t));
 cleanup_context:
 	dst_context_destroy(&ctx);
 	if (ret == DST_R_VERIFYFAILURE && !downcase) {
 		downcase = true;
 		goto again;
 	}
+	if (ret == ISC_R_SUCCESS && sigcache != NULL)
+		dns_sigcache_add(sigcache, digest);
+cleanup_array:
+	isc_mem_put(mctx, rdatas, nrdatas * sizeof(dns_rdata_t));
 cleanup_struct:
 	dns_rdata_freestruct(&sig);
 
@@ -580,6 +670,8 @@ cleanup_struct:
 		inc_stat(dns_dnssecstats_wildcard);
 		ret = DNS_R_FROMWILDCARD;
 	}
+	if (cachedp != NULL)
+		*cachedp = cached;
 	return (ret);
 }
 
@@ -589,7 +589,8 @@ static dns_dbmethods_t ecdb_methods = {
 	NULL,			/* getsize */
 	NULL,			/* setservestalettl */
 	NULL,			/* getservestalettl */
-	NULL			/* setgluecachestats */
+	NULL,			/* setgluecachestats */
+	NULL			/* nodememory */
 };
 
 static isc_result_t
@@ -43,35 +43,67 @@ ISC_LANG_BEGINDECLS
 #define DNS_COMPRESS_ALL		0x01	/*%< all compression. */
 #define DNS_COMPRESS_CASESENSITIVE	0x02	/*%< case sensitive compression. */
 #define DNS_COMPRESS_ENABLED		0x04
+#define DNS_COMPRESS_LEGACY		0x08	/*%< legacy compression table. */
 
 /*
+ * The compression context indexes every label written to the message.
+ * A label's node is found by hashing the label together with the
+ * offset of the rest of its name, so the longest suffix of a name that
+ * is already in the message is found with one probe per label, walking
+ * from the root.  The index starts in the preallocated arrays below
+ * and grows with the message.
+ *
+ * DNS_COMPRESS_INITIALBUCKETS must be a power of 2.
+ */
+#define DNS_COMPRESS_INITIALBUCKETS	64
+#define DNS_COMPRESS_INITIALNODES	64
+#define DNS_COMPRESS_INITIALLABELS	512
+
+/*
+ * The legacy table, which only holds the first two suffixes of each
+ * name and looks them up by the first character of the name.  It is
+ * kept so that messages can be rendered exactly as older versions
+ * did, for tests.
+ *
  * DNS_COMPRESS_TABLESIZE must be a power of 2. The compress code
  * utilizes this assumption.
  */
 #define DNS_COMPRESS_TABLEBITS 6
 #define DNS_COMPRESS_TABLESIZE (1U << DNS_COMPRESS_TABLEBITS)
 #define DNS_COMPRESS_TABLEMASK (DNS_COMPRESS_TABLESIZE - 1)
-#define DNS_COMPRESS_INITIALNODES 16
 
 typedef struct dns_compressnode dns_compressnode_t;
+typedef struct dns_compresslegacy dns_compresslegacy_t;
 
 struct dns_compressnode {
-	dns_compressnode_t	*next;
-	uint16_t		offset;
-	uint16_t		count;
-	isc_region_t            r;
-	dns_name_t              name;
+	uint16_t		offset;		/*%< Label's message offset. */
+	uint16_t		parent;		/*%< Offset of rest of name. */
+	uint16_t		label;		/*%< Label's place in labels. */
+	uint16_t		hash;		/*%< Hash of label and parent. */
+	uint16_t		next;		/*%< Next in bucket, plus one. */
 };
 
 struct dns_compress {
 	unsigned int		magic;		/*%< Magic number. */
 	unsigned int		allowed;	/*%< Allowed methods. */
 	int			edns;		/*%< Edns version or -1. */
-	/*% Global compression table. */
-	dns_compressnode_t	*table[DNS_COMPRESS_TABLESIZE];
-	/*% Preallocated nodes for the table. */
+	/*% Suffix index: bucket heads, plus one, or 0. */
+	uint16_t		*buckets;
+	unsigned int		nbuckets;
+	/*% Nodes, in the order they were added. */
+	dns_compressnode_t	*nodes;
+	unsigned int		count;		/*%< Number of nodes. */
+	unsigned int		size;
+	/*% Copies of the labels of the nodes. */
+	unsigned char		*labels;
+	unsigned int		labelsused;
+	unsigned int		labelssize;
+	/*% Preallocated storage for the index. */
+	uint16_t		initialbuckets[DNS_COMPRESS_INITIALBUCKETS];
 	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
-	uint16_t		count;		/*%< Number of nodes. */
+	unsigned char		initiallabels[DNS_COMPRESS_INITIALLABELS];
+	/*% Legacy compression table. */
+	dns_compresslegacy_t	*table[DNS_COMPRESS_TABLESIZE];
 	isc_mem_t		*mctx;		/*%< Memory context. */
 };
 
@@ -170,6 +202,18 @@ dns_compress_getsensitive(dns_compress_t *cctx);
  *		'cctx' to be initialized.
  */
 
+void
+dns_compress_setlegacy(dns_compress_t *cctx, bool legacy);
+/*%<
+ *	Use the legacy compression table, which finds fewer suffixes
+ *	to compress against but renders names exactly as older
+ *	versions did.  This is meant for tests that compare message
+ *	contents.
+ *
+ *	Requires:
+ *\li		'cctx' to be initialized, with no names added.
+ */
+
 int
 dns_compress_getedns(dns_compress_t *cctx);
 
@@ -188,6 +232,8 @@ dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 			dns_name_t *prefix, uint16_t *offset);
 /*%<
  *	Finds longest possible match of 'name' in the global compression table.
+ *	Unless the legacy table is in use, every suffix of every name
+ *	added is considered.
  *
  *	Requires:
  *\li		'cctx' to be initialized.
@@ -196,6 +196,7 @@ typedef struct dns_dbmethods {
 	isc_result_t	(*setservestalettl)(dns_db_t *db, dns_ttl_t ttl);
 	isc_result_t	(*getservestalettl)(dns_db_t *db, dns_ttl_t *ttl);
 	isc_result_t	(*setgluecachestats)(dns_db_t *db, isc_stats_t *stats);
+	size_t		(*nodememory)(dns_db_t *db);
 } dns_dbmethods_t;
 
 typedef isc_result_t
@@ -1362,6 +1363,21 @@ dns_db_nodecount(dns_db_t *db);
  * \li	The number of nodes in the database
  */
 
+size_t
+dns_db_nodememory(dns_db_t *db);
+/*%<
+ * For database implementations using an RBT, report the number of
+ * bytes taken by the tree's nodes.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * Returns:
+ * \li	The memory used by the nodes of the database, or 0 if not
+ *      implemented.
+ */
+
 size_t
 dns_db_hashsize(dns_db_t *db);
 /*%<
@@ -129,6 +129,12 @@ struct dns_dispatchset {
  *
  * _EXCLUSIVE
  *	A separate socket will be used on-demand for each transaction.
+ *
+ * _REUSEPORT
+ *	The dispatcher gets its own socket bound with SO_REUSEPORT, so that
+ *	several dispatchers can listen on the same address and port and
+ *	the kernel will balance incoming packets between them.  Such a
+ *	dispatcher is never shared through dns_dispatch_getudp().
  */
 #define DNS_DISPATCHATTR_PRIVATE	0x00000001U
 #define DNS_DISPATCHATTR_TCP		0x00000002U
@@ -140,6 +146,7 @@ struct dns_dispatchset {
 #define DNS_DISPATCHATTR_CONNECTED	0x00000080U
 #define DNS_DISPATCHATTR_FIXEDID	0x00000100U
 #define DNS_DISPATCHATTR_EXCLUSIVE	0x00000200U
+#define DNS_DISPATCHATTR_REUSEPORT	0x00000400U
 /*@}*/
 
 /*
@@ -373,6 +380,27 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
  * if connected == NULL).
  */
 
+isc_result_t
+dns_dispatch_setidle(dns_dispatch_t *disp, isc_timermgr_t *timermgr,
+		     unsigned int idle);
+/*%<
+ * Keep the TCP connection of 'disp' open for 'idle' milliseconds after
+ * its last response entry is removed, even if nothing else is attached
+ * to it, so that dns_dispatch_gettcp() can find it for later queries to
+ * the same server.  The connection is closed early if the server
+ * closes it.  A later call replaces 'idle'; 'idle' == 0 stops keeping
+ * the connection open.
+ *
+ * Requires:
+ *\li	'disp' is a valid TCP dispatch, and the caller is attached to it.
+ *
+ *\li	'timermgr' is a valid timer manager.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	Anything else	-- the connection is not kept open.
+ */
+
 
 isc_result_t
 dns_dispatch_addresponse(dns_dispatch_t *disp, unsigned int options,
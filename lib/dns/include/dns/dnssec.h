@@ -122,6 +122,12 @@ isc_result_t
 dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		  bool ignoretime, unsigned int maxbits,
 		  isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild);
+
+isc_result_t
+dns_dnssec_verify2(const dns_name_t *name, dns_rdataset_t *set,
+		   dst_key_t *key, bool ignoretime, unsigned int maxbits,
+		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild,
+		   dns_sigcache_t *sigcache, bool *cachedp);
 /*%<
  *	Verifies the RRSIG record covering this rdataset signed by a specific
  *	key.  This does not determine if the key's owner is authorized to sign
@@ -130,6 +136,11 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
  *
  *	'maxbits' specifies the maximum number of rsa exponent bits accepted.
  *
+ *	If 'sigcache' is not NULL, dns_dnssec_verify2() skips the
+ *	cryptographic verification of a signature found in it, and adds
+ *	each signature that verifies to it.  If 'cachedp' is not NULL,
+ *	'*cachedp' is set to whether the signature was found there.
+ *
  *	Requires:
  *\li		'name' (the owner name of the record) is a valid name
  *\li		'set' is a valid rdataset
@@ -170,6 +170,8 @@ typedef int dns_messagetextflag_t;
 						   source buffer */
 #define DNS_MESSAGEPARSE_IGNORETRUNCATION 0x0008 /*%< truncation errors are
 						  * not fatal. */
+#define DNS_MESSAGEPARSE_NOCOPY		0x0010	/*%< refer to the source
+						   buffer where possible */
 
 /*
  * Control behavior of rendering
@@ -207,6 +209,10 @@ struct dns_message {
 	/* private from here down */
 	dns_namelist_t			sections[DNS_SECTION_MAX];
 	dns_name_t		       *cursors[DNS_SECTION_MAX];
+	/* Hash tables of the names in large sections, built on demand. */
+	dns_name_t		      **index[DNS_SECTION_MAX];
+	unsigned int			indexsize[DNS_SECTION_MAX];
+	unsigned int			indexcount[DNS_SECTION_MAX];
 	dns_rdataset_t		       *opt;
 	dns_rdataset_t		       *sig0;
 	dns_rdataset_t		       *tsig;
@@ -450,6 +456,12 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
  * If #DNS_MESSAGEPARSE_IGNORETRUNCATION is set then return as many complete
  * RR's as possible, DNS_R_RECOVERABLE will be returned.
  *
+ * If #DNS_MESSAGEPARSE_NOCOPY is set, owner names that are not compressed,
+ * and the rdata of OPT records and of class IN A and AAAA records, refer to
+ * 'source' instead of being copied into the message.  The contents of
+ * 'source' must then not change until the message is reset or destroyed.
+ * It is ignored if #DNS_MESSAGEPARSE_CLONEBUFFER is also set.
+ *
  * OPT and TSIG records are always handled specially, regardless of the
  * 'preserve_order' setting.
  *
@@ -44,7 +44,13 @@ ISC_LANG_BEGINDECLS
 #endif
 #endif
 
-#define DNS_RBT_USEMAGIC 1
+/*
+ * The node magic number costs 8 bytes per node, with padding, so it is
+ * only checked when the library is built with DNS_RBT_USEMAGIC=1.
+ */
+#ifndef DNS_RBT_USEMAGIC
+#define DNS_RBT_USEMAGIC 0
+#endif
 
 /*
  * These should add up to 30.
@@ -52,6 +58,12 @@ ISC_LANG_BEGINDECLS
 #define DNS_RBT_LOCKLENGTH                      10
 #define DNS_RBT_REFLENGTH                       20
 
+/*
+ * Bits left for the dead node index in the word with the node lock
+ * bitfields.
+ */
+#define DNS_RBT_DEADINDEXLENGTH                 20
+
 #define DNS_RBTNODE_MAGIC               ISC_MAGIC('R','B','N','O')
 #if DNS_RBT_USEMAGIC
 #define DNS_RBTNODE_VALID(n)            ISC_MAGIC_VALID(n, DNS_RBTNODE_MAGIC)
@@ -80,13 +92,14 @@ struct dns_rbtnode {
 	/*@{*/
 	/*!
 	 * The following bitfields add up to a total bitwidth of 32.
-	 * The range of values necessary for each item is indicated,
-	 * but in the case of "attributes" the field is wider to accommodate
-	 * possible future expansion.
+	 * The range of values necessary for each item is indicated.
 	 *
 	 * In each case below the "range" indicated is what's _necessary_ for
 	 * the bitfield to hold, not what it actually _can_ hold.
 	 *
+	 * Whether the name is absolute is not stored: only a name that
+	 * ends in the root label can be, so it is taken from the name.
+	 *
 	 * Note: Tree lock must be held before modifying these
 	 * bit-fields.
 	 *
@@ -101,29 +114,26 @@ struct dns_rbtnode {
 	unsigned int is_root : 1;       /*%< range is 0..1 */
 	unsigned int color : 1;         /*%< range is 0..1 */
 	unsigned int find_callback : 1; /*%< range is 0..1 */
-	unsigned int attributes : 3;    /*%< range is 0..2 */
 	unsigned int nsec : 2;          /*%< range is 0..3 */
 	unsigned int namelen : 8;       /*%< range is 1..255 */
 	unsigned int offsetlen : 8;     /*%< range is 1..128 */
 	unsigned int oldnamelen : 8;    /*%< range is 1..255 */
-	/*@}*/
 
 	/* flags needed for serialization to file */
 	unsigned int is_mmapped : 1;
-	unsigned int parent_is_relative : 1;
-	unsigned int left_is_relative : 1;
-	unsigned int right_is_relative : 1;
-	unsigned int down_is_relative : 1;
-	unsigned int data_is_relative : 1;
+	unsigned int is_relative : 1;   /*%< non-NULL pointers are offsets */
 
 	/* node needs to be cleaned from rpz */
 	unsigned int rpz : 1;
 	unsigned int :0;                /* end of bitfields c/o tree lock */
+	/*@}*/
 
 	/*%
-	 * These are needed for hashing. The 'uppernode' points to the
-	 * node's superdomain node in the parent subtree, so that it can
-	 * be reached from a child that was found by a hash lookup.
+	 * These are needed for hashing.  The hash value is set when the
+	 * node is added, so it can share a qword with the bitfields
+	 * above.  The 'uppernode' points to the node's superdomain node
+	 * in the parent subtree, so that it can be reached from a child
+	 * that was found by a hash lookup.
 	 */
 	unsigned int hashval;
 	dns_rbtnode_t *uppernode;
@@ -134,13 +144,6 @@ struct dns_rbtnode {
 	dns_rbtnode_t *right;
 	dns_rbtnode_t *down;
 
-	/*%
-	 * Used for LRU cache.  This linked list is used to mark nodes which
-	 * have no data any longer, but we cannot unlink at that exact moment
-	 * because we did not or could not obtain a write lock on the tree.
-	 */
-	ISC_LINK(dns_rbtnode_t) deadlink;
-
 	/*@{*/
 	/*!
 	 * These values are used in the RBT DB implementation.  The appropriate
@@ -167,9 +170,25 @@ struct dns_rbtnode {
 #ifndef DNS_RBT_USEISCREFCOUNT
 	unsigned int references:DNS_RBT_REFLENGTH;
 #endif
+
+	/*%
+	 * Used for LRU cache.  Nodes which have no data any longer, but
+	 * which we cannot unlink at that exact moment because we did not
+	 * or could not obtain a write lock on the tree, are kept in a
+	 * per-bucket array of dead nodes.  This is the node's position in
+	 * that array plus one, or zero if it is not there.  It is all
+	 * ones for a dead node that the array couldn't take.
+	 */
+	unsigned int deadindex:DNS_RBT_DEADINDEXLENGTH;
 	unsigned int :0;                /* end of bitfields c/o node lock */
+
 #ifdef DNS_RBT_USEISCREFCOUNT
-	isc_refcount_t references; /* note that this is not in the bitfield */
+	/*%
+	 * The reference count is changed under the node lock too, but it
+	 * is atomic rather than a bitfield, so it shares a qword with the
+	 * bitfields above.
+	 */
+	isc_refcount_t references;
 #endif
 	/*@}*/
 };
@@ -689,6 +708,16 @@ dns_rbt_nodecount(dns_rbt_t *rbt);
  * \li  rbt is a valid rbt manager.
  */
 
+size_t
+dns_rbt_nodememory(dns_rbt_t *rbt);
+/*%<
+ * Obtain the number of bytes taken by the nodes in the tree of trees,
+ * including the names and offset tables stored with them.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ */
+
 size_t
 dns_rbt_hashsize(dns_rbt_t *rbt);
 /*%<
@@ -177,7 +177,8 @@ dns_resolver_create(dns_view_t *view,
  *
  *\li	'taskmgr' is a valid task manager.
  *
- *\li	'ntasks' > 0.
+ *\li	'ntasks' > 0.  Fetch contexts are hashed by name into
+ *	'ntasks' buckets, each with its own lock and task.
  *
  *\li	'socketmgr' is a valid socket manager.
  *
@@ -737,6 +738,20 @@ void
 dns_resolver_dumpfetches(dns_resolver_t *resolver,
 			 isc_statsformat_t format, FILE *fp);
 
+void
+dns_resolver_dumpshards(dns_resolver_t *resolver,
+			isc_statsformat_t format, FILE *fp);
+/*%<
+ * Write one line per fetch context bucket to 'fp': the fetch contexts
+ * it holds now, how many it has created, and how many fetches joined
+ * one already running.
+ *
+ * Requires:
+ * \li	'resolver' to be valid.
+ * \li	'format' to be isc_statsformat_file.
+ * \li	'fp' to be a valid FILE pointer.
+ */
+
 
 #ifdef ENABLE_AFL
 /*%
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#ifndef DNS_RESPCACHE_H
+#define DNS_RESPCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/respcache.h
+ * \brief
+ * Defines dns_respcache_t, a cache of rendered responses.
+ *
+ * Notes:
+ *\li	A response cache holds complete responses in wire format, as
+ *	they were rendered for a query, so that the same query can be
+ *	answered again by copying them.  It is used by the server for
+ *	authoritative answers.
+ *
+ *\li	A response is stored under the query name, compared
+ *	case-sensitively because the response repeats it, the query
+ *	type, a set of caller-defined options describing everything
+ *	else the response depends on, and the database and SOA serial
+ *	it was built from.  A response built from an older version or an
+ *	older database never matches, and is replaced by the next one
+ *	added for the same query.
+ *
+ *\li	Responses do not hold references to their databases.  A
+ *	database that may be found at the address of a freed one is
+ *	announced with dns_respcache_newdb(), so that no response cache
+ *	mistakes it for the old one.
+ *
+ *\li	The cache is split into stripes, each with its own lock, hash
+ *	table and LRU list, and a share of the configured size.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	The memory used by the cached responses, their names and the
+ *	per-entry overhead is kept below the size given at creation.
+ *
+ * Security:
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/buffer.h>
+#include <isc/lang.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+/*%
+ * The largest response that can be cached.
+ */
+#define DNS_RESPCACHE_MAXRESPONSE	4096
+
+typedef struct dns_respcachekey {
+	const dns_name_t *	qname;
+	dns_rdatatype_t		qtype;
+	uint32_t		options;	/*%< caller-defined */
+	uint16_t		size;		/*%< largest response allowed */
+	dns_db_t *		db;
+	uint32_t		serial;
+} dns_respcachekey_t;
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, size_t maxsize,
+		     dns_respcache_t **rcp);
+/*%
+ * Create a response cache using at most about 'maxsize' bytes of memory,
+ * and store it in '*rcp'.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	maxsize > 0
+ * \li	rcp != NULL && *rcp == NULL
+ */
+
+void
+dns_respcache_destroy(dns_respcache_t **rcp);
+/*%
+ * Flush and then free the response cache in '*rcp'.  '*rcp' is set to
+ * NULL on return.
+ *
+ * Requires:
+ * \li	'*rcp' to be a valid response cache.
+ */
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *rc, const dns_respcachekey_t *key,
+		   isc_buffer_t *target, dns_name_t *rrlname,
+		   isc_result_t *rrlresultp);
+/*%
+ * Look for the response to 'key' in 'rc', and copy it to 'target'.
+ *
+ * If 'rrlname' is not NULL and the response was added with a rate
+ * limiting name, that name is copied to 'rrlname' and its kind of
+ * response to '*rrlresultp'; otherwise '*rrlresultp' is set to
+ * ISC_R_NOTFOUND.
+ *
+ * Requires:
+ * \li	'rc' to be a valid response cache.
+ * \li	'key' and 'key->qname' != NULL; 'key->qname' is absolute.
+ * \li	'target' is a valid buffer.
+ * \li	'rrlname' is NULL, or has a dedicated buffer, and 'rrlresultp'
+ *	is not NULL.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_NOTFOUND		no response to 'key' is cached
+ * \li	ISC_R_NOSPACE		the response does not fit in 'target'
+ */
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *rc, const dns_respcachekey_t *key,
+		  const isc_region_t *response, const dns_name_t *rrlname,
+		  isc_result_t rrlresult);
+/*%
+ * Cache 'response' as the answer to 'key', replacing any response
+ * cached for the same query from another database or serial.  If
+ * 'rrlname' is not NULL, the name and kind of response that response
+ * rate limiting accounts the response against are cached with it.
+ *
+ * Requires:
+ * \li	'rc' to be a valid response cache.
+ * \li	'key' and 'key->qname' != NULL; 'key->qname' is absolute.
+ * \li	'key->db' != NULL.
+ * \li	'response' != NULL.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_RANGE		the response is larger than
+ *				#DNS_RESPCACHE_MAXRESPONSE or than a
+ *				stripe of the cache
+ * \li	ISC_R_NOMEMORY
+ */
+
+void
+dns_respcache_flush(dns_respcache_t *rc);
+/*%
+ * Remove every response from 'rc'.
+ *
+ * Requires:
+ * \li	'rc' to be a valid response cache.
+ */
+
+void
+dns_respcache_newdb(const dns_db_t *db);
+/*%
+ * Invalidate the responses cached, in every response cache, from any
+ * database at the address of 'db', which is about to be used to answer
+ * queries, e.g. because it is being attached to a zone.  This takes
+ * constant time, and the responses are freed as they are replaced or
+ * age out.  Responses from a few other databases may be invalidated
+ * too.
+ *
+ * Requires:
+ * \li	'db' != NULL.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_RESPCACHE_H */
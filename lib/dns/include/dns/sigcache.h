@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#ifndef DNS_SIGCACHE_H
+#define DNS_SIGCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/sigcache.h
+ * \brief
+ * Defines dns_sigcache_t, a cache of verified signatures.
+ *
+ * Notes:
+ *\li	A signature cache remembers which RRSIGs have been verified, so
+ *	that verifying the same signature over the same RRset with the
+ *	same key again does not need the public key operation.  It is
+ *	filled and consulted by dns_dnssec_verify2().
+ *
+ *\li	Each signature is recorded as a SHA-256 digest of the DNSKEY, the
+ *	complete RRSIG rdata and the canonical form of the RRset it
+ *	covers, so nothing about the signature can change without
+ *	missing the cache.  The validity period of the signature is
+ *	checked by the caller every time.
+ *
+ *\li	The cache is a fixed table of small sets, each replacing its
+ *	oldest digest when a new one is added, and is shared by every
+ *	view that is given a reference to it.
+ *
+ * Reliability:
+ *
+ * Resources:
+ *\li	The table is allocated when the cache is created and uses about
+ *	the size given then.
+ *
+ * Security:
+ *\li	A hit is only as strong as SHA-256 against second preimages: a
+ *	forged signature matches only if its digest equals that of one
+ *	that really verified.
+ *
+ * Standards:
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <stdbool.h>
+
+#include <isc/lang.h>
+#include <isc/sha2.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+#define DNS_SIGCACHE_DIGESTLENGTH	ISC_SHA256_DIGESTLENGTH
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_sigcache_create(isc_mem_t *mctx, size_t maxsize,
+		    dns_sigcache_t **cachep);
+/*%
+ * Create a signature cache using about 'maxsize' bytes of memory, and
+ * store it in '*cachep'.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	maxsize > 0
+ * \li	cachep != NULL && *cachep == NULL
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_NOMEMORY
+ */
+
+void
+dns_sigcache_attach(dns_sigcache_t *source, dns_sigcache_t **targetp);
+/*%
+ * Attach '*targetp' to 'source'.
+ *
+ * Requires:
+ * \li	'source' to be a valid signature cache.
+ * \li	targetp != NULL && *targetp == NULL
+ */
+
+void
+dns_sigcache_detach(dns_sigcache_t **cachep);
+/*%
+ * Detach '*cachep' from its cache, freeing the cache when this was the
+ * last reference.  '*cachep' is set to NULL on return.
+ *
+ * Requires:
+ * \li	'*cachep' to be a valid signature cache.
+ */
+
+bool
+dns_sigcache_find(dns_sigcache_t *cache, const unsigned char *digest);
+/*%
+ * Return true if 'digest' is in 'cache'.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache.
+ * \li	'digest' points to #DNS_SIGCACHE_DIGESTLENGTH bytes.
+ */
+
+void
+dns_sigcache_add(dns_sigcache_t *cache, const unsigned char *digest);
+/*%
+ * Add 'digest' to 'cache', unless it is already there.  This may
+ * evict another digest.
+ *
+ * Requires:
+ * \li	'cache' to be a valid signature cache.
+ * \li	'digest' points to #DNS_SIGCACHE_DIGESTLENGTH bytes.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_SIGCACHE_H */
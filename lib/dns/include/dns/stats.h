@@ -70,7 +70,13 @@ enum {
 	dns_resstatscounter_serverquota = 42,
 	dns_resstatscounter_nextitem = 43,
 	dns_resstatscounter_priming = 44,
-	dns_resstatscounter_max = 45,
+	dns_resstatscounter_dispsockopen = 45,
+	dns_resstatscounter_dispsockreuse = 46,
+	dns_resstatscounter_tcpconn = 47,
+	dns_resstatscounter_tcpreuse = 48,
+	dns_resstatscounter_sigcachehit = 49,
+	dns_resstatscounter_sigcachemiss = 50,
+	dns_resstatscounter_max = 51,
 
 	/*
 	 * DNSSEC stats.
@@ -120,8 +126,9 @@ enum {
 	dns_cachestatscounter_querymisses = 4,
 	dns_cachestatscounter_deletelru = 5,
 	dns_cachestatscounter_deletettl = 6,
+	dns_cachestatscounter_probation = 7,
 
-	dns_cachestatscounter_max = 7,
+	dns_cachestatscounter_max = 8,
 
 	/*%
 	 * Query statistics counters (obsolete).
@@ -126,9 +126,11 @@ typedef uint16_t				dns_rdatatype_t;
 typedef struct dns_request			dns_request_t;
 typedef struct dns_requestmgr			dns_requestmgr_t;
 typedef struct dns_resolver			dns_resolver_t;
+typedef struct dns_respcache			dns_respcache_t;
 typedef struct dns_sdbimplementation		dns_sdbimplementation_t;
 typedef uint8_t					dns_secalg_t;
 typedef uint8_t					dns_secproto_t;
+typedef struct dns_sigcache			dns_sigcache_t;
 typedef struct dns_signature			dns_signature_t;
 typedef struct dns_sortlist_arg			dns_sortlist_arg_t;
 typedef struct dns_ssurule			dns_ssurule_t;
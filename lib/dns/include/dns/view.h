@@ -154,6 +154,7 @@ struct dns_view {
 	bool			sendcookie;
 	dns_ttl_t			maxcachettl;
 	dns_ttl_t			maxncachettl;
+	unsigned int			cacheshards;
 	uint32_t			nta_lifetime;
 	uint32_t			nta_recheck;
 	char				*nta_file;
@@ -188,6 +189,8 @@ struct dns_view {
 	dns_dlzdblist_t 		dlz_unsearched;
 	uint32_t			fail_ttl;
 	dns_badcache_t			*failcache;
+	dns_respcache_t			*respcache;
+	dns_sigcache_t			*sigcache;
 
 	/*
 	 * Configurable data for server use only,
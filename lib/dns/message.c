@@ -434,6 +434,112 @@ msginit(dns_message_t *m) {
 	m->querytsig = NULL;
 }
 
+/*%
+ * Sections are searched linearly until a search has passed this many
+ * names; then the section gets an index.
+ */
+#define INDEX_MINNAMES	16
+#define INDEX_MINSIZE	64
+
+static void
+index_free(dns_message_t *msg, dns_section_t sectionid) {
+	if (msg->index[sectionid] == NULL)
+		return;
+
+	isc_mem_put(msg->mctx, msg->index[sectionid],
+		    msg->indexsize[sectionid] * sizeof(dns_name_t *));
+	msg->index[sectionid] = NULL;
+	msg->indexsize[sectionid] = 0;
+	msg->indexcount[sectionid] = 0;
+}
+
+static inline void
+index_insert(dns_name_t **index, unsigned int size, dns_name_t *name,
+	     unsigned int *countp)
+{
+	unsigned int i, mask = size - 1;
+
+	for (i = dns_name_fullhash(name, false) & mask;
+	     index[i] != NULL;
+	     i = (i + 1) & mask)
+	{
+		if (dns_name_equal(index[i], name)) {
+			index[i] = name;
+			return;
+		}
+	}
+	index[i] = name;
+	(*countp)++;
+}
+
+/*
+ * Double the size of the index of 'sectionid', or create it.
+ */
+static bool
+index_grow(dns_message_t *msg, dns_section_t sectionid) {
+	dns_name_t **index, **old = msg->index[sectionid];
+	unsigned int i, size, oldsize = msg->indexsize[sectionid];
+	unsigned int count = 0;
+
+	size = (oldsize == 0) ? INDEX_MINSIZE : oldsize * 2;
+	index = isc_mem_get(msg->mctx, size * sizeof(dns_name_t *));
+	if (index == NULL)
+		return (false);
+	memset(index, 0, size * sizeof(dns_name_t *));
+
+	for (i = 0; i < oldsize; i++) {
+		if (old[i] != NULL)
+			index_insert(index, size, old[i], &count);
+	}
+	if (old != NULL)
+		isc_mem_put(msg->mctx, old, oldsize * sizeof(dns_name_t *));
+
+	msg->index[sectionid] = index;
+	msg->indexsize[sectionid] = size;
+	msg->indexcount[sectionid] = count;
+	return (true);
+}
+
+/*
+ * Add 'name', which has just been appended to 'sectionid', to the
+ * section's index, if it has one.  It replaces any equal name, as
+ * findname() finds the last one.
+ */
+static void
+index_add(dns_message_t *msg, dns_section_t sectionid, dns_name_t *name) {
+	if (msg->index[sectionid] == NULL)
+		return;
+
+	if ((msg->indexcount[sectionid] + 1) * 2 > msg->indexsize[sectionid] &&
+	    !index_grow(msg, sectionid))
+	{
+		index_free(msg, sectionid);
+		return;
+	}
+
+	index_insert(msg->index[sectionid], msg->indexsize[sectionid], name,
+		     &msg->indexcount[sectionid]);
+}
+
+static bool
+index_build(dns_message_t *msg, dns_section_t sectionid) {
+	dns_name_t *name;
+
+	INSIST(msg->index[sectionid] == NULL);
+
+	if (!index_grow(msg, sectionid))
+		return (false);
+
+	for (name = ISC_LIST_HEAD(msg->sections[sectionid]);
+	     name != NULL;
+	     name = ISC_LIST_NEXT(name, link))
+	{
+		index_add(msg, sectionid, name);
+	}
+
+	return (msg->index[sectionid] != NULL);
+}
+
 static inline void
 msgresetnames(dns_message_t *msg, unsigned int first_section) {
 	unsigned int i;
@@ -444,6 +550,7 @@ msgresetnames(dns_message_t *msg, unsigned int first_section) {
 	 * Clean up name lists by calling the rdataset disassociate function.
 	 */
 	for (i = first_section; i < DNS_SECTION_MAX; i++) {
+		index_free(msg, i);
 		name = ISC_LIST_HEAD(msg->sections[i]);
 		while (name != NULL) {
 			next_name = ISC_LIST_NEXT(name, link);
@@ -727,8 +834,12 @@ dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp)
 	m->from_to_wire = intent;
 	msginit(m);
 
-	for (i = 0; i < DNS_SECTION_MAX; i++)
+	for (i = 0; i < DNS_SECTION_MAX; i++) {
 		ISC_LIST_INIT(m->sections[i]);
+		m->index[i] = NULL;
+		m->indexsize[i] = 0;
+		m->indexcount[i] = 0;
+	}
 
 	m->mctx = NULL;
 	isc_mem_attach(mctx, &m->mctx);
@@ -821,21 +932,42 @@ dns_message_destroy(dns_message_t **msgp) {
 
 static isc_result_t
 findname(dns_name_t **foundname, const dns_name_t *target,
-	 dns_namelist_t *section)
+	 dns_message_t *msg, dns_section_t sectionid)
 {
-	dns_name_t *curr;
-
-	for (curr = ISC_LIST_TAIL(*section);
-	     curr != NULL;
-	     curr = ISC_LIST_PREV(curr, link)) {
-		if (dns_name_equal(curr, target)) {
-			if (foundname != NULL)
-				*foundname = curr;
-			return (ISC_R_SUCCESS);
+	dns_name_t *curr, **index;
+	unsigned int i, mask, n = 0;
+
+	if (msg->index[sectionid] == NULL) {
+		for (curr = ISC_LIST_TAIL(msg->sections[sectionid]);
+		     curr != NULL;
+		     curr = ISC_LIST_PREV(curr, link)) {
+			if (dns_name_equal(curr, target))
+				goto found;
+			if (++n == INDEX_MINNAMES &&
+			    index_build(msg, sectionid))
+				break;
 		}
+		if (curr == NULL)
+			return (ISC_R_NOTFOUND);
 	}
 
+	index = msg->index[sectionid];
+	mask = msg->indexsize[sectionid] - 1;
+	for (i = dns_name_fullhash(target, false) & mask;
+	     index[i] != NULL;
+	     i = (i + 1) & mask)
+	{
+		if (dns_name_equal(index[i], target)) {
+			curr = index[i];
+			goto found;
+		}
+	}
 	return (ISC_R_NOTFOUND);
+
+ found:
+	if (foundname != NULL)
+		*foundname = curr;
+	return (ISC_R_SUCCESS);
 }
 
 isc_result_t
@@ -887,14 +1019,45 @@ dns_message_findtype(const dns_name_t *name, dns_rdatatype_t type,
 /*
  * Read a name from buffer "source".
  */
+/*
+ * If the name at the start of the active region of 'source' is not
+ * compressed, make 'name' refer to it and consume it.
+ */
+static inline bool
+getnamenocopy(dns_name_t *name, isc_buffer_t *source) {
+	isc_region_t r;
+	unsigned int length = 0, n;
+
+	isc_buffer_activeregion(source, &r);
+	while (length < r.length) {
+		n = r.base[length];
+		if (n > 63)	/* Let dns_name_fromwire() deal with it. */
+			return (false);
+		length += n + 1;
+		if (length > DNS_NAME_MAXWIRE)
+			return (false);
+		if (n == 0) {
+			r.length = length;
+			dns_name_fromregion(name, &r);
+			isc_buffer_forward(source, length);
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
 static isc_result_t
 getname(dns_name_t *name, isc_buffer_t *source, dns_message_t *msg,
-	dns_decompress_t *dctx)
+	dns_decompress_t *dctx, bool nocopy)
 {
 	isc_buffer_t *scratch;
 	isc_result_t result;
 	unsigned int tries;
 
+	if (nocopy && getnamenocopy(name, source))
+		return (ISC_R_SUCCESS);
+
 	scratch = currentbuffer(msg);
 
 	/*
@@ -927,17 +1090,33 @@ getname(dns_name_t *name, isc_buffer_t *source, dns_message_t *msg,
 static isc_result_t
 getrdata(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	 dns_rdataclass_t rdclass, dns_rdatatype_t rdtype,
-	 unsigned int rdatalen, dns_rdata_t *rdata)
+	 unsigned int rdatalen, dns_rdata_t *rdata, bool nocopy)
 {
 	isc_buffer_t *scratch;
+	isc_buffer_t self;
 	isc_result_t result;
 	unsigned int tries;
 	unsigned int trysize;
 
-	scratch = currentbuffer(msg);
-
 	isc_buffer_setactive(source, rdatalen);
 
+	/*
+	 * The rdata of these types has no names to decompress, and
+	 * dns_rdata_fromwire() checks it before copying it unchanged, so
+	 * it can be "copied" onto itself.
+	 */
+	if (nocopy &&
+	    (rdtype == dns_rdatatype_opt ||
+	     (rdclass == dns_rdataclass_in &&
+	      (rdtype == dns_rdatatype_a || rdtype == dns_rdatatype_aaaa))))
+	{
+		isc_buffer_init(&self, isc_buffer_current(source), rdatalen);
+		return (dns_rdata_fromwire(rdata, rdclass, rdtype, source,
+					   dctx, 0, &self));
+	}
+
+	scratch = currentbuffer(msg);
+
 	/*
 	 * First try:  use current buffer.
 	 * Second try:  allocate a new buffer of size
@@ -1005,10 +1184,13 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	bool free_name;
 	bool best_effort;
 	bool seen_problem;
+	bool nocopy;
 
 	section = &msg->sections[DNS_SECTION_QUESTION];
 
 	best_effort = (options & DNS_MESSAGEPARSE_BESTEFFORT);
+	nocopy = ((options & DNS_MESSAGEPARSE_NOCOPY) != 0 &&
+		  (options & DNS_MESSAGEPARSE_CLONEBUFFER) == 0);
 	seen_problem = false;
 
 	name = NULL;
@@ -1033,7 +1215,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		 */
 		isc_buffer_remainingregion(source, &r);
 		isc_buffer_setactive(source, r.length);
-		result = getname(name, source, msg, dctx);
+		result = getname(name, source, msg, dctx, nocopy);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
 
@@ -1043,7 +1225,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		 * name since we no longer need it, and set our name pointer
 		 * to point to the name we found.
 		 */
-		result = findname(&name2, name, section);
+		result = findname(&name2, name, msg, DNS_SECTION_QUESTION);
 
 		/*
 		 * If it is the first name in the section, accept it.
@@ -1059,6 +1241,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			if (!ISC_LIST_EMPTY(*section))
 				DO_ERROR(DNS_R_FORMERR);
 			ISC_LIST_APPEND(*section, name, link);
+			index_add(msg, DNS_SECTION_QUESTION, name);
 			free_name = false;
 		} else {
 			isc_mempool_put(msg->namepool, name);
@@ -1237,11 +1420,13 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 	dns_ttl_t ttl;
 	dns_namelist_t *section;
 	bool free_name = false, free_rdataset = false;
-	bool preserve_order, best_effort, seen_problem;
+	bool preserve_order, best_effort, seen_problem, nocopy;
 	bool issigzero;
 
 	preserve_order = (options & DNS_MESSAGEPARSE_PRESERVEORDER);
 	best_effort = (options & DNS_MESSAGEPARSE_BESTEFFORT);
+	nocopy = ((options & DNS_MESSAGEPARSE_NOCOPY) != 0 &&
+		  (options & DNS_MESSAGEPARSE_CLONEBUFFER) == 0);
 	seen_problem = false;
 
 	section = &msg->sections[sectionid];
@@ -1271,7 +1456,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 		 */
 		isc_buffer_remainingregion(source, &r);
 		isc_buffer_setactive(source, r.length);
-		result = getname(name, source, msg, dctx);
+		result = getname(name, source, msg, dctx, nocopy);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
 
@@ -1415,10 +1600,10 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			   msg->opcode == dns_opcode_update &&
 			   sectionid == DNS_SECTION_UPDATE) {
 			result = getrdata(source, msg, dctx, msg->rdclass,
-					  rdtype, rdatalen, rdata);
+					  rdtype, rdatalen, rdata, nocopy);
 		} else
 			result = getrdata(source, msg, dctx, rdclass,
-					  rdtype, rdatalen, rdata);
+					  rdtype, rdatalen, rdata, nocopy);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
 		rdata->rdclass = rdclass;
@@ -1469,6 +1654,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			    !issigzero)
 			{
 				ISC_LIST_APPEND(*section, name, link);
+				index_add(msg, sectionid, name);
 				free_name = false;
 			}
 		} else {
@@ -1478,7 +1664,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 			 * allocated name since we no longer need it, and set
 			 * our name pointer to point to the name we found.
 			 */
-			result = findname(&name2, name, section);
+			result = findname(&name2, name, msg, sectionid);
 
 			/*
 			 * If it is a new name, append to the section.
@@ -1488,6 +1674,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t *dctx,
 				name = name2;
 			} else {
 				ISC_LIST_APPEND(*section, name, link);
+				index_add(msg, sectionid, name);
 			}
 			free_name = false;
 		}
@@ -2505,8 +2692,7 @@ dns_message_findname(dns_message_t *msg, dns_section_t section,
 		REQUIRE(rdataset == NULL || *rdataset == NULL);
 	}
 
-	result = findname(&foundname, target,
-			  &msg->sections[section]);
+	result = findname(&foundname, target, msg, section);
 
 	if (result == ISC_R_NOTFOUND)
 		return (DNS_R_NXDOMAIN);
@@ -2544,7 +2730,9 @@ dns_message_movename(dns_message_t *msg, dns_name_t *name,
 	 * Unlink the name from the old section
 	 */
 	ISC_LIST_UNLINK(msg->sections[fromsection], name, link);
+	index_free(msg, fromsection);
 	ISC_LIST_APPEND(msg->sections[tosection], name, link);
+	index_add(msg, tosection, name);
 }
 
 void
@@ -2557,6 +2745,7 @@ dns_message_addname(dns_message_t *msg, dns_name_t *name,
 	REQUIRE(VALID_NAMED_SECTION(section));
 
 	ISC_LIST_APPEND(msg->sections[section], name, link);
+	index_add(msg, section, name);
 }
 
 void
@@ -2569,6 +2758,7 @@ dns_message_removename(dns_message_t *msg, dns_name_t *name,
 	REQUIRE(VALID_NAMED_SECTION(section));
 
 	ISC_LIST_UNLINK(msg->sections[section], name, link);
+	index_free(msg, section);
 }
 
 isc_result_t
@@ -19,6 +19,10 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <isc/buffer.h>
 #include <isc/hash.h>
 #include <isc/mem.h>
@@ -109,6 +113,97 @@ static unsigned char maptolower[] = {
 #define CONVERTTOASCII(c)
 #define CONVERTFROMASCII(c)
 
+/*
+ * Case-insensitive comparisons work on 16 bytes at a time with SSE2,
+ * or on 8 bytes at a time in a 64-bit word, and only use maptolower[]
+ * for what is left.  Both give the same result as maptolower[]: only
+ * 'A' to 'Z' change.
+ */
+
+/*%
+ * Set bit 5 in every byte of 'x' that is an upper case letter.
+ */
+static inline uint64_t
+tolower8(uint64_t x) {
+	uint64_t heptets = x & UINT64_C(0x7f7f7f7f7f7f7f7f);
+	uint64_t gea = heptets + UINT64_C(0x3f3f3f3f3f3f3f3f);
+	uint64_t gtz = heptets + UINT64_C(0x2525252525252525);
+	uint64_t upper = gea & ~gtz & ~x & UINT64_C(0x8080808080808080);
+
+	return (x | (upper >> 2));
+}
+
+static inline uint64_t
+load8(const unsigned char *p) {
+	uint64_t x;
+
+	memmove(&x, p, sizeof(x));
+	return (x);
+}
+
+#ifdef __SSE2__
+static inline __m128i
+tolower16(const unsigned char *p) {
+	__m128i x = _mm_loadu_si128((const __m128i *)p);
+	/* 'A' to 'Z' become the 26 smallest signed bytes. */
+	__m128i t = _mm_add_epi8(x, _mm_set1_epi8(0x80 - 'A'));
+	__m128i upper = _mm_cmplt_epi8(t, _mm_set1_epi8(-128 + 26));
+
+	return (_mm_or_si128(x, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+}
+#endif
+
+/*%
+ * Return the offset of the first of the 'n' bytes at 'a' and 'b' that
+ * differ when case is ignored, or 'n' if there is none.  'avail' bytes,
+ * at least 'n', may be read from each, so that a short label can still
+ * be compared a word at a time.
+ */
+static inline unsigned int
+casediff(const unsigned char *a, const unsigned char *b, unsigned int n,
+	 unsigned int avail)
+{
+	unsigned int i = 0;
+
+	/*
+	 * Labels that differ mostly differ in their first byte.
+	 */
+	if (n == 0 || maptolower[a[0]] != maptolower[b[0]])
+		return (0);
+
+#ifdef __SSE2__
+	while (i < n && avail - i >= 16) {
+		unsigned int mask;
+
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(tolower16(a + i),
+							tolower16(b + i)));
+		if (mask != 0xffff) {
+			mask = ~mask & 0xffff;
+#ifdef HAVE_BUILTIN_CTZ
+			i += __builtin_ctz(mask);
+#else
+			while ((mask & 1) == 0) {
+				mask >>= 1;
+				i++;
+			}
+#endif
+			return (ISC_MIN(i, n));
+		}
+		i += 16;
+	}
+#endif
+	while (i < n && avail - i >= 8) {
+		if (tolower8(load8(a + i)) != tolower8(load8(b + i)))
+			break;
+		i += 8;
+	}
+	for (; i < n; i++) {
+		if (maptolower[a[i]] != maptolower[b[i]])
+			return (i);
+	}
+	return (n);
+}
+
 #define INIT_OFFSETS(name, var, default_offsets) \
 	if ((name)->offsets != NULL)		 \
 		var = (name)->offsets;		 \
@@ -491,8 +586,8 @@ dns_namereln_t
 dns_name_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
 		     int *orderp, unsigned int *nlabelsp)
 {
-	unsigned int l1, l2, l, count1, count2, count, nlabels;
-	int cdiff, ldiff, chdiff;
+	unsigned int l1, l2, l, count1, count2, count, nlabels, i;
+	int cdiff, ldiff;
 	unsigned char *label1, *label2;
 	unsigned char *offsets1, *offsets2;
 	dns_offsets_t odata1, odata2;
@@ -563,43 +658,13 @@ dns_name_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
 		else
 			count = count2;
 
-		/* Loop unrolled for performance */
-		while (ISC_LIKELY(count > 3)) {
-			chdiff = (int)maptolower[label1[0]] -
-				 (int)maptolower[label2[0]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			chdiff = (int)maptolower[label1[1]] -
-				 (int)maptolower[label2[1]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			chdiff = (int)maptolower[label1[2]] -
-				 (int)maptolower[label2[2]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			chdiff = (int)maptolower[label1[3]] -
-				 (int)maptolower[label2[3]];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
-			count -= 4;
-			label1 += 4;
-			label2 += 4;
-		}
-		while (ISC_LIKELY(count-- > 0)) {
-			chdiff = (int)maptolower[*label1++] -
-				 (int)maptolower[*label2++];
-			if (chdiff != 0) {
-				*orderp = chdiff;
-				goto done;
-			}
+		i = casediff(label1, label2, count,
+			     ISC_MIN(name1->length - *offsets1,
+				     name2->length - *offsets2) - 1);
+		if (i < count) {
+			*orderp = (int)maptolower[label1[i]] -
+				  (int)maptolower[label2[i]];
+			goto done;
 		}
 		if (cdiff != 0) {
 			*orderp = cdiff;
@@ -648,9 +713,6 @@ dns_name_compare(const dns_name_t *name1, const dns_name_t *name2) {
 
 bool
 dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
-	unsigned int l, count;
-	unsigned char c;
-	unsigned char *label1, *label2;
 
 	/*
 	 * Are 'name1' and 'name2' equal?
@@ -675,46 +737,15 @@ dns_name_equal(const dns_name_t *name1, const dns_name_t *name2) {
 	if (name1->length != name2->length)
 		return (false);
 
-	l = name1->labels;
-
-	if (l != name2->labels)
+	if (name1->labels != name2->labels)
 		return (false);
 
-	label1 = name1->ndata;
-	label2 = name2->ndata;
-	while (ISC_LIKELY(l-- > 0)) {
-		count = *label1++;
-		if (count != *label2++)
-			return (false);
-
-		INSIST(count <= 63); /* no bitstring support */
-
-		/* Loop unrolled for performance */
-		while (ISC_LIKELY(count > 3)) {
-			c = maptolower[label1[0]];
-			if (c != maptolower[label2[0]])
-				return (false);
-			c = maptolower[label1[1]];
-			if (c != maptolower[label2[1]])
-				return (false);
-			c = maptolower[label1[2]];
-			if (c != maptolower[label2[2]])
-				return (false);
-			c = maptolower[label1[3]];
-			if (c != maptolower[label2[3]])
-				return (false);
-			count -= 4;
-			label1 += 4;
-			label2 += 4;
-		}
-		while (ISC_LIKELY(count-- > 0)) {
-			c = maptolower[*label1++];
-			if (c != maptolower[*label2++])
-				return (false);
-		}
-	}
-
-	return (true);
+	/*
+	 * The label lengths are compared along with the labels: they are
+	 * never more than 63, and so are not changed by ignoring case.
+	 */
+	return (casediff(name1->ndata, name2->ndata, name1->length,
+			 name1->length) == name1->length);
 }
 
 bool
@@ -748,7 +779,7 @@ dns_name_caseequal(const dns_name_t *name1, const dns_name_t *name2) {
 
 int
 dns_name_rdatacompare(const dns_name_t *name1, const dns_name_t *name2) {
-	unsigned int l1, l2, l, count1, count2, count;
+	unsigned int l1, l2, l, count1, count2, count, i;
 	unsigned char c1, c2;
 	unsigned char *label1, *label2;
 
@@ -781,15 +812,16 @@ dns_name_rdatacompare(const dns_name_t *name1, const dns_name_t *name2) {
 		if (count1 != count2)
 			return ((count1 < count2) ? -1 : 1);
 		count = count1;
-		while (count > 0) {
-			count--;
-			c1 = maptolower[*label1++];
-			c2 = maptolower[*label2++];
-			if (c1 < c2)
-				return (-1);
-			else if (c1 > c2)
-				return (1);
+		i = casediff(label1, label2, count,
+			     ISC_MIN(name1->length - (label1 - name1->ndata),
+				     name2->length - (label2 - name2->ndata)));
+		if (i < count) {
+			c1 = maptolower[label1[i]];
+			c2 = maptolower[label2[i]];
+			return ((c1 < c2) ? -1 : 1);
 		}
+		label1 += count;
+		label2 += count;
 	}
 
 	/*
@@ -64,6 +64,15 @@
 
 #define RBT_HASH_SIZE           64
 
+/*%
+ * Number of old hashtable buckets moved into a newly grown table on
+ * each insertion or removal while a resize is in progress.  The table
+ * grows when the load factor reaches 3, so roughly three insertions per
+ * old bucket separate two resizes and the migration normally completes
+ * long before the next one.
+ */
+#define RBT_HASH_MIGRATE        4
+
 #ifdef RBT_MEM_TEST
 #undef RBT_HASH_SIZE
 #define RBT_HASH_SIZE 2 /*%< To give the reallocation code a workout. */
@@ -76,8 +85,12 @@ struct dns_rbt {
 	void			(*data_deleter)(void *, void *);
 	void *			deleter_arg;
 	unsigned int		nodecount;
+	size_t			nodememory;
 	size_t			hashsize;
 	dns_rbtnode_t **	hashtable;
+	size_t			oldhashsize;
+	dns_rbtnode_t **	oldhashtable;
+	size_t			hashmigrate;
 	void *			mmap_location;
 };
 
@@ -160,7 +173,8 @@ serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
 static inline dns_rbtnode_t *
 getparent(dns_rbtnode_t *node, file_header_t *header) {
 	char *adjusted_address = (char *)(node->parent);
-	adjusted_address += node->parent_is_relative * (uintptr_t)header;
+	adjusted_address += (node->is_relative & (node->parent != NULL)) *
+			    (uintptr_t)header;
 
 	return ((dns_rbtnode_t *)adjusted_address);
 }
@@ -168,7 +182,8 @@ getparent(dns_rbtnode_t *node, file_header_t *header) {
 static inline dns_rbtnode_t *
 getleft(dns_rbtnode_t *node, file_header_t *header) {
 	char *adjusted_address = (char *)(node->left);
-	adjusted_address += node->left_is_relative * (uintptr_t)header;
+	adjusted_address += (node->is_relative & (node->left != NULL)) *
+			    (uintptr_t)header;
 
 	return ((dns_rbtnode_t *)adjusted_address);
 }
@@ -176,7 +191,8 @@ getleft(dns_rbtnode_t *node, file_header_t *header) {
 static inline dns_rbtnode_t *
 getright(dns_rbtnode_t *node, file_header_t *header) {
 	char *adjusted_address = (char *)(node->right);
-	adjusted_address += node->right_is_relative * (uintptr_t)header;
+	adjusted_address += (node->is_relative & (node->right != NULL)) *
+			    (uintptr_t)header;
 
 	return ((dns_rbtnode_t *)adjusted_address);
 }
@@ -184,7 +200,8 @@ getright(dns_rbtnode_t *node, file_header_t *header) {
 static inline dns_rbtnode_t *
 getdown(dns_rbtnode_t *node, file_header_t *header) {
 	char *adjusted_address = (char *)(node->down);
-	adjusted_address += node->down_is_relative * (uintptr_t)header;
+	adjusted_address += (node->is_relative & (node->down != NULL)) *
+			    (uintptr_t)header;
 
 	return ((dns_rbtnode_t *)adjusted_address);
 }
@@ -192,7 +209,8 @@ getdown(dns_rbtnode_t *node, file_header_t *header) {
 static inline dns_rbtnode_t *
 getdata(dns_rbtnode_t *node, file_header_t *header) {
 	char *adjusted_address = (char *)(node->data);
-	adjusted_address += node->data_is_relative * (uintptr_t)header;
+	adjusted_address += (node->is_relative & (node->data != NULL)) *
+			    (uintptr_t)header;
 
 	return ((dns_rbtnode_t *)adjusted_address);
 }
@@ -213,7 +231,6 @@ getdata(dns_rbtnode_t *node, file_header_t *header) {
 #define NAMELEN(node)           ((node)->namelen)
 #define OLDNAMELEN(node)        ((node)->oldnamelen)
 #define OFFSETLEN(node)         ((node)->offsetlen)
-#define ATTRS(node)             ((node)->attributes)
 #define IS_ROOT(node)           ((node)->is_root)
 #define FINDCALLBACK(node)      ((node)->find_callback)
 
@@ -242,6 +259,12 @@ getdata(dns_rbtnode_t *node, file_header_t *header) {
 #define OFFSETS(node)   (NAME(node) + OLDNAMELEN(node) + 1)
 #define OLDOFFSETLEN(node) (OFFSETS(node)[-1])
 
+/*%
+ * Only a name that ends in the root label is absolute.
+ */
+#define IS_ABSOLUTE(node) \
+	(NAME(node)[OFFSETS(node)[OFFSETLEN(node) - 1]] == 0)
+
 #define NODE_SIZE(node) (sizeof(*node) + \
 			 OLDNAMELEN(node) + OLDOFFSETLEN(node) + 1)
 
@@ -278,8 +301,9 @@ NODENAME(dns_rbtnode_t *node, dns_name_t *name) {
 	name->labels = OFFSETLEN(node);
 	name->ndata = NAME(node);
 	name->offsets = OFFSETS(node);
-	name->attributes = ATTRS(node);
-	name->attributes |= DNS_NAMEATTR_READONLY;
+	name->attributes = DNS_NAMEATTR_READONLY;
+	if (IS_ABSOLUTE(node))
+		name->attributes |= DNS_NAMEATTR_ABSOLUTE;
 }
 
 void
@@ -288,8 +312,9 @@ dns_rbtnode_nodename(dns_rbtnode_t *node, dns_name_t *name) {
 	name->labels = OFFSETLEN(node);
 	name->ndata = NAME(node);
 	name->offsets = OFFSETS(node);
-	name->attributes = ATTRS(node);
-	name->attributes |= DNS_NAMEATTR_READONLY;
+	name->attributes = DNS_NAMEATTR_READONLY;
+	if (IS_ABSOLUTE(node))
+		name->attributes |= DNS_NAMEATTR_ABSOLUTE;
 }
 
 dns_rbtnode_t *
@@ -545,12 +570,9 @@ serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
 	CHECK(isc_stdio_seek(file, file_position, SEEK_SET));
 
 	temp_node = *node;
-	temp_node.down_is_relative = 0;
-	temp_node.left_is_relative = 0;
-	temp_node.right_is_relative = 0;
-	temp_node.parent_is_relative = 0;
-	temp_node.data_is_relative = 0;
+	temp_node.is_relative = 1;
 	temp_node.is_mmapped = 1;
+	temp_node.deadindex = 0;
 
 	/*
 	 * If the next node is not NULL, calculate the next node's location
@@ -558,26 +580,16 @@ serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t left,
 	 * structure changes, and it also assumes that we always write the
 	 * nodes out in list order (which we currently do.)
 	*/
-	if (temp_node.parent != NULL) {
+	if (temp_node.parent != NULL)
 		temp_node.parent = (dns_rbtnode_t *)(parent);
-		temp_node.parent_is_relative = 1;
-	}
-	if (temp_node.left != NULL) {
+	if (temp_node.left != NULL)
 		temp_node.left = (dns_rbtnode_t *)(left);
-		temp_node.left_is_relative = 1;
-	}
-	if (temp_node.right != NULL) {
+	if (temp_node.right != NULL)
 		temp_node.right = (dns_rbtnode_t *)(right);
-		temp_node.right_is_relative = 1;
-	}
-	if (temp_node.down != NULL) {
+	if (temp_node.down != NULL)
 		temp_node.down = (dns_rbtnode_t *)(down);
-		temp_node.down_is_relative = 1;
-	}
-	if (temp_node.data != NULL) {
+	if (temp_node.data != NULL)
 		temp_node.data = (dns_rbtnode_t *)(data);
-		temp_node.data_is_relative = 1;
-	}
 
 	node_data = (unsigned char *) node + sizeof(dns_rbtnode_t);
 	datasize = NODE_SIZE(node) - sizeof(dns_rbtnode_t);
@@ -767,47 +779,41 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 	/* memorize header contents prior to fixup */
 	memmove(&header, n, sizeof(header));
 
-	if (n->left_is_relative) {
+	CONFIRM(n->is_relative);
+
+	if (n->left != NULL) {
 		CONFIRM(n->left <= (dns_rbtnode_t *) nodemax);
 		n->left = getleft(n, rbt->mmap_location);
-		n->left_is_relative = 0;
 		CONFIRM(DNS_RBTNODE_VALID(n->left));
-	} else
-		CONFIRM(n->left == NULL);
+	}
 
-	if (n->right_is_relative) {
+	if (n->right != NULL) {
 		CONFIRM(n->right <= (dns_rbtnode_t *) nodemax);
 		n->right = getright(n, rbt->mmap_location);
-		n->right_is_relative = 0;
 		CONFIRM(DNS_RBTNODE_VALID(n->right));
-	} else
-		CONFIRM(n->right == NULL);
+	}
 
-	if (n->down_is_relative) {
+	if (n->down != NULL) {
 		CONFIRM(n->down <= (dns_rbtnode_t *) nodemax);
 		n->down = getdown(n, rbt->mmap_location);
-		n->down_is_relative = 0;
 		CONFIRM(n->down > (dns_rbtnode_t *) n);
 		CONFIRM(DNS_RBTNODE_VALID(n->down));
-	} else
-		CONFIRM(n->down == NULL);
+	}
 
-	if (n->parent_is_relative) {
+	if (n->parent != NULL) {
 		CONFIRM(n->parent <= (dns_rbtnode_t *) nodemax);
 		n->parent = getparent(n, rbt->mmap_location);
-		n->parent_is_relative = 0;
 		CONFIRM(n->parent < (dns_rbtnode_t *) n);
 		CONFIRM(DNS_RBTNODE_VALID(n->parent));
-	} else
-		CONFIRM(n->parent == NULL);
+	}
 
-	if (n->data_is_relative) {
+	if (n->data != NULL) {
 		CONFIRM(n->data <= (void *) filesize);
 		n->data = getdata(n, rbt->mmap_location);
-		n->data_is_relative = 0;
 		CONFIRM(n->data > (void *) n);
-	} else
-		CONFIRM(n->data == NULL);
+	}
+
+	n->is_relative = 0;
 
 	hash_node(rbt, n, fullname);
 
@@ -826,6 +832,7 @@ treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
 		CHECK(datafixer(n, base, filesize, fixer_arg, crc));
 
 	rbt->nodecount++;
+	rbt->nodememory += NODE_SIZE(n);
 	node_data = (unsigned char *) n + sizeof(dns_rbtnode_t);
 	datasize = NODE_SIZE(n) - sizeof(dns_rbtnode_t);
 
@@ -937,6 +944,7 @@ dns_rbt_deserialize_tree(void *base_address, size_t filesize,
 	if (result != ISC_R_SUCCESS && rbt != NULL) {
 		rbt->root = NULL;
 		rbt->nodecount = 0;
+		rbt->nodememory = 0;
 		dns_rbt_destroy(&rbt);
 	}
 
@@ -967,8 +975,12 @@ dns_rbt_create(isc_mem_t *mctx, dns_rbtdeleter_t deleter,
 	rbt->deleter_arg = deleter_arg;
 	rbt->root = NULL;
 	rbt->nodecount = 0;
+	rbt->nodememory = 0;
 	rbt->hashtable = NULL;
 	rbt->hashsize = 0;
+	rbt->oldhashtable = NULL;
+	rbt->oldhashsize = 0;
+	rbt->hashmigrate = 0;
 	rbt->mmap_location = NULL;
 
 	result = inithash(rbt);
@@ -1011,6 +1023,9 @@ dns_rbt_destroy2(dns_rbt_t **rbtp, unsigned int quantum) {
 	if (rbt->hashtable != NULL)
 		isc_mem_put(rbt->mctx, rbt->hashtable,
 			    rbt->hashsize * sizeof(dns_rbtnode_t *));
+	if (rbt->oldhashtable != NULL)
+		isc_mem_put(rbt->mctx, rbt->oldhashtable,
+			    rbt->oldhashsize * sizeof(dns_rbtnode_t *));
 
 	rbt->magic = 0;
 
@@ -1027,6 +1042,14 @@ dns_rbt_nodecount(dns_rbt_t *rbt) {
 	return (rbt->nodecount);
 }
 
+size_t
+dns_rbt_nodememory(dns_rbt_t *rbt) {
+
+	REQUIRE(VALID_RBT(rbt));
+
+	return (rbt->nodememory);
+}
+
 size_t
 dns_rbt_hashsize(dns_rbt_t *rbt) {
 
@@ -1152,6 +1175,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 		result = create_node(rbt->mctx, add_name, &new_current);
 		if (result == ISC_R_SUCCESS) {
 			rbt->nodecount++;
+			rbt->nodememory += NODE_SIZE(new_current);
 			new_current->is_root = 1;
 
 			UPPERNODE(new_current) = NULL;
@@ -1321,7 +1345,8 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 				/*
 				 * Set up the new root of the next level.
 				 * By definition it will not be the top
-				 * level tree, so clear DNS_NAMEATTR_ABSOLUTE.
+				 * level tree, and its name, which is now
+				 * the prefix, is not absolute.
 				 */
 				current->is_root = 1;
 				PARENT(current) = new_current;
@@ -1338,9 +1363,9 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 				RIGHT(current) = NULL;
 
 				MAKE_BLACK(current);
-				ATTRS(current) &= ~DNS_NAMEATTR_ABSOLUTE;
 
 				rbt->nodecount++;
+				rbt->nodememory += NODE_SIZE(new_current);
 				dns_name_getlabelsequence(name,
 							  nlabels - hlabels,
 							  hlabels, new_name);
@@ -1396,6 +1421,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 
 		addonlevel(new_current, current, order, root);
 		rbt->nodecount++;
+		rbt->nodememory += NODE_SIZE(new_current);
 		*nodep = new_current;
 		hash_node(rbt, new_current, name);
 	}
@@ -1531,6 +1557,8 @@ dns_rbt_findnode(dns_rbt_t *rbt, const dns_name_t *name, dns_name_t *foundname,
 			unsigned int nlabels;
 			unsigned int tlabels = 1;
 			unsigned int hash;
+			dns_rbtnode_t **hashtable;
+			size_t hashsize;
 
 			/*
 			 * The case of current not being a subtree root,
@@ -1572,9 +1600,14 @@ dns_rbt_findnode(dns_rbt_t *rbt, const dns_name_t *name, dns_name_t *foundname,
 
 			/*
 			 * Walk all the nodes in the hash bucket pointed
-			 * by the computed hash value.
+			 * by the computed hash value.  While the table is
+			 * being grown, buckets which have not yet been
+			 * migrated are also searched in the old table.
 			 */
-			for (hnode = rbt->hashtable[hash % rbt->hashsize];
+			hashtable = rbt->hashtable;
+			hashsize = rbt->hashsize;
+		hashbucket:
+			for (hnode = hashtable[hash % hashsize];
 			     hnode != NULL;
 			     hnode = hnode->hashnext)
 			{
@@ -1604,6 +1637,15 @@ dns_rbt_findnode(dns_rbt_t *rbt, const dns_name_t *name, dns_name_t *foundname,
 				}
 			}
 
+			if (hnode == NULL && hashtable == rbt->hashtable &&
+			    rbt->oldhashtable != NULL &&
+			    hash % rbt->oldhashsize >= rbt->hashmigrate)
+			{
+				hashtable = rbt->oldhashtable;
+				hashsize = rbt->oldhashsize;
+				goto hashbucket;
+			}
+
 			if (hnode != NULL) {
 				current = hnode;
 				/*
@@ -2202,17 +2244,13 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	DOWN(node) = NULL;
 	DATA(node) = NULL;
 	node->is_mmapped = 0;
-	node->down_is_relative = 0;
-	node->left_is_relative = 0;
-	node->right_is_relative = 0;
-	node->parent_is_relative = 0;
-	node->data_is_relative = 0;
+	node->is_relative = 0;
 	node->rpz = 0;
 
 	HASHNEXT(node) = NULL;
 	HASHVAL(node) = 0;
 
-	ISC_LINK_INIT(node, deadlink);
+	node->deadindex = 0;
 
 	LOCKNUM(node) = 0;
 	WILD(node) = 0;
@@ -2226,8 +2264,8 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	/*
 	 * The following is stored to make reconstructing a name from the
 	 * stored value in the node easy:  the length of the name, the number
-	 * of labels, whether the name is absolute or not, the name itself,
-	 * and the name's offsets table.
+	 * of labels, the name itself, and the name's offsets table.  Whether
+	 * the name is absolute is seen from its last label.
 	 *
 	 * XXX RTH
 	 *      The offsets table could be made smaller by eliminating the
@@ -2239,7 +2277,6 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	 */
 	OLDNAMELEN(node) = NAMELEN(node) = region.length;
 	OLDOFFSETLEN(node) = OFFSETLEN(node) = labels;
-	ATTRS(node) = name->attributes;
 
 	memmove(NAME(node), region.base, region.length);
 	memmove(OFFSETS(node), name->offsets, labels);
@@ -2253,20 +2290,31 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 }
 
 /*
- * Add a node to the hash table
+ * Add a node to the hash table.  While the table is being grown, a
+ * node whose bucket has not been migrated yet goes into the old table
+ * with the rest of that bucket, which is where unhash_node() looks.
  */
 static inline void
 hash_add_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
 	unsigned int hash;
+	dns_rbtnode_t **table;
 
 	REQUIRE(name != NULL);
 
 	HASHVAL(node) = dns_name_fullhash(name, false);
 
-	hash = HASHVAL(node) % rbt->hashsize;
-	HASHNEXT(node) = rbt->hashtable[hash];
+	if (rbt->oldhashtable != NULL &&
+	    HASHVAL(node) % rbt->oldhashsize >= rbt->hashmigrate)
+	{
+		table = rbt->oldhashtable;
+		hash = HASHVAL(node) % rbt->oldhashsize;
+	} else {
+		table = rbt->hashtable;
+		hash = HASHVAL(node) % rbt->hashsize;
+	}
+	HASHNEXT(node) = table[hash];
 
-	rbt->hashtable[hash] = node;
+	table[hash] = node;
 }
 
 /*
@@ -2289,44 +2337,74 @@ inithash(dns_rbt_t *rbt) {
 }
 
 /*
- * Rebuild the hashtable to reduce the load factor
+ * Move up to 'count' buckets of the old hash table into the current
+ * one, and release the old table once it is empty.
  */
 static void
-rehash(dns_rbt_t *rbt, unsigned int newcount) {
-	unsigned int oldsize;
-	dns_rbtnode_t **oldtable;
+hash_migrate(dns_rbt_t *rbt, size_t count) {
 	dns_rbtnode_t *node;
 	dns_rbtnode_t *nextnode;
 	unsigned int hash;
-	unsigned int i;
 
-	oldsize = (unsigned int)rbt->hashsize;
-	oldtable = rbt->hashtable;
-	do {
-		INSIST((rbt->hashsize * 2 + 1) > rbt->hashsize);
-		rbt->hashsize = rbt->hashsize * 2 + 1;
-	} while (newcount >= (rbt->hashsize * 3));
-	rbt->hashtable = isc_mem_get(rbt->mctx,
-				     rbt->hashsize * sizeof(dns_rbtnode_t *));
-	if (rbt->hashtable == NULL) {
-		rbt->hashtable = oldtable;
-		rbt->hashsize = oldsize;
+	if (rbt->oldhashtable == NULL)
 		return;
-	}
 
-	for (i = 0; i < rbt->hashsize; i++)
-		rbt->hashtable[i] = NULL;
-
-	for (i = 0; i < oldsize; i++) {
-		for (node = oldtable[i]; node != NULL; node = nextnode) {
+	while (count-- > 0 && rbt->hashmigrate < rbt->oldhashsize) {
+		node = rbt->oldhashtable[rbt->hashmigrate];
+		for (; node != NULL; node = nextnode) {
 			hash = HASHVAL(node) % rbt->hashsize;
 			nextnode = HASHNEXT(node);
 			HASHNEXT(node) = rbt->hashtable[hash];
 			rbt->hashtable[hash] = node;
 		}
+		rbt->oldhashtable[rbt->hashmigrate++] = NULL;
 	}
 
-	isc_mem_put(rbt->mctx, oldtable, oldsize * sizeof(dns_rbtnode_t *));
+	if (rbt->hashmigrate == rbt->oldhashsize) {
+		isc_mem_put(rbt->mctx, rbt->oldhashtable,
+			    rbt->oldhashsize * sizeof(dns_rbtnode_t *));
+		rbt->oldhashtable = NULL;
+		rbt->oldhashsize = 0;
+		rbt->hashmigrate = 0;
+	}
+}
+
+/*
+ * Grow the hashtable to reduce the load factor.  The existing table is
+ * kept as the old table and its buckets are moved across a few at a
+ * time by hash_node() and unhash_node(), so that no single insertion
+ * has to pay for relinking every node in the tree.
+ */
+static void
+rehash(dns_rbt_t *rbt, unsigned int newcount) {
+	size_t newsize;
+	dns_rbtnode_t **newtable;
+	unsigned int i;
+
+	/*
+	 * A previous migration is normally long finished by the time
+	 * the table needs to grow again; if not, complete it now.
+	 */
+	hash_migrate(rbt, rbt->oldhashsize);
+	INSIST(rbt->oldhashtable == NULL);
+
+	newsize = rbt->hashsize;
+	do {
+		INSIST((newsize * 2 + 1) > newsize);
+		newsize = newsize * 2 + 1;
+	} while (newcount >= (newsize * 3));
+	newtable = isc_mem_get(rbt->mctx, newsize * sizeof(dns_rbtnode_t *));
+	if (newtable == NULL)
+		return;
+
+	for (i = 0; i < newsize; i++)
+		newtable[i] = NULL;
+
+	rbt->oldhashtable = rbt->hashtable;
+	rbt->oldhashsize = rbt->hashsize;
+	rbt->hashmigrate = 0;
+	rbt->hashtable = newtable;
+	rbt->hashsize = newsize;
 }
 
 /*
@@ -2339,6 +2417,8 @@ hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
 
 	if (rbt->nodecount >= (rbt->hashsize * 3))
 		rehash(rbt, rbt->nodecount);
+	else
+		hash_migrate(rbt, RBT_HASH_MIGRATE);
 
 	hash_add_node(rbt, node, name);
 }
@@ -2349,15 +2429,28 @@ hash_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
 static inline void
 unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node) {
 	unsigned int bucket;
+	dns_rbtnode_t **table;
 	dns_rbtnode_t *bucket_node;
 
 	REQUIRE(DNS_RBTNODE_VALID(node));
 
-	bucket = HASHVAL(node) % rbt->hashsize;
-	bucket_node = rbt->hashtable[bucket];
+	/*
+	 * If the node's bucket has not been migrated yet, it is still
+	 * in the old table.
+	 */
+	if (rbt->oldhashtable != NULL &&
+	    HASHVAL(node) % rbt->oldhashsize >= rbt->hashmigrate)
+	{
+		table = rbt->oldhashtable;
+		bucket = HASHVAL(node) % rbt->oldhashsize;
+	} else {
+		table = rbt->hashtable;
+		bucket = HASHVAL(node) % rbt->hashsize;
+	}
+	bucket_node = table[bucket];
 
 	if (bucket_node == node) {
-		rbt->hashtable[bucket] = HASHNEXT(node);
+		table[bucket] = HASHNEXT(node);
 	} else {
 		while (HASHNEXT(bucket_node) != node) {
 			INSIST(HASHNEXT(bucket_node) != NULL);
@@ -2365,6 +2458,8 @@ unhash_node(dns_rbt_t *rbt, dns_rbtnode_t *node) {
 		}
 		HASHNEXT(bucket_node) = HASHNEXT(node);
 	}
+
+	hash_migrate(rbt, RBT_HASH_MIGRATE);
 }
 
 static inline void
@@ -2780,12 +2875,13 @@ static void
 freenode(dns_rbt_t *rbt, dns_rbtnode_t **nodep) {
 	dns_rbtnode_t *node = *nodep;
 
+	rbt->nodecount--;
+	rbt->nodememory -= NODE_SIZE(node);
+
 	if (node->is_mmapped == 0) {
 		isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
 	}
 	*nodep = NULL;
-
-	rbt->nodecount--;
 }
 
 static void
@@ -2968,12 +3064,8 @@ dns_rbt_printnodeinfo(dns_rbtnode_t *n, FILE *f) {
 
 	fprintf(f, "n = %p\n", n);
 
-	fprintf(f, "Relative pointers: %s%s%s%s%s\n",
-			(n->parent_is_relative == 1 ? " P" : ""),
-			(n->right_is_relative == 1 ? " R" : ""),
-			(n->left_is_relative == 1 ? " L" : ""),
-			(n->down_is_relative == 1 ? " D" : ""),
-			(n->data_is_relative == 1 ? " T" : ""));
+	fprintf(f, "Relative pointers: %s\n",
+			(n->is_relative == 1 ? "yes" : "no"));
 
 	fprintf(f, "node lock address = %u\n", n->locknum);
 
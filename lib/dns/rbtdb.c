@@ -73,6 +73,10 @@
 #define MAP_FAILED	((void *)-1)
 #endif
 
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+#include <stdatomic.h>
+#endif
+
 #include "rbtdb.h"
 
 #define RBTDB_MAGIC                     ISC_MAGIC('R', 'B', 'D', '4')
@@ -183,6 +187,7 @@ typedef uint32_t                    rbtdb_rdatatype_t;
 typedef isc_rwlock_t nodelock_t;
 
 #define NODE_INITLOCK(l)        isc_rwlock_init((l), 0, 0)
+#define NODE_INITBIASEDLOCK(l, m) isc_rwlock_initbiased((l), (m), 0, 0)
 #define NODE_DESTROYLOCK(l)     isc_rwlock_destroy(l)
 #define NODE_LOCK(l, t)         RWLOCK((l), (t))
 #define NODE_UNLOCK(l, t)       RWUNLOCK((l), (t))
@@ -197,6 +202,7 @@ typedef isc_rwlock_t nodelock_t;
 typedef isc_mutex_t nodelock_t;
 
 #define NODE_INITLOCK(l)        isc_mutex_init(l)
+#define NODE_INITBIASEDLOCK(l, m) isc_mutex_init(l)
 #define NODE_DESTROYLOCK(l)     DESTROYLOCK(l)
 #define NODE_LOCK(l, t)         LOCK(l)
 #define NODE_UNLOCK(l, t)       UNLOCK(l)
@@ -210,14 +216,85 @@ typedef isc_mutex_t nodelock_t;
 #endif
 
 /*%
- * Whether to rate-limit updating the LRU to avoid possible thread contention.
- * Our performance measurement has shown the cost is marginal, so it's defined
- * to be 0 by default either with or without threads.
+ * Cache hits set the reference bit of the rdataset header (see
+ * touch_header()) while holding the node lock only for reading, so
+ * concurrent readers may set it at the same time.  They all store the
+ * same value, and the bit is only cleared with the node lock held for
+ * writing, so a plain bool will do where atomics are unavailable.
+ */
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+typedef atomic_bool rbtdb_refbit_t;
+#define REFBIT_ISSET(h) \
+	atomic_load_explicit(&(h)->referenced, memory_order_relaxed)
+#define REFBIT_STORE(h, v) \
+	atomic_store_explicit(&(h)->referenced, (v), memory_order_relaxed)
+#else
+typedef bool rbtdb_refbit_t;
+#define REFBIT_ISSET(h)         ((h)->referenced)
+#define REFBIT_STORE(h, v)      ((h)->referenced = (v))
+#endif
+
+/*%
+ * Number of referenced entries overmem_purge() will pass over per LRU list.
+ */
+#define RBTDB_LRU_SCAN 16
+
+/*%
+ * Cache admission (TinyLFU).  While the cache is over its memory limit,
+ * a new entry may only displace an LRU victim that has been used less
+ * often than the new entry itself; otherwise it is put on probation at
+ * the tail of its LRU list, where it will be the next to go.  Usage is
+ * estimated with a count-min sketch of node names behind a one-bit
+ * "doorkeeper" filter, so that names seen only once never reach the
+ * sketch, and all counts are halved every RBTDB_SKETCH_SAMPLES accesses.
+ *
+ * Set DNS_RBTDB_CACHE_ADMISSION to 0 to purge in plain LRU order.
+ */
+#ifndef DNS_RBTDB_CACHE_ADMISSION
+#define DNS_RBTDB_CACHE_ADMISSION 1
+#endif
+
+#define RBTDB_SKETCH_DEPTH	4
+#define RBTDB_SKETCH_WIDTH	65536		/*%< Must be a power of 2. */
+#define RBTDB_SKETCH_MAX	15
+#define RBTDB_SKETCH_SAMPLES	(RBTDB_SKETCH_WIDTH * 8)
+
+/*%
+ * The sketch is updated by cache hits holding only read locks.  The
+ * counts are estimates anyway, so increments racing with each other or
+ * with aging are allowed to get lost.
  */
-#ifndef DNS_RBTDB_LIMITLRUUPDATE
-#define DNS_RBTDB_LIMITLRUUPDATE 0
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+typedef atomic_uchar rbtdb_sketchcount_t;
+typedef atomic_uint rbtdb_sketchword_t;
+#define SKETCH_LOAD(p)		atomic_load_explicit((p), memory_order_relaxed)
+#define SKETCH_STORE(p, v) \
+	atomic_store_explicit((p), (v), memory_order_relaxed)
+#define SKETCH_OR(p, v) \
+	atomic_fetch_or_explicit((p), (v), memory_order_relaxed)
+#define SKETCH_INCR(p) \
+	(atomic_fetch_add_explicit((p), 1, memory_order_relaxed) + 1)
+#else
+typedef unsigned char rbtdb_sketchcount_t;
+typedef unsigned int rbtdb_sketchword_t;
+#define SKETCH_LOAD(p)		(*(p))
+#define SKETCH_STORE(p, v)	(*(p) = (v))
+#define SKETCH_OR(p, v)		(*(p) |= (v))
+#define SKETCH_INCR(p)		(++(*(p)))
 #endif
 
+/*%
+ * A sketch may be shared by several cache databases making up one cache,
+ * as the shards of a "shardcache" do, so that there is one per cache.
+ */
+typedef struct rbtdb_sketch {
+	isc_mem_t		*mctx;
+	isc_refcount_t		references;
+	rbtdb_sketchcount_t	counts[RBTDB_SKETCH_DEPTH][RBTDB_SKETCH_WIDTH];
+	rbtdb_sketchword_t	doorkeeper[RBTDB_SKETCH_WIDTH / 32];
+	rbtdb_sketchword_t	samples;
+} rbtdb_sketch_t;
+
 /*
  * Allow clients with a virtual time of up to 5 minutes in the past to see
  * records that would have otherwise have expired.
@@ -275,7 +352,11 @@ typedef struct rdatasetheader {
 	 */
 
 	dns_rbtnode_t                   *node;
-	isc_stdtime_t                   last_used;
+	rbtdb_refbit_t                  referenced;
+	/*%<
+	 * Set when a cache entry is used, cleared when overmem_purge()
+	 * gives it a second chance.  Not covered by the node lock.
+	 */
 	ISC_LINK(struct rdatasetheader) link;
 
 	unsigned int                    heap_index;
@@ -292,7 +373,27 @@ typedef struct rdatasetheader {
 } rdatasetheader_t;
 
 typedef ISC_LIST(rdatasetheader_t)      rdatasetheaderlist_t;
-typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
+
+/*%
+ * Nodes waiting to be deleted.  A node in 'nodes' records its position,
+ * plus one, in 'deadindex', so it can be taken out again in constant
+ * time.  When 'nodes' can't grow, the node is only marked as dead in
+ * its own 'deadindex' and counted in 'unlisted', so that adding a dead
+ * node never fails; such nodes are found again by walking the tree once
+ * 'nodes' has room for them.
+ */
+typedef struct {
+	dns_rbtnode_t **		nodes;
+	unsigned int			count;
+	unsigned int			size;
+	unsigned int			unlisted;
+} rbtnodelist_t;
+
+#define DEADINDEX_UNLISTED	((1U << DNS_RBT_DEADINDEXLENGTH) - 1)
+#define DEADINDEX_MAX		(DEADINDEX_UNLISTED - 1)
+
+#define DEADNODES_EMPTY(list) \
+	((list)->count == 0 && (list)->unlisted == 0)
 
 #define RDATASET_ATTR_NONEXISTENT       0x0001
 /*%< May be potentially served as stale data. */
@@ -310,6 +411,8 @@ typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
 #define RDATASET_ATTR_CASEFULLYLOWER    0x1000
 /*%< Ancient - awaiting cleanup. */
 #define RDATASET_ATTR_ANCIENT           0x2000
+/*%< Not admitted to the cache; kept at the tail of the LRU list. */
+#define RDATASET_ATTR_PROBATION         0x4000
 
 /*
  * XXX
@@ -349,6 +452,8 @@ typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
 	(((header)->attributes & RDATASET_ATTR_CASEFULLYLOWER) != 0)
 #define ANCIENT(header) \
 	(((header)->attributes & RDATASET_ATTR_ANCIENT) != 0)
+#define PROBATION(header) \
+	(((header)->attributes & RDATASET_ATTR_PROBATION) != 0)
 
 #define ACTIVE(header, now) \
 	(((header)->rdh_ttl > (now)) || \
@@ -523,6 +628,11 @@ struct dns_rbtdb {
 	isc_mem_t			*hmctx;
 	isc_heap_t                      **heaps;
 
+	/*%
+	 * Usage frequency estimates for cache admission (cache DB only).
+	 */
+	rbtdb_sketch_t			*sketch;
+
 	/*
 	 * Base values for the mmap() code.
 	 */
@@ -585,14 +695,16 @@ static isc_result_t rdataset_getclosest(dns_rdataset_t *rdataset,
 					dns_name_t *name,
 					dns_rdataset_t *neg,
 					dns_rdataset_t *negsig);
-static inline bool need_headerupdate(rdatasetheader_t *header,
-					      isc_stdtime_t now);
-static void update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
-			  isc_stdtime_t now);
+static inline void touch_header(rdatasetheader_t *header);
+static isc_result_t sketch_create(isc_mem_t *mctx, rbtdb_sketch_t **sketchp);
+static void sketch_detach(rbtdb_sketch_t **sketchp);
+static void sketch_record(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node);
+static unsigned int sketch_estimate(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node);
 static void expire_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
 			  bool tree_locked, expire_t reason);
-static void overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
-			  isc_stdtime_t now, bool tree_locked);
+static bool overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
+			  isc_stdtime_t now, bool tree_locked,
+			  unsigned int frequency);
 static isc_result_t resign_insert(dns_rbtdb_t *rbtdb, int idx,
 				  rdatasetheader_t *newheader);
 static void resign_delete(dns_rbtdb_t *rbtdb, rbtdb_version_t *version,
@@ -997,6 +1109,157 @@ adjust_quantum(unsigned int old, isc_time_t *start) {
 	return (nodes);
 }
 
+/*%
+ * Make room for 'size' nodes in 'list', if memory allows.
+ */
+static void
+deadnode_grow(dns_rbtdb_t *rbtdb, rbtnodelist_t *list, unsigned int size) {
+	dns_rbtnode_t **nodes;
+
+	if (size > DEADINDEX_MAX)
+		size = DEADINDEX_MAX;
+	if (size <= list->size)
+		return;
+
+	nodes = isc_mem_get(rbtdb->common.mctx,
+			    size * sizeof(dns_rbtnode_t *));
+	if (nodes == NULL) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_INFO,
+			      "failed to grow the dead node list");
+		return;
+	}
+	if (list->nodes != NULL) {
+		memmove(nodes, list->nodes,
+			list->count * sizeof(dns_rbtnode_t *));
+		isc_mem_put(rbtdb->common.mctx, list->nodes,
+			    list->size * sizeof(dns_rbtnode_t *));
+	}
+	list->nodes = nodes;
+	list->size = size;
+}
+
+/*%
+ * Add 'node' to the dead nodes in 'list'.  This can't fail: if the
+ * array can't take the node, it is left marked as unlisted.
+ *
+ * The caller must hold the node's bucket write lock.
+ */
+static void
+deadnode_append(dns_rbtdb_t *rbtdb, rbtnodelist_t *list,
+		dns_rbtnode_t *node)
+{
+	INSIST(node->deadindex == 0);
+
+	if (list->count == list->size)
+		deadnode_grow(rbtdb, list,
+			      (list->size == 0) ? 16 : list->size * 2);
+
+	if (list->count == list->size) {
+		node->deadindex = DEADINDEX_UNLISTED;
+		list->unlisted++;
+		return;
+	}
+
+	list->nodes[list->count++] = node;
+	node->deadindex = list->count;
+}
+
+/*%
+ * Take 'node' out of the dead nodes in 'list', moving the last one into
+ * its place.
+ */
+static void
+deadnode_unlink(rbtnodelist_t *list, dns_rbtnode_t *node) {
+	unsigned int i = node->deadindex - 1;
+
+	INSIST(node->deadindex != 0);
+
+	if (node->deadindex == DEADINDEX_UNLISTED) {
+		INSIST(list->unlisted != 0);
+		list->unlisted--;
+		node->deadindex = 0;
+		return;
+	}
+
+	INSIST(i < list->count);
+	INSIST(list->nodes[i] == node);
+
+	list->nodes[i] = list->nodes[--list->count];
+	list->nodes[i]->deadindex = i + 1;
+	node->deadindex = 0;
+}
+
+/*%
+ * Take the most recently added node out of 'list', or return NULL.
+ */
+static dns_rbtnode_t *
+deadnode_pop(rbtnodelist_t *list) {
+	dns_rbtnode_t *node;
+
+	if (list->count == 0)
+		return (NULL);
+
+	node = list->nodes[--list->count];
+	node->deadindex = 0;
+	return (node);
+}
+
+/*%
+ * Move the unlisted dead nodes in 'tree' that belong to bucket
+ * 'bucketnum' into its array, as far as there is room.
+ */
+static void
+deadnode_relisttree(rbtnodelist_t *list, dns_rbt_t *tree, int bucketnum) {
+	dns_rbtnodechain_t chain;
+	dns_rbtnode_t *node;
+	isc_result_t result;
+
+	dns_rbtnodechain_init(&chain, NULL);
+	result = dns_rbtnodechain_first(&chain, tree, NULL, NULL);
+	while ((result == ISC_R_SUCCESS || result == DNS_R_NEWORIGIN) &&
+	       list->unlisted != 0 && list->count < list->size)
+	{
+		node = NULL;
+		(void)dns_rbtnodechain_current(&chain, NULL, NULL, &node);
+		if (node->locknum == (unsigned int)bucketnum &&
+		    node->deadindex == DEADINDEX_UNLISTED)
+		{
+			list->unlisted--;
+			list->nodes[list->count++] = node;
+			node->deadindex = list->count;
+		}
+		result = dns_rbtnodechain_next(&chain, NULL, NULL);
+	}
+	dns_rbtnodechain_invalidate(&chain);
+}
+
+/*%
+ * Find the unlisted dead nodes of bucket 'bucketnum' again, so that they
+ * can be cleaned up.  This walks the whole database, so it is only done
+ * once the array has been emptied, and the array is first grown to hold
+ * all of them if possible.
+ *
+ * The caller must hold a tree write lock and bucketnum'th node (write)
+ * lock.
+ */
+static void
+deadnode_relist(dns_rbtdb_t *rbtdb, int bucketnum) {
+	rbtnodelist_t *list = &rbtdb->deadnodes[bucketnum];
+
+	if (list->unlisted == 0 || list->count != 0)
+		return;
+
+	deadnode_grow(rbtdb, list, list->unlisted);
+	if (list->size == 0)
+		return;
+
+	deadnode_relisttree(list, rbtdb->tree, bucketnum);
+	deadnode_relisttree(list, rbtdb->nsec, bucketnum);
+	deadnode_relisttree(list, rbtdb->nsec3, bucketnum);
+	INSIST(list->unlisted == 0 || list->count == list->size);
+}
+
 static void
 free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 	unsigned int i;
@@ -1029,15 +1292,14 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 	/*
 	 * We assume the number of remaining dead nodes is reasonably small;
 	 * the overhead of unlinking all nodes here should be negligible.
+	 * Unlisted ones are freed with the trees.
 	 */
 	for (i = 0; i < rbtdb->node_lock_count; i++) {
 		dns_rbtnode_t *node;
 
-		node = ISC_LIST_HEAD(rbtdb->deadnodes[i]);
-		while (node != NULL) {
-			ISC_LIST_UNLINK(rbtdb->deadnodes[i], node, deadlink);
-			node = ISC_LIST_HEAD(rbtdb->deadnodes[i]);
-		}
+		while ((node = deadnode_pop(&rbtdb->deadnodes[i])) != NULL)
+			;
+		rbtdb->deadnodes[i].unlisted = 0;
 	}
 
 	if (event == NULL)
@@ -1115,8 +1377,14 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 	 * Clean up dead node buckets.
 	 */
 	if (rbtdb->deadnodes != NULL) {
-		for (i = 0; i < rbtdb->node_lock_count; i++)
-			INSIST(ISC_LIST_EMPTY(rbtdb->deadnodes[i]));
+		for (i = 0; i < rbtdb->node_lock_count; i++) {
+			INSIST(DEADNODES_EMPTY(&rbtdb->deadnodes[i]));
+			if (rbtdb->deadnodes[i].nodes != NULL)
+				isc_mem_put(rbtdb->common.mctx,
+					    rbtdb->deadnodes[i].nodes,
+					    rbtdb->deadnodes[i].size *
+					    sizeof(dns_rbtnode_t *));
+		}
 		isc_mem_put(rbtdb->common.mctx, rbtdb->deadnodes,
 		    rbtdb->node_lock_count * sizeof(rbtnodelist_t));
 	}
@@ -1129,6 +1397,8 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 		isc_mem_put(rbtdb->hmctx, rbtdb->heaps,
 			    rbtdb->node_lock_count * sizeof(isc_heap_t *));
 	}
+	if (rbtdb->sketch != NULL)
+		sketch_detach(&rbtdb->sketch);
 
 	if (rbtdb->rrsetstats != NULL)
 		dns_stats_detach(&rbtdb->rrsetstats);
@@ -1759,7 +2029,7 @@ delete_node(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node) {
 	dns_name_t *name;
 	isc_result_t result = ISC_R_UNEXPECTED;
 
-	INSIST(!ISC_LINK_LINKED(node, deadlink));
+	INSIST(node->deadindex == 0);
 
 	if (isc_log_wouldlog(dns_lctx, ISC_LOG_DEBUG(1))) {
 		char printname[DNS_NAME_FORMATSIZE];
@@ -1917,7 +2187,7 @@ new_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node) {
 	unsigned int lockrefs, noderefs;
 	isc_refcount_t *lockref;
 
-	INSIST(!ISC_LINK_LINKED(node, deadlink));
+	INSIST(node->deadindex == 0);
 	dns_rbtnode_refincrement0(node, &noderefs);
 	if (noderefs == 1) {    /* this is the first reference to the node */
 		lockref = &rbtdb->node_locks[node->locknum].references;
@@ -1940,9 +2210,11 @@ cleanup_dead_nodes(dns_rbtdb_t *rbtdb, int bucketnum) {
 	dns_rbtnode_t *node;
 	int count = 10;         /* XXXJT: should be adjustable */
 
-	node = ISC_LIST_HEAD(rbtdb->deadnodes[bucketnum]);
-	while (node != NULL && count > 0) {
-		ISC_LIST_UNLINK(rbtdb->deadnodes[bucketnum], node, deadlink);
+	deadnode_relist(rbtdb, bucketnum);
+
+	while (count > 0 &&
+	       (node = deadnode_pop(&rbtdb->deadnodes[bucketnum])) != NULL)
+	{
 
 		/*
 		 * Since we're holding a tree write lock, it should be
@@ -1969,13 +2241,17 @@ cleanup_dead_nodes(dns_rbtdb_t *rbtdb, int bucketnum) {
 				ev->ev_sender = db;
 				isc_task_send(rbtdb->task, &ev);
 			} else {
-				ISC_LIST_APPEND(rbtdb->deadnodes[bucketnum],
-						node, deadlink);
+				/*
+				 * Put it back and try again later.
+				 */
+				deadnode_append(rbtdb,
+						&rbtdb->deadnodes[bucketnum],
+						node);
+				break;
 			}
 		} else {
 			delete_node(rbtdb, node);
 		}
-		node = ISC_LIST_HEAD(rbtdb->deadnodes[bucketnum]);
 		count--;
 	}
 }
@@ -2007,12 +2283,12 @@ reactivate_node(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	 * Check if we can possibly cleanup the dead node.  If so, upgrade
 	 * the node lock below to perform the cleanup.
 	 */
-	if (!ISC_LIST_EMPTY(rbtdb->deadnodes[node->locknum]) &&
+	if (!DEADNODES_EMPTY(&rbtdb->deadnodes[node->locknum]) &&
 	    treelocktype == isc_rwlocktype_write) {
 		maybe_cleanup = true;
 	}
 
-	if (ISC_LINK_LINKED(node, deadlink) || maybe_cleanup) {
+	if (node->deadindex != 0 || maybe_cleanup) {
 		/*
 		 * Upgrade the lock and test if we still need to unlink.
 		 */
@@ -2020,9 +2296,9 @@ reactivate_node(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		locktype = isc_rwlocktype_write;
 		POST(locktype);
 		NODE_WEAKLOCK(nodelock, locktype);
-		if (ISC_LINK_LINKED(node, deadlink))
-			ISC_LIST_UNLINK(rbtdb->deadnodes[node->locknum],
-					node, deadlink);
+		if (node->deadindex != 0)
+			deadnode_unlink(&rbtdb->deadnodes[node->locknum],
+					node);
 		if (maybe_cleanup)
 			cleanup_dead_nodes(rbtdb, node->locknum);
 	}
@@ -2196,17 +2472,17 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 					      "decrement_reference: failed to "
 					      "allocate pruning event");
 				INSIST(node->data == NULL);
-				INSIST(!ISC_LINK_LINKED(node, deadlink));
-				ISC_LIST_APPEND(rbtdb->deadnodes[bucket], node,
-						deadlink);
+				INSIST(node->deadindex == 0);
+				deadnode_append(rbtdb,
+						&rbtdb->deadnodes[bucket], node);
 			}
 		} else {
 			delete_node(rbtdb, node);
 		}
 	} else {
 		INSIST(node->data == NULL);
-		INSIST(!ISC_LINK_LINKED(node, deadlink));
-		ISC_LIST_APPEND(rbtdb->deadnodes[bucket], node, deadlink);
+		INSIST(node->deadindex == 0);
+		deadnode_append(rbtdb, &rbtdb->deadnodes[bucket], node);
 	}
 
  restore_locks:
@@ -2276,9 +2552,9 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 			 * from the list beforehand as we do in
 			 * reactivate_node().
 			 */
-			if (ISC_LINK_LINKED(parent, deadlink))
-				ISC_LIST_UNLINK(rbtdb->deadnodes[locknum],
-						parent, deadlink);
+			if (parent->deadindex != 0)
+				deadnode_unlink(&rbtdb->deadnodes[locknum],
+						parent);
 			new_reference(rbtdb, parent);
 		} else
 			parent = NULL;
@@ -2496,7 +2772,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
 			  isc_rwlocktype_write);
 		cleanup_dead_nodes(rbtdb, locknum);
-		if (ISC_LIST_HEAD(rbtdb->deadnodes[locknum]) != NULL)
+		if (!DEADNODES_EMPTY(&rbtdb->deadnodes[locknum]))
 			again = true;
 		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
 			    isc_rwlocktype_write);
@@ -4597,7 +4873,7 @@ cache_zonecut_callback(dns_rbtnode_t *node, dns_name_t *name, void *arg) {
 		 * search->zonecut_rdataset will still be valid later.
 		 */
 		new_reference(search->rbtdb, node);
-		INSIST(!ISC_LINK_LINKED(node, deadlink));
+		INSIST(node->deadindex == 0);
 		search->zonecut = node;
 		search->zonecut_rdataset = dname_header;
 		search->zonecut_sigrdataset = sigdname_header;
@@ -4711,24 +4987,10 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 			if (foundsig != NULL)
 				bind_rdataset(search->rbtdb, node, foundsig,
 					      search->now, sigrdataset);
-			if (need_headerupdate(found, search->now) ||
-			    (foundsig != NULL &&
-			     need_headerupdate(foundsig, search->now))) {
-				if (locktype != isc_rwlocktype_write) {
-					NODE_UNLOCK(lock, locktype);
-					NODE_LOCK(lock, isc_rwlocktype_write);
-					locktype = isc_rwlocktype_write;
-					POST(locktype);
-				}
-				if (need_headerupdate(found, search->now))
-					update_header(search->rbtdb, found,
-						      search->now);
-				if (foundsig != NULL &&
-				    need_headerupdate(foundsig, search->now)) {
-					update_header(search->rbtdb, foundsig,
-						      search->now);
-				}
-			}
+			touch_header(found);
+			if (foundsig != NULL)
+				touch_header(foundsig);
+			sketch_record(search->rbtdb, node);
 		}
 
 	node_exit:
@@ -4849,7 +5111,6 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	rdatasetheader_t *header, *header_prev, *header_next;
 	rdatasetheader_t *found, *nsheader;
 	rdatasetheader_t *foundsig, *nssig, *cnamesig;
-	rdatasetheader_t *update, *updatesig;
 	rdatasetheader_t *nsecheader, *nsecsig;
 	rbtdb_rdatatype_t sigtype, negtype;
 
@@ -4873,8 +5134,6 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	dns_fixedname_init(&search.zonecut_name);
 	dns_rbtnodechain_init(&search.chain, search.rbtdb->common.mctx);
 	search.now = now;
-	update = NULL;
-	updatesig = NULL;
 
 	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
@@ -5044,18 +5303,17 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		{
 			if (nodep != NULL) {
 				new_reference(search.rbtdb, node);
-				INSIST(!ISC_LINK_LINKED(node, deadlink));
+				INSIST(node->deadindex == 0);
 				*nodep = node;
 			}
 			bind_rdataset(search.rbtdb, node, nsecheader,
 				      search.now, rdataset);
-			if (need_headerupdate(nsecheader, search.now))
-				update = nsecheader;
+			touch_header(nsecheader);
+			sketch_record(search.rbtdb, node);
 			if (nsecsig != NULL) {
 				bind_rdataset(search.rbtdb, node, nsecsig,
 					      search.now, sigrdataset);
-				if (need_headerupdate(nsecsig, search.now))
-					updatesig = nsecsig;
+				touch_header(nsecsig);
 			}
 			result = DNS_R_COVERINGNSEC;
 			goto node_exit;
@@ -5068,18 +5326,17 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		if (nsheader != NULL) {
 			if (nodep != NULL) {
 				new_reference(search.rbtdb, node);
-				INSIST(!ISC_LINK_LINKED(node, deadlink));
+				INSIST(node->deadindex == 0);
 				*nodep = node;
 			}
 			bind_rdataset(search.rbtdb, node, nsheader, search.now,
 				      rdataset);
-			if (need_headerupdate(nsheader, search.now))
-				update = nsheader;
+			touch_header(nsheader);
+			sketch_record(search.rbtdb, node);
 			if (nssig != NULL) {
 				bind_rdataset(search.rbtdb, node, nssig,
 					      search.now, sigrdataset);
-				if (need_headerupdate(nssig, search.now))
-					updatesig = nssig;
+				touch_header(nssig);
 			}
 			result = DNS_R_DELEGATION;
 			goto node_exit;
@@ -5098,7 +5355,7 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 
 	if (nodep != NULL) {
 		new_reference(search.rbtdb, node);
-		INSIST(!ISC_LINK_LINKED(node, deadlink));
+		INSIST(node->deadindex == 0);
 		*nodep = node;
 	}
 
@@ -5130,29 +5387,16 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	    result == DNS_R_NCACHENXRRSET) {
 		bind_rdataset(search.rbtdb, node, found, search.now,
 			      rdataset);
-		if (need_headerupdate(found, search.now))
-			update = found;
+		touch_header(found);
+		sketch_record(search.rbtdb, node);
 		if (!NEGATIVE(found) && foundsig != NULL) {
 			bind_rdataset(search.rbtdb, node, foundsig, search.now,
 				      sigrdataset);
-			if (need_headerupdate(foundsig, search.now))
-				updatesig = foundsig;
+			touch_header(foundsig);
 		}
 	}
 
  node_exit:
-	if ((update != NULL || updatesig != NULL) &&
-	    locktype != isc_rwlocktype_write) {
-		NODE_UNLOCK(lock, locktype);
-		NODE_LOCK(lock, isc_rwlocktype_write);
-		locktype = isc_rwlocktype_write;
-		POST(locktype);
-	}
-	if (update != NULL && need_headerupdate(update, search.now))
-		update_header(search.rbtdb, update, search.now);
-	if (updatesig != NULL && need_headerupdate(updatesig, search.now))
-		update_header(search.rbtdb, updatesig, search.now);
-
 	NODE_UNLOCK(lock, locktype);
 
  tree_exit:
@@ -5283,7 +5527,7 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 
 	if (nodep != NULL) {
 		new_reference(search.rbtdb, node);
-		INSIST(!ISC_LINK_LINKED(node, deadlink));
+		INSIST(node->deadindex == 0);
 		*nodep = node;
 	}
 
@@ -5292,21 +5536,10 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 		bind_rdataset(search.rbtdb, node, foundsig, search.now,
 			      sigrdataset);
 
-	if (need_headerupdate(found, search.now) ||
-	    (foundsig != NULL &&  need_headerupdate(foundsig, search.now))) {
-		if (locktype != isc_rwlocktype_write) {
-			NODE_UNLOCK(lock, locktype);
-			NODE_LOCK(lock, isc_rwlocktype_write);
-			locktype = isc_rwlocktype_write;
-			POST(locktype);
-		}
-		if (need_headerupdate(found, search.now))
-			update_header(search.rbtdb, found, search.now);
-		if (foundsig != NULL &&
-		    need_headerupdate(foundsig, search.now)) {
-			update_header(search.rbtdb, foundsig, search.now);
-		}
-	}
+	touch_header(found);
+	if (foundsig != NULL)
+		touch_header(foundsig);
+	sketch_record(search.rbtdb, node);
 
 	NODE_UNLOCK(lock, locktype);
 
@@ -6274,7 +6507,8 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 			newheader->down = NULL;
 			idx = newheader->node->locknum;
 			if (IS_CACHE(rbtdb)) {
-				if (ZEROTTL(newheader))
+				if (ZEROTTL(newheader) ||
+				    PROBATION(newheader))
 					ISC_LIST_APPEND(rbtdb->rdatasets[idx],
 							newheader, link);
 				else
@@ -6336,7 +6570,8 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 						      newheader);
 					return (result);
 				}
-				if (ZEROTTL(newheader))
+				if (ZEROTTL(newheader) ||
+				    PROBATION(newheader))
 					ISC_LIST_APPEND(rbtdb->rdatasets[idx],
 							newheader, link);
 				else
@@ -6401,7 +6636,7 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 					      newheader);
 				return (result);
 			}
-			if (ZEROTTL(newheader))
+			if (ZEROTTL(newheader) || PROBATION(newheader))
 				ISC_LIST_APPEND(rbtdb->rdatasets[idx],
 						newheader, link);
 			else
@@ -6648,7 +6883,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->closest = NULL;
 	newheader->count = init_count++;
 	newheader->trust = rdataset->trust;
-	newheader->last_used = now;
+	REFBIT_STORE(newheader, false);
 	newheader->node = rbtnode;
 	if (rbtversion != NULL) {
 		newheader->serial = rbtversion->serial;
@@ -6725,8 +6960,28 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	}
 
-	if (cache_is_overmem)
-		overmem_purge(rbtdb, rbtnode->locknum, now, tree_locked);
+	/*
+	 * Data is added to a cache after a miss, which counts as a use of
+	 * the name as far as admission is concerned.  The signatures come
+	 * with the data they cover, so they don't count again.
+	 */
+	if (IS_CACHE(rbtdb) && rdataset->type != dns_rdatatype_rrsig)
+		sketch_record(rbtdb, rbtnode);
+
+	if (cache_is_overmem) {
+		unsigned int frequency = 0;
+
+		if (rbtdb->sketch != NULL)
+			frequency = sketch_estimate(rbtdb, rbtnode);
+		if (!overmem_purge(rbtdb, rbtnode->locknum, now, tree_locked,
+				   frequency))
+		{
+			newheader->attributes |= RDATASET_ATTR_PROBATION;
+			if (rbtdb->cachestats != NULL)
+				isc_stats_increment(rbtdb->cachestats,
+					dns_cachestatscounter_probation);
+		}
+	}
 
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
@@ -6834,7 +7089,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
 	newheader->count = init_count++;
-	newheader->last_used = 0;
+	REFBIT_STORE(newheader, false);
 	newheader->node = rbtnode;
 	if ((rdataset->attributes & DNS_RDATASETATTR_RESIGN) != 0) {
 		newheader->attributes |= RDATASET_ATTR_RESIGN;
@@ -6944,7 +7199,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			newheader->node = rbtnode;
 			newheader->resign = 0;
 			newheader->resign_lsb = 0;
-			newheader->last_used = 0;
+			REFBIT_STORE(newheader, false);
 		} else {
 			free_rdataset(rbtdb, rbtdb->common.mctx, newheader);
 			goto unlock;
@@ -7032,7 +7287,7 @@ deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	else
 		newheader->serial = 0;
 	newheader->count = 0;
-	newheader->last_used = 0;
+	REFBIT_STORE(newheader, false);
 	newheader->node = rbtnode;
 
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
@@ -7218,7 +7473,7 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
 	newheader->count = init_count++;
-	newheader->last_used = 0;
+	REFBIT_STORE(newheader, false);
 	newheader->node = node;
 	setownercase(newheader, name);
 
@@ -7786,6 +8041,22 @@ nodecount(dns_db_t *db) {
 	return (count);
 }
 
+static size_t
+nodememory(dns_db_t *db) {
+	dns_rbtdb_t *rbtdb;
+	size_t size;
+
+	rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	size = dns_rbt_nodememory(rbtdb->tree);
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+
+	return (size);
+}
+
 static size_t
 hashsize(dns_db_t *db) {
 	dns_rbtdb_t *rbtdb;
@@ -8179,7 +8450,8 @@ static dns_dbmethods_t zone_methods = {
 	getsize,
 	NULL,			/* setservestalettl */
 	NULL,			/* getservestalettl */
-	setgluecachestats
+	setgluecachestats,
+	nodememory
 };
 
 static dns_dbmethods_t cache_methods = {
@@ -8230,7 +8502,8 @@ static dns_dbmethods_t cache_methods = {
 	NULL,			/* getsize */
 	setservestalettl,
 	getservestalettl,
-	NULL
+	NULL,			/* setgluecachestats */
+	nodememory
 };
 
 isc_result_t
@@ -8278,7 +8551,16 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_rbtdb;
 
-	result = isc_rwlock_init(&rbtdb->tree_lock, 0, 0);
+	/*
+	 * The tree and node locks of a cache are read-locked for every
+	 * lookup by every worker thread, so make them reader-biased.
+	 * Zones are far more numerous and far less contended, and are not
+	 * worth the extra memory.
+	 */
+	if (IS_CACHE(rbtdb))
+		result = isc_rwlock_initbiased(&rbtdb->tree_lock, mctx, 0, 0);
+	else
+		result = isc_rwlock_init(&rbtdb->tree_lock, 0, 0);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_lock;
 
@@ -8309,8 +8591,14 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	rbtdb->gluecachestats = NULL;
 
 	rbtdb->rrsetstats = NULL;
+	rbtdb->sketch = NULL;
 	if (IS_CACHE(rbtdb)) {
-		result = dns_rdatasetstats_create(mctx, &rbtdb->rrsetstats);
+		if (argc > 1 && argv[1] != NULL)
+			dns_stats_attach((dns_stats_t *)argv[1],
+					 &rbtdb->rrsetstats);
+		else
+			result = dns_rdatasetstats_create(mctx,
+							  &rbtdb->rrsetstats);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup_node_locks;
 		rbtdb->rdatasets = isc_mem_get(mctx, rbtdb->node_lock_count *
@@ -8321,6 +8609,22 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 		}
 		for (i = 0; i < (int)rbtdb->node_lock_count; i++)
 			ISC_LIST_INIT(rbtdb->rdatasets[i]);
+#if DNS_RBTDB_CACHE_ADMISSION
+		if (argc > 2 && argv[2] != NULL) {
+			dns_rbtdb_t *source = (dns_rbtdb_t *)argv[2];
+
+			REQUIRE(VALID_RBTDB(source) && IS_CACHE(source));
+			if (source->sketch != NULL) {
+				isc_refcount_increment(
+					&source->sketch->references, NULL);
+				rbtdb->sketch = source->sketch;
+			}
+		} else {
+			result = sketch_create(hmctx, &rbtdb->sketch);
+			if (result != ISC_R_SUCCESS)
+				goto cleanup_rdatasets;
+		}
+#endif
 	} else
 		rbtdb->rdatasets = NULL;
 
@@ -8352,13 +8656,17 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 		result = ISC_R_NOMEMORY;
 		goto cleanup_heaps;
 	}
-	for (i = 0; i < (int)rbtdb->node_lock_count; i++)
-		ISC_LIST_INIT(rbtdb->deadnodes[i]);
+	memset(rbtdb->deadnodes, 0,
+	       rbtdb->node_lock_count * sizeof(rbtnodelist_t));
 
 	rbtdb->active = rbtdb->node_lock_count;
 
 	for (i = 0; i < (int)(rbtdb->node_lock_count); i++) {
-		result = NODE_INITLOCK(&rbtdb->node_locks[i].lock);
+		if (IS_CACHE(rbtdb))
+			result = NODE_INITBIASEDLOCK(&rbtdb->node_locks[i].lock,
+						     mctx);
+		else
+			result = NODE_INITLOCK(&rbtdb->node_locks[i].lock);
 		if (result == ISC_R_SUCCESS) {
 			result = isc_refcount_init(&rbtdb->node_locks[i].references, 0);
 			if (result != ISC_R_SUCCESS)
@@ -8545,6 +8853,8 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	}
 
  cleanup_rdatasets:
+	if (rbtdb->sketch != NULL)
+		sketch_detach(&rbtdb->sketch);
 	if (rbtdb->rdatasets != NULL)
 		isc_mem_put(mctx, rbtdb->rdatasets, rbtdb->node_lock_count *
 			    sizeof(rdatasetheaderlist_t));
@@ -10248,70 +10558,156 @@ no_glue:
  */
 
 /*%
- * See if a given cache entry that is being reused needs to be updated
- * in the LRU-list.  From the LRU management point of view, this function is
- * expected to return true for almost all cases.  When used with threads,
- * however, this may cause a non-negligible performance penalty because a
- * writer lock will have to be acquired before updating the list.
- * If DNS_RBTDB_LIMITLRUUPDATE is defined to be non 0 at compilation time, this
- * function returns true if the entry has not been updated for some period of
- * time.  We differentiate the NS or glue address case and the others since
- * experiments have shown that the former tends to be accessed relatively
- * infrequently and the cost of cache miss is higher (e.g., a missing NS records
- * may cause external queries at a higher level zone, involving more
- * transactions).
+ * Note that a cache entry has been used.  The entry stays where it is in
+ * its LRU list; overmem_purge() gives referenced entries a second chance
+ * before expiring them.  Setting the bit is a single relaxed store, so
+ * that a cache hit never has to upgrade to a write lock.
  *
  * Caller must hold the node (read or write) lock.
  */
-static inline bool
-need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
+static inline void
+touch_header(rdatasetheader_t *header) {
 	if ((header->attributes &
 	     (RDATASET_ATTR_NONEXISTENT |
 	      RDATASET_ATTR_ANCIENT |
 	      RDATASET_ATTR_ZEROTTL)) != 0)
-		return (false);
+		return;
 
-#if DNS_RBTDB_LIMITLRUUPDATE
-	if (header->type == dns_rdatatype_ns ||
-	    (header->trust == dns_trust_glue &&
-	     (header->type == dns_rdatatype_a ||
-	      header->type == dns_rdatatype_aaaa))) {
-		/*
-		 * Glue records are updated if at least 60 seconds have passed
-		 * since the previous update time.
-		 */
-		return (header->last_used + 60 <= now);
+	/* Avoid dirtying the cache line when the bit is already set. */
+	if (!REFBIT_ISSET(header))
+		REFBIT_STORE(header, true);
+}
+
+static isc_result_t
+sketch_create(isc_mem_t *mctx, rbtdb_sketch_t **sketchp) {
+	rbtdb_sketch_t *sketch;
+	isc_result_t result;
+
+	REQUIRE(sketchp != NULL && *sketchp == NULL);
+
+	sketch = isc_mem_get(mctx, sizeof(*sketch));
+	if (sketch == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(sketch, 0, sizeof(*sketch));
+
+	result = isc_refcount_init(&sketch->references, 1);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, sketch, sizeof(*sketch));
+		return (result);
 	}
+	isc_mem_attach(mctx, &sketch->mctx);
 
-	/* Other records are updated if 5 minutes have passed. */
-	return (header->last_used + 300 <= now);
-#else
-	UNUSED(now);
+	*sketchp = sketch;
 
-	return (true);
-#endif
+	return (ISC_R_SUCCESS);
+}
+
+static void
+sketch_detach(rbtdb_sketch_t **sketchp) {
+	rbtdb_sketch_t *sketch;
+	unsigned int refs;
+
+	REQUIRE(sketchp != NULL && *sketchp != NULL);
+
+	sketch = *sketchp;
+	*sketchp = NULL;
+
+	isc_refcount_decrement(&sketch->references, &refs);
+	if (refs == 0) {
+		isc_refcount_destroy(&sketch->references);
+		isc_mem_putanddetach(&sketch->mctx, sketch, sizeof(*sketch));
+	}
 }
 
 /*%
- * Update the timestamp of a given cache entry and move it to the head
- * of the corresponding LRU list.
- *
- * Caller must hold the node (write) lock.
- *
- * Note that the we do NOT touch the heap here, as the TTL has not changed.
+ * Column of the sketch row 'row' that counts names hashing to 'hashval'.
+ */
+static inline unsigned int
+sketch_column(unsigned int hashval, unsigned int row) {
+	unsigned int h2 = ((hashval >> 16) | (hashval << 16)) * 0x9e3779b1U;
+
+	return ((hashval + row * (h2 | 1)) & (RBTDB_SKETCH_WIDTH - 1));
+}
+
+/*%
+ * Halve all counts and empty the doorkeeper, so that names which used to
+ * be popular eventually make way for new ones.
  */
 static void
-update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
-	      isc_stdtime_t now)
-{
-	INSIST(IS_CACHE(rbtdb));
+sketch_age(rbtdb_sketch_t *sketch) {
+	unsigned int i, j, count;
+
+	SKETCH_STORE(&sketch->samples, 0);
+
+	for (i = 0; i < RBTDB_SKETCH_DEPTH; i++) {
+		for (j = 0; j < RBTDB_SKETCH_WIDTH; j++) {
+			count = SKETCH_LOAD(&sketch->counts[i][j]);
+			if (count != 0)
+				SKETCH_STORE(&sketch->counts[i][j],
+					     count >> 1);
+		}
+	}
+	for (i = 0; i < RBTDB_SKETCH_WIDTH / 32; i++)
+		SKETCH_STORE(&sketch->doorkeeper[i], 0);
+}
+
+/*%
+ * Record a use of 'node': a cache hit, or the addition of data after a
+ * cache miss.  The first use only sets the node's doorkeeper bit.
+ */
+static void
+sketch_record(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node) {
+	rbtdb_sketch_t *sketch = rbtdb->sketch;
+	unsigned int i, col, count, bit;
+
+	if (sketch == NULL)
+		return;
 
-	/* To be checked: can we really assume this? XXXMLG */
-	INSIST(ISC_LINK_LINKED(header, link));
+	col = sketch_column(node->hashval, RBTDB_SKETCH_DEPTH);
+	bit = 1U << (col % 32);
+	if ((SKETCH_LOAD(&sketch->doorkeeper[col / 32]) & bit) == 0) {
+		(void)SKETCH_OR(&sketch->doorkeeper[col / 32], bit);
+		return;
+	}
+
+	for (i = 0; i < RBTDB_SKETCH_DEPTH; i++) {
+		col = sketch_column(node->hashval, i);
+		count = SKETCH_LOAD(&sketch->counts[i][col]);
+		if (count < RBTDB_SKETCH_MAX)
+			SKETCH_STORE(&sketch->counts[i][col], count + 1);
+	}
 
-	ISC_LIST_UNLINK(rbtdb->rdatasets[header->node->locknum], header, link);
-	header->last_used = now;
-	ISC_LIST_PREPEND(rbtdb->rdatasets[header->node->locknum], header, link);
+	/*
+	 * Only the use that takes 'samples' to the limit ages the
+	 * sketch; uses racing with it see a larger value and go on.
+	 */
+	if (SKETCH_INCR(&sketch->samples) == RBTDB_SKETCH_SAMPLES)
+		sketch_age(sketch);
+}
+
+/*%
+ * Estimate how often 'node' has been used recently.
+ */
+static unsigned int
+sketch_estimate(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node) {
+	rbtdb_sketch_t *sketch = rbtdb->sketch;
+	unsigned int i, col, count, estimate = RBTDB_SKETCH_MAX;
+
+	INSIST(sketch != NULL);
+
+	col = sketch_column(node->hashval, RBTDB_SKETCH_DEPTH);
+	if ((SKETCH_LOAD(&sketch->doorkeeper[col / 32]) &
+	     (1U << (col % 32))) == 0)
+		return (0);
+
+	for (i = 0; i < RBTDB_SKETCH_DEPTH; i++) {
+		col = sketch_column(node->hashval, i);
+		count = SKETCH_LOAD(&sketch->counts[i][col]);
+		if (count < estimate)
+			estimate = count;
+	}
+
+	return (estimate + 1);
 }
 
 /*%
@@ -10323,17 +10719,29 @@ update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
  * entries of the same name of different RR types while adding RRsets from a
  * single response (consider the case where we're adding A and AAAA glue records
  * of the same NS name).
+ *
+ * The LRU lists are swept like a CLOCK: an entry that has been used since
+ * the last sweep has its reference bit cleared and is moved back to the head
+ * of the list instead of being purged.  At most RBTDB_LRU_SCAN entries per
+ * list get this second chance, so that a list full of hot entries cannot stop
+ * us from recovering memory.
+ *
+ * If 'frequency' is non-zero, it is the estimated usage of the new entry,
+ * which is not admitted if the next LRU victim has been used at least as
+ * often.  Nothing more is purged in that case, and false is returned.
+ * Entries on probation are always purged first.
  */
-static void
+static bool
 overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
-	      isc_stdtime_t now, bool tree_locked)
+	      isc_stdtime_t now, bool tree_locked, unsigned int frequency)
 {
-	rdatasetheader_t *header, *header_prev;
-	unsigned int locknum;
+	rdatasetheader_t *header, *header_prev, *moved;
+	unsigned int locknum, scanned;
 	int purgecount = 2;
+	bool admit = true;
 
 	for (locknum = (locknum_start + 1) % rbtdb->node_lock_count;
-	     locknum != locknum_start && purgecount > 0;
+	     locknum != locknum_start && purgecount > 0 && admit;
 	     locknum = (locknum + 1) % rbtdb->node_lock_count) {
 		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
 			  isc_rwlocktype_write);
@@ -10345,10 +10753,33 @@ overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
 			purgecount--;
 		}
 
+		scanned = 0;
+		moved = NULL;
 		for (header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
-		     header != NULL && purgecount > 0;
+		     header != NULL && header != moved && purgecount > 0;
 		     header = header_prev) {
 			header_prev = ISC_LIST_PREV(header, link);
+			if (REFBIT_ISSET(header) && scanned++ < RBTDB_LRU_SCAN) {
+				/*
+				 * Stop once we get back to the entries we
+				 * have moved to the head.
+				 */
+				if (moved == NULL)
+					moved = header;
+				REFBIT_STORE(header, false);
+				header->attributes &= ~RDATASET_ATTR_PROBATION;
+				ISC_LIST_UNLINK(rbtdb->rdatasets[locknum],
+						header, link);
+				ISC_LIST_PREPEND(rbtdb->rdatasets[locknum],
+						 header, link);
+				continue;
+			}
+			if (frequency != 0 && !PROBATION(header) &&
+			    sketch_estimate(rbtdb, header->node) >= frequency)
+			{
+				admit = false;
+				break;
+			}
 			/*
 			 * Unlink the entry at this point to avoid checking it
 			 * again even if it's currently used someone else and
@@ -10366,6 +10797,8 @@ overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
 		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
 				    isc_rwlocktype_write);
 	}
+
+	return (admit);
 }
 
 static void
@@ -40,9 +40,22 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *base, dns_dbtype_t type,
  * allocation of heap memory.  Generally this is used for cache databases
  * only.
  *
+ * If argv[1] is set for a cache database, it points to a rdataset
+ * statistics set to be shared with other databases instead of creating
+ * a private one.  This is used by the sharded cache database.
+ *
+ * If argv[2] is set for a cache database, it points to another "rbt"
+ * cache database whose cache admission sketch is shared instead of
+ * allocating a private one, so that the shards of one cache together
+ * estimate how often names are used.
+ *
  * Requires:
  *
  * \li argc == 0 or argv[0] is a valid memory context.
+ *
+ * \li argc < 2 or argv[1] is NULL or a valid rdataset statistics set.
+ *
+ * \li argc < 3 or argv[2] is NULL or a valid "rbt" cache database.
  */
 
 ISC_LANG_ENDDECLS
@@ -153,6 +153,12 @@
 #define MAX_SINGLE_QUERY_TIMEOUT 9000U
 #define MAX_SINGLE_QUERY_TIMEOUT_US (MAX_SINGLE_QUERY_TIMEOUT*US_PER_MSEC)
 
+/*
+ * The longest we keep an idle TCP connection open for a server that
+ * asked for it with the EDNS TCP keepalive option.
+ */
+#define MAX_TCP_IDLE 60000U
+
 /*
  * We need to allow a individual query time to complete / timeout.
  */
@@ -178,7 +184,10 @@
 #define DEFAULT_MAX_QUERIES 75
 #endif
 
-/* Number of hash buckets for zone counters */
+/*
+ * Minimum number of hash buckets for zone counters; there are at least
+ * as many as there are fetch context buckets.
+ */
 #ifndef RES_DOMAIN_BUCKETS
 #define RES_DOMAIN_BUCKETS	523
 #endif
@@ -239,6 +248,7 @@ struct tried {
 #define VALID_QUERY(query)		ISC_MAGIC_VALID(query, QUERY_MAGIC)
 
 #define RESQUERY_ATTR_CANCELED          0x02
+#define RESQUERY_ATTR_TCPREUSE          0x04
 
 #define RESQUERY_CONNECTING(q)          ((q)->connects > 0)
 #define RESQUERY_CANCELED(q)            (((q)->attributes & \
@@ -264,6 +274,7 @@ struct fetchctx {
 	dns_name_t			fullname;
 	dns_rdatatype_t			fulltype;
 	unsigned int			options;
+	unsigned int			hashval;
 	unsigned int			bucketnum;
 	unsigned int			dbucketnum;
 	char *				info;
@@ -433,6 +444,10 @@ typedef struct fctxbucket {
 	ISC_LIST(fetchctx_t)		fctxs;
 	bool			exiting;
 	isc_mem_t *			mctx;
+	/*% Locked by 'lock'; reported by dns_resolver_dumpshards(). */
+	unsigned int			nfctxs;
+	uint64_t			created;
+	uint64_t			joined;
 } fctxbucket_t;
 
 typedef struct fctxcount fctxcount_t;
@@ -487,6 +502,7 @@ struct dns_resolver {
 	bool			exclusivev6;
 	unsigned int			nbuckets;
 	fctxbucket_t *			buckets;
+	unsigned int			ndbuckets;
 	zonebucket_t *			dbuckets;
 	uint32_t			lame_ttl;
 	ISC_LIST(alternate_t)		alternates;
@@ -1146,6 +1162,7 @@ fctx_cancelquery(resquery_t **queryp, dns_dispatchevent_t **deventp,
 	dns_adbaddrinfo_t *addrinfo;
 	isc_socket_t *sock;
 	isc_stdtime_t now;
+	bool tcpbroken = false;
 
 	query = *queryp;
 	fctx = query->fctx;
@@ -1313,11 +1330,19 @@ fctx_cancelquery(resquery_t **queryp, dns_dispatchevent_t **deventp,
 			sock = dns_dispatch_getsocket(query->dispatch);
 		if (sock != NULL)
 			isc_socket_cancel(sock, NULL, ISC_SOCKCANCEL_SEND);
+		tcpbroken = ((query->options & DNS_FETCHOPT_TCP) != 0);
 	}
 
 	if (query->dispentry != NULL)
 		dns_dispatch_removeresponse(&query->dispentry, deventp);
 
+	/*
+	 * The canceled send may have left part of a message on the TCP
+	 * connection; no other query may use it.
+	 */
+	if (tcpbroken && query->dispatch != NULL)
+		dns_dispatch_cancel(query->dispatch);
+
 	ISC_LIST_UNLINK(fctx->queries, query, link);
 
 	if (query->tsig != NULL)
@@ -1471,7 +1496,7 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 
 	INSIST(fctx->dbucketnum == RES_NOBUCKET);
 	bucketnum = dns_name_fullhash(&fctx->domain, false)
-			% RES_DOMAIN_BUCKETS;
+			% fctx->res->ndbuckets;
 
 	LOCK(&fctx->res->lock);
 	spill = fctx->res->zspill;
@@ -1879,7 +1904,8 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	isc_task_t *task;
 	isc_result_t result;
 	resquery_t *query;
-	isc_sockaddr_t addr;
+	isc_sockaddr_t addr, any;
+	isc_interval_t interval;
 	bool have_addr = false;
 	unsigned int srtt;
 	isc_dscp_t dscp = -1;
@@ -1985,20 +2011,35 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 		if (query->dscp == -1)
 			query->dscp = dscp;
 
-		result = isc_socket_create(res->socketmgr, pf,
-					   isc_sockettype_tcp,
-					   &query->tcpsocket);
-		if (result != ISC_R_SUCCESS)
-			goto cleanup_query;
+		/*
+		 * Queries to the same server share a TCP connection, and
+		 * one may have been kept open after its last query.
+		 */
+		isc_sockaddr_anyofpf(&any, pf);
+		result = dns_dispatch_gettcp(res->dispatchmgr,
+					     &addrinfo->sockaddr,
+					     isc_sockaddr_eqaddr(&addr, &any)
+						     ? NULL : &addr,
+					     NULL, &query->dispatch);
+		if (result == ISC_R_SUCCESS) {
+			query->attributes |= RESQUERY_ATTR_TCPREUSE;
+		} else {
+			result = isc_socket_create(res->socketmgr, pf,
+						   isc_sockettype_tcp,
+						   &query->tcpsocket);
+			if (result != ISC_R_SUCCESS)
+				goto cleanup_query;
 
 #ifndef BROKEN_TCP_BIND_BEFORE_CONNECT
-		result = isc_socket_bind(query->tcpsocket, &addr, 0);
-		if (result != ISC_R_SUCCESS)
-			goto cleanup_socket;
+			result = isc_socket_bind(query->tcpsocket, &addr, 0);
+			if (result != ISC_R_SUCCESS)
+				goto cleanup_socket;
 #endif
-		/*
-		 * A dispatch will be created once the connect succeeds.
-		 */
+			/*
+			 * A dispatch will be created once the connect
+			 * succeeds.
+			 */
+		}
 	} else {
 		if (have_addr) {
 			unsigned int attrs, attrmask;
@@ -2069,7 +2110,22 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	ISC_LINK_INIT(query, link);
 	query->magic = QUERY_MAGIC;
 
-	if ((query->options & DNS_FETCHOPT_TCP) != 0) {
+	if ((query->attributes & RESQUERY_ATTR_TCPREUSE) != 0) {
+		/*
+		 * Already connected; allow as long as for a new
+		 * connection (see resquery_connected()).
+		 */
+		isc_interval_set(&interval, 20, 0);
+		result = fctx_startidletimer(query->fctx, &interval);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_dispatch;
+
+		result = resquery_send(query);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_dispatch;
+		inc_stats(res, dns_resstatscounter_tcpreuse);
+		QTRACE("reusing TCP connection");
+	} else if ((query->options & DNS_FETCHOPT_TCP) != 0) {
 		/*
 		 * Connect to the remote server.
 		 *
@@ -2891,6 +2947,7 @@ resquery_connected(isc_task_t *task, isc_event_t *event) {
 	isc_interval_t interval;
 	isc_result_t result;
 	unsigned int attrs;
+	isc_sockaddr_t local;
 	fetchctx_t *fctx;
 
 	REQUIRE(event->ev_type == ISC_SOCKEVENT_CONNECT);
@@ -2945,7 +3002,6 @@ resquery_connected(isc_task_t *task, isc_event_t *event) {
 			 */
 			attrs = 0;
 			attrs |= DNS_DISPATCHATTR_TCP;
-			attrs |= DNS_DISPATCHATTR_PRIVATE;
 			attrs |= DNS_DISPATCHATTR_CONNECTED;
 			if (isc_sockaddr_pf(&query->addrinfo->sockaddr) ==
 			    AF_INET)
@@ -2954,13 +3010,23 @@ resquery_connected(isc_task_t *task, isc_event_t *event) {
 				attrs |= DNS_DISPATCHATTR_IPV6;
 			attrs |= DNS_DISPATCHATTR_MAKEQUERY;
 
-			result = dns_dispatch_createtcp(query->dispatchmgr,
-							query->tcpsocket,
-							query->fctx->res->taskmgr,
-							NULL, NULL,
-							4096, 2, 1, 1, 3,
-							attrs,
-							&query->dispatch);
+			/*
+			 * The dispatch is not private: later queries to
+			 * the same server from the same address will
+			 * find it with dns_dispatch_gettcp() and use
+			 * this connection while it is open.
+			 */
+			result = isc_socket_getsockname(query->tcpsocket,
+							&local);
+			if (result == ISC_R_SUCCESS)
+				result = dns_dispatch_createtcp(
+						query->dispatchmgr,
+						query->tcpsocket,
+						query->fctx->res->taskmgr,
+						&local,
+						&query->addrinfo->sockaddr,
+						4096, 32768, 32768, 61, 67,
+						attrs, &query->dispatch);
 
 			/*
 			 * Regardless of whether dns_dispatch_create()
@@ -4088,6 +4154,7 @@ fctx_unlink(fetchctx_t *fctx) {
 	bucketnum = fctx->bucketnum;
 
 	ISC_LIST_UNLINK(res->buckets[bucketnum].fctxs, fctx, link);
+	res->buckets[bucketnum].nfctxs--;
 
 	LOCK(&res->nlock);
 	res->nfctx--;
@@ -4489,7 +4556,7 @@ log_ns_ttl(fetchctx_t *fctx, const char *where) {
 static isc_result_t
 fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	    const dns_name_t *domain, dns_rdataset_t *nameservers,
-	    unsigned int options, unsigned int bucketnum, unsigned int depth,
+	    unsigned int options, unsigned int hashval, unsigned int depth,
 	    isc_counter_t *qc, fetchctx_t **fctxp)
 {
 	fetchctx_t *fctx;
@@ -4501,9 +4568,11 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	char buf[DNS_NAME_FORMATSIZE + DNS_RDATATYPE_FORMATSIZE];
 	char typebuf[DNS_RDATATYPE_FORMATSIZE];
 	isc_mem_t *mctx;
+	unsigned int bucketnum = hashval % res->nbuckets;
 
 	/*
-	 * Caller must be holding the lock for bucket number 'bucketnum'.
+	 * Caller must be holding the lock for the bucket 'hashval'
+	 * selects.
 	 */
 	REQUIRE(fctxp != NULL && *fctxp == NULL);
 
@@ -4558,6 +4627,7 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	 */
 	fctx->res = res;
 	fctx->references = 0;
+	fctx->hashval = hashval;
 	fctx->bucketnum = bucketnum;
 	fctx->dbucketnum = RES_NOBUCKET;
 	fctx->state = fetchstate_init;
@@ -4775,6 +4845,8 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	}
 
 	ISC_LIST_APPEND(res->buckets[bucketnum].fctxs, fctx, link);
+	res->buckets[bucketnum].nfctxs++;
+	res->buckets[bucketnum].created++;
 
 	LOCK(&res->nlock);
 	res->nfctx++;
@@ -7514,7 +7586,19 @@ rctx_dispfail(respctx_t *rctx) {
 		return (ISC_R_SUCCESS);
 	}
 
-	if (devent->result == ISC_R_EOF &&
+	if ((query->attributes & RESQUERY_ATTR_TCPREUSE) != 0 &&
+	    (devent->result == ISC_R_EOF ||
+	     devent->result == ISC_R_CONNECTIONRESET ||
+	     devent->result == ISC_R_CANCELED))
+	{
+		/*
+		 * The connection this query shared was closed, perhaps
+		 * by the server after it had been idle; nothing is
+		 * known about the server itself.  Try again over a new
+		 * connection.
+		 */
+		rctx->resend = true;
+	} else if (devent->result == ISC_R_EOF &&
 	    (rctx->retryopts & DNS_FETCHOPT_NOEDNS0) == 0) {
 		/*
 		 * The problem might be that they don't understand EDNS0.
@@ -7657,6 +7741,7 @@ rctx_opt(respctx_t *rctx) {
 	unsigned char *optvalue;
 	dns_adbaddrinfo_t *addrinfo;
 	unsigned char cookie[8];
+	unsigned int idle;
 	bool seen_cookie = false;
 	bool seen_nsid = false;
 
@@ -7711,6 +7796,25 @@ rctx_opt(respctx_t *rctx) {
 					  dns_resstatscounter_cookiein);
 				seen_cookie = true;
 				break;
+			case DNS_OPT_TCP_KEEPALIVE:
+				/*
+				 * The server's idle timeout, in units of
+				 * 100 milliseconds: keep the connection
+				 * open that long for further queries.
+				 */
+				if (optlen != 2U ||
+				    (query->options & DNS_FETCHOPT_TCP) == 0)
+				{
+					isc_buffer_forward(&optbuf, optlen);
+					break;
+				}
+				idle = isc_buffer_getuint16(&optbuf) * 100U;
+				if (idle > MAX_TCP_IDLE)
+					idle = MAX_TCP_IDLE;
+				(void)dns_dispatch_setidle(query->dispatch,
+							   fctx->res->timermgr,
+							   idle);
+				break;
 			default:
 				isc_buffer_forward(&optbuf, optlen);
 				break;
@@ -9671,13 +9775,13 @@ destroy(dns_resolver_t *res) {
 	}
 	isc_mem_put(res->mctx, res->buckets,
 		    res->nbuckets * sizeof(fctxbucket_t));
-	for (i = 0; i < RES_DOMAIN_BUCKETS; i++) {
+	for (i = 0; i < res->ndbuckets; i++) {
 		INSIST(ISC_LIST_EMPTY(res->dbuckets[i].list));
 		isc_mem_detach(&res->dbuckets[i].mctx);
 		DESTROYLOCK(&res->dbuckets[i].lock);
 	}
 	isc_mem_put(res->mctx, res->dbuckets,
-		    RES_DOMAIN_BUCKETS * sizeof(zonebucket_t));
+		    res->ndbuckets * sizeof(zonebucket_t));
 	if (res->dispatches4 != NULL)
 		dns_dispatchset_destroy(&res->dispatches4);
 	if (res->dispatches6 != NULL)
@@ -9875,16 +9979,20 @@ dns_resolver_create(dns_view_t *view,
 		isc_task_setname(res->buckets[i].task, name, res);
 		ISC_LIST_INIT(res->buckets[i].fctxs);
 		res->buckets[i].exiting = false;
+		res->buckets[i].nfctxs = 0;
+		res->buckets[i].created = 0;
+		res->buckets[i].joined = 0;
 		buckets_created++;
 	}
 
+	res->ndbuckets = ISC_MAX(ntasks, RES_DOMAIN_BUCKETS);
 	res->dbuckets = isc_mem_get(view->mctx,
-				    RES_DOMAIN_BUCKETS * sizeof(zonebucket_t));
+				    res->ndbuckets * sizeof(zonebucket_t));
 	if (res->dbuckets == NULL) {
 		result = ISC_R_NOMEMORY;
 		goto cleanup_buckets;
 	}
-	for (i = 0; i < RES_DOMAIN_BUCKETS; i++) {
+	for (i = 0; i < res->ndbuckets; i++) {
 		ISC_LIST_INIT(res->dbuckets[i].list);
 		res->dbuckets[i].mctx = NULL;
 		isc_mem_attach(view->mctx, &res->dbuckets[i].mctx);
@@ -9999,7 +10107,7 @@ dns_resolver_create(dns_view_t *view,
 		isc_mem_detach(&res->dbuckets[i].mctx);
 	}
 	isc_mem_put(view->mctx, res->dbuckets,
-		    RES_DOMAIN_BUCKETS * sizeof(zonebucket_t));
+		    res->ndbuckets * sizeof(zonebucket_t));
 
  cleanup_buckets:
 	for (i = 0; i < buckets_created; i++) {
@@ -10266,8 +10374,8 @@ dns_resolver_detach(dns_resolver_t **resp) {
 }
 
 static inline bool
-fctx_match(fetchctx_t *fctx, const dns_name_t *name, dns_rdatatype_t type,
-	   unsigned int options)
+fctx_match(fetchctx_t *fctx, const dns_name_t *name, unsigned int hashval,
+	   dns_rdatatype_t type, unsigned int options)
 {
 	/*
 	 * Don't match fetch contexts that are shutting down.
@@ -10276,7 +10384,13 @@ fctx_match(fetchctx_t *fctx, const dns_name_t *name, dns_rdatatype_t type,
 	    ISC_LIST_EMPTY(fctx->events))
 		return (false);
 
-	if (fctx->fulltype != type || fctx->options != options)
+	/*
+	 * Every context in the bucket has a name with the same hash
+	 * modulo the number of buckets, so compare the full hash value
+	 * before the names.
+	 */
+	if (fctx->hashval != hashval || fctx->fulltype != type ||
+	    fctx->options != options)
 		return (false);
 	return (dns_name_equal(&fctx->fullname, name));
 }
@@ -10379,7 +10493,7 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	dns_fetch_t *fetch;
 	fetchctx_t *fctx = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
-	unsigned int bucketnum;
+	unsigned int hashval, bucketnum;
 	bool new_fctx = false;
 	isc_event_t *event;
 	unsigned int count = 0;
@@ -10414,7 +10528,8 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	fetch->mctx = NULL;
 	isc_mem_attach(res->mctx, &fetch->mctx);
 
-	bucketnum = dns_name_fullhash(name, false) % res->nbuckets;
+	hashval = dns_name_fullhash(name, false);
+	bucketnum = hashval % res->nbuckets;
 
 	LOCK(&res->lock);
 	spillat = res->spillat;
@@ -10431,7 +10546,7 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 		for (fctx = ISC_LIST_HEAD(res->buckets[bucketnum].fctxs);
 		     fctx != NULL;
 		     fctx = ISC_LIST_NEXT(fctx, link)) {
-			if (fctx_match(fctx, name, type, options))
+			if (fctx_match(fctx, name, hashval, type, options))
 				break;
 		}
 	}
@@ -10464,7 +10579,7 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 
 	if (fctx == NULL) {
 		result = fctx_create(res, name, type, domain, nameservers,
-				     options, bucketnum, depth, qc, &fctx);
+				     options, hashval, depth, qc, &fctx);
 		if (result != ISC_R_SUCCESS)
 			goto unlock;
 		new_fctx = true;
@@ -10473,6 +10588,8 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 
 	result = fctx_join(fctx, task, client, id, action, arg,
 			   rdataset, sigrdataset, fetch);
+	if (!new_fctx && result == ISC_R_SUCCESS)
+		res->buckets[bucketnum].joined++;
 	if (new_fctx) {
 		if (result == ISC_R_SUCCESS) {
 			/*
@@ -11253,13 +11370,13 @@ void
 dns_resolver_dumpfetches(dns_resolver_t *resolver,
 			 isc_statsformat_t format, FILE *fp)
 {
-	int i;
+	unsigned int i;
 
 	REQUIRE(VALID_RESOLVER(resolver));
 	REQUIRE(fp != NULL);
 	REQUIRE(format == isc_statsformat_file);
 
-	for (i = 0; i < RES_DOMAIN_BUCKETS; i++) {
+	for (i = 0; i < resolver->ndbuckets; i++) {
 		fctxcount_t *fc;
 		LOCK(&resolver->dbuckets[i].lock);
 		for (fc = ISC_LIST_HEAD(resolver->dbuckets[i].list);
@@ -11274,6 +11391,27 @@ dns_resolver_dumpfetches(dns_resolver_t *resolver,
 	}
 }
 
+void
+dns_resolver_dumpshards(dns_resolver_t *resolver,
+			isc_statsformat_t format, FILE *fp)
+{
+	unsigned int i;
+
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(fp != NULL);
+	REQUIRE(format == isc_statsformat_file);
+
+	for (i = 0; i < resolver->nbuckets; i++) {
+		fctxbucket_t *bucket = &resolver->buckets[i];
+
+		LOCK(&bucket->lock);
+		fprintf(fp, "res%u: %u active (%" PRIu64 " created, %"
+			PRIu64 " joined)\n", i, bucket->nfctxs,
+			bucket->created, bucket->joined);
+		UNLOCK(&bucket->lock);
+	}
+}
+
 void
 dns_resolver_setquotaresponse(dns_resolver_t *resolver,
 			      dns_quotatype_t which, isc_result_t resp)
@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/buffer.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/name.h>
+#include <dns/respcache.h>
+
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+#include <stdatomic.h>
+#endif
+
+#define RESPCACHE_MAGIC			ISC_MAGIC('R', 's', 'p', 'C')
+#define VALID_RESPCACHE(rc)		ISC_MAGIC_VALID(rc, RESPCACHE_MAGIC)
+
+/*%
+ * The number of stripes; a power of two.
+ */
+#define RESPCACHE_STRIPES		16
+
+/*%
+ * Hash tables are sized for entries of about this many bytes, which
+ * is a small answer with its names and overhead.
+ */
+#define RESPCACHE_ENTRYSIZE		512
+#define RESPCACHE_MINBUCKETS		16
+
+/*%
+ * Responses do not hold references to their databases.  Instead, each
+ * response records the generation of its database address, kept in a
+ * table shared by every response cache and indexed by a hash of the
+ * address, and only matches while that is unchanged.  The generation
+ * is advanced when a database is attached to a zone, so that it is not
+ * mistaken for an older database that was freed at the same address;
+ * responses from other databases hashing to the same slot are lost
+ * too.  Advancing it only has to change it, so in the non-atomic
+ * variant an increment lost to a concurrent one does no harm.
+ */
+#define RESPCACHE_GENBITS		10
+#define RESPCACHE_GENERATIONS		(1U << RESPCACHE_GENBITS)
+
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+typedef atomic_uint rcgeneration_t;
+#define GEN_LOAD(p)	atomic_load_explicit((p), memory_order_relaxed)
+#define GEN_INCR(p) \
+	((void)atomic_fetch_add_explicit((p), 1, memory_order_relaxed))
+#else
+typedef unsigned int rcgeneration_t;
+#define GEN_LOAD(p)	(*(p))
+#define GEN_INCR(p)	((void)(++(*(p))))
+#endif
+
+static rcgeneration_t generations[RESPCACHE_GENERATIONS];
+
+typedef struct rcentry rcentry_t;
+typedef ISC_LIST(rcentry_t) rcentrylist_t;
+
+/*%
+ * An entry is followed in memory by the query name, the rate limiting
+ * name, if any, and the response.
+ */
+struct rcentry {
+	ISC_LINK(rcentry_t)	hlink;
+	ISC_LINK(rcentry_t)	link;
+	unsigned int		hashval;
+	dns_rdatatype_t		qtype;
+	uint16_t		size;
+	uint32_t		options;
+	const dns_db_t *	db;		/*%< not a reference */
+	unsigned int		generation;
+	uint32_t		serial;
+	isc_result_t		rrlresult;
+	unsigned int		qnamelen;
+	unsigned int		rrlnamelen;
+	unsigned int		length;
+};
+
+#define ENTRY_QNAME(e)		((unsigned char *)((e) + 1))
+#define ENTRY_RRLNAME(e)	(ENTRY_QNAME(e) + (e)->qnamelen)
+#define ENTRY_RESPONSE(e)	(ENTRY_RRLNAME(e) + (e)->rrlnamelen)
+#define ENTRY_SIZE(e)		(sizeof(rcentry_t) + (e)->qnamelen + \
+				 (e)->rrlnamelen + (e)->length)
+
+typedef struct rcstripe {
+	isc_mutex_t		lock;
+	rcentrylist_t *		table;
+	unsigned int		nbuckets;
+	rcentrylist_t		lru;		/*%< most recently used first */
+	size_t			used;
+} rcstripe_t;
+
+struct dns_respcache {
+	unsigned int		magic;
+	isc_mem_t *		mctx;
+	size_t			stripesize;
+	rcstripe_t		stripes[RESPCACHE_STRIPES];
+};
+
+static inline unsigned int
+hash(const dns_respcachekey_t *key) {
+	unsigned int hashval;
+
+	hashval = dns_name_fullhash(key->qname, true);
+	hashval ^= ((unsigned int)key->qtype << 16) | key->size;
+	hashval ^= key->options * 0x9e3779b1U;
+
+	return (hashval);
+}
+
+static inline rcgeneration_t *
+getgeneration(const dns_db_t *db) {
+	uint32_t h = (uint32_t)((uintptr_t)db >> 4) * 0x9e3779b1U;
+
+	return (&generations[h >> (32 - RESPCACHE_GENBITS)]);
+}
+
+static inline rcstripe_t *
+getstripe(dns_respcache_t *rc, unsigned int hashval) {
+	return (&rc->stripes[hashval % RESPCACHE_STRIPES]);
+}
+
+static inline rcentrylist_t *
+getbucket(rcstripe_t *stripe, unsigned int hashval) {
+	return (&stripe->table[(hashval / RESPCACHE_STRIPES) %
+			       stripe->nbuckets]);
+}
+
+/*
+ * Find the entry for the same query as 'key', whatever its database
+ * and serial.  The stripe must be locked.
+ */
+static rcentry_t *
+lookup(rcstripe_t *stripe, const dns_respcachekey_t *key,
+       unsigned int hashval, const isc_region_t *qname)
+{
+	rcentry_t *entry;
+
+	for (entry = ISC_LIST_HEAD(*getbucket(stripe, hashval));
+	     entry != NULL;
+	     entry = ISC_LIST_NEXT(entry, hlink))
+	{
+		if (entry->hashval == hashval &&
+		    entry->qtype == key->qtype &&
+		    entry->size == key->size &&
+		    entry->options == key->options &&
+		    entry->qnamelen == qname->length &&
+		    memcmp(ENTRY_QNAME(entry), qname->base,
+			   qname->length) == 0)
+		{
+			return (entry);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Unlink 'entry' from its stripe, which must be locked, and put it on
+ * 'freelist'.
+ */
+static void
+unlink_entry(rcstripe_t *stripe, rcentry_t *entry, rcentrylist_t *freelist) {
+	ISC_LIST_UNLINK(*getbucket(stripe, entry->hashval), entry, hlink);
+	ISC_LIST_UNLINK(stripe->lru, entry, link);
+	stripe->used -= ENTRY_SIZE(entry);
+	ISC_LIST_APPEND(*freelist, entry, link);
+}
+
+/*
+ * Free the entries on 'freelist', with no stripe locked.
+ */
+static void
+free_entries(dns_respcache_t *rc, rcentrylist_t *freelist) {
+	rcentry_t *entry;
+
+	while ((entry = ISC_LIST_HEAD(*freelist)) != NULL) {
+		ISC_LIST_UNLINK(*freelist, entry, link);
+		isc_mem_put(rc->mctx, entry, ENTRY_SIZE(entry));
+	}
+}
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, size_t maxsize,
+		     dns_respcache_t **rcp)
+{
+	isc_result_t result;
+	dns_respcache_t *rc;
+	unsigned int i, nbuckets;
+	size_t n;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(maxsize > 0);
+	REQUIRE(rcp != NULL && *rcp == NULL);
+
+	rc = isc_mem_get(mctx, sizeof(*rc));
+	if (rc == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(rc, 0, sizeof(*rc));
+
+	rc->stripesize = maxsize / RESPCACHE_STRIPES;
+	n = rc->stripesize / RESPCACHE_ENTRYSIZE;
+	if (n < RESPCACHE_MINBUCKETS)
+		nbuckets = RESPCACHE_MINBUCKETS;
+	else if (n > UINT32_MAX / RESPCACHE_STRIPES)
+		nbuckets = UINT32_MAX / RESPCACHE_STRIPES;
+	else
+		nbuckets = (unsigned int)n;
+
+	for (i = 0; i < RESPCACHE_STRIPES; i++) {
+		rcstripe_t *stripe = &rc->stripes[i];
+		unsigned int j;
+
+		stripe->table = isc_mem_get(mctx,
+					    nbuckets * sizeof(rcentrylist_t));
+		if (stripe->table == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		result = isc_mutex_init(&stripe->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, stripe->table,
+				    nbuckets * sizeof(rcentrylist_t));
+			stripe->table = NULL;
+			goto cleanup;
+		}
+		for (j = 0; j < nbuckets; j++)
+			ISC_LIST_INIT(stripe->table[j]);
+		stripe->nbuckets = nbuckets;
+		ISC_LIST_INIT(stripe->lru);
+		stripe->used = 0;
+	}
+
+	isc_mem_attach(mctx, &rc->mctx);
+	rc->magic = RESPCACHE_MAGIC;
+
+	*rcp = rc;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	while (i-- > 0) {
+		rcstripe_t *stripe = &rc->stripes[i];
+
+		DESTROYLOCK(&stripe->lock);
+		isc_mem_put(mctx, stripe->table,
+			    stripe->nbuckets * sizeof(rcentrylist_t));
+	}
+	isc_mem_put(mctx, rc, sizeof(*rc));
+	return (result);
+}
+
+void
+dns_respcache_destroy(dns_respcache_t **rcp) {
+	dns_respcache_t *rc;
+	unsigned int i;
+
+	REQUIRE(rcp != NULL && VALID_RESPCACHE(*rcp));
+	rc = *rcp;
+	*rcp = NULL;
+
+	dns_respcache_flush(rc);
+
+	rc->magic = 0;
+	for (i = 0; i < RESPCACHE_STRIPES; i++) {
+		rcstripe_t *stripe = &rc->stripes[i];
+
+		INSIST(ISC_LIST_EMPTY(stripe->lru));
+		DESTROYLOCK(&stripe->lock);
+		isc_mem_put(rc->mctx, stripe->table,
+			    stripe->nbuckets * sizeof(rcentrylist_t));
+	}
+	isc_mem_putanddetach(&rc->mctx, rc, sizeof(*rc));
+}
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *rc, const dns_respcachekey_t *key,
+		   isc_buffer_t *target, dns_name_t *rrlname,
+		   isc_result_t *rrlresultp)
+{
+	isc_result_t result;
+	rcstripe_t *stripe;
+	rcentry_t *entry;
+	isc_region_t qname, r;
+	unsigned int hashval;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+	REQUIRE(key != NULL && key->qname != NULL);
+	REQUIRE(dns_name_isabsolute(key->qname));
+	REQUIRE(ISC_BUFFER_VALID(target));
+	REQUIRE(rrlname == NULL || rrlresultp != NULL);
+
+	dns_name_toregion(key->qname, &qname);
+	hashval = hash(key);
+	stripe = getstripe(rc, hashval);
+
+	LOCK(&stripe->lock);
+	entry = lookup(stripe, key, hashval, &qname);
+	if (entry == NULL || entry->db != key->db ||
+	    entry->generation != GEN_LOAD(getgeneration(key->db)) ||
+	    entry->serial != key->serial)
+	{
+		result = ISC_R_NOTFOUND;
+		goto unlock;
+	}
+	if (entry->length > isc_buffer_availablelength(target)) {
+		result = ISC_R_NOSPACE;
+		goto unlock;
+	}
+
+	isc_buffer_putmem(target, ENTRY_RESPONSE(entry), entry->length);
+	if (rrlname != NULL) {
+		if (entry->rrlnamelen > 0) {
+			r.base = ENTRY_RRLNAME(entry);
+			r.length = entry->rrlnamelen;
+			dns_name_fromregion(rrlname, &r);
+			*rrlresultp = entry->rrlresult;
+		} else {
+			*rrlresultp = ISC_R_NOTFOUND;
+		}
+	}
+
+	if (entry != ISC_LIST_HEAD(stripe->lru)) {
+		ISC_LIST_UNLINK(stripe->lru, entry, link);
+		ISC_LIST_PREPEND(stripe->lru, entry, link);
+	}
+	result = ISC_R_SUCCESS;
+
+ unlock:
+	UNLOCK(&stripe->lock);
+	return (result);
+}
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *rc, const dns_respcachekey_t *key,
+		  const isc_region_t *response, const dns_name_t *rrlname,
+		  isc_result_t rrlresult)
+{
+	rcentrylist_t freelist;
+	rcstripe_t *stripe;
+	rcentry_t *entry, *old;
+	isc_region_t qname, rname;
+	unsigned int hashval;
+	size_t size;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+	REQUIRE(key != NULL && key->qname != NULL);
+	REQUIRE(dns_name_isabsolute(key->qname));
+	REQUIRE(key->db != NULL);
+	REQUIRE(response != NULL);
+
+	if (response->length > DNS_RESPCACHE_MAXRESPONSE)
+		return (ISC_R_RANGE);
+
+	dns_name_toregion(key->qname, &qname);
+	if (rrlname != NULL) {
+		dns_name_toregion(rrlname, &rname);
+	} else {
+		rname.base = NULL;
+		rname.length = 0;
+	}
+
+	size = sizeof(*entry) + qname.length + rname.length + response->length;
+	if (size > rc->stripesize)
+		return (ISC_R_RANGE);
+
+	entry = isc_mem_get(rc->mctx, size);
+	if (entry == NULL)
+		return (ISC_R_NOMEMORY);
+
+	ISC_LINK_INIT(entry, hlink);
+	ISC_LINK_INIT(entry, link);
+	entry->hashval = hashval = hash(key);
+	entry->qtype = key->qtype;
+	entry->size = key->size;
+	entry->options = key->options;
+	entry->db = key->db;
+	entry->generation = GEN_LOAD(getgeneration(key->db));
+	entry->serial = key->serial;
+	entry->rrlresult = rrlresult;
+	entry->qnamelen = qname.length;
+	entry->rrlnamelen = rname.length;
+	entry->length = response->length;
+	memmove(ENTRY_QNAME(entry), qname.base, qname.length);
+	if (rname.length > 0)
+		memmove(ENTRY_RRLNAME(entry), rname.base, rname.length);
+	memmove(ENTRY_RESPONSE(entry), response->base, response->length);
+
+	ISC_LIST_INIT(freelist);
+	stripe = getstripe(rc, hashval);
+
+	LOCK(&stripe->lock);
+	old = lookup(stripe, key, hashval, &qname);
+	if (old != NULL)
+		unlink_entry(stripe, old, &freelist);
+
+	ISC_LIST_PREPEND(*getbucket(stripe, hashval), entry, hlink);
+	ISC_LIST_PREPEND(stripe->lru, entry, link);
+	stripe->used += size;
+
+	while (stripe->used > rc->stripesize) {
+		old = ISC_LIST_TAIL(stripe->lru);
+		INSIST(old != NULL && old != entry);
+		unlink_entry(stripe, old, &freelist);
+	}
+	UNLOCK(&stripe->lock);
+
+	free_entries(rc, &freelist);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_respcache_flush(dns_respcache_t *rc) {
+	rcentrylist_t freelist;
+	rcentry_t *entry;
+	unsigned int i;
+
+	REQUIRE(VALID_RESPCACHE(rc));
+
+	ISC_LIST_INIT(freelist);
+
+	for (i = 0; i < RESPCACHE_STRIPES; i++) {
+		rcstripe_t *stripe = &rc->stripes[i];
+
+		LOCK(&stripe->lock);
+		while ((entry = ISC_LIST_HEAD(stripe->lru)) != NULL)
+			unlink_entry(stripe, entry, &freelist);
+		UNLOCK(&stripe->lock);
+	}
+
+	free_entries(rc, &freelist);
+}
+
+void
+dns_respcache_newdb(const dns_db_t *db) {
+	REQUIRE(db != NULL);
+
+	GEN_INCR(getgeneration(db));
+}
@@ -0,0 +1,1481 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/refcount.h>
+#include <isc/rwlock.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/masterdump.h>
+#include <dns/rbt.h>
+#include <dns/rdataset.h>
+#include <dns/result.h>
+#include <dns/stats.h>
+
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+#include <stdatomic.h>
+#endif
+
+#include "rbtdb.h"
+#include "shardcache.h"
+
+#define SHARDCACHE_MAGIC		ISC_MAGIC('S', 'h', 'C', 'D')
+#define VALID_SHARDCACHE(sdb)	((sdb) != NULL && \
+				 (sdb)->common.impmagic == SHARDCACHE_MAGIC)
+
+/*%
+ * The sharded cache database.  Every owner name lives in exactly one
+ * shard, picked by a hash of the name.  The shards are ordinary "rbt"
+ * cache databases: nodes and rdatasets handed out by this database are
+ * really theirs, and node operations are passed to the shard the node
+ * belongs to, which is found from the hash value the RBT keeps in every
+ * node.
+ *
+ * A shard's tree also contains empty nodes for the ancestors of the names
+ * stored in it, whatever shard those ancestors belong to.  Those nodes
+ * never hold data and are never handed out.
+ */
+
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+typedef atomic_bool shardcache_flag_t;
+#define FLAG_ISSET(f)	atomic_load_explicit((f), memory_order_relaxed)
+#define FLAG_STORE(f, v) \
+	atomic_store_explicit((f), (v), memory_order_relaxed)
+#else
+typedef bool shardcache_flag_t;
+#define FLAG_ISSET(f)	(*(f))
+#define FLAG_STORE(f, v) (*(f) = (v))
+#endif
+
+typedef struct shardcache {
+	/* Unlocked. */
+	dns_db_t			common;
+	isc_refcount_t			references;
+	unsigned int			nshards;
+	dns_db_t			*shards[DNS_SHARDCACHE_MAXSHARDS];
+	/*
+	 * A reference to the root node of every shard keeps it from being
+	 * pruned, so that every name has a predecessor in every shard.
+	 */
+	dns_dbnode_t			*roots[DNS_SHARDCACHE_MAXSHARDS];
+	dns_stats_t			*rrsetstats;
+
+	/*
+	 * The owner names of the DNAMEs in the cache, so that finds only
+	 * look for one above the name in other shards where there may be
+	 * one.  DNAMEs are added with 'dnamelock' held for writing, and
+	 * an owner whose DNAME has gone, e.g. expired, is removed from
+	 * 'dnames' by the next find that looks for it.
+	 */
+	isc_rwlock_t			dnamelock;
+	dns_rbt_t			*dnames;	/* Locked by dnamelock. */
+	unsigned int			ndnames;	/* Locked by dnamelock. */
+	/*
+	 * Whether 'ndnames' is nonzero, for finds to check without
+	 * taking 'dnamelock'.
+	 */
+	shardcache_flag_t		hasdnames;
+} shardcache_t;
+
+typedef struct shardcache_load {
+	shardcache_t			*sdb;
+	dns_rdatacallbacks_t		callbacks[DNS_SHARDCACHE_MAXSHARDS];
+} shardcache_load_t;
+
+/*%
+ * The iterator merges one iterator per shard in DNSSEC order.  Each of
+ * them is kept on its own shard's node nearest to the merged position in
+ * the direction of travel, and is paused between calls so that no shard's
+ * tree stays locked.
+ */
+typedef struct shardcache_dbiterator {
+	dns_dbiterator_t		common;
+	isc_result_t			result;
+	unsigned int			current;
+	bool				forward;
+	bool				new_origin;
+	dns_dbiterator_t		*iters[DNS_SHARDCACHE_MAXSHARDS];
+	isc_result_t			results[DNS_SHARDCACHE_MAXSHARDS];
+	dns_fixedname_t			names[DNS_SHARDCACHE_MAXSHARDS];
+} shardcache_dbiterator_t;
+
+static void		dbiterator_destroy(dns_dbiterator_t **iteratorp);
+static isc_result_t	dbiterator_first(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_last(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_seek(dns_dbiterator_t *iterator,
+					const dns_name_t *name);
+static isc_result_t	dbiterator_prev(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_next(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_current(dns_dbiterator_t *iterator,
+					   dns_dbnode_t **nodep,
+					   dns_name_t *name);
+static isc_result_t	dbiterator_pause(dns_dbiterator_t *iterator);
+static isc_result_t	dbiterator_origin(dns_dbiterator_t *iterator,
+					  dns_name_t *name);
+
+static dns_dbiteratormethods_t dbiterator_methods = {
+	dbiterator_destroy,
+	dbiterator_first,
+	dbiterator_last,
+	dbiterator_seek,
+	dbiterator_prev,
+	dbiterator_next,
+	dbiterator_current,
+	dbiterator_pause,
+	dbiterator_origin
+};
+
+/*
+ * Shard selection.  The hash is mixed before it is reduced, as the RBT
+ * and rbtdb reduce the very same value to pick hash buckets and node
+ * locks.
+ */
+static inline unsigned int
+shard_byhash(const shardcache_t *sdb, unsigned int hash) {
+	return (((hash * 0x9e3779b1U) >> 16) % sdb->nshards);
+}
+
+static inline unsigned int
+shard_byname(const shardcache_t *sdb, const dns_name_t *name) {
+	return (shard_byhash(sdb, dns_name_fullhash(name, false)));
+}
+
+static inline unsigned int
+shard_bynode(const shardcache_t *sdb, dns_dbnode_t *node) {
+	return (shard_byhash(sdb, ((dns_rbtnode_t *)node)->hashval));
+}
+
+/*
+ * DNAME owner tracking.
+ */
+
+/*%
+ * Is a DNAME owner tracked at 'name' or, if 'orabove' is true, at any of
+ * its ancestors?
+ */
+static bool
+dname_tracked(shardcache_t *sdb, const dns_name_t *name, bool orabove) {
+	isc_result_t result;
+	void *data = NULL;
+
+	RWLOCK(&sdb->dnamelock, isc_rwlocktype_read);
+	result = dns_rbt_findname(sdb->dnames, name, 0, NULL, &data);
+	RWUNLOCK(&sdb->dnamelock, isc_rwlocktype_read);
+
+	return (result == ISC_R_SUCCESS ||
+		(orabove && result == DNS_R_PARTIALMATCH));
+}
+
+/*%
+ * Track 'name' as a DNAME owner.  Requires 'dnamelock' held for writing.
+ * Returns ISC_R_EXISTS if it already was.
+ */
+static isc_result_t
+dname_track(shardcache_t *sdb, const dns_name_t *name) {
+	isc_result_t result;
+
+	result = dns_rbt_addname(sdb->dnames, name, sdb);
+	if (result == ISC_R_SUCCESS && sdb->ndnames++ == 0)
+		FLAG_STORE(&sdb->hasdnames, true);
+
+	return (result);
+}
+
+/*%
+ * Stop tracking 'name'.  Requires 'dnamelock' held for writing.
+ */
+static void
+dname_untrack(shardcache_t *sdb, const dns_name_t *name) {
+	if (dns_rbt_deletename(sdb->dnames, name, false) == ISC_R_SUCCESS &&
+	    --sdb->ndnames == 0)
+		FLAG_STORE(&sdb->hasdnames, false);
+}
+
+/*%
+ * Stop tracking 'name' unless its shard has a DNAME there after all,
+ * which is checked with 'dnamelock' held so that a DNAME being added
+ * cannot be missed.
+ */
+static void
+dname_prune(shardcache_t *sdb, const dns_name_t *name, isc_stdtime_t now) {
+	dns_db_t *shard = sdb->shards[shard_byname(sdb, name)];
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t dname;
+	isc_result_t result;
+
+	dns_rdataset_init(&dname);
+
+	RWLOCK(&sdb->dnamelock, isc_rwlocktype_write);
+	result = dns_db_findnode(shard, name, false, &node);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_db_findrdataset(shard, node, NULL,
+					     dns_rdatatype_dname, 0, now,
+					     &dname, NULL);
+		if (dns_rdataset_isassociated(&dname))
+			dns_rdataset_disassociate(&dname);
+		dns_db_detachnode(shard, &node);
+	}
+	if (result != ISC_R_SUCCESS)
+		dname_untrack(sdb, name);
+	RWUNLOCK(&sdb->dnamelock, isc_rwlocktype_write);
+}
+
+/*
+ * DB Routines
+ */
+
+static void
+attach(dns_db_t *source, dns_db_t **targetp) {
+	shardcache_t *sdb = (shardcache_t *)source;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	isc_refcount_increment(&sdb->references, NULL);
+
+	*targetp = source;
+}
+
+static void
+free_shardcache(shardcache_t *sdb) {
+	unsigned int s;
+
+	for (s = 0; s < sdb->nshards; s++) {
+		if (sdb->roots[s] != NULL)
+			dns_db_detachnode(sdb->shards[s], &sdb->roots[s]);
+		if (sdb->shards[s] != NULL)
+			dns_db_detach(&sdb->shards[s]);
+	}
+	if (sdb->rrsetstats != NULL)
+		dns_stats_detach(&sdb->rrsetstats);
+	if (sdb->dnames != NULL) {
+		dns_rbt_destroy(&sdb->dnames);
+		isc_rwlock_destroy(&sdb->dnamelock);
+	}
+	if (dns_name_dynamic(&sdb->common.origin))
+		dns_name_free(&sdb->common.origin, sdb->common.mctx);
+	isc_refcount_destroy(&sdb->references);
+
+	sdb->common.impmagic = 0;
+	sdb->common.magic = 0;
+
+	isc_mem_putanddetach(&sdb->common.mctx, sdb, sizeof(*sdb));
+}
+
+static void
+detach(dns_db_t **dbp) {
+	shardcache_t *sdb;
+	unsigned int refs;
+
+	REQUIRE(dbp != NULL);
+	sdb = (shardcache_t *)*dbp;
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	isc_refcount_decrement(&sdb->references, &refs);
+	if (refs == 0)
+		free_shardcache(sdb);
+
+	*dbp = NULL;
+}
+
+static isc_result_t
+loading_addrdataset(void *arg, const dns_name_t *name,
+		    dns_rdataset_t *rdataset)
+{
+	shardcache_load_t *loadctx = arg;
+	shardcache_t *sdb = loadctx->sdb;
+	dns_rdatacallbacks_t *callbacks;
+	isc_result_t result;
+
+	callbacks = &loadctx->callbacks[shard_byname(sdb, name)];
+	if (rdataset->type != dns_rdatatype_dname)
+		return ((callbacks->add)(callbacks->add_private, name,
+					 rdataset));
+
+	RWLOCK(&sdb->dnamelock, isc_rwlocktype_write);
+	result = dname_track(sdb, name);
+	if (result == ISC_R_SUCCESS || result == ISC_R_EXISTS)
+		result = (callbacks->add)(callbacks->add_private, name,
+					  rdataset);
+	RWUNLOCK(&sdb->dnamelock, isc_rwlocktype_write);
+
+	return (result);
+}
+
+static isc_result_t
+beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	shardcache_load_t *loadctx;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int s;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	loadctx = isc_mem_get(sdb->common.mctx, sizeof(*loadctx));
+	if (loadctx == NULL)
+		return (ISC_R_NOMEMORY);
+
+	loadctx->sdb = sdb;
+	for (s = 0; s < sdb->nshards; s++) {
+		dns_rdatacallbacks_init(&loadctx->callbacks[s]);
+		result = dns_db_beginload(sdb->shards[s],
+					  &loadctx->callbacks[s]);
+		if (result != ISC_R_SUCCESS)
+			break;
+	}
+	if (result != ISC_R_SUCCESS) {
+		while (s-- > 0)
+			(void)dns_db_endload(sdb->shards[s],
+					     &loadctx->callbacks[s]);
+		isc_mem_put(sdb->common.mctx, loadctx, sizeof(*loadctx));
+		return (result);
+	}
+
+	callbacks->add = loading_addrdataset;
+	callbacks->add_private = loadctx;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	shardcache_load_t *loadctx;
+	isc_result_t result = ISC_R_SUCCESS, tresult;
+	unsigned int s;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+	loadctx = callbacks->add_private;
+	REQUIRE(loadctx != NULL && loadctx->sdb == sdb);
+
+	for (s = 0; s < sdb->nshards; s++) {
+		tresult = dns_db_endload(sdb->shards[s],
+					 &loadctx->callbacks[s]);
+		if (tresult != ISC_R_SUCCESS && result == ISC_R_SUCCESS)
+			result = tresult;
+	}
+
+	callbacks->add = NULL;
+	callbacks->add_private = NULL;
+
+	isc_mem_put(sdb->common.mctx, loadctx, sizeof(*loadctx));
+
+	return (result);
+}
+
+static isc_result_t
+dump(dns_db_t *db, dns_dbversion_t *version, const char *filename,
+     dns_masterformat_t masterformat)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_master_dump(sdb->common.mctx, db, version,
+				&dns_master_style_default,
+				filename, masterformat, NULL));
+}
+
+/*
+ * A cache has a single, constant version; the first shard's stands in
+ * for all of them, and the shards are always passed a NULL version.
+ */
+static void
+currentversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	dns_db_currentversion(sdb->shards[0], versionp);
+}
+
+static isc_result_t
+newversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_newversion(sdb->shards[0], versionp));
+}
+
+static void
+attachversion(dns_db_t *db, dns_dbversion_t *source,
+	      dns_dbversion_t **targetp)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	dns_db_attachversion(sdb->shards[0], source, targetp);
+}
+
+static void
+closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	dns_db_closeversion(sdb->shards[0], versionp, commit);
+}
+
+static isc_result_t
+findnode(dns_db_t *db, const dns_name_t *name, bool create,
+	 dns_dbnode_t **nodep)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_findnode(sdb->shards[shard_byname(sdb, name)],
+				name, create, nodep));
+}
+
+/*
+ * Look for a DNAME at the proper ancestors of 'name', from the top down,
+ * as the shard holding 'name' only sees those stored in it.  Only the
+ * ancestors tracked as DNAME owners are looked up.
+ */
+static isc_result_t
+find_dname(shardcache_t *sdb, const dns_name_t *name, unsigned int options,
+	   isc_stdtime_t now, dns_dbnode_t **nodep, dns_name_t *foundname,
+	   dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	dns_rdataset_t dname, dnamesig;
+	dns_dbnode_t *node;
+	dns_name_t suffix;
+	unsigned int i, labels, s;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	dns_name_init(&suffix, NULL);
+	dns_rdataset_init(&dname);
+	dns_rdataset_init(&dnamesig);
+
+	labels = dns_name_countlabels(name);
+	if (labels < 2)
+		return (ISC_R_NOTFOUND);
+	dns_name_getlabelsequence(name, 1, labels - 1, &suffix);
+	if (!dname_tracked(sdb, &suffix, true))
+		return (ISC_R_NOTFOUND);
+
+	for (i = 1; i < labels && result == ISC_R_NOTFOUND; i++) {
+		dns_name_getlabelsequence(name, labels - i, i, &suffix);
+		if (!dname_tracked(sdb, &suffix, false))
+			continue;
+		s = shard_byname(sdb, &suffix);
+		node = NULL;
+		if (dns_db_findnode(sdb->shards[s], &suffix, false,
+				    &node) != ISC_R_SUCCESS)
+		{
+			dname_prune(sdb, &suffix, now);
+			continue;
+		}
+
+		result = dns_db_findrdataset(sdb->shards[s], node, NULL,
+					     dns_rdatatype_dname, 0, now,
+					     &dname, &dnamesig);
+		if (result == ISC_R_NOTFOUND) {
+			dns_db_detachnode(sdb->shards[s], &node);
+			dname_prune(sdb, &suffix, now);
+			continue;
+		}
+		if (result == ISC_R_SUCCESS &&
+		    (!DNS_TRUST_PENDING(dname.trust) ||
+		     (options & DNS_DBFIND_PENDINGOK) != 0))
+			result = dns_name_copy(&suffix, foundname, NULL);
+		else
+			result = ISC_R_NOTFOUND;
+
+		if (result == ISC_R_SUCCESS) {
+			if (nodep != NULL)
+				dns_db_transfernode(sdb->shards[s], &node,
+						    nodep);
+			if (rdataset != NULL)
+				dns_rdataset_clone(&dname, rdataset);
+			if (sigrdataset != NULL &&
+			    dns_rdataset_isassociated(&dnamesig))
+				dns_rdataset_clone(&dnamesig, sigrdataset);
+			result = DNS_R_DNAME;
+		}
+
+		if (dns_rdataset_isassociated(&dname))
+			dns_rdataset_disassociate(&dname);
+		if (dns_rdataset_isassociated(&dnamesig))
+			dns_rdataset_disassociate(&dnamesig);
+		if (node != NULL)
+			dns_db_detachnode(sdb->shards[s], &node);
+	}
+
+	return (result);
+}
+
+/*
+ * Shard 'skip' found the deepest zone cut of 'name' among the names it
+ * holds (if any), which has 'minlabels' - 1 labels.  Look for a deeper one
+ * in the other shards, and if there is one, return it instead.
+ */
+static bool
+deeper_zonecut(shardcache_t *sdb, const dns_name_t *name, unsigned int skip,
+	       unsigned int minlabels, isc_stdtime_t now,
+	       dns_dbnode_t **nodep, dns_name_t *foundname,
+	       dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	dns_rdataset_t ns, nssig;
+	dns_dbnode_t *node = NULL;
+	dns_name_t suffix;
+	unsigned int i, s = 0;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	dns_name_init(&suffix, NULL);
+	dns_rdataset_init(&ns);
+	dns_rdataset_init(&nssig);
+
+	for (i = dns_name_countlabels(name) - 1; i >= minlabels; i--) {
+		dns_name_getlabelsequence(name,
+					  dns_name_countlabels(name) - i, i,
+					  &suffix);
+		s = shard_byname(sdb, &suffix);
+		if (s == skip)
+			continue;
+		if (dns_db_findnode(sdb->shards[s], &suffix, false,
+				    &node) != ISC_R_SUCCESS)
+			continue;
+		result = dns_db_findrdataset(sdb->shards[s], node, NULL,
+					     dns_rdatatype_ns, 0, now,
+					     &ns, &nssig);
+		if (result == ISC_R_SUCCESS)
+			break;
+		dns_db_detachnode(sdb->shards[s], &node);
+	}
+
+	if (result == ISC_R_SUCCESS) {
+		if (nodep != NULL && *nodep != NULL)
+			dns_db_detachnode(sdb->shards[skip], nodep);
+		if (rdataset != NULL && dns_rdataset_isassociated(rdataset))
+			dns_rdataset_disassociate(rdataset);
+		if (sigrdataset != NULL &&
+		    dns_rdataset_isassociated(sigrdataset))
+			dns_rdataset_disassociate(sigrdataset);
+
+		RUNTIME_CHECK(dns_name_copy(&suffix, foundname, NULL) ==
+			      ISC_R_SUCCESS);
+		if (nodep != NULL)
+			dns_db_transfernode(sdb->shards[s], &node, nodep);
+		if (rdataset != NULL)
+			dns_rdataset_clone(&ns, rdataset);
+		if (sigrdataset != NULL && dns_rdataset_isassociated(&nssig))
+			dns_rdataset_clone(&nssig, sigrdataset);
+	}
+
+	if (dns_rdataset_isassociated(&ns))
+		dns_rdataset_disassociate(&ns);
+	if (dns_rdataset_isassociated(&nssig))
+		dns_rdataset_disassociate(&nssig);
+	if (node != NULL)
+		dns_db_detachnode(sdb->shards[s], &node);
+
+	return (result == ISC_R_SUCCESS);
+}
+
+static isc_result_t
+find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
+     dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
+     dns_dbnode_t **nodep, dns_name_t *foundname,
+     dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+	unsigned int s, minlabels;
+	isc_result_t result;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	if (now == 0)
+		isc_stdtime_get(&now);
+
+	if (FLAG_ISSET(&sdb->hasdnames)) {
+		result = find_dname(sdb, name, options, now, nodep, foundname,
+				    rdataset, sigrdataset);
+		if (result != ISC_R_NOTFOUND)
+			return (result);
+	}
+
+	s = shard_byname(sdb, name);
+	result = dns_db_find(sdb->shards[s], name, NULL, type, options, now,
+			     nodep, foundname, rdataset, sigrdataset);
+
+	/*
+	 * A delegation found by the shard may not be the deepest one.
+	 */
+	if (result == DNS_R_DELEGATION)
+		minlabels = dns_name_countlabels(foundname) + 1;
+	else if (result == ISC_R_NOTFOUND)
+		minlabels = 1;
+	else
+		return (result);
+
+	if (deeper_zonecut(sdb, name, s, minlabels, now, nodep, foundname,
+			   rdataset, sigrdataset))
+		result = DNS_R_DELEGATION;
+
+	return (result);
+}
+
+static isc_result_t
+findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
+	    isc_stdtime_t now, dns_dbnode_t **nodep, dns_name_t *foundname,
+	    dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+	unsigned int s, minlabels;
+	isc_result_t result;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	if (now == 0)
+		isc_stdtime_get(&now);
+
+	s = shard_byname(sdb, name);
+	result = dns_db_findzonecut(sdb->shards[s], name, options, now, nodep,
+				    foundname, rdataset, sigrdataset);
+	if (result == ISC_R_SUCCESS)
+		minlabels = dns_name_countlabels(foundname) + 1;
+	else if (result == ISC_R_NOTFOUND)
+		minlabels = 1;
+	else
+		return (result);
+
+	if (deeper_zonecut(sdb, name, s, minlabels, now, nodep, foundname,
+			   rdataset, sigrdataset))
+		result = ISC_R_SUCCESS;
+
+	return (result);
+}
+
+static void
+attachnode(dns_db_t *db, dns_dbnode_t *source, dns_dbnode_t **targetp) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	dns_db_attachnode(sdb->shards[shard_bynode(sdb, source)],
+			  source, targetp);
+}
+
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	dns_db_detachnode(sdb->shards[shard_bynode(sdb, *targetp)], targetp);
+}
+
+static isc_result_t
+expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_expirenode(sdb->shards[shard_bynode(sdb, node)],
+				  node, now));
+}
+
+static void
+printnode(dns_db_t *db, dns_dbnode_t *node, FILE *out) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	dns_db_printnode(sdb->shards[shard_bynode(sdb, node)], node, out);
+}
+
+static isc_result_t
+createiterator(dns_db_t *db, unsigned int options,
+	       dns_dbiterator_t **iteratorp)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+	shardcache_dbiterator_t *sdbiter;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int s;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	sdbiter = isc_mem_get(sdb->common.mctx, sizeof(*sdbiter));
+	if (sdbiter == NULL)
+		return (ISC_R_NOMEMORY);
+
+	sdbiter->common.methods = &dbiterator_methods;
+	sdbiter->common.db = NULL;
+	dns_db_attach(db, &sdbiter->common.db);
+	sdbiter->common.relative_names =
+		(options & DNS_DB_RELATIVENAMES) != 0;
+	sdbiter->common.magic = DNS_DBITERATOR_MAGIC;
+	sdbiter->common.cleaning = false;
+	sdbiter->result = ISC_R_NOMORE;
+	sdbiter->current = 0;
+	sdbiter->forward = true;
+	sdbiter->new_origin = false;
+
+	/*
+	 * The shards are asked for absolute names, which are needed to
+	 * merge them.  Relative names are made in dbiterator_current().
+	 */
+	options &= ~DNS_DB_RELATIVENAMES;
+	for (s = 0; s < sdb->nshards; s++) {
+		sdbiter->iters[s] = NULL;
+		sdbiter->results[s] = ISC_R_NOMORE;
+		dns_fixedname_init(&sdbiter->names[s]);
+		if (result == ISC_R_SUCCESS)
+			result = dns_db_createiterator(sdb->shards[s], options,
+						       &sdbiter->iters[s]);
+	}
+	if (result != ISC_R_SUCCESS) {
+		dns_dbiterator_t *iterator = (dns_dbiterator_t *)sdbiter;
+		dbiterator_destroy(&iterator);
+		return (result);
+	}
+
+	*iteratorp = (dns_dbiterator_t *)sdbiter;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     dns_rdatatype_t type, dns_rdatatype_t covers,
+	     isc_stdtime_t now, dns_rdataset_t *rdataset,
+	     dns_rdataset_t *sigrdataset)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_findrdataset(sdb->shards[shard_bynode(sdb, node)],
+				    node, NULL, type, covers, now,
+				    rdataset, sigrdataset));
+}
+
+static isc_result_t
+allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     isc_stdtime_t now, dns_rdatasetiter_t **iteratorp)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_allrdatasets(sdb->shards[shard_bynode(sdb, node)],
+				    node, NULL, now, iteratorp));
+}
+
+static isc_result_t
+addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	    isc_stdtime_t now, dns_rdataset_t *rdataset, unsigned int options,
+	    dns_rdataset_t *addedrdataset)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+	dns_db_t *shard;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_result_t result, tresult;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	shard = sdb->shards[shard_bynode(sdb, node)];
+	if (rdataset->type != dns_rdatatype_dname)
+		return (dns_db_addrdataset(shard, node, NULL, now, rdataset,
+					   options, addedrdataset));
+
+	name = dns_fixedname_initname(&fixed);
+	result = dns_db_nodefullname(shard, node, name);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	RWLOCK(&sdb->dnamelock, isc_rwlocktype_write);
+	tresult = dname_track(sdb, name);
+	if (tresult == ISC_R_SUCCESS || tresult == ISC_R_EXISTS) {
+		result = dns_db_addrdataset(shard, node, NULL, now, rdataset,
+					    options, addedrdataset);
+		if (tresult == ISC_R_SUCCESS &&
+		    result != ISC_R_SUCCESS && result != DNS_R_UNCHANGED)
+			dname_untrack(sdb, name);
+	} else
+		result = tresult;
+	RWUNLOCK(&sdb->dnamelock, isc_rwlocktype_write);
+
+	return (result);
+}
+
+static isc_result_t
+subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+		 dns_rdataset_t *rdataset, unsigned int options,
+		 dns_rdataset_t *newrdataset)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	return (dns_db_subtractrdataset(sdb->shards[shard_bynode(sdb, node)],
+					node, NULL, rdataset, options,
+					newrdataset));
+}
+
+static isc_result_t
+deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	       dns_rdatatype_t type, dns_rdatatype_t covers)
+{
+	shardcache_t *sdb = (shardcache_t *)db;
+	dns_db_t *shard;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_result_t result;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	UNUSED(version);
+
+	shard = sdb->shards[shard_bynode(sdb, node)];
+	result = dns_db_deleterdataset(shard, node, NULL, type, covers);
+	if (result == ISC_R_SUCCESS && type == dns_rdatatype_dname) {
+		name = dns_fixedname_initname(&fixed);
+		if (dns_db_nodefullname(shard, node, name) == ISC_R_SUCCESS)
+			dname_prune(sdb, name, 0);
+	}
+
+	return (result);
+}
+
+static bool
+issecure(dns_db_t *db) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_issecure(sdb->shards[0]));
+}
+
+static unsigned int
+nodecount(dns_db_t *db) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	unsigned int s, count = 0;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (s = 0; s < sdb->nshards; s++)
+		count += dns_db_nodecount(sdb->shards[s]);
+
+	return (count);
+}
+
+static bool
+ispersistent(dns_db_t *db) {
+	UNUSED(db);
+
+	return (false);
+}
+
+static void
+overmem(dns_db_t *db, bool over) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	unsigned int s;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (s = 0; s < sdb->nshards; s++)
+		dns_db_overmem(sdb->shards[s], over);
+}
+
+static void
+settask(dns_db_t *db, isc_task_t *task) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	unsigned int s;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (s = 0; s < sdb->nshards; s++)
+		dns_db_settask(sdb->shards[s], task);
+}
+
+static bool
+isdnssec(dns_db_t *db) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_isdnssec(sdb->shards[0]));
+}
+
+static dns_stats_t *
+getrrsetstats(dns_db_t *db) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (sdb->rrsetstats);
+}
+
+static isc_result_t
+setcachestats(dns_db_t *db, isc_stats_t *stats) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int s;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (s = 0; s < sdb->nshards && result == ISC_R_SUCCESS; s++)
+		result = dns_db_setcachestats(sdb->shards[s], stats);
+
+	return (result);
+}
+
+static size_t
+hashsize(dns_db_t *db) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	unsigned int s;
+	size_t size = 0;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (s = 0; s < sdb->nshards; s++)
+		size += dns_db_hashsize(sdb->shards[s]);
+
+	return (size);
+}
+
+static size_t
+nodememory(dns_db_t *db) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	unsigned int s;
+	size_t size = 0;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (s = 0; s < sdb->nshards; s++)
+		size += dns_db_nodememory(sdb->shards[s]);
+
+	return (size);
+}
+
+static isc_result_t
+nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_nodefullname(sdb->shards[shard_bynode(sdb, node)],
+				    node, name));
+}
+
+static isc_result_t
+setservestalettl(dns_db_t *db, dns_ttl_t ttl) {
+	shardcache_t *sdb = (shardcache_t *)db;
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int s;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	for (s = 0; s < sdb->nshards && result == ISC_R_SUCCESS; s++)
+		result = dns_db_setservestalettl(sdb->shards[s], ttl);
+
+	return (result);
+}
+
+static isc_result_t
+getservestalettl(dns_db_t *db, dns_ttl_t *ttl) {
+	shardcache_t *sdb = (shardcache_t *)db;
+
+	REQUIRE(VALID_SHARDCACHE(sdb));
+
+	return (dns_db_getservestalettl(sdb->shards[0], ttl));
+}
+
+static dns_dbmethods_t shardcache_methods = {
+	attach,
+	detach,
+	beginload,
+	endload,
+	NULL,			/* serialize */
+	dump,
+	currentversion,
+	newversion,
+	attachversion,
+	closeversion,
+	findnode,
+	find,
+	findzonecut,
+	attachnode,
+	detachnode,
+	expirenode,
+	printnode,
+	createiterator,
+	findrdataset,
+	allrdatasets,
+	addrdataset,
+	subtractrdataset,
+	deleterdataset,
+	issecure,
+	nodecount,
+	ispersistent,
+	overmem,
+	settask,
+	NULL,			/* getoriginnode */
+	NULL,			/* transfernode */
+	NULL,			/* getnsec3parameters */
+	NULL,			/* findnsec3node */
+	NULL,			/* setsigningtime */
+	NULL,			/* getsigningtime */
+	NULL,			/* resigned */
+	isdnssec,
+	getrrsetstats,
+	NULL,			/* rpz_attach */
+	NULL,			/* rpz_ready */
+	NULL,			/* findnodeext */
+	NULL,			/* findext */
+	setcachestats,
+	hashsize,
+	nodefullname,
+	NULL,			/* getsize */
+	setservestalettl,
+	getservestalettl,
+	NULL,			/* setgluecachestats */
+	nodememory
+};
+
+isc_result_t
+dns_shardcache_create(isc_mem_t *mctx, const dns_name_t *origin,
+		      dns_dbtype_t type, dns_rdataclass_t rdclass,
+		      unsigned int argc, char *argv[], void *driverarg,
+		      dns_db_t **dbp)
+{
+	shardcache_t *sdb;
+	isc_result_t result;
+	isc_mem_t *hmctx = mctx;
+	char *shardargv[3];
+	unsigned int s, nshards;
+
+	REQUIRE(type == dns_dbtype_cache);
+	REQUIRE(dns_name_equal(origin, dns_rootname));
+	REQUIRE(dbp != NULL && *dbp == NULL);
+
+	UNUSED(driverarg);
+
+	if (argc > 0)
+		hmctx = (isc_mem_t *)argv[0];
+	if (argc > 1 && argv[1] != NULL)
+		nshards = (unsigned int)strtoul(argv[1], NULL, 10);
+	else
+		nshards = isc_os_ncpus() * 2;
+	if (nshards < 1)
+		nshards = 1;
+	if (nshards > DNS_SHARDCACHE_MAXSHARDS)
+		nshards = DNS_SHARDCACHE_MAXSHARDS;
+
+	sdb = isc_mem_get(mctx, sizeof(*sdb));
+	if (sdb == NULL)
+		return (ISC_R_NOMEMORY);
+
+	memset(sdb, 0, sizeof(*sdb));
+	sdb->common.methods = &shardcache_methods;
+	sdb->common.attributes = DNS_DBATTR_CACHE;
+	sdb->common.rdclass = rdclass;
+	sdb->common.mctx = NULL;
+	isc_mem_attach(mctx, &sdb->common.mctx);
+	ISC_LIST_INIT(sdb->common.update_listeners);
+	dns_name_init(&sdb->common.origin, NULL);
+	sdb->nshards = nshards;
+	isc_refcount_init(&sdb->references, 1);
+
+	result = dns_name_dupwithoffsets(origin, mctx, &sdb->common.origin);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	result = isc_rwlock_init(&sdb->dnamelock, 0, 0);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	result = dns_rbt_create(mctx, NULL, NULL, &sdb->dnames);
+	if (result != ISC_R_SUCCESS) {
+		isc_rwlock_destroy(&sdb->dnamelock);
+		goto cleanup;
+	}
+
+	/*
+	 * The shards share one set of rdataset statistics, which is what
+	 * dns_db_getrrsetstats() returns for the whole cache.
+	 */
+	result = dns_rdatasetstats_create(mctx, &sdb->rrsetstats);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	/*
+	 * The other shards also share the first one's admission sketch,
+	 * which keeps the memory it takes independent of the number of
+	 * shards.
+	 */
+	shardargv[0] = (char *)hmctx;
+	shardargv[1] = (char *)sdb->rrsetstats;
+	shardargv[2] = NULL;
+	for (s = 0; s < nshards; s++) {
+		result = dns_rbtdb_create(mctx, origin, type, rdclass,
+					  3, shardargv, NULL,
+					  &sdb->shards[s]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		result = dns_db_findnode(sdb->shards[s], dns_rootname, true,
+					 &sdb->roots[s]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		shardargv[2] = (char *)sdb->shards[0];
+	}
+
+	sdb->common.magic = DNS_DB_MAGIC;
+	sdb->common.impmagic = SHARDCACHE_MAGIC;
+
+	*dbp = (dns_db_t *)sdb;
+
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	isc_refcount_decrement(&sdb->references, NULL);
+	free_shardcache(sdb);
+	return (result);
+}
+
+/*
+ * Database Iterator Methods
+ */
+
+/*
+ * Leave shard 's' on its first node in the direction of travel, starting
+ * with the one it is on now if 'result' is ISC_R_SUCCESS, that belongs to
+ * it, and remember that node's name.
+ */
+static isc_result_t
+iter_settle(shardcache_dbiterator_t *sdbiter, unsigned int s,
+	    isc_result_t result, bool forward)
+{
+	shardcache_t *sdb = (shardcache_t *)sdbiter->common.db;
+	dns_dbiterator_t *iter = sdbiter->iters[s];
+	dns_name_t *name = dns_fixedname_name(&sdbiter->names[s]);
+	dns_dbnode_t *node = NULL;
+
+	if (result == ISC_R_NOTFOUND)
+		result = ISC_R_NOMORE;
+
+	while (result == ISC_R_SUCCESS) {
+		result = dns_dbiterator_current(iter, &node, name);
+		if (result != ISC_R_SUCCESS)
+			break;
+		dns_db_detachnode(iter->db, &node);
+		if (shard_byname(sdb, name) == s)
+			break;
+		if (forward)
+			result = dns_dbiterator_next(iter);
+		else
+			result = dns_dbiterator_prev(iter);
+	}
+
+	(void)dns_dbiterator_pause(iter);
+	sdbiter->results[s] = result;
+
+	return (result);
+}
+
+/*
+ * Position shard 's' on its last node before 'name', or at 'name' too
+ * if 'inclusive' is true.
+ */
+static isc_result_t
+iter_before(shardcache_dbiterator_t *sdbiter, unsigned int s,
+	    const dns_name_t *name, bool inclusive)
+{
+	dns_dbiterator_t *iter = sdbiter->iters[s];
+	isc_result_t result;
+
+	result = dns_dbiterator_seek(iter, name);
+	if (result == ISC_R_SUCCESS && !inclusive) {
+		result = dns_dbiterator_prev(iter);
+	} else if (result == DNS_R_PARTIALMATCH) {
+		/*
+		 * The iterator now points to the predecessor's name, but
+		 * to the node of the closest ancestor; step over and back
+		 * to get both right.
+		 */
+		result = dns_dbiterator_next(iter);
+		if (result == ISC_R_SUCCESS)
+			result = dns_dbiterator_prev(iter);
+		else if (result == ISC_R_NOMORE)
+			result = dns_dbiterator_last(iter);
+	}
+
+	return (iter_settle(sdbiter, s, result, false));
+}
+
+/*
+ * Position shard 's' on its first node after 'name'.
+ */
+static isc_result_t
+iter_after(shardcache_dbiterator_t *sdbiter, unsigned int s,
+	   const dns_name_t *name)
+{
+	dns_dbiterator_t *iter = sdbiter->iters[s];
+	isc_result_t result;
+
+	result = dns_dbiterator_seek(iter, name);
+	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH)
+		result = dns_dbiterator_next(iter);
+	else if (result == ISC_R_NOTFOUND)
+		result = dns_dbiterator_first(iter);
+
+	return (iter_settle(sdbiter, s, result, true));
+}
+
+/*
+ * Make the shard with the lowest (or, going backwards, highest) name the
+ * current one.
+ */
+static isc_result_t
+iter_pick(shardcache_dbiterator_t *sdbiter) {
+	shardcache_t *sdb = (shardcache_t *)sdbiter->common.db;
+	dns_name_t *name, *best = NULL;
+	unsigned int s;
+	int order;
+
+	for (s = 0; s < sdb->nshards; s++) {
+		if (sdbiter->results[s] != ISC_R_SUCCESS)
+			continue;
+		name = dns_fixedname_name(&sdbiter->names[s]);
+		if (best != NULL) {
+			order = dns_name_compare(name, best);
+			if (sdbiter->forward ? order >= 0 : order <= 0)
+				continue;
+		}
+		best = name;
+		sdbiter->current = s;
+	}
+
+	sdbiter->result = (best != NULL) ? ISC_R_SUCCESS : ISC_R_NOMORE;
+
+	return (sdbiter->result);
+}
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp) {
+	shardcache_dbiterator_t *sdbiter;
+	shardcache_t *sdb;
+	dns_db_t *db;
+	unsigned int s;
+
+	sdbiter = (shardcache_dbiterator_t *)*iteratorp;
+	db = sdbiter->common.db;
+	sdb = (shardcache_t *)db;
+
+	for (s = 0; s < sdb->nshards; s++)
+		if (sdbiter->iters[s] != NULL)
+			dns_dbiterator_destroy(&sdbiter->iters[s]);
+
+	sdbiter->common.magic = 0;
+	isc_mem_put(sdb->common.mctx, sdbiter, sizeof(*sdbiter));
+	dns_db_detach(&db);
+
+	*iteratorp = NULL;
+}
+
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator) {
+	shardcache_dbiterator_t *sdbiter = (shardcache_dbiterator_t *)iterator;
+	shardcache_t *sdb = (shardcache_t *)iterator->db;
+	unsigned int s;
+
+	for (s = 0; s < sdb->nshards; s++)
+		(void)iter_settle(sdbiter, s,
+				  dns_dbiterator_first(sdbiter->iters[s]),
+				  true);
+
+	sdbiter->forward = true;
+	sdbiter->new_origin = true;
+
+	return (iter_pick(sdbiter));
+}
+
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator) {
+	shardcache_dbiterator_t *sdbiter = (shardcache_dbiterator_t *)iterator;
+	shardcache_t *sdb = (shardcache_t *)iterator->db;
+	unsigned int s;
+
+	for (s = 0; s < sdb->nshards; s++)
+		(void)iter_settle(sdbiter, s,
+				  dns_dbiterator_last(sdbiter->iters[s]),
+				  false);
+
+	sdbiter->forward = false;
+	sdbiter->new_origin = true;
+
+	return (iter_pick(sdbiter));
+}
+
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator, const dns_name_t *name) {
+	shardcache_dbiterator_t *sdbiter = (shardcache_dbiterator_t *)iterator;
+	shardcache_t *sdb = (shardcache_t *)iterator->db;
+	isc_result_t result;
+	unsigned int s;
+
+	for (s = 0; s < sdb->nshards; s++)
+		(void)iter_before(sdbiter, s, name, true);
+
+	sdbiter->forward = false;
+	sdbiter->new_origin = true;
+
+	result = iter_pick(sdbiter);
+	if (result != ISC_R_SUCCESS) {
+		sdbiter->result = ISC_R_NOTFOUND;
+		return (ISC_R_NOTFOUND);
+	}
+
+	if (dns_name_equal(dns_fixedname_name(&sdbiter->names[sdbiter->current]),
+			   name))
+		return (ISC_R_SUCCESS);
+	return (DNS_R_PARTIALMATCH);
+}
+
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator) {
+	shardcache_dbiterator_t *sdbiter = (shardcache_dbiterator_t *)iterator;
+	shardcache_t *sdb = (shardcache_t *)iterator->db;
+	unsigned int s, cur = sdbiter->current;
+	dns_name_t *name;
+
+	if (sdbiter->result != ISC_R_SUCCESS)
+		return (sdbiter->result);
+
+	/*
+	 * After moving forward, the other shards are past the current
+	 * name; bring them back to their last node before it.
+	 */
+	if (sdbiter->forward) {
+		name = dns_fixedname_name(&sdbiter->names[cur]);
+		for (s = 0; s < sdb->nshards; s++)
+			if (s != cur)
+				(void)iter_before(sdbiter, s, name, false);
+		sdbiter->forward = false;
+	}
+
+	(void)iter_settle(sdbiter, cur, dns_dbiterator_prev(sdbiter->iters[cur]),
+			  false);
+	sdbiter->new_origin = false;
+
+	return (iter_pick(sdbiter));
+}
+
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator) {
+	shardcache_dbiterator_t *sdbiter = (shardcache_dbiterator_t *)iterator;
+	shardcache_t *sdb = (shardcache_t *)iterator->db;
+	unsigned int s, cur = sdbiter->current;
+	dns_name_t *name;
+
+	if (sdbiter->result != ISC_R_SUCCESS)
+		return (sdbiter->result);
+
+	if (!sdbiter->forward) {
+		name = dns_fixedname_name(&sdbiter->names[cur]);
+		for (s = 0; s < sdb->nshards; s++)
+			if (s != cur)
+				(void)iter_after(sdbiter, s, name);
+		sdbiter->forward = true;
+	}
+
+	(void)iter_settle(sdbiter, cur, dns_dbiterator_next(sdbiter->iters[cur]),
+			  true);
+	sdbiter->new_origin = false;
+
+	return (iter_pick(sdbiter));
+}
+
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name)
+{
+	shardcache_dbiterator_t *sdbiter = (shardcache_dbiterator_t *)iterator;
+	dns_dbiterator_t *iter;
+	dns_name_t *nodename, prefix;
+	isc_result_t result;
+
+	REQUIRE(sdbiter->result == ISC_R_SUCCESS);
+
+	iter = sdbiter->iters[sdbiter->current];
+	result = dns_dbiterator_current(iter, nodep, NULL);
+	(void)dns_dbiterator_pause(iter);
+	if (result != ISC_R_SUCCESS || name == NULL)
+		return (result);
+
+	nodename = dns_fixedname_name(&sdbiter->names[sdbiter->current]);
+	if (!iterator->relative_names)
+		return (dns_name_copy(nodename, name, NULL));
+
+	/*
+	 * Names are relative to the root, which is therefore the only
+	 * origin there is.
+	 */
+	dns_name_init(&prefix, NULL);
+	if (dns_name_countlabels(nodename) > 1) {
+		dns_name_getlabelsequence(nodename, 0,
+					  dns_name_countlabels(nodename) - 1,
+					  &prefix);
+		nodename = &prefix;
+	}
+	result = dns_name_copy(nodename, name, NULL);
+	if (result == ISC_R_SUCCESS && sdbiter->new_origin)
+		result = DNS_R_NEWORIGIN;
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator) {
+	UNUSED(iterator);
+
+	/*
+	 * The shard iterators are paused after every call.
+	 */
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name) {
+	shardcache_dbiterator_t *sdbiter = (shardcache_dbiterator_t *)iterator;
+
+	if (sdbiter->result != ISC_R_SUCCESS)
+		return (sdbiter->result);
+
+	return (dns_name_copy(dns_rootname, name, NULL));
+}
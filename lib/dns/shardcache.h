@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+
+#ifndef DNS_SHARDCACHE_H
+#define DNS_SHARDCACHE_H 1
+
+#include <isc/lang.h>
+#include <dns/types.h>
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file
+ * \brief
+ * DNS Sharded Cache DB Implementation
+ *
+ * A "shardcache" database partitions the cache across a number of
+ * independent "rbt" cache databases, chosen by a hash of the owner name.
+ * Each shard has its own tree, locks, LRU lists and TTL heaps, so that
+ * writers filling different parts of the cache do not contend with each
+ * other.  Lookups that depend on more than one name (zone cuts, DNAME
+ * processing, iteration) are resolved across the shards.
+ */
+
+/*%
+ * Maximum number of shards.
+ */
+#define DNS_SHARDCACHE_MAXSHARDS	16
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns_shardcache_create(isc_mem_t *mctx, const dns_name_t *base,
+		      dns_dbtype_t type, dns_rdataclass_t rdclass,
+		      unsigned int argc, char *argv[], void *driverarg,
+		      dns_db_t **dbp);
+
+/*%<
+ * Create a new database of type "shardcache".  Called via
+ * dns_db_create(); see documentation for that function for more details.
+ *
+ * If argv[0] is set, it points to a valid memory context to be used for
+ * allocation of heap memory by every shard.
+ *
+ * If argv[1] is set, it is the number of shards as a decimal string.
+ * Otherwise twice the number of CPUs is used.  Either way the number is
+ * limited to #DNS_SHARDCACHE_MAXSHARDS.
+ *
+ * Requires:
+ *
+ * \li type == dns_dbtype_cache and 'base' is the root name.
+ *
+ * \li argc == 0 or argv[0] is a valid memory context.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_SHARDCACHE_H */
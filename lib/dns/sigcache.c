@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/mutexblock.h>
+#include <isc/refcount.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/sigcache.h>
+
+#define SIGCACHE_MAGIC			ISC_MAGIC('S', 'g', 'C', 'h')
+#define VALID_SIGCACHE(c)		ISC_MAGIC_VALID(c, SIGCACHE_MAGIC)
+
+/*%
+ * Digests per set, and the number of locks the sets share.
+ */
+#define SIGCACHE_WAYS			4
+#define SIGCACHE_LOCKS			64
+
+typedef struct sigcache_set {
+	unsigned char		digests[SIGCACHE_WAYS]
+				       [DNS_SIGCACHE_DIGESTLENGTH];
+	uint8_t			used;		/*%< bitmap of 'digests' */
+	uint8_t			next;		/*%< oldest, replaced next */
+} sigcache_set_t;
+
+struct dns_sigcache {
+	unsigned int		magic;
+	isc_mem_t *		mctx;
+	isc_refcount_t		references;
+	unsigned int		nsets;
+	sigcache_set_t *	sets;
+	isc_mutex_t		locks[SIGCACHE_LOCKS];
+};
+
+/*
+ * Digests are SHA-256 output, so any of their bits will do to
+ * pick a set.
+ */
+static inline unsigned int
+setnum(dns_sigcache_t *cache, const unsigned char *digest) {
+	uint32_t h;
+
+	memmove(&h, digest, sizeof(h));
+	return (h % cache->nsets);
+}
+
+static inline int
+findway(sigcache_set_t *set, const unsigned char *digest) {
+	int i;
+
+	for (i = 0; i < SIGCACHE_WAYS; i++) {
+		if ((set->used & (1 << i)) != 0 &&
+		    memcmp(set->digests[i], digest,
+			   DNS_SIGCACHE_DIGESTLENGTH) == 0)
+		{
+			return (i);
+		}
+	}
+	return (-1);
+}
+
+isc_result_t
+dns_sigcache_create(isc_mem_t *mctx, size_t maxsize,
+		    dns_sigcache_t **cachep)
+{
+	isc_result_t result;
+	dns_sigcache_t *cache;
+	size_t nsets;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(maxsize > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	nsets = maxsize / sizeof(sigcache_set_t);
+	if (nsets == 0)
+		nsets = 1;
+	if (nsets > UINT32_MAX / 2)
+		nsets = UINT32_MAX / 2;
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+
+	cache->nsets = (unsigned int)nsets;
+	cache->sets = isc_mem_get(mctx, cache->nsets * sizeof(sigcache_set_t));
+	if (cache->sets == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_cache;
+	}
+	memset(cache->sets, 0, cache->nsets * sizeof(sigcache_set_t));
+
+	result = isc_mutexblock_init(cache->locks, SIGCACHE_LOCKS);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_sets;
+
+	result = isc_refcount_init(&cache->references, 1);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup_locks;
+
+	cache->mctx = NULL;
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->magic = SIGCACHE_MAGIC;
+
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup_locks:
+	DESTROYMUTEXBLOCK(cache->locks, SIGCACHE_LOCKS);
+ cleanup_sets:
+	isc_mem_put(mctx, cache->sets, cache->nsets * sizeof(sigcache_set_t));
+ cleanup_cache:
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+void
+dns_sigcache_attach(dns_sigcache_t *source, dns_sigcache_t **targetp) {
+	REQUIRE(VALID_SIGCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+
+	*targetp = source;
+}
+
+void
+dns_sigcache_detach(dns_sigcache_t **cachep) {
+	dns_sigcache_t *cache;
+	unsigned int refs;
+
+	REQUIRE(cachep != NULL && VALID_SIGCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	isc_refcount_decrement(&cache->references, &refs);
+	if (refs == 0) {
+		isc_refcount_destroy(&cache->references);
+		DESTROYMUTEXBLOCK(cache->locks, SIGCACHE_LOCKS);
+		isc_mem_put(cache->mctx, cache->sets,
+			    cache->nsets * sizeof(sigcache_set_t));
+		cache->magic = 0;
+		isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+	}
+}
+
+bool
+dns_sigcache_find(dns_sigcache_t *cache, const unsigned char *digest) {
+	unsigned int n;
+	bool found;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(digest != NULL);
+
+	n = setnum(cache, digest);
+	LOCK(&cache->locks[n % SIGCACHE_LOCKS]);
+	found = (findway(&cache->sets[n], digest) >= 0);
+	UNLOCK(&cache->locks[n % SIGCACHE_LOCKS]);
+
+	return (found);
+}
+
+void
+dns_sigcache_add(dns_sigcache_t *cache, const unsigned char *digest) {
+	sigcache_set_t *set;
+	unsigned int n;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(digest != NULL);
+
+	n = setnum(cache, digest);
+	set = &cache->sets[n];
+
+	LOCK(&cache->locks[n % SIGCACHE_LOCKS]);
+	if (findway(set, digest) < 0) {
+		memmove(set->digests[set->next], digest,
+			DNS_SIGCACHE_DIGESTLENGTH);
+		set->used |= 1 << set->next;
+		set->next = (set->next + 1) % SIGCACHE_WAYS;
+	}
+	UNLOCK(&cache->locks[n % SIGCACHE_LOCKS]);
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdbool.h>
+
+#include <isc/event.h>
+#include <isc/netaddr.h>
+#include <isc/os.h>
+#include <isc/sockaddr.h>
+#include <isc/stdtime.h>
+#include <isc/task.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include <dns/adb.h>
+#include <dns/events.h>
+#include <dns/view.h>
+
+#include "dnstest.h"
+
+#define NTHREADS	8
+#define ITERATIONS	20000
+
+/*
+ * A multiple of 10, so that adjusting it towards itself with any
+ * factor leaves it unchanged, and of 512, so that aging it once is
+ * exact.
+ */
+#define RTT		512000
+#define RTT_AGED	(RTT - RTT / 512)
+
+static dns_adb_t *adb = NULL;
+static isc_sockaddr_t server;
+static isc_stdtime_t now, agetime;
+static bool shutdown_done = false;
+
+typedef struct {
+	unsigned int		bit;
+	bool			age;
+	unsigned int		errors;
+} updater_t;
+
+/*
+ * Adjust the server's smoothed RTT towards the value it already has,
+ * optionally age it, and toggle this thread's own flag bit, leaving it
+ * set.  Each thread works through its own addrinfo for the same entry,
+ * as fetches do.
+ */
+static isc_threadresult_t
+updater(isc_threadarg_t arg) {
+	updater_t *u = arg;
+	dns_adbaddrinfo_t *addr = NULL;
+	isc_result_t result;
+	int i;
+
+	result = dns_adb_findaddrinfo(adb, &server, &addr, now);
+	if (result != ISC_R_SUCCESS) {
+		u->errors++;
+		return ((isc_threadresult_t)0);
+	}
+
+	for (i = 0; i < ITERATIONS; i++) {
+		if (u->age) {
+			dns_adb_agesrtt(adb, addr, agetime);
+			if (addr->srtt != RTT_AGED && addr->srtt != RTT)
+				u->errors++;
+		} else {
+			dns_adb_adjustsrtt(adb, addr, RTT,
+					   DNS_ADB_RTTADJDEFAULT);
+			if (addr->srtt != RTT)
+				u->errors++;
+		}
+		dns_adb_changeflags(adb, addr, (i % 2 == 0) ? 0 : u->bit,
+				    u->bit);
+	}
+	dns_adb_changeflags(adb, addr, u->bit, u->bit);
+
+	dns_adb_freeaddrinfo(adb, &addr);
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+adb_shutdown(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	isc_event_free(&event);
+	shutdown_done = true;
+}
+
+static void
+run_updaters(bool age, unsigned int *flagsp, unsigned int *srttp) {
+	isc_thread_t threads[NTHREADS];
+	updater_t updaters[NTHREADS];
+	dns_adbaddrinfo_t *addr = NULL;
+	isc_result_t result;
+	unsigned int i;
+
+	for (i = 0; i < NTHREADS; i++) {
+		updaters[i].bit = 1U << i;
+		updaters[i].age = age;
+		updaters[i].errors = 0;
+		result = isc_thread_create(updater, &updaters[i],
+					   &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++) {
+		(void)isc_thread_join(threads[i], NULL);
+		ATF_CHECK_EQ_MSG(updaters[i].errors, 0,
+				 "thread %u: %u inconsistent RTTs", i,
+				 updaters[i].errors);
+	}
+
+	result = dns_adb_findaddrinfo(adb, &server, &addr, now);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	*flagsp = addr->flags;
+	*srttp = addr->srtt;
+	dns_adb_freeaddrinfo(adb, &addr);
+}
+
+ATF_TC(concurrent);
+ATF_TC_HEAD(concurrent, tc) {
+	atf_tc_set_md_var(tc, "descr", "concurrent RTT and flag updates "
+			  "on one address");
+}
+ATF_TC_BODY(concurrent, tc) {
+	dns_view_t *view = NULL;
+	dns_adbaddrinfo_t *addr = NULL;
+	isc_task_t *task = NULL;
+	isc_event_t *event;
+	isc_netaddr_t na;
+	struct in_addr ina;
+	unsigned int allbits = (1U << NTHREADS) - 1;
+	unsigned int flags, srtt;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, true);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_makeview("view", &view);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_adb_create(mctx, view, timermgr, taskmgr, &adb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ina.s_addr = htonl(0xc0000201);		/* 192.0.2.1 */
+	isc_netaddr_fromin(&na, &ina);
+	isc_sockaddr_fromnetaddr(&server, &na, 53);
+
+	/*
+	 * Lookups use the real time so that the entry doesn't expire;
+	 * aging uses a later one so that it happens at all.
+	 */
+	isc_stdtime_get(&now);
+	agetime = now + 1;
+
+	result = dns_adb_findaddrinfo(adb, &server, &addr, now);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_adb_adjustsrtt(adb, addr, RTT, DNS_ADB_RTTADJREPLACE);
+	ATF_REQUIRE_EQ(addr->srtt, RTT);
+	dns_adb_freeaddrinfo(adb, &addr);
+
+	/*
+	 * No update may be lost: every thread's bit ends up set, and
+	 * the RTT, only ever adjusted towards itself, is unchanged.
+	 */
+	run_updaters(false, &flags, &srtt);
+	ATF_CHECK_EQ(flags & allbits, allbits);
+	ATF_CHECK_EQ(srtt, RTT);
+
+	/*
+	 * However many threads age the entry at the same time, it is
+	 * aged only once for that second.
+	 */
+	run_updaters(true, &flags, &srtt);
+	ATF_CHECK_EQ(flags & allbits, allbits);
+	ATF_CHECK_EQ(srtt, RTT_AGED);
+
+	/*
+	 * The ADB shuts down asynchronously and updates the view's
+	 * statistics as it does, so the view has to outlive it.
+	 */
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	event = isc_event_allocate(mctx, task, DNS_EVENT_VIEWADBSHUTDOWN,
+				   adb_shutdown, NULL, sizeof(*event));
+	ATF_REQUIRE(event != NULL);
+	dns_adb_whenshutdown(adb, task, &event);
+	dns_adb_shutdown(adb);
+	dns_adb_detach(&adb);
+	while (!shutdown_done)
+		dns_test_nap(1000);
+	isc_task_detach(&task);
+	dns_view_detach(&view);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, concurrent);
+	return (atf_no_error());
+}
@@ -16,13 +16,21 @@
 #include <atf-c.h>
 
 #include <unistd.h>
+#include <stdio.h>
 #include <stdlib.h>
 
+#include <isc/mem.h>
+#include <isc/stats.h>
+#include <isc/util.h>
+
+#include <dns/cache.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/journal.h>
 #include <dns/name.h>
+#include <dns/rbt.h>
 #include <dns/rdatalist.h>
+#include <dns/stats.h>
 
 #include "dnstest.h"
 
@@ -34,6 +42,215 @@
 #define	BIGBUFLEN	(64 * 1024)
 #define TEST_ORIGIN	"test"
 
+static void
+lru_addname(dns_db_t *db, const char *text) {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+	unsigned char data[] = { 0x0a, 0x00, 0x00, 0x01 };
+
+	name = dns_fixedname_initname(&fixed);
+	result = dns_name_fromstring(name, text, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	rdata.data = data;
+	rdata.length = 4;
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.ttl = 3600;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.rdclass = dns_rdataclass_in;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_findnode(db, name, true, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static isc_result_t
+lru_findname(dns_db_t *db, const char *text) {
+	dns_fixedname_t fixed, found_fixed;
+	dns_name_t *name, *found;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	name = dns_fixedname_initname(&fixed);
+	found = dns_fixedname_initname(&found_fixed);
+	result = dns_name_fromstring(name, text, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, 0,
+			     &node, found, &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	if (node != NULL)
+		dns_db_detachnode(db, &node);
+
+	return (result);
+}
+
+static void
+lru_water(void *arg, int mark) {
+	UNUSED(arg);
+	UNUSED(mark);
+}
+
+static void
+lru_getstat(isc_statscounter_t counter, uint64_t value, void *arg) {
+	if (counter == dns_cachestatscounter_probation)
+		*(uint64_t *)arg = value;
+}
+
+/*
+ * Add an rdataset of 'type' at 'owner'.  A records get a fixed address,
+ * other types the name 'target'.
+ */
+static void
+shard_add(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	  const char *target)
+{
+	dns_fixedname_t fixed, tfixed;
+	dns_name_t *name, *tname;
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+	unsigned char data[] = { 0x0a, 0x00, 0x00, 0x01 };
+
+	name = dns_fixedname_initname(&fixed);
+	result = dns_name_fromstring(name, owner, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	if (type == dns_rdatatype_a) {
+		rdata.data = data;
+		rdata.length = 4;
+	} else {
+		tname = dns_fixedname_initname(&tfixed);
+		result = dns_name_fromstring(tname, target, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		rdata.data = tname->ndata;
+		rdata.length = tname->length;
+	}
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = type;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.ttl = 3600;
+	rdatalist.type = type;
+	rdatalist.rdclass = dns_rdataclass_in;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_findnode(db, name, true, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	/* Nodes are routed to their shard by the hash kept in them. */
+	ATF_CHECK_EQ(((dns_rbtnode_t *)node)->hashval,
+		     dns_name_fullhash(name, false));
+	result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+/*
+ * Look up 'text' and check the result and the name it was found at.
+ */
+static void
+shard_find(dns_db_t *db, const char *text, dns_rdatatype_t type,
+	   isc_result_t expect, const char *expectname)
+{
+	dns_fixedname_t fixed, found_fixed, efixed;
+	dns_name_t *name, *found, *ename;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	name = dns_fixedname_initname(&fixed);
+	found = dns_fixedname_initname(&found_fixed);
+	ename = dns_fixedname_initname(&efixed);
+	result = dns_name_fromstring(name, text, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(ename, expectname, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, NULL, type, 0, 0, &node, found,
+			     &rdataset, NULL);
+	ATF_CHECK_EQ_MSG(result, expect, "%s: %s", text,
+			 isc_result_totext(result));
+	if (result == expect && result != ISC_R_NOTFOUND) {
+		ATF_CHECK_MSG(dns_name_equal(found, ename), "%s", text);
+		ATF_CHECK(dns_rdataset_isassociated(&rdataset));
+		ATF_CHECK(node != NULL);
+	}
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	if (node != NULL)
+		dns_db_detachnode(db, &node);
+}
+
+static void
+shard_findzonecut(dns_db_t *db, const char *text, unsigned int options,
+		  const char *expectname)
+{
+	dns_fixedname_t fixed, found_fixed, efixed;
+	dns_name_t *name, *found, *ename;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	name = dns_fixedname_initname(&fixed);
+	found = dns_fixedname_initname(&found_fixed);
+	ename = dns_fixedname_initname(&efixed);
+	result = dns_name_fromstring(name, text, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(ename, expectname, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findzonecut(db, name, options, 0, NULL, found,
+				    &rdataset, NULL);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s", text);
+	if (result == ISC_R_SUCCESS)
+		ATF_CHECK_MSG(dns_name_equal(found, ename), "%s", text);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+}
+
+static void
+shard_create(isc_mem_t *mymctx, dns_db_t **dbp) {
+	char *argv[2];
+	isc_result_t result;
+
+	argv[0] = (char *)mymctx;
+	argv[1] = (char *)"8";
+	result = dns_db_create(mymctx, "shardcache", dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in,
+			       2, argv, dbp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_db_iscache(*dbp));
+}
+
 /*
  * Individual unit tests
  */
@@ -262,6 +479,388 @@ ATF_TC_BODY(dns_dbfind_staleok, tc) {
 	isc_mem_detach(&mymctx);
 }
 
+ATF_TC(lru_secondchance);
+ATF_TC_HEAD(lru_secondchance, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "overmem cache purges unused entries before "
+			  "recently used ones");
+}
+ATF_TC_BODY(lru_secondchance, tc) {
+	dns_db_t *db = NULL;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	char text[64];
+	void *ptr;
+	int i, j, unused;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 64; i++) {
+		snprintf(text, sizeof(text), "name%d.example", i);
+		lru_addname(db, text);
+	}
+
+	/*
+	 * From now on every addition purges something.  The water mark is
+	 * checked when memory is next taken from the context itself, which
+	 * a large allocation guarantees.
+	 */
+	isc_mem_setwater(mymctx, lru_water, NULL, 1, 1);
+	ptr = isc_mem_get(mymctx, BIGBUFLEN);
+	ATF_REQUIRE(ptr != NULL);
+	isc_mem_put(mymctx, ptr, BIGBUFLEN);
+	ATF_REQUIRE(isc_mem_isovermem(mymctx));
+
+	/*
+	 * Keep using the even names while more names are added; only the
+	 * odd ones may be purged.  The new names are added twice, so that
+	 * they are used more often than the odd ones and get admitted.
+	 */
+	for (i = 0; i < 8; i++) {
+		for (j = 0; j < 64; j += 2) {
+			snprintf(text, sizeof(text), "name%d.example", j);
+			result = lru_findname(db, text);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+		snprintf(text, sizeof(text), "extra%d.example", i);
+		lru_addname(db, text);
+		lru_addname(db, text);
+	}
+
+	unused = 0;
+	for (i = 0; i < 64; i++) {
+		snprintf(text, sizeof(text), "name%d.example", i);
+		result = lru_findname(db, text);
+		if ((i % 2) == 0)
+			ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s", text);
+		else if (result == ISC_R_SUCCESS)
+			unused++;
+	}
+	ATF_CHECK(unused < 32);
+
+	isc_mem_setwater(mymctx, NULL, NULL, 0, 0);
+	dns_db_detach(&db);
+	isc_mem_detach(&mymctx);
+}
+
+ATF_TC(cache_admission);
+ATF_TC_HEAD(cache_admission, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "overmem cache does not let names used once "
+			  "displace popular ones");
+}
+ATF_TC_BODY(cache_admission, tc) {
+	dns_db_t *db = NULL;
+	isc_mem_t *mymctx = NULL;
+	isc_stats_t *stats = NULL;
+	isc_result_t result;
+	uint64_t probation = 0;
+	char text[64];
+	void *ptr;
+	int i, j;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mymctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create(mymctx, &stats, dns_cachestatscounter_max);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_setcachestats(db, stats);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Popular names are looked up a few times each. */
+	for (i = 0; i < 64; i++) {
+		snprintf(text, sizeof(text), "name%d.example", i);
+		lru_addname(db, text);
+		for (j = 0; j < 4; j++) {
+			result = lru_findname(db, text);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+	}
+
+	isc_mem_setwater(mymctx, lru_water, NULL, 1, 1);
+	ptr = isc_mem_get(mymctx, BIGBUFLEN);
+	ATF_REQUIRE(ptr != NULL);
+	isc_mem_put(mymctx, ptr, BIGBUFLEN);
+	ATF_REQUIRE(isc_mem_isovermem(mymctx));
+
+	/* A flood of names that are never used again. */
+	for (i = 0; i < 256; i++) {
+		snprintf(text, sizeof(text), "junk%d.example", i);
+		lru_addname(db, text);
+	}
+
+	for (i = 0; i < 64; i++) {
+		snprintf(text, sizeof(text), "name%d.example", i);
+		result = lru_findname(db, text);
+		ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s", text);
+	}
+
+	isc_stats_dump(stats, lru_getstat, &probation, ISC_STATSDUMP_VERBOSE);
+	ATF_CHECK(probation > 0);
+
+	isc_mem_setwater(mymctx, NULL, NULL, 0, 0);
+	isc_stats_detach(&stats);
+	dns_db_detach(&db);
+	isc_mem_detach(&mymctx);
+}
+
+ATF_TC(shardcache_find);
+ATF_TC_HEAD(shardcache_find, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "sharded cache finds zone cuts and DNAMEs held "
+			  "in other shards");
+}
+ATF_TC_BODY(shardcache_find, tc) {
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	char text[64], cut[64];
+	int i;
+
+	UNUSED(tc);
+
+	name = dns_fixedname_initname(&fixed);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	shard_create(mymctx, &db);
+
+	shard_add(db, "example", dns_rdatatype_ns, "ns.example");
+	shard_add(db, "www.example", dns_rdatatype_a, NULL);
+	for (i = 0; i < 32; i++) {
+		snprintf(text, sizeof(text), "z%d.example", i);
+		shard_add(db, text, dns_rdatatype_ns, "ns.example");
+		snprintf(text, sizeof(text), "www.z%d.example", i);
+		shard_add(db, text, dns_rdatatype_a, NULL);
+	}
+
+	shard_find(db, "www.example", dns_rdatatype_a, ISC_R_SUCCESS,
+		   "www.example");
+	shard_find(db, "nowhere.example", dns_rdatatype_a,
+		   DNS_R_DELEGATION, "example");
+	shard_find(db, "example.net", dns_rdatatype_a, ISC_R_NOTFOUND, ".");
+	for (i = 0; i < 32; i++) {
+		/*
+		 * Most of these names are held in another shard than their
+		 * zone cut.
+		 */
+		snprintf(cut, sizeof(cut), "z%d.example", i);
+		snprintf(text, sizeof(text), "www.z%d.example", i);
+		shard_find(db, text, dns_rdatatype_a, ISC_R_SUCCESS, text);
+		snprintf(text, sizeof(text), "a.b.z%d.example", i);
+		shard_find(db, text, dns_rdatatype_a, DNS_R_DELEGATION, cut);
+		snprintf(text, sizeof(text), "www.z%d.example", i);
+		shard_find(db, text, dns_rdatatype_aaaa,
+			   DNS_R_DELEGATION, cut);
+		snprintf(text, sizeof(text), "a.b.z%d.example", i);
+		shard_findzonecut(db, text, 0, cut);
+		shard_findzonecut(db, cut, 0, cut);
+		shard_findzonecut(db, cut, DNS_DBFIND_NOEXACT, "example");
+	}
+
+	/*
+	 * A DNAME is found above names of any shard, and above deeper
+	 * zone cuts.
+	 */
+	shard_add(db, "z7.example", dns_rdatatype_dname, "example.net");
+	for (i = 0; i < 32; i++) {
+		snprintf(text, sizeof(text), "x%d.www.z7.example", i);
+		shard_find(db, text, dns_rdatatype_a, DNS_R_DNAME,
+			   "z7.example");
+	}
+	shard_find(db, "z7.example", dns_rdatatype_dname, ISC_R_SUCCESS,
+		   "z7.example");
+	shard_find(db, "www.z8.example", dns_rdatatype_a, ISC_R_SUCCESS,
+		   "www.z8.example");
+
+	/*
+	 * Once the DNAME is gone, names below it are found as before,
+	 * and a new one is found again.
+	 */
+	result = dns_name_fromstring(name, "z7.example", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(db, name, false, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_deleterdataset(db, node, NULL, dns_rdatatype_dname, 0);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	shard_find(db, "www.z7.example", dns_rdatatype_a, ISC_R_SUCCESS,
+		   "www.z7.example");
+	shard_find(db, "a.b.z7.example", dns_rdatatype_a, DNS_R_DELEGATION,
+		   "z7.example");
+	shard_add(db, "z7.example", dns_rdatatype_dname, "example.net");
+	shard_find(db, "www.z7.example", dns_rdatatype_a, DNS_R_DNAME,
+		   "z7.example");
+
+	dns_db_detach(&db);
+
+	/* Loading goes through the shards too. */
+	shard_create(mymctx, &db);
+	result = dns_db_load(db, "testdata/db/data.db",
+			     dns_masterformat_text, 0);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_db_nodecount(db) > 0);
+	dns_db_detach(&db);
+
+	isc_mem_detach(&mymctx);
+}
+
+ATF_TC(shardcache_iterator);
+ATF_TC_HEAD(shardcache_iterator, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "sharded cache iterates in DNSSEC order and "
+			  "flushes whole trees");
+}
+ATF_TC_BODY(shardcache_iterator, tc) {
+	dns_cache_t *cache = NULL;
+	dns_db_t *db = NULL;
+	dns_dbiterator_t *iter = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fnames[128], fixed;
+	dns_name_t *name;
+	isc_mem_t *mymctx = NULL;
+	isc_result_t result;
+	char text[64];
+	char *argv[1] = { (char *)"8" };
+	int i, n, count;
+
+	UNUSED(tc);
+
+	result = isc_mem_create(0, 0, &mymctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_cache_create(mymctx, mymctx, NULL, NULL,
+				  dns_rdataclass_in, "test", "shardcache",
+				  1, argv, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_cache_attachdb(cache, &db);
+
+	for (i = 0; i < 16; i++) {
+		snprintf(text, sizeof(text), "n%d.sub.example", i);
+		shard_add(db, text, dns_rdatatype_a, NULL);
+		snprintf(text, sizeof(text), "n%d.example", i);
+		shard_add(db, text, dns_rdatatype_a, NULL);
+		snprintf(text, sizeof(text), "a.n%d.example", i);
+		shard_add(db, text, dns_rdatatype_a, NULL);
+	}
+
+	/*
+	 * Forward: strictly increasing, no name twice.
+	 */
+	result = dns_db_createiterator(db, 0, &iter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	n = 0;
+	for (result = dns_dbiterator_first(iter);
+	     result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(iter))
+	{
+		ATF_REQUIRE(n < 128);
+		name = dns_fixedname_initname(&fnames[n]);
+		result = dns_dbiterator_current(iter, &node, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		if (n > 0)
+			ATF_CHECK(dns_name_compare(dns_fixedname_name(
+					&fnames[n - 1]), name) < 0);
+		n++;
+	}
+	ATF_CHECK_EQ(result, ISC_R_NOMORE);
+	ATF_CHECK(n >= 48);
+
+	/*
+	 * Backward: the same names in reverse.
+	 */
+	i = n;
+	name = dns_fixedname_initname(&fixed);
+	for (result = dns_dbiterator_last(iter);
+	     result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_prev(iter))
+	{
+		ATF_REQUIRE(i > 0);
+		i--;
+		result = dns_dbiterator_current(iter, &node, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		ATF_CHECK(dns_name_equal(name,
+					 dns_fixedname_name(&fnames[i])));
+	}
+	ATF_CHECK_EQ(result, ISC_R_NOMORE);
+	ATF_CHECK_EQ(i, 0);
+
+	/*
+	 * Seeking, and turning around.
+	 */
+	result = dns_dbiterator_seek(iter, dns_fixedname_name(&fnames[n / 2]));
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_prev(iter);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	ATF_CHECK(dns_name_equal(name, dns_fixedname_name(&fnames[n / 2 - 1])));
+	result = dns_dbiterator_next(iter);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_next(iter);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	ATF_CHECK(dns_name_equal(name, dns_fixedname_name(&fnames[n / 2 + 1])));
+
+	result = dns_name_fromstring(name, "m.example", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_seek(iter, name);
+	ATF_CHECK_EQ(result, DNS_R_PARTIALMATCH);
+	result = dns_dbiterator_next(iter);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed), "n0.example",
+				     0, NULL);
+	ATF_CHECK(dns_name_equal(name, dns_fixedname_name(&fixed)));
+
+	dns_dbiterator_destroy(&iter);
+
+	/*
+	 * Flushing a tree removes the names below it from every shard.
+	 */
+	result = dns_name_fromstring(name, "sub.example", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_cache_flushnode(cache, name, true);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	count = 0;
+	for (i = 0; i < 16; i++) {
+		snprintf(text, sizeof(text), "n%d.sub.example", i);
+		if (lru_findname(db, text) == ISC_R_SUCCESS)
+			count++;
+		snprintf(text, sizeof(text), "n%d.example", i);
+		ATF_CHECK_EQ(lru_findname(db, text), ISC_R_SUCCESS);
+	}
+	ATF_CHECK_EQ(count, 0);
+
+	dns_db_detach(&db);
+	dns_cache_detach(&cache);
+	isc_mem_detach(&mymctx);
+}
+
 ATF_TC(class);
 ATF_TC_HEAD(class, tc) {
 	atf_tc_set_md_var(tc, "descr", "database class");
@@ -401,6 +1000,10 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, getoriginnode);
 	ATF_TP_ADD_TC(tp, getsetservestalettl);
 	ATF_TP_ADD_TC(tp, dns_dbfind_staleok);
+	ATF_TP_ADD_TC(tp, lru_secondchance);
+	ATF_TP_ADD_TC(tp, cache_admission);
+	ATF_TP_ADD_TC(tp, shardcache_find);
+	ATF_TP_ADD_TC(tp, shardcache_iterator);
 	ATF_TP_ADD_TC(tp, class);
 	ATF_TP_ADD_TC(tp, dbtype);
 	ATF_TP_ADD_TC(tp, version);
@@ -330,6 +330,257 @@ ATF_TC_BODY(dispatch_getnext, tc) {
 	dns_test_end();
 }
 
+static void
+noresponse(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	isc_event_free(&event);
+}
+
+ATF_TC(dispatch_boundset);
+ATF_TC_HEAD(dispatch_boundset, tc) {
+	atf_tc_set_md_var(tc, "descr", "test reusing bound query sockets");
+}
+ATF_TC_BODY(dispatch_boundset, tc) {
+	isc_result_t result;
+	isc_sockaddr_t dests[2], addr;
+	isc_task_t *task = NULL;
+	isc_socket_t *sock;
+	dns_dispentry_t *entry;
+	struct in_addr ina;
+	unsigned int attrs;
+	isc_socket_t *socks[20];
+	in_port_t ports[20];
+	uint16_t id;
+	int i, j, nports;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, true);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The manager's default port range is used: reuse must not
+	 * depend on the random port happening to be bound already.
+	 */
+	result = dns_dispatchmgr_create(mctx, &dispatchmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ina.s_addr = htonl(INADDR_LOOPBACK);
+	isc_sockaddr_fromin(&local, &ina, 0);
+	attrs = DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_UDP |
+		DNS_DISPATCHATTR_EXCLUSIVE;
+	result = dns_dispatch_getudp(dispatchmgr, socketmgr, taskmgr,
+				     &local, 512, 6, 1024, 17, 19, attrs,
+				     attrs, &dispatch);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The transactions alternate between two servers, and connect
+	 * their sockets as the resolver does.
+	 */
+	isc_sockaddr_fromin(&dests[0], &ina, 53);
+	isc_sockaddr_fromin(&dests[1], &ina, 54);
+	for (i = 0; i < 20; i++) {
+		entry = NULL;
+		result = dns_dispatch_addresponse(dispatch, 0, &dests[i % 2],
+						  task, noresponse, NULL, &id,
+						  &entry, socketmgr);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		sock = dns_dispatch_getentrysocket(entry);
+		result = isc_socket_connect(sock, &dests[i % 2], task,
+					    noresponse, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_getsockname(sock, &addr);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		socks[i] = sock;
+		ports[i] = isc_sockaddr_getport(&addr);
+		dns_dispatch_removeresponse(&entry, NULL);
+
+		/* Let the canceled receive return the socket. */
+		dns_test_nap(10000);
+	}
+
+	/*
+	 * With one transaction at a time the bound set holds a single
+	 * socket for each server, which every later transaction with
+	 * that server takes.  A socket used with one server is never
+	 * used with the other.
+	 */
+	nports = 0;
+	for (i = 0; i < 20; i++) {
+		for (j = 0; j < i; j++)
+			if (ports[j] == ports[i])
+				break;
+		if (j == i)
+			nports++;
+		for (j = 0; j < i; j++)
+			if (socks[j] == socks[i])
+				ATF_CHECK_EQ_MSG(i % 2, j % 2, "socket used "
+						 "with both servers");
+	}
+	ATF_CHECK_MSG(nports <= 2, "%d ports used", nports);
+
+	dns_dispatch_detach(&dispatch);
+	dns_dispatchmgr_destroy(&dispatchmgr);
+	isc_task_detach(&task);
+
+	dns_test_end();
+}
+
+ATF_TC(dispatch_tcpidle);
+ATF_TC_HEAD(dispatch_tcpidle, tc) {
+	atf_tc_set_md_var(tc, "descr", "test keeping idle TCP dispatches");
+}
+ATF_TC_BODY(dispatch_tcpidle, tc) {
+	isc_result_t result;
+	isc_socket_t *sock = NULL;
+	isc_sockaddr_t peer;
+	struct in_addr ina;
+	dns_dispatch_t *disp = NULL, *found = NULL;
+	unsigned int attrs;
+	bool connected = false;
+	int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, true);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_dispatchmgr_create(mctx, &dispatchmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The socket is never connected, so the dispatch is found by
+	 * its peer address.
+	 */
+	ina.s_addr = htonl(INADDR_LOOPBACK);
+	isc_sockaddr_fromin(&peer, &ina, 5300);
+	result = isc_socket_create(socketmgr, AF_INET, isc_sockettype_tcp,
+				   &sock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	attrs = DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_TCP;
+	result = dns_dispatch_createtcp(dispatchmgr, sock, taskmgr, NULL,
+					&peer, 4096, 32768, 32768, 61, 67,
+					attrs, &disp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_socket_detach(&sock);
+
+	result = dns_dispatch_setidle(disp, timermgr, 200);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Nothing else is attached, but the dispatch is kept open.
+	 */
+	dns_dispatch_detach(&disp);
+	result = dns_dispatch_gettcp(dispatchmgr, &peer, NULL, &connected,
+				     &found);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	if (found != NULL)
+		dns_dispatch_detach(&found);
+
+	/*
+	 * Until the idle time has passed.
+	 */
+	for (i = 0; i < 50; i++) {
+		usleep(100000);
+		result = dns_dispatch_gettcp(dispatchmgr, &peer, NULL,
+					     &connected, &found);
+		if (result != ISC_R_SUCCESS)
+			break;
+		dns_dispatch_detach(&found);
+	}
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/*
+	 * Destroying the manager closes connections kept open.
+	 */
+	result = isc_socket_create(socketmgr, AF_INET, isc_sockettype_tcp,
+				   &sock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dispatch_createtcp(dispatchmgr, sock, taskmgr, NULL,
+					&peer, 4096, 32768, 32768, 61, 67,
+					attrs, &disp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_socket_detach(&sock);
+	result = dns_dispatch_setidle(disp, timermgr, 60000);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_dispatch_detach(&disp);
+
+	dns_dispatchmgr_destroy(&dispatchmgr);
+
+	dns_test_end();
+}
+
+ATF_TC(dispatchmgr_destroy);
+ATF_TC_HEAD(dispatchmgr_destroy, tc) {
+	atf_tc_set_md_var(tc, "descr", "destroy a dispatch manager while "
+			  "detached dispatches are still on its list");
+}
+ATF_TC_BODY(dispatchmgr_destroy, tc) {
+	isc_result_t result;
+	isc_socket_t *sock = NULL;
+	isc_sockaddr_t any, peer;
+	struct in_addr ina;
+	dns_dispatch_t *disp = NULL;
+	unsigned int attrs;
+	int i, j;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, true);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_sockaddr_any(&any);
+	ina.s_addr = htonl(INADDR_LOOPBACK);
+	isc_sockaddr_fromin(&peer, &ina, 5300);
+
+	/*
+	 * Detached dispatches have already sent their control event
+	 * but are only taken off the manager's list when their task
+	 * runs it, so the manager sees them in between.
+	 */
+	for (i = 0; i < 20; i++) {
+		result = dns_dispatchmgr_create(mctx, &dispatchmgr);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		for (j = 0; j < 4; j++) {
+			attrs = DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_UDP;
+			result = dns_dispatch_getudp(dispatchmgr, socketmgr,
+						     taskmgr, &any, 512, 6,
+						     1024, 17, 19, attrs,
+						     attrs, &disp);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			dns_dispatch_detach(&disp);
+
+			result = isc_socket_create(socketmgr, AF_INET,
+						   isc_sockettype_tcp, &sock);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			attrs = DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_TCP;
+			result = dns_dispatch_createtcp(dispatchmgr, sock,
+							taskmgr, NULL, &peer,
+							4096, 32768, 32768,
+							61, 67, attrs, &disp);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			isc_socket_detach(&sock);
+			if (j % 2 == 0) {
+				result = dns_dispatch_setidle(disp, timermgr,
+							      60000);
+				ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			}
+			dns_dispatch_detach(&disp);
+		}
+
+		dns_dispatchmgr_destroy(&dispatchmgr);
+	}
+
+	dns_test_end();
+}
+
 /*
  * Main
  */
@@ -337,5 +588,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, dispatchset_create);
 	ATF_TP_ADD_TC(tp, dispatchset_get);
 	ATF_TP_ADD_TC(tp, dispatch_getnext);
+	ATF_TP_ADD_TC(tp, dispatch_boundset);
+	ATF_TP_ADD_TC(tp, dispatch_tcpidle);
+	ATF_TP_ADD_TC(tp, dispatchmgr_destroy);
 	return (atf_no_error());
 }
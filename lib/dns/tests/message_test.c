@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/print.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/result.h>
+
+#include "dnstest.h"
+
+#define NAMES	100
+
+/*
+ * Append an uncompressed "<label>.example." to 'b'.
+ */
+static void
+putname(isc_buffer_t *b, const char *label) {
+	isc_buffer_putuint8(b, strlen(label));
+	isc_buffer_putstr(b, label);
+	isc_buffer_putuint8(b, 7);
+	isc_buffer_putstr(b, "example");
+	isc_buffer_putuint8(b, 0);
+}
+
+/*
+ * A response with an A record for each of h0.example. to h<NAMES-1>.example.
+ * in the answer section, followed by an AAAA record for every other name,
+ * in upper case and in the reverse order.
+ */
+static void
+makeresponse(isc_buffer_t *b) {
+	char label[16];
+	unsigned int i;
+
+	isc_buffer_putuint16(b, 1);		/* id */
+	isc_buffer_putuint16(b, 0x8400);	/* QR, AA */
+	isc_buffer_putuint16(b, 0);
+	isc_buffer_putuint16(b, NAMES + NAMES / 2);
+	isc_buffer_putuint16(b, 0);
+	isc_buffer_putuint16(b, 0);
+
+	for (i = 0; i < NAMES; i++) {
+		snprintf(label, sizeof(label), "h%u", i);
+		putname(b, label);
+		isc_buffer_putuint16(b, dns_rdatatype_a);
+		isc_buffer_putuint16(b, dns_rdataclass_in);
+		isc_buffer_putuint32(b, 300);
+		isc_buffer_putuint16(b, 4);
+		isc_buffer_putuint32(b, 0x0a000000 + i);
+	}
+	for (i = NAMES; i > 0; i -= 2) {
+		snprintf(label, sizeof(label), "H%u", i - 1);
+		putname(b, label);
+		isc_buffer_putuint16(b, dns_rdatatype_aaaa);
+		isc_buffer_putuint16(b, dns_rdataclass_in);
+		isc_buffer_putuint32(b, 300);
+		isc_buffer_putuint16(b, 16);
+		isc_buffer_putuint32(b, 0x20010db8);
+		isc_buffer_putuint32(b, 0);
+		isc_buffer_putuint32(b, 0);
+		isc_buffer_putuint32(b, i - 1);
+	}
+}
+
+static void
+checkname(dns_message_t *msg, unsigned int i) {
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_rdataset_t *rdataset;
+	isc_result_t result;
+	char text[32];
+
+	snprintf(text, sizeof(text), "h%u.Example.", i);
+	dns_test_namefromstring(text, &fname);
+
+	name = NULL;
+	rdataset = NULL;
+	result = dns_message_findname(msg, DNS_SECTION_ANSWER,
+				      dns_fixedname_name(&fname),
+				      dns_rdatatype_a, 0, &name, &rdataset);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s A: %s", text,
+			 isc_result_totext(result));
+	if (result == ISC_R_SUCCESS)
+		ATF_CHECK_EQ(dns_rdataset_count(rdataset), 1);
+
+	name = NULL;
+	rdataset = NULL;
+	result = dns_message_findname(msg, DNS_SECTION_ANSWER,
+				      dns_fixedname_name(&fname),
+				      dns_rdatatype_aaaa, 0, &name, &rdataset);
+	ATF_CHECK_EQ_MSG(result, (i % 2 == 1) ? ISC_R_SUCCESS
+					      : DNS_R_NXRRSET,
+			 "%s AAAA: %s", text, isc_result_totext(result));
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(findname_parse);
+ATF_TC_HEAD(findname_parse, tc) {
+	atf_tc_set_md_var(tc, "descr", "names in large sections are merged "
+			  "and found when a message is parsed");
+}
+ATF_TC_BODY(findname_parse, tc) {
+	unsigned char data[8192];
+	dns_fixedname_t fname;
+	dns_message_t *msg = NULL;
+	isc_buffer_t b;
+	isc_result_t result;
+	unsigned int i, count = 0;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&b, data, sizeof(data));
+	makeresponse(&b);
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_parse(msg, &b, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* The AAAA records were added to the names of the A records. */
+	for (result = dns_message_firstname(msg, DNS_SECTION_ANSWER);
+	     result == ISC_R_SUCCESS;
+	     result = dns_message_nextname(msg, DNS_SECTION_ANSWER))
+		count++;
+	ATF_CHECK_EQ(count, NAMES);
+
+	for (i = 0; i < NAMES; i++)
+		checkname(msg, i);
+
+	dns_test_namefromstring("h100.example.", &fname);
+	result = dns_message_findname(msg, DNS_SECTION_ANSWER,
+				      dns_fixedname_name(&fname),
+				      dns_rdatatype_a, 0, NULL, NULL);
+	ATF_CHECK_EQ(result, DNS_R_NXDOMAIN);
+
+	/* The index is rebuilt after the message is reset. */
+	dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+	isc_buffer_first(&b);
+	result = dns_message_parse(msg, &b, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < NAMES; i++)
+		checkname(msg, i);
+
+	dns_message_destroy(&msg);
+
+	dns_test_end();
+}
+
+ATF_TC(findname_render);
+ATF_TC_HEAD(findname_render, tc) {
+	atf_tc_set_md_var(tc, "descr", "names added to, moved between and "
+			  "removed from large sections are found");
+}
+ATF_TC_BODY(findname_render, tc) {
+	static dns_fixedname_t fnames[NAMES];
+	dns_message_t *msg = NULL;
+	dns_name_t *name, *moved = NULL, *removed = NULL;
+	isc_result_t result;
+	unsigned int i;
+	char text[32];
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NAMES; i++) {
+		snprintf(text, sizeof(text), "h%u.example.", i);
+		dns_test_namefromstring(text, &fnames[i]);
+		name = NULL;
+		result = dns_message_gettempname(msg, &name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_name_clone(dns_fixedname_name(&fnames[i]), name);
+		dns_message_addname(msg, name, DNS_SECTION_ANSWER);
+		if (i == 10)
+			moved = name;
+		if (i == 20)
+			removed = name;
+	}
+
+	for (i = 0; i < NAMES; i++) {
+		name = NULL;
+		result = dns_message_findname(msg, DNS_SECTION_ANSWER,
+					      dns_fixedname_name(&fnames[i]),
+					      dns_rdatatype_any, 0, &name,
+					      NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(dns_name_equal(name,
+					 dns_fixedname_name(&fnames[i])));
+	}
+
+	dns_message_movename(msg, moved, DNS_SECTION_ANSWER,
+			     DNS_SECTION_AUTHORITY);
+	dns_message_removename(msg, removed, DNS_SECTION_ANSWER);
+
+	for (i = 0; i < NAMES; i++) {
+		result = dns_message_findname(msg, DNS_SECTION_ANSWER,
+					      dns_fixedname_name(&fnames[i]),
+					      dns_rdatatype_any, 0, NULL, NULL);
+		ATF_CHECK_EQ(result, (i == 10 || i == 20) ? DNS_R_NXDOMAIN
+							  : ISC_R_SUCCESS);
+	}
+	name = NULL;
+	result = dns_message_findname(msg, DNS_SECTION_AUTHORITY,
+				      dns_fixedname_name(&fnames[10]),
+				      dns_rdatatype_any, 0, &name, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(name, moved);
+
+	dns_message_puttempname(msg, &removed);
+	dns_message_destroy(&msg);
+
+	dns_test_end();
+}
+
+/*
+ * www.example/A with an EDNS cookie, and an answer whose owner name is
+ * compressed.
+ */
+static unsigned char query[] = {
+	0x00, 0x01, 0x81, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,
+	0x03, 'w', 'w', 'w', 0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x00,
+	0x00, 0x01, 0x00, 0x01,
+	0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10,
+	0x00, 0x04, 0x0a, 0x00, 0x00, 0x01,
+	0x00, 0x00, 0x29, 0x10, 0x00, 0x00, 0x00, 0x80, 0x00,
+	0x00, 0x0c, 0x00, 0x0a, 0x00, 0x08,
+	0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+};
+
+#define INQUERY(p) \
+	((unsigned char *)(p) >= query && \
+	 (unsigned char *)(p) < query + sizeof(query))
+
+ATF_TC(parse_nocopy);
+ATF_TC_HEAD(parse_nocopy, tc) {
+	atf_tc_set_md_var(tc, "descr", "DNS_MESSAGEPARSE_NOCOPY makes "
+			  "names and rdata refer to the source buffer");
+}
+ATF_TC_BODY(parse_nocopy, tc) {
+	unsigned char saved[sizeof(query)];
+	dns_message_t *msg = NULL;
+	dns_name_t *qname, *name;
+	dns_rdataset_t *rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_buffer_t b;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&b, query, sizeof(query));
+	isc_buffer_add(&b, sizeof(query));
+	result = dns_message_parse(msg, &b, DNS_MESSAGEPARSE_NOCOPY);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* The question name is not compressed. */
+	result = dns_message_firstname(msg, DNS_SECTION_QUESTION);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	qname = NULL;
+	dns_message_currentname(msg, DNS_SECTION_QUESTION, &qname);
+	ATF_CHECK(INQUERY(qname->ndata));
+
+	/* The answer's owner name is, but its A rdata is not. */
+	name = NULL;
+	rdataset = NULL;
+	result = dns_message_findname(msg, DNS_SECTION_ANSWER, qname,
+				      dns_rdatatype_a, 0, &name, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(!INQUERY(name->ndata));
+	ATF_CHECK(dns_name_equal(name, qname));
+	result = dns_rdataset_first(rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdataset_current(rdataset, &rdata);
+	ATF_CHECK(INQUERY(rdata.data));
+	ATF_CHECK_EQ(rdata.length, 4);
+
+	rdataset = dns_message_getopt(msg);
+	ATF_REQUIRE(rdataset != NULL);
+	result = dns_rdataset_first(rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdata_reset(&rdata);
+	dns_rdataset_current(rdataset, &rdata);
+	ATF_CHECK(INQUERY(rdata.data));
+	ATF_CHECK_EQ(rdata.length, 12);
+
+	/* Bad rdata is still rejected, and the buffer is left alone. */
+	dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+	query[sizeof(query) - 9] = 7;		/* cookie length */
+	memmove(saved, query, sizeof(query));
+	isc_buffer_first(&b);
+	result = dns_message_parse(msg, &b, DNS_MESSAGEPARSE_NOCOPY);
+	ATF_CHECK_EQ(result, DNS_R_OPTERR);
+	ATF_CHECK(memcmp(saved, query, sizeof(query)) == 0);
+	query[sizeof(query) - 9] = 8;
+
+	dns_message_destroy(&msg);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, findname_parse);
+	ATF_TP_ADD_TC(tp, findname_render);
+	ATF_TP_ADD_TC(tp, parse_nocopy);
+
+	return (atf_no_error());
+}
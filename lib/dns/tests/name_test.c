@@ -13,6 +13,7 @@
 
 #include <config.h>
 
+#include <ctype.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -26,6 +27,7 @@
 #include <isc/mem.h>
 #include <isc/os.h>
 #include <isc/print.h>
+#include <isc/string.h>
 #include <isc/thread.h>
 #include <isc/util.h>
 
@@ -122,6 +124,69 @@ ATF_TC_BODY(fullcompare, tc) {
 	}
 }
 
+ATF_TC(caseinsensitive);
+ATF_TC_HEAD(caseinsensitive, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "case-insensitive comparison of long labels");
+}
+ATF_TC_BODY(caseinsensitive, tc) {
+	const char *base = "abcdefghijklmnopqrstuvwxyz0123456789_abcdefghijklm"
+			   ".Example.COM.";
+	dns_fixedname_t fixed1, fixed2;
+	dns_name_t *name1, *name2;
+	char text[DNS_NAME_FORMATSIZE];
+	size_t i, len;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	name1 = dns_fixedname_initname(&fixed1);
+	name2 = dns_fixedname_initname(&fixed2);
+	result = dns_name_fromstring2(name1, base, NULL, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Change one byte at a time, so that every offset of the word
+	 * and byte at a time comparisons is covered.
+	 */
+	len = strlen(base);
+	for (i = 0; i < len; i++) {
+		if (base[i] == '.')
+			continue;
+
+		strlcpy(text, base, sizeof(text));
+		text[i] = isupper((unsigned char)text[i]) ?
+			  tolower((unsigned char)text[i]) :
+			  toupper((unsigned char)text[i]);
+		result = dns_name_fromstring2(name2, text, NULL, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(dns_name_equal(name1, name2));
+		ATF_CHECK_EQ(dns_name_compare(name1, name2), 0);
+		ATF_CHECK_EQ(dns_name_rdatacompare(name1, name2), 0);
+		ATF_CHECK_EQ(dns_name_fullhash(name1, false),
+			     dns_name_fullhash(name2, false));
+
+		/*
+		 * '@' and '[' are next to 'A' and 'Z', and '`' and '{'
+		 * to 'a' and 'z', but are not letters.
+		 */
+		strlcpy(text, base, sizeof(text));
+		text[i] = (base[i] == 'a') ? '`' :
+			  (base[i] == 'z') ? '{' :
+			  (base[i] == 'E') ? '@' :
+			  (base[i] == 'M') ? '[' : base[i] + 1;
+		result = dns_name_fromstring2(name2, text, NULL, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(!dns_name_equal(name1, name2));
+		ATF_CHECK_EQ(dns_name_compare(name1, name2) < 0,
+			     tolower((unsigned char)base[i]) <
+			     tolower((unsigned char)text[i]));
+		ATF_CHECK_EQ(dns_name_rdatacompare(name1, name2) < 0,
+			     tolower((unsigned char)base[i]) <
+			     tolower((unsigned char)text[i]));
+	}
+}
+
 static void
 compress_test(dns_name_t *name1, dns_name_t *name2, dns_name_t *name3,
 	      unsigned char *expected, unsigned int length,
@@ -278,6 +343,159 @@ ATF_TC_BODY(compression, tc) {
 	dns_test_end();
 }
 
+/*
+ * Render 'names' into 'target' with 'cctx'.
+ */
+static void
+render(const char **names, unsigned int count, dns_compress_t *cctx,
+       isc_buffer_t *target)
+{
+	dns_fixedname_t fname;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		dns_test_namefromstring(names[i], &fname);
+		ATF_REQUIRE_EQ(dns_name_towire(dns_fixedname_name(&fname),
+					       cctx, target), ISC_R_SUCCESS);
+	}
+}
+
+/*
+ * Check that 'target' holds 'names'.
+ */
+static void
+check_rendered(const char **names, unsigned int count, isc_buffer_t *target) {
+	dns_fixedname_t fname, fout;
+	dns_decompress_t dctx;
+	isc_buffer_t source, out;
+	unsigned char outdata[DNS_NAME_MAXWIRE];
+	unsigned int i;
+
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_STRICT);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&source, target->base, target->used);
+	isc_buffer_add(&source, target->used);
+	isc_buffer_setactive(&source, target->used);
+	for (i = 0; i < count; i++) {
+		dns_test_namefromstring(names[i], &fname);
+		dns_fixedname_init(&fout);
+		isc_buffer_init(&out, outdata, sizeof(outdata));
+		ATF_REQUIRE_EQ(dns_name_fromwire(dns_fixedname_name(&fout),
+						 &source, &dctx, 0, &out),
+			       ISC_R_SUCCESS);
+		ATF_CHECK(dns_name_equal(dns_fixedname_name(&fout),
+					 dns_fixedname_name(&fname)));
+	}
+	ATF_CHECK_EQ(isc_buffer_remaininglength(&source), 0);
+	dns_decompress_invalidate(&dctx);
+}
+
+ATF_TC(compression_suffix);
+ATF_TC_HEAD(compression_suffix, tc) {
+	atf_tc_set_md_var(tc, "descr", "names are compressed against every "
+			  "suffix already in the message");
+}
+ATF_TC_BODY(compression_suffix, tc) {
+	const char *names[] = { "a.b.example.com.", "c.example.com.",
+				"x.c.example.com.", "EXAMPLE.COM.", "com." };
+	unsigned char expected[] = "\001a\001b\007example\003com\000"
+				   "\001c\300\004"
+				   "\001x\300\021"
+				   "\300\004"
+				   "\300\014";
+	unsigned char buf[512];
+	isc_buffer_t target;
+	dns_compress_t cctx;
+
+	UNUSED(tc);
+
+	ATF_REQUIRE_EQ(dns_test_begin(NULL, false), ISC_R_SUCCESS);
+
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&target, buf, sizeof(buf));
+	render(names, 5, &cctx, &target);
+	check_rendered(names, 5, &target);
+	ATF_CHECK_EQ(target.used, sizeof(expected) - 1);
+	ATF_CHECK(memcmp(buf, expected, sizeof(expected) - 1) == 0);
+
+	/* Roll back the last three names and render them again. */
+	dns_compress_rollback(&cctx, 21);
+	isc_buffer_subtract(&target, target.used - 21);
+	memset(buf + 21, 0, sizeof(buf) - 21);
+	render(names + 2, 3, &cctx, &target);
+	ATF_CHECK_EQ(target.used, sizeof(expected) - 1);
+	ATF_CHECK(memcmp(buf, expected, sizeof(expected) - 1) == 0);
+	dns_compress_invalidate(&cctx);
+
+	/* Case-sensitive compression does not match "EXAMPLE.COM." */
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	dns_compress_setsensitive(&cctx, true);
+	isc_buffer_init(&target, buf, sizeof(buf));
+	render(names, 5, &cctx, &target);
+	check_rendered(names, 5, &target);
+	ATF_CHECK_EQ(target.used, sizeof(expected) - 1 - 2 + 13);
+	dns_compress_invalidate(&cctx);
+
+	/*
+	 * The legacy table only looks for the first two suffixes, so
+	 * "c.example.com." is written in full.
+	 */
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	dns_compress_setlegacy(&cctx, true);
+	isc_buffer_init(&target, buf, sizeof(buf));
+	render(names, 5, &cctx, &target);
+	check_rendered(names, 5, &target);
+	ATF_CHECK(memcmp(buf + 17, "\001c\007example\003com\000", 15) == 0);
+	dns_compress_invalidate(&cctx);
+
+	dns_test_end();
+}
+
+ATF_TC(compression_grow);
+ATF_TC_HEAD(compression_grow, tc) {
+	atf_tc_set_md_var(tc, "descr", "the compression index grows with "
+			  "the message");
+}
+ATF_TC_BODY(compression_grow, tc) {
+	static unsigned char buf[65535];
+	static char text[1000][64];
+	const char *names[1000];
+	isc_buffer_t target;
+	dns_compress_t cctx;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	ATF_REQUIRE_EQ(dns_test_begin(NULL, false), ISC_R_SUCCESS);
+
+	for (i = 0; i < 1000; i++) {
+		snprintf(text[i], sizeof(text[i]), "host%u.sub%u.zone%u.example.",
+			 i, i % 37, i % 5);
+		names[i] = text[i];
+	}
+
+	ATF_REQUIRE_EQ(dns_compress_init(&cctx, -1, mctx), ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&target, buf, sizeof(buf));
+	render(names, 1000, &cctx, &target);
+	check_rendered(names, 1000, &target);
+	/* Most names are compressed to their first label and a pointer. */
+	ATF_CHECK(target.used < 1000 * 12);
+
+	/* Roll back everything after the first name, then everything. */
+	dns_compress_rollback(&cctx, 26);
+	ATF_CHECK_EQ(cctx.count, 4);
+	dns_compress_rollback(&cctx, 0);
+	ATF_CHECK_EQ(cctx.count, 0);
+	ATF_CHECK_EQ(cctx.labelsused, 0);
+	dns_compress_invalidate(&cctx);
+
+	dns_test_end();
+}
+
 ATF_TC(istat);
 ATF_TC_HEAD(istat, tc) {
 	atf_tc_set_md_var(tc, "descr", "is trust-anchor-telemetry test");
@@ -751,7 +969,10 @@ ATF_TC_BODY(benchmark, tc) {
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, fullcompare);
+	ATF_TP_ADD_TC(tp, caseinsensitive);
 	ATF_TP_ADD_TC(tp, compression);
+	ATF_TP_ADD_TC(tp, compression_suffix);
+	ATF_TP_ADD_TC(tp, compression_grow);
 	ATF_TP_ADD_TC(tp, istat);
 	ATF_TP_ADD_TC(tp, init);
 	ATF_TP_ADD_TC(tp, invalidate);
@@ -243,7 +243,8 @@ ATF_TC_BODY(rbt_create, tc) {
 
 ATF_TC(rbt_nodecount);
 ATF_TC_HEAD(rbt_nodecount, tc) {
-	atf_tc_set_md_var(tc, "descr", "Test dns_rbt_nodecount() on a tree");
+	atf_tc_set_md_var(tc, "descr", "Test dns_rbt_nodecount() and "
+			  "dns_rbt_nodememory() on a tree");
 }
 ATF_TC_BODY(rbt_nodecount, tc) {
 	isc_result_t result;
@@ -259,6 +260,8 @@ ATF_TC_BODY(rbt_nodecount, tc) {
 	ctx = test_context_setup();
 
 	ATF_CHECK_EQ(15, dns_rbt_nodecount(ctx->rbt));
+	ATF_CHECK(dns_rbt_nodememory(ctx->rbt) >
+		  15 * sizeof(dns_rbtnode_t));
 
 	test_context_teardown(ctx);
 
@@ -1063,6 +1066,195 @@ ATF_TC_BODY(rbt_insert_and_remove, tc) {
 			 "result: %s", isc_result_totext(result));
 	ATF_CHECK_EQ_MSG(dns_rbt_nodecount(mytree), 0,
 			 "%u != 0", dns_rbt_nodecount(mytree));
+	ATF_CHECK_EQ(dns_rbt_nodememory(mytree), 0);
+
+	dns_rbt_destroy(&mytree);
+
+	dns_test_end();
+}
+
+/*
+ * Check that names 'first' up to (but not including) 'last' can be
+ * found in the tree.
+ */
+static void
+check_rehash_names(dns_rbt_t *rbt, size_t first, size_t last) {
+	dns_fixedname_t fname, found;
+	dns_name_t *name, *foundname;
+	isc_result_t result;
+	char namebuf[64];
+	size_t *n;
+	size_t i;
+
+	foundname = dns_fixedname_initname(&found);
+
+	for (i = first; i < last; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.rehash",
+			 (unsigned int)i);
+		dns_test_namefromstring(namebuf, &fname);
+		name = dns_fixedname_name(&fname);
+
+		n = NULL;
+		result = dns_rbt_findname(rbt, name, 0, foundname,
+					  (void *) &n);
+		ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s: %s", namebuf,
+				 isc_result_totext(result));
+		if (result == ISC_R_SUCCESS)
+			ATF_CHECK_EQ(*n, i);
+	}
+}
+
+ATF_TC(rbt_rehash);
+ATF_TC_HEAD(rbt_rehash, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "names stay reachable while the hash table grows");
+}
+ATF_TC_BODY(rbt_rehash, tc) {
+	isc_result_t result;
+	dns_rbt_t *mytree = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	char namebuf[64];
+	size_t hashsize;
+	size_t *n;
+	size_t i;
+
+	UNUSED(tc);
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+
+	result = dns_test_begin(NULL, true);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rbt_create(mctx, delete_data, NULL, &mytree);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	hashsize = dns_rbt_hashsize(mytree);
+
+	for (i = 0; i < 4096; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.rehash",
+			 (unsigned int)i);
+		dns_test_namefromstring(namebuf, &fname);
+		name = dns_fixedname_name(&fname);
+
+		n = isc_mem_get(mctx, sizeof(size_t));
+		ATF_REQUIRE(n != NULL);
+		*n = i;
+		result = dns_rbt_addname(mytree, name, n);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		/*
+		 * Right after the table has grown most of the nodes
+		 * are still linked from the old table; make sure that
+		 * they can all be found then and a few insertions later.
+		 */
+		if (dns_rbt_hashsize(mytree) != hashsize) {
+			hashsize = dns_rbt_hashsize(mytree);
+			check_rehash_names(mytree, 0, i + 1);
+		} else if (i % 64 == 0) {
+			check_rehash_names(mytree, 0, i + 1);
+		}
+	}
+
+	ATF_CHECK(dns_rbt_hashsize(mytree) > 64);
+	check_rehash_names(mytree, 0, 4096);
+
+	/* Remove the names in insertion order. */
+	for (i = 0; i < 4096; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.rehash",
+			 (unsigned int)i);
+		dns_test_namefromstring(namebuf, &fname);
+		name = dns_fixedname_name(&fname);
+
+		result = dns_rbt_deletename(mytree, name, false);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+		if (i % 512 == 0)
+			check_rehash_names(mytree, i + 1, 4096);
+	}
+
+	dns_rbt_destroy(&mytree);
+
+	dns_test_end();
+}
+
+static void
+add_rehash_name(dns_rbt_t *rbt, size_t i) {
+	dns_fixedname_t fname;
+	isc_result_t result;
+	char namebuf[64];
+	size_t *n;
+
+	snprintf(namebuf, sizeof(namebuf), "n%u.rehash", (unsigned int)i);
+	dns_test_namefromstring(namebuf, &fname);
+
+	n = isc_mem_get(mctx, sizeof(size_t));
+	ATF_REQUIRE(n != NULL);
+	*n = i;
+	result = dns_rbt_addname(rbt, dns_fixedname_name(&fname), n);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+delete_rehash_name(dns_rbt_t *rbt, size_t i) {
+	dns_fixedname_t fname;
+	isc_result_t result;
+	char namebuf[64];
+
+	snprintf(namebuf, sizeof(namebuf), "n%u.rehash", (unsigned int)i);
+	dns_test_namefromstring(namebuf, &fname);
+
+	result = dns_rbt_deletename(rbt, dns_fixedname_name(&fname), false);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s: %s", namebuf,
+			 isc_result_totext(result));
+}
+
+ATF_TC(rbt_rehash_delete);
+ATF_TC_HEAD(rbt_rehash_delete, tc) {
+	atf_tc_set_md_var(tc, "descr",
+			  "names added while the hash table grows can be "
+			  "deleted before it has finished");
+}
+ATF_TC_BODY(rbt_rehash_delete, tc) {
+	isc_result_t result;
+	dns_rbt_t *mytree = NULL;
+	size_t hashsize, grown, i, j;
+
+	UNUSED(tc);
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+
+	result = dns_test_begin(NULL, true);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_rbt_create(mctx, delete_data, NULL, &mytree);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Each time the table grows, add a few names while most old
+	 * buckets have not been moved yet, and delete them again at
+	 * once; then check that every other name is still there.
+	 */
+	hashsize = dns_rbt_hashsize(mytree);
+	grown = 0;
+	for (i = 0; i < 4096; i++) {
+		add_rehash_name(mytree, i);
+		if (dns_rbt_hashsize(mytree) == hashsize)
+			continue;
+
+		hashsize = dns_rbt_hashsize(mytree);
+		grown++;
+		for (j = 0; j < 8; j++)
+			add_rehash_name(mytree, 10000 + j);
+		for (j = 0; j < 8; j++)
+			delete_rehash_name(mytree, 10000 + j);
+		ATF_CHECK_EQ(dns_rbt_nodecount(mytree), i + 2);
+		check_rehash_names(mytree, 0, i + 1);
+	}
+	ATF_CHECK(grown > 0);
+
+	for (i = 0; i < 4096; i++)
+		delete_rehash_name(mytree, i);
 
 	dns_rbt_destroy(&mytree);
 
@@ -1418,6 +1610,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, rbt_insert);
 	ATF_TP_ADD_TC(tp, rbt_remove);
 	ATF_TP_ADD_TC(tp, rbt_insert_and_remove);
+	ATF_TP_ADD_TC(tp, rbt_rehash);
+	ATF_TP_ADD_TC(tp, rbt_rehash_delete);
 	ATF_TP_ADD_TC(tp, rbt_findname);
 	ATF_TP_ADD_TC(tp, rbt_addname);
 	ATF_TP_ADD_TC(tp, rbt_deletename);
@@ -15,6 +15,8 @@
 
 #include <atf-c.h>
 
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <isc/app.h>
@@ -214,6 +216,42 @@ ATF_TC_BODY(settimeout_overmax, tc) {
 	teardown();
 }
 
+ATF_TC(dumpshards);
+ATF_TC_HEAD(dumpshards, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_resolver_dumpshards");
+}
+ATF_TC_BODY(dumpshards, tc) {
+	isc_result_t result;
+	dns_resolver_t *resolver = NULL;
+	char line[100];
+	unsigned int lines = 0;
+	FILE *fp;
+
+	UNUSED(tc);
+
+	setup();
+
+	result = dns_resolver_create(view, taskmgr, 7, 1,
+				     socketmgr, timermgr, 0,
+				     dispatchmgr, dispatch, NULL, &resolver);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	fp = tmpfile();
+	ATF_REQUIRE(fp != NULL);
+	dns_resolver_dumpshards(resolver, isc_statsformat_file, fp);
+	rewind(fp);
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		ATF_CHECK(strstr(line, ": 0 active (0 created, 0 joined)")
+			  != NULL);
+		lines++;
+	}
+	ATF_CHECK_EQ(lines, 7);
+	fclose(fp);
+
+	destroy_resolver(&resolver);
+	teardown();
+}
+
 /*
  * Main
  */
@@ -224,5 +262,6 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, settimeout_default);
 	ATF_TP_ADD_TC(tp, settimeout_belowmin);
 	ATF_TP_ADD_TC(tp, settimeout_overmax);
+	ATF_TP_ADD_TC(tp, dumpshards);
 	return (atf_no_error());
 }
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/print.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/respcache.h>
+#include <dns/result.h>
+
+#include "dnstest.h"
+
+static dns_db_t *
+makedb(void) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	return (db);
+}
+
+static void
+makekey(dns_respcachekey_t *key, dns_fixedname_t *fname, const char *name,
+	dns_db_t *db, uint32_t serial)
+{
+	dns_test_namefromstring(name, fname);
+	key->qname = dns_fixedname_name(fname);
+	key->qtype = dns_rdatatype_a;
+	key->options = 0;
+	key->size = 1232;
+	key->db = db;
+	key->serial = serial;
+}
+
+/*
+ * A fake response, recognizable by its first byte.
+ */
+static void
+makeresponse(isc_region_t *r, unsigned char *data, unsigned int length,
+	     unsigned char tag)
+{
+	memset(data, 0, length);
+	data[0] = tag;
+	r->base = data;
+	r->length = length;
+}
+
+static isc_result_t
+find(dns_respcache_t *rc, const dns_respcachekey_t *key,
+     unsigned char *tagp)
+{
+	unsigned char data[DNS_RESPCACHE_MAXRESPONSE];
+	isc_buffer_t b;
+	isc_result_t result, rrlresult;
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_respcache_find(rc, key, &b, NULL, &rrlresult);
+	if (result == ISC_R_SUCCESS) {
+		ATF_CHECK(isc_buffer_usedlength(&b) > 0);
+		*tagp = data[0];
+	}
+	return (result);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(respcache_find);
+ATF_TC_HEAD(respcache_find, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_respcache_find() matches the "
+			  "whole key");
+}
+ATF_TC_BODY(respcache_find, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_respcachekey_t key, other;
+	dns_fixedname_t fname, fother, frrl;
+	unsigned char data[512], out[512], tag;
+	dns_db_t *db1, *db2;
+	dns_name_t *rrlname;
+	isc_result_t result, rrlresult;
+	isc_buffer_t b;
+	isc_region_t r;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_respcache_create(mctx, 1024 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	db1 = makedb();
+	db2 = makedb();
+
+	makekey(&key, &fname, "www.example.", db1, 1);
+	makeresponse(&r, data, sizeof(data), 1);
+	result = dns_respcache_add(rc, &key, &r, NULL, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	tag = 0;
+	result = find(rc, &key, &tag);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(tag, 1);
+
+	/* Every part of the key has to match. */
+	makekey(&other, &fother, "WWW.example.", db1, 1);
+	ATF_CHECK_EQ(find(rc, &other, &tag), ISC_R_NOTFOUND);
+	makekey(&other, &fother, "www.example.", db1, 2);
+	ATF_CHECK_EQ(find(rc, &other, &tag), ISC_R_NOTFOUND);
+	makekey(&other, &fother, "www.example.", db2, 1);
+	ATF_CHECK_EQ(find(rc, &other, &tag), ISC_R_NOTFOUND);
+	makekey(&other, &fother, "www.example.", db1, 1);
+	other.qtype = dns_rdatatype_aaaa;
+	ATF_CHECK_EQ(find(rc, &other, &tag), ISC_R_NOTFOUND);
+	other.qtype = dns_rdatatype_a;
+	other.options = 1;
+	ATF_CHECK_EQ(find(rc, &other, &tag), ISC_R_NOTFOUND);
+	other.options = 0;
+	other.size = 512;
+	ATF_CHECK_EQ(find(rc, &other, &tag), ISC_R_NOTFOUND);
+
+	/* Too small a buffer. */
+	isc_buffer_init(&b, out, 100);
+	result = dns_respcache_find(rc, &key, &b, NULL, &rrlresult);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+
+	/* No rate limiting name was stored. */
+	rrlname = dns_fixedname_initname(&frrl);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, &b, rrlname, &rrlresult);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(rrlresult, ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&b), sizeof(data));
+
+	/* Replace it with a response that has one. */
+	makeresponse(&r, data, sizeof(data), 2);
+	result = dns_respcache_add(rc, &key, &r, dns_rootname,
+				   DNS_R_NXDOMAIN);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&b, out, sizeof(out));
+	result = dns_respcache_find(rc, &key, &b, rrlname, &rrlresult);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(out[0], 2);
+	ATF_CHECK_EQ(rrlresult, DNS_R_NXDOMAIN);
+	ATF_CHECK(dns_name_equal(rrlname, dns_rootname));
+
+	/* Responses that are too large are refused. */
+	{
+		unsigned char big[DNS_RESPCACHE_MAXRESPONSE + 1];
+
+		makeresponse(&r, big, sizeof(big), 3);
+		result = dns_respcache_add(rc, &key, &r, NULL, ISC_R_SUCCESS);
+		ATF_CHECK_EQ(result, ISC_R_RANGE);
+	}
+
+	dns_respcache_destroy(&rc);
+	ATF_CHECK_EQ(rc, NULL);
+	dns_db_detach(&db1);
+	dns_db_detach(&db2);
+
+	dns_test_end();
+}
+
+ATF_TC(respcache_replace);
+ATF_TC_HEAD(respcache_replace, tc) {
+	atf_tc_set_md_var(tc, "descr", "a newer serial replaces the cached "
+			  "response, and the cache stays within its size");
+}
+ATF_TC_BODY(respcache_replace, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_respcachekey_t key;
+	dns_fixedname_t fname;
+	unsigned char data[1024], tag;
+	char namebuf[64];
+	unsigned int i, found;
+	isc_result_t result;
+	isc_region_t r;
+	dns_db_t *db;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_respcache_create(mctx, 256 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	db = makedb();
+
+	makekey(&key, &fname, "www.example.", db, 1);
+	makeresponse(&r, data, sizeof(data), 1);
+	result = dns_respcache_add(rc, &key, &r, NULL, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	key.serial = 2;
+	makeresponse(&r, data, sizeof(data), 2);
+	result = dns_respcache_add(rc, &key, &r, NULL, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK_EQ(find(rc, &key, &tag), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(tag, 2);
+	key.serial = 1;
+	ATF_CHECK_EQ(find(rc, &key, &tag), ISC_R_NOTFOUND);
+
+	/*
+	 * Add far more than fits; the least recently used responses
+	 * go, the most recent ones stay.
+	 */
+	for (i = 0; i < 2048; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.example.", i);
+		makekey(&key, &fname, namebuf, db, 1);
+		makeresponse(&r, data, sizeof(data), i & 0xff);
+		result = dns_respcache_add(rc, &key, &r, NULL, ISC_R_SUCCESS);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	found = 0;
+	for (i = 0; i < 2048; i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.example.", i);
+		makekey(&key, &fname, namebuf, db, 1);
+		if (find(rc, &key, &tag) == ISC_R_SUCCESS) {
+			ATF_CHECK_EQ(tag, i & 0xff);
+			found++;
+		}
+	}
+	ATF_CHECK(found > 0);
+	ATF_CHECK(found < 256);
+
+	snprintf(namebuf, sizeof(namebuf), "n%u.example.", 2047);
+	makekey(&key, &fname, namebuf, db, 1);
+	ATF_CHECK_EQ(find(rc, &key, &tag), ISC_R_SUCCESS);
+
+	dns_respcache_destroy(&rc);
+	dns_db_detach(&db);
+
+	dns_test_end();
+}
+
+ATF_TC(respcache_newdb);
+ATF_TC_HEAD(respcache_newdb, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_respcache_newdb() invalidates "
+			  "the responses from one database address in "
+			  "every cache");
+}
+ATF_TC_BODY(respcache_newdb, tc) {
+	dns_respcache_t *rc1 = NULL, *rc2 = NULL;
+	dns_respcachekey_t key;
+	dns_fixedname_t fname;
+	unsigned char data[512], tag;
+	dns_db_t *dbs[5];
+	char namebuf[64];
+	unsigned int i, found;
+	isc_result_t result;
+	isc_region_t r;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_respcache_create(mctx, 1024 * 1024, &rc1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_respcache_create(mctx, 1024 * 1024, &rc2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * A response replaces any other for the same query, so each
+	 * database answers another name.  The caches hold no
+	 * references to the databases.
+	 */
+	for (i = 0; i < 5; i++) {
+		dbs[i] = makedb();
+		snprintf(namebuf, sizeof(namebuf), "www%u.example.", i);
+		makekey(&key, &fname, namebuf, dbs[i], 1);
+		makeresponse(&r, data, sizeof(data), i);
+		result = dns_respcache_add(rc1, &key, &r, NULL,
+					   ISC_R_SUCCESS);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		result = dns_respcache_add(rc2, &key, &r, NULL,
+					   ISC_R_SUCCESS);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	dns_respcache_newdb(dbs[0]);
+
+	makekey(&key, &fname, "www0.example.", dbs[0], 1);
+	ATF_CHECK_EQ(find(rc1, &key, &tag), ISC_R_NOTFOUND);
+	ATF_CHECK_EQ(find(rc2, &key, &tag), ISC_R_NOTFOUND);
+
+	/*
+	 * The responses from the other databases stay, unless one of
+	 * them happens to share the generation of the first; allow for
+	 * that once.
+	 */
+	found = 0;
+	for (i = 1; i < 5; i++) {
+		snprintf(namebuf, sizeof(namebuf), "www%u.example.", i);
+		makekey(&key, &fname, namebuf, dbs[i], 1);
+		if (find(rc1, &key, &tag) == ISC_R_SUCCESS) {
+			ATF_CHECK_EQ(tag, i);
+			found++;
+		}
+	}
+	ATF_CHECK(found >= 3);
+
+	/* A response added afterwards is found again. */
+	makekey(&key, &fname, "www0.example.", dbs[0], 1);
+	makeresponse(&r, data, sizeof(data), 9);
+	result = dns_respcache_add(rc1, &key, &r, NULL, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(find(rc1, &key, &tag), ISC_R_SUCCESS);
+	ATF_CHECK_EQ(tag, 9);
+
+	dns_respcache_flush(rc1);
+	ATF_CHECK_EQ(find(rc1, &key, &tag), ISC_R_NOTFOUND);
+
+	for (i = 0; i < 5; i++)
+		dns_db_detach(&dbs[i]);
+	dns_respcache_destroy(&rc1);
+	dns_respcache_destroy(&rc2);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, respcache_find);
+	ATF_TP_ADD_TC(tp, respcache_replace);
+	ATF_TP_ADD_TC(tp, respcache_newdb);
+
+	return (atf_no_error());
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdbool.h>
+
+#include <isc/buffer.h>
+#include <isc/stdtime.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/dnssec.h>
+#include <dns/fixedname.h>
+#include <dns/keyvalues.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/result.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+#include <dst/result.h>
+
+#include "dnstest.h"
+
+static void
+makedigest(unsigned char *digest, unsigned int set, unsigned char tag) {
+	memset(digest, tag, DNS_SIGCACHE_DIGESTLENGTH);
+	memmove(digest, &set, sizeof(set));
+}
+
+ATF_TC(findadd);
+ATF_TC_HEAD(findadd, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_sigcache_find and "
+			  "dns_sigcache_add");
+}
+ATF_TC_BODY(findadd, tc) {
+	dns_sigcache_t *cache = NULL, *cache2 = NULL;
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_result_t result;
+	unsigned char i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Small enough for a single set. */
+	result = dns_sigcache_create(mctx, 1, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	makedigest(digest, 0, 1);
+	ATF_CHECK(!dns_sigcache_find(cache, digest));
+	dns_sigcache_add(cache, digest);
+	ATF_CHECK(dns_sigcache_find(cache, digest));
+
+	/* Adding it again must not take another slot. */
+	dns_sigcache_add(cache, digest);
+	for (i = 2; i < 5; i++) {
+		makedigest(digest, 0, i);
+		dns_sigcache_add(cache, digest);
+	}
+	makedigest(digest, 0, 1);
+	ATF_CHECK(dns_sigcache_find(cache, digest));
+
+	/* A fifth digest replaces the oldest. */
+	makedigest(digest, 0, 5);
+	dns_sigcache_add(cache, digest);
+	ATF_CHECK(dns_sigcache_find(cache, digest));
+	makedigest(digest, 0, 1);
+	ATF_CHECK(!dns_sigcache_find(cache, digest));
+	makedigest(digest, 0, 2);
+	ATF_CHECK(dns_sigcache_find(cache, digest));
+
+	dns_sigcache_attach(cache, &cache2);
+	dns_sigcache_detach(&cache);
+	ATF_CHECK(cache == NULL);
+	ATF_CHECK(dns_sigcache_find(cache2, digest));
+	dns_sigcache_detach(&cache2);
+
+	dns_test_end();
+}
+
+ATF_TC(verify);
+ATF_TC_HEAD(verify, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_dnssec_verify2 with a "
+			  "signature cache");
+}
+ATF_TC_BODY(verify, tc) {
+	dns_sigcache_t *cache = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dst_key_t *key = NULL;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT, sigrdata = DNS_RDATA_INIT;
+	unsigned char addr[4] = { 192, 0, 2, 1 };
+	unsigned char sigbuf[1024];
+	isc_buffer_t b;
+	isc_stdtime_t now, expire;
+	isc_result_t result;
+	bool cached;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, false);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_sigcache_create(mctx, 4096, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	name = dns_fixedname_initname(&fname);
+	result = dns_name_fromstring(name, "example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dst_key_generate(name, DST_ALG_ECDSA256, 256, 0,
+				  DNS_KEYOWNER_ZONE, DNS_KEYPROTO_DNSSEC,
+				  dns_rdataclass_in, mctx, &key, NULL);
+	if (result == DST_R_UNSUPPORTEDALG) {
+		dns_sigcache_detach(&cache);
+		dns_test_end();
+		atf_tc_skip("ECDSA not supported");
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdata_init(&rdata);
+	rdata.data = addr;
+	rdata.length = sizeof(addr);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	expire = now + 3600;
+	isc_buffer_init(&b, sigbuf, sizeof(sigbuf));
+	result = dns_dnssec_sign(name, &rdataset, key, &now, &expire, mctx,
+				 &b, &sigrdata);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_dnssec_verify2(name, &rdataset, key, false, 0, mctx,
+				    &sigrdata, NULL, cache, &cached);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(!cached);
+
+	result = dns_dnssec_verify2(name, &rdataset, key, false, 0, mctx,
+				    &sigrdata, NULL, cache, &cached);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(cached);
+
+	/* Different data under the same signature is not a hit. */
+	addr[3] = 2;
+	result = dns_dnssec_verify2(name, &rdataset, key, false, 0, mctx,
+				    &sigrdata, NULL, cache, &cached);
+	ATF_CHECK_EQ(result, DNS_R_SIGINVALID);
+	ATF_CHECK(!cached);
+	addr[3] = 1;
+
+	/* Nor is a damaged signature. */
+	sigrdata.data[sigrdata.length - 1] ^= 0x01;
+	result = dns_dnssec_verify2(name, &rdataset, key, false, 0, mctx,
+				    &sigrdata, NULL, cache, &cached);
+	ATF_CHECK_EQ(result, DNS_R_SIGINVALID);
+	ATF_CHECK(!cached);
+	sigrdata.data[sigrdata.length - 1] ^= 0x01;
+
+	/* The signature that verified is still cached. */
+	result = dns_dnssec_verify2(name, &rdataset, key, false, 0, mctx,
+				    &sigrdata, NULL, cache, &cached);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(cached);
+
+	dns_rdataset_disassociate(&rdataset);
+	dst_key_free(&key);
+	dns_sigcache_detach(&cache);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, findadd);
+	ATF_TP_ADD_TC(tp, verify);
+	return (atf_no_error());
+}
@@ -39,6 +39,7 @@
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
 #include <dns/result.h>
+#include <dns/stats.h>
 #include <dns/validator.h>
 #include <dns/view.h>
 
@@ -1505,14 +1506,20 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 	isc_result_t result;
 	dns_fixedname_t fixed;
 	bool ignore = false;
+	bool cached = false;
 	dns_name_t *wild;
 
 	val->attributes |= VALATTR_TRIEDVERIFY;
 	wild = dns_fixedname_initname(&fixed);
  again:
-	result = dns_dnssec_verify(val->event->name, val->event->rdataset,
-				   key, ignore, val->view->maxbits,
-				   val->view->mctx, rdata, wild);
+	result = dns_dnssec_verify2(val->event->name, val->event->rdataset,
+				    key, ignore, val->view->maxbits,
+				    val->view->mctx, rdata, wild,
+				    val->view->sigcache, &cached);
+	if (val->view->sigcache != NULL && val->view->resstats != NULL)
+		isc_stats_increment(val->view->resstats,
+				    cached ? dns_resstatscounter_sigcachehit :
+					     dns_resstatscounter_sigcachemiss);
 	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
 	    val->view->acceptexpired)
 	{
@@ -52,10 +52,12 @@
 #include <dns/rbt.h>
 #include <dns/rdataset.h>
 #include <dns/request.h>
+#include <dns/respcache.h>
 #include <dns/resolver.h>
 #include <dns/result.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
+#include <dns/sigcache.h>
 #include <dns/stats.h>
 #include <dns/time.h>
 #include <dns/tsig.h>
@@ -215,6 +217,7 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->provideixfr = true;
 	view->maxcachettl = 7 * 24 * 3600;
 	view->maxncachettl = 3 * 3600;
+	view->cacheshards = 0;
 	view->nta_lifetime = 0;
 	view->nta_recheck = 0;
 	view->prefetch_eligible = 0;
@@ -258,6 +261,8 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->failcache = NULL;
 	(void)dns_badcache_init(view->mctx, DNS_VIEW_FAILCACHESIZE,
 				   &view->failcache);
+	view->respcache = NULL;
+	view->sigcache = NULL;
 	view->v6bias = 0;
 	view->dtenv = NULL;
 	view->dttypes = 0;
@@ -543,6 +548,10 @@ destroy(dns_view_t *view) {
 	dns_aclenv_destroy(&view->aclenv);
 	if (view->failcache != NULL)
 		dns_badcache_destroy(&view->failcache);
+	if (view->respcache != NULL)
+		dns_respcache_destroy(&view->respcache);
+	if (view->sigcache != NULL)
+		dns_sigcache_detach(&view->sigcache);
 	DESTROYLOCK(&view->new_zone_lock);
 	DESTROYLOCK(&view->lock);
 	isc_refcount_destroy(&view->references);
@@ -621,6 +630,12 @@ view_flushanddetach(dns_view_t **viewp, bool flush) {
 		if (view->catzs != NULL) {
 			dns_catz_catzs_detach(&view->catzs);
 		}
+		/*
+		 * Zones keep a weak reference to their view; don't let
+		 * responses cached here hold their databases meanwhile.
+		 */
+		if (view->respcache != NULL)
+			dns_respcache_flush(view->respcache);
 		done = all_done(view);
 		UNLOCK(&view->lock);
 
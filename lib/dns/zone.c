@@ -68,6 +68,7 @@
 #include <dns/rdatatype.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/rriterator.h>
 #include <dns/soa.h>
@@ -15162,6 +15163,11 @@ static inline void
 zone_attachdb(dns_zone_t *zone, dns_db_t *db) {
 	REQUIRE(zone->db == NULL && db != NULL);
 
+	/*
+	 * Responses cached from an older database at the same address,
+	 * in any view, must not be mistaken for this one's.
+	 */
+	dns_respcache_newdb(db);
 	dns_db_attach(db, &zone->db);
 }
 
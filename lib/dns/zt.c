@@ -85,7 +85,11 @@ dns_zt_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, dns_zt_t **ztp) {
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_zt;
 
-	result = isc_rwlock_init(&zt->rwlock, 0, 0);
+	/*
+	 * The zone table is consulted for every query and changed only
+	 * when zones are added or removed.
+	 */
+	result = isc_rwlock_initbiased(&zt->rwlock, mctx, 0, 0);
 	if (result != ISC_R_SUCCESS)
 		goto cleanup_rbt;
 
@@ -205,6 +205,8 @@ typedef struct isc_memmethods {
 	bool (*isovermem)(isc_mem_t *mctx);
 	isc_result_t (*mpcreate)(isc_mem_t *mctx, size_t size,
 				 isc_mempool_t **mpctxp);
+	isc_result_t (*mpcreateshared)(isc_mem_t *mctx, size_t size,
+				       isc_mempool_t **mpctxp);
 } isc_memmethods_t;
 
 typedef struct isc_mempoolmethods {
@@ -563,6 +565,24 @@ isc_mempool_create(isc_mem_t *mctx, size_t size, isc_mempool_t **mpctxp);
  *\li	#ISC_R_SUCCESS		-- all is well.
  */
 
+isc_result_t
+isc_mempool_createshared(isc_mem_t *mctx, size_t size,
+			 isc_mempool_t **mpctxp);
+/*%<
+ * Create a memory pool that may be used by several threads at once
+ * without an associated lock.
+ *
+ * The free list is split into one shard per CPU, each with its own lock,
+ * and every thread always uses the same shard, so gets and puts from
+ * different threads rarely contend.  'freemax' bounds the free items of
+ * the pool as a whole and is divided between the shards; 'fillcount'
+ * applies to each shard.  'maxalloc' is enforced exactly.
+ *
+ * isc_mempool_associatelock() must not be called on a shared pool.
+ *
+ * Requires, defaults and returns are as for isc_mempool_create().
+ */
+
 void
 isc_mempool_destroy(isc_mempool_t **mpctxp);
 /*%<
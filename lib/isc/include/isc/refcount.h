@@ -101,9 +101,13 @@ ISC_LANG_BEGINDECLS
 #define ISC_REFCOUNT_HAVESTDATOMIC 1
 #endif
 
+/*
+ * The counter is kept to 32 bits even where the "fast" 32-bit type is
+ * wider: it is embedded in large numbers of objects, such as RBT nodes.
+ */
 typedef struct isc_refcount {
 #if defined(ISC_REFCOUNT_HAVESTDATOMIC)
-	atomic_int_fast32_t refs;
+	atomic_int_least32_t refs;
 #else
 	int32_t refs;
 #endif
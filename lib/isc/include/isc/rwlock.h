@@ -35,6 +35,8 @@ typedef enum {
 } isc_rwlocktype_t;
 
 #ifdef ISC_PLATFORM_USETHREADS
+struct isc_rwreader;
+
 #if (defined(ISC_PLATFORM_HAVESTDATOMIC) && defined(ATOMIC_INT_LOCK_FREE)) || (defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG))
 #define ISC_RWLOCK_USEATOMIC 1
 #if (defined(ISC_PLATFORM_HAVESTDATOMIC) && defined(ATOMIC_INT_LOCK_FREE))
@@ -84,6 +86,15 @@ struct isc_rwlock {
 	/* Unlocked. */
 	unsigned int		write_quota;
 
+	/*
+	 * Reader-biased locks (see isc_rwlock_initbiased()) count their
+	 * readers in 'readers', an array of 'nreaders' per-CPU counters,
+	 * rather than in cnt_and_flag.  NULL for ordinary locks.
+	 */
+	isc_mem_t *		mctx;
+	unsigned int		nreaders;
+	struct isc_rwreader *	readers;
+
 #else  /* ISC_RWLOCK_USEATOMIC */
 
 	/*%< Locked by lock. */
@@ -121,6 +132,32 @@ isc_result_t
 isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
 		unsigned int write_quota);
 
+isc_result_t
+isc_rwlock_initbiased(isc_rwlock_t *rwl, isc_mem_t *mctx,
+		      unsigned int read_quota, unsigned int write_quota);
+/*%<
+ * Like isc_rwlock_init(), but create a reader-biased lock for data that
+ * is read far more often than it is written.
+ *
+ * Readers of a reader-biased lock only touch a counter belonging to
+ * their own CPU slot, so concurrent readers on different CPUs do not
+ * contend for a shared cache line.  A writer revokes the read bias by
+ * flagging the lock and then waits for every slot to drain, which makes
+ * write locking more expensive than with an ordinary lock.
+ *
+ * The per-CPU counters are allocated from 'mctx'.  When the platform
+ * lacks the atomic operations needed, an ordinary lock is created.
+ *
+ * Requires:
+ *\li	'rwl' is a valid pointer.
+ *\li	'mctx' is a valid memory context.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_UNEXPECTED
+ */
+
 isc_result_t
 isc_rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type);
 
@@ -130,9 +130,15 @@ ISC_LANG_BEGINDECLS
  * _REUSEADDRESS:	Set SO_REUSEADDR prior to calling bind(),
  * 			if a non-zero port is specified (applies to
  * 			AF_INET and AF_INET6).
+ *
+ * _REUSEPORT:		Set SO_REUSEPORT prior to calling bind(), so
+ * 			that several sockets can be bound to the same
+ * 			address and port and the kernel will spread
+ * 			incoming traffic across them.
  */
 typedef enum {
 	ISC_SOCKET_REUSEADDRESS	= 0x01U,
+	ISC_SOCKET_REUSEPORT	= 0x02U,
 } isc_socket_options_t;
 /*@}*/
 
@@ -719,6 +725,8 @@ isc_socket_bind(isc_socket_t *sock, const isc_sockaddr_t *addressp,
  * \li	ISC_R_ADDRNOTAVAIL
  * \li	ISC_R_ADDRINUSE
  * \li	ISC_R_BOUND
+ * \li	ISC_R_NOTIMPLEMENTED	ISC_SOCKET_REUSEPORT was requested but
+ *				the system does not support SO_REUSEPORT.
  * \li	ISC_R_UNEXPECTED
  */
 
@@ -787,7 +795,10 @@ isc_socket_connect(isc_socket_t *sock, const isc_sockaddr_t *addressp,
  *
  * Requires:
  *
- * \li	'socket' is a valid TCP socket
+ * \li	'socket' is a valid TCP or UDP socket
+ *
+ * \li	If 'socket' is already connected, 'addressp' is the address of
+ *	its peer
  *
  * \li	'addressp' points to a valid isc_sockaddr
  *
@@ -1039,12 +1050,17 @@ isc_socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 
 isc_result_t
 isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		      unsigned int maxsocks);
+		      unsigned int maxsocks, int nthreads);
 /*%<
  * Create a socket manager.  If "maxsocks" is non-zero, it specifies the
  * maximum number of sockets that the created manager should handle.
+ * "nthreads" is the number of socket watcher threads to run; sockets are
+ * distributed among them by file descriptor, each thread having its own
+ * event notification descriptor.  Values less than one are treated as
+ * one, and only one thread is used when the library is built without
+ * thread support.
  * isc_socketmgr_create() is equivalent of isc_socketmgr_create2() with
- * "maxsocks" being zero.
+ * "maxsocks" being zero and "nthreads" being one.
  * isc_socketmgr_createinctx() also associates the new manager with the
  * specified application context.
  *
@@ -1172,6 +1188,54 @@ isc_socket_socketevent(isc_mem_t *mctx, void *sender,
  * Get a isc_socketevent_t to be used with isc_socket_sendto2(), etc.
  */
 
+isc_result_t
+isc_socket_setrecvbatch(isc_socket_t *sock, unsigned int count,
+			unsigned int size);
+/*%<
+ * Read up to 'count' datagrams of up to 'size' bytes each per system
+ * call on UDP socket 'sock', where the system supports it.  Datagrams
+ * read ahead are kept by the socket and used to satisfy later receive
+ * requests without further system calls.  A 'count' of 0 or 1 turns
+ * batching off.
+ *
+ * Datagrams longer than 'size' are truncated, and the receive event
+ * has #ISC_SOCKEVENTATTR_TRUNC set, as if the request's buffer had
+ * been too short.
+ *
+ * Batching is only useful when 'sock' is read by a single consumer:
+ * datagrams read ahead are not visible to other sockets which share
+ * the same descriptor through isc_socket_dup().
+ *
+ * Requires:
+ *\li	'sock' is a valid UDP socket.
+ *\li	'size' > 0 if 'count' > 1.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_NOTIMPLEMENTED	batched receives are not supported;
+ *				the socket is unchanged.
+ */
+
+isc_result_t
+isc_socket_purge(isc_socket_t *sock);
+/*%<
+ * Discard every datagram queued for UDP socket 'sock', including any
+ * read ahead by isc_socket_setrecvbatch(), so that the next receive
+ * request only sees datagrams which arrive after this call.  This lets
+ * a bound socket that has been idle be used again for a new exchange.
+ *
+ * Requires:
+ *\li	'sock' is a valid, open UDP socket.
+ *\li	There must be no pending receive requests.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_QUOTA		datagrams kept arriving while the queue was
+ *				being emptied; some may be left.
+ *\li	#ISC_R_NOTIMPLEMENTED
+ */
+
 void
 isc_socket_cleanunix(const isc_sockaddr_t *addr, bool active);
 
@@ -20,6 +20,7 @@
 #include <stddef.h>
 #include <limits.h>
 
+#include <isc/atomic.h>
 #include <isc/bind9.h>
 #include <isc/json.h>
 #include <isc/magic.h>
@@ -27,12 +28,19 @@
 #include <isc/mem.h>
 #include <isc/msgs.h>
 #include <isc/once.h>
+#include <isc/os.h>
+#include <isc/platform.h>
 #include <isc/string.h>
 #include <isc/mutex.h>
 #include <isc/print.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/xml.h>
 
+#if defined(ISC_PLATFORM_HAVESTDATOMIC)
+#include <stdatomic.h>
+#endif
+
 #define MCTXLOCK(m, l) if (((m)->flags & ISC_MEMFLAG_NOLOCK) == 0) LOCK(l)
 #define MCTXUNLOCK(m, l) if (((m)->flags & ISC_MEMFLAG_NOLOCK) == 0) UNLOCK(l)
 
@@ -53,6 +61,24 @@ LIBISC_EXTERNAL_DATA unsigned int isc_mem_defaultflags = ISC_MEMFLAG_DEFAULT;
 #define TABLE_INCREMENT		1024
 #define DEBUG_TABLE_COUNT	512U
 
+/*
+ * Per-thread allocation caches.  Blocks up to MEMCACHE_MAXSIZE bytes
+ * are kept in per-thread, per-context magazines of about
+ * MEMCACHE_BYTES bytes each, and moved to and from the context half a
+ * magazine at a time.  A thread's caches form a MEMCACHE_WAYS-way set
+ * associative table of MEMCACHE_SETS sets; a cache is only taken over
+ * for another context once its owner has made MEMCACHE_IDLE cached
+ * calls without using it.
+ */
+#define MEMCACHE_MAXSIZE	512U
+#define MEMCACHE_CLASSES	(MEMCACHE_MAXSIZE / ALIGNMENT_SIZE)
+#define MEMCACHE_BYTES		8192U
+#define MEMCACHE_MAXDEPTH	64U
+#define MEMCACHE_SETBITS	4
+#define MEMCACHE_SETS		(1U << MEMCACHE_SETBITS)
+#define MEMCACHE_WAYS		4
+#define MEMCACHE_IDLE		65536U
+
 /*
  * Types.
  */
@@ -83,6 +109,65 @@ struct element {
 	element *		next;
 };
 
+#ifdef ISC_PLATFORM_USETHREADS
+typedef struct memcache memcache_t;
+struct memcache {
+	isc_mutex_t		lock;
+	/* Locked by lock. */
+	isc__mem_t *		ctx;
+	element *		items[MEMCACHE_CLASSES];
+	unsigned int		count[MEMCACHE_CLASSES];
+	/* Locked by ctx->lock. */
+	ISC_LINK(memcache_t)	link;
+	/* Owning thread only. */
+	unsigned int		lastuse;
+};
+
+typedef struct {
+	unsigned int		id;
+	unsigned int		clock;
+	memcache_t *		caches[MEMCACHE_SETS][MEMCACHE_WAYS];
+} memthread_t;
+#endif /* ISC_PLATFORM_USETHREADS */
+
+/*
+ * Shared memory pools count their allocations atomically; without atomic
+ * operations a shared pool has a single shard, whose lock also protects
+ * the count.
+ */
+#if defined(ISC_PLATFORM_HAVESTDATOMIC) && defined(ATOMIC_INT_LOCK_FREE)
+typedef atomic_int_fast32_t mpcount_t;
+#define MPCOUNT_INIT(p, v)	atomic_init((p), (v))
+#define MPCOUNT_ADD(p, v) \
+	atomic_fetch_add_explicit((p), (v), memory_order_relaxed)
+#define MEMPOOL_MAXSHARDS	32U
+#elif defined(ISC_PLATFORM_HAVEXADD)
+typedef int32_t mpcount_t;
+#define MPCOUNT_INIT(p, v)	(*(p) = (v))
+#define MPCOUNT_ADD(p, v)	isc_atomic_xadd((p), (v))
+#define MEMPOOL_MAXSHARDS	32U
+#else
+typedef int32_t mpcount_t;
+#define MPCOUNT_INIT(p, v)	(*(p) = (v))
+#define MPCOUNT_ADD(p, v)	((*(p) += (v)) - (v))
+#define MEMPOOL_MAXSHARDS	1U
+#endif
+
+/*
+ * One shard of a shared memory pool.  Shards are spaced a cache line
+ * apart so that threads using neighbouring shards don't share one.
+ */
+typedef struct {
+	isc_mutex_t		lock;
+	element *		items;
+	unsigned int		freecount;
+	unsigned int		gets;
+} mpshard_t;
+
+#define MPSHARD_SIZE		((sizeof(mpshard_t) + 63U) & ~63U)
+#define MPSHARD(mp, i) \
+	((mpshard_t *)((unsigned char *)(mp)->shards + (i) * MPSHARD_SIZE))
+
 typedef struct {
 	/*!
 	 * This structure must be ALIGNMENT_SIZE bytes.
@@ -118,6 +203,12 @@ static isc_mutex_t 		createlock;
  */
 static uint64_t		totallost;
 
+#ifdef ISC_PLATFORM_USETHREADS
+static isc_thread_key_t		memcache_key;
+static bool			memcache_ok = false;
+static unsigned int		memthread_nextid;	/* contextslock */
+#endif
+
 struct isc__mem {
 	isc_mem_t		common;
 	unsigned int		flags;
@@ -163,6 +254,11 @@ struct isc__mem {
 
 	unsigned int		memalloc_failures;
 	ISC_LINK(isc__mem_t)	link;
+
+#ifdef ISC_PLATFORM_USETHREADS
+	bool			usecache;
+	ISC_LIST(memcache_t)	caches;
+#endif
 };
 
 #define MEMPOOL_MAGIC		ISC_MAGIC('M', 'E', 'M', 'p')
@@ -185,6 +281,10 @@ struct isc__mempool {
 	unsigned int	fillcount;	/*%< # of items to fetch on each fill */
 	/*%< Stats only. */
 	unsigned int	gets;		/*%< # of requests to this pool */
+	/*%< Shared pools only; unlocked, see isc_mempool_createshared(). */
+	void	       *shards;		/*%< nshards x MPSHARD_SIZE */
+	unsigned int	nshards;
+	mpcount_t	sharedallocated; /*%< # of items given out */
 	/*%< Debugging only. */
 #if ISC_MEMPOOL_NAMES
 	char		name[16];	/*%< printed name in stats reports */
@@ -198,6 +298,7 @@ struct isc__mempool {
 #if ! ISC_MEM_TRACKLINES
 #define ADD_TRACE(a, b, c, d, e)
 #define DELETE_TRACE(a, b, c, d, e)
+#define MEMCACHE_BYPASS false
 #define ISC_MEMFUNC_SCOPE
 #else
 #define TRACE_OR_RECORD (ISC_MEM_DEBUGTRACE|ISC_MEM_DEBUGRECORD)
@@ -213,6 +314,11 @@ struct isc__mempool {
 				 b != NULL))				\
 			delete_trace_entry(a, b, c, d, e);		\
 	} while(0)
+/*
+ * Traced allocations bypass the per-thread caches.
+ */
+#define MEMCACHE_BYPASS \
+	ISC_UNLIKELY((isc_mem_debugging & TRACE_OR_RECORD) != 0)
 
 static void
 print_active(isc__mem_t *ctx, FILE *out);
@@ -277,6 +383,9 @@ void *
 isc__mem_gettag(isc_mem_t *ctx);
 isc_result_t
 isc__mempool_create(isc_mem_t *mctx, size_t size, isc_mempool_t **mpctxp);
+isc_result_t
+isc__mempool_createshared(isc_mem_t *mctx, size_t size,
+			  isc_mempool_t **mpctxp);
 void
 isc__mempool_setname(isc_mempool_t *mpctx, const char *name);
 void
@@ -308,6 +417,10 @@ isc__mem_printactive(isc_mem_t *ctx0, FILE *file);
 unsigned int
 isc__mem_references(isc_mem_t *ctx0);
 
+static void
+mempool_sharedcounts(isc__mempool_t *mpctx, unsigned int *allocatedp,
+		     unsigned int *freecountp, unsigned int *getsp);
+
 static struct isc__memmethods {
 	isc_memmethods_t methods;
 
@@ -335,7 +448,8 @@ static struct isc__memmethods {
 		isc__mem_maxinuse,
 		isc__mem_total,
 		isc__mem_isovermem,
-		isc__mempool_create
+		isc__mempool_create,
+		isc__mempool_createshared
 	},
 	(void *)isc_mem_createx,
 	(void *)isc_mem_create,
@@ -832,6 +946,427 @@ mem_putstats(isc__mem_t *ctx, void *ptr, size_t size) {
 	ctx->malloced -= size;
 }
 
+/*!
+ * Check the high water mark after the context's in-use count has grown.
+ * Returns true if the water callback should be called.
+ */
+static inline bool
+mem_hiwater(isc__mem_t *ctx) {
+	bool call_water = false;
+
+	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water) {
+		ctx->is_overmem = true;
+		if (!ctx->hi_called)
+			call_water = true;
+	}
+	if (ctx->inuse > ctx->maxinuse) {
+		ctx->maxinuse = ctx->inuse;
+		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
+			fprintf(stderr, "maxinuse = %lu\n",
+				(unsigned long)ctx->inuse);
+	}
+
+	return (call_water);
+}
+
+/*!
+ * Check the low water mark after the context's in-use count has shrunk.
+ * Returns true if the water callback should be called.
+ */
+static inline bool
+mem_lowater(isc__mem_t *ctx) {
+	bool call_water = false;
+
+	/*
+	 * The check against ctx->lo_water == 0 is for the condition
+	 * when the context was pushed over hi_water but then had
+	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
+	 */
+	if ((ctx->inuse < ctx->lo_water) || (ctx->lo_water == 0U)) {
+		ctx->is_overmem = false;
+		if (ctx->hi_called)
+			call_water = true;
+	}
+
+	return (call_water);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+/*
+ * Per-thread allocation caches.
+ *
+ * Each thread has a set associative table of caches indexed by memory
+ * context, and each cache holds a magazine of free blocks for every size
+ * class up to MEMCACHE_MAXSIZE.  isc_mem_get() and isc_mem_put() of a small
+ * block only touch the calling thread's cache; blocks move between a
+ * magazine and its context half a magazine at a time.
+ *
+ * Cached blocks have already been taken from the context: they are
+ * counted in 'inuse' and in stats[new_size], so the context's accounting
+ * stays exact except that cached blocks look allocated, and quota and
+ * water marks are checked whenever blocks move.  For this to balance,
+ * cacheable sizes are always accounted at their quantized size.
+ *
+ * A cache is attached to a context ('cache->ctx' is set and the cache is
+ * on 'ctx->caches') only while both the cache and the context are
+ * locked, so either lock is enough to read that state.  The cache lock is
+ * taken by the owning thread on every use and is only contended when the
+ * context is being destroyed.  Lock order is cache before context.
+ *
+ * When every way of a context's set is attached to some other context,
+ * the least recently used way is drained and reattached only if its
+ * owner hasn't used it for MEMCACHE_IDLE calls; otherwise the thread
+ * bypasses its caches for that context.  A thread that spreads its work
+ * over more contexts than it has ways thus keeps caching for the ones it
+ * uses most, instead of draining a cache on every switch.
+ */
+
+static inline bool
+memcache_cacheable(isc__mem_t *ctx, size_t size) {
+	return (ctx->usecache && size <= MEMCACHE_MAXSIZE &&
+		quantize(size) < ctx->max_size);
+}
+
+static inline unsigned int
+memcache_depth(size_t new_size) {
+	unsigned int depth = MEMCACHE_BYTES / new_size;
+
+	if (depth > MEMCACHE_MAXDEPTH)
+		depth = MEMCACHE_MAXDEPTH;
+	return (depth);
+}
+
+/*!
+ * Return a list of 'new_size' blocks to 'ctx', which must be locked.
+ */
+static void
+memcache_putunlocked(isc__mem_t *ctx, element *list, size_t new_size) {
+	element *next;
+
+	while (list != NULL) {
+		next = list->next;
+		if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+			mem_putunlocked(ctx, list, new_size);
+		} else {
+			mem_putstats(ctx, list, new_size);
+			mem_put(ctx, list, new_size);
+		}
+		list = next;
+	}
+}
+
+/*!
+ * Return every cached block to the cache's context and detach the cache.
+ * Both the cache and its context must be locked.
+ */
+static void
+memcache_drainunlocked(memcache_t *cache) {
+	isc__mem_t *ctx = cache->ctx;
+	unsigned int i;
+
+	for (i = 0; i < MEMCACHE_CLASSES; i++) {
+		if (cache->count[i] == 0U)
+			continue;
+		memcache_putunlocked(ctx, cache->items[i],
+				     (i + 1) * ALIGNMENT_SIZE);
+		cache->items[i] = NULL;
+		cache->count[i] = 0;
+	}
+	ISC_LIST_UNLINK(ctx->caches, cache, link);
+	cache->ctx = NULL;
+}
+
+/*!
+ * Detach a locked cache from its context, if it has one.  The water
+ * marks are left for the context's next get or put to re-evaluate.
+ */
+static void
+memcache_release(memcache_t *cache) {
+	isc__mem_t *ctx = cache->ctx;
+
+	if (ctx == NULL)
+		return;
+	LOCK(&ctx->lock);
+	memcache_drainunlocked(cache);
+	UNLOCK(&ctx->lock);
+}
+
+/*!
+ * Thread exit: give back everything the thread still has cached.
+ */
+static void
+memcache_threadexit(void *arg) {
+	memthread_t *thread = arg;
+	memcache_t *cache;
+	unsigned int i, j;
+
+	for (i = 0; i < MEMCACHE_SETS; i++) {
+		for (j = 0; j < MEMCACHE_WAYS; j++) {
+			cache = thread->caches[i][j];
+			if (cache == NULL)
+				continue;
+			LOCK(&cache->lock);
+			memcache_release(cache);
+			UNLOCK(&cache->lock);
+			DESTROYLOCK(&cache->lock);
+			free(cache);
+		}
+	}
+	free(thread);
+}
+
+/*!
+ * Return the calling thread's per-thread state, creating it if needed.
+ */
+static memthread_t *
+memthread_get(void) {
+	memthread_t *thread;
+
+	if (!memcache_ok)
+		return (NULL);
+
+	thread = isc_thread_key_getspecific(memcache_key);
+	if (ISC_UNLIKELY(thread == NULL)) {
+		thread = calloc(1, sizeof(*thread));
+		if (thread == NULL)
+			return (NULL);
+		if (isc_thread_key_setspecific(memcache_key, thread) != 0) {
+			free(thread);
+			return (NULL);
+		}
+		LOCK(&contextslock);
+		thread->id = memthread_nextid++;
+		UNLOCK(&contextslock);
+	}
+
+	return (thread);
+}
+
+/*!
+ * Allocate an unattached cache for way 'way' of 'set'.
+ */
+static memcache_t *
+memcache_new(memthread_t *thread, unsigned int set, unsigned int way) {
+	memcache_t *cache;
+
+	cache = calloc(1, sizeof(*cache));
+	if (cache == NULL)
+		return (NULL);
+	if (isc_mutex_init(&cache->lock) != ISC_R_SUCCESS) {
+		free(cache);
+		return (NULL);
+	}
+	ISC_LINK_INIT(cache, link);
+	thread->caches[set][way] = cache;
+	return (cache);
+}
+
+/*!
+ * Find the calling thread's cache for 'ctx', attaching one if a way is
+ * free or idle, and return it locked.  Returns NULL if there is no cache
+ * for 'ctx', in which case the caller falls back to the context itself.
+ *
+ * 'cache->ctx' is read without the cache lock to pick a way; it can
+ * only change under us if memcache_destroy() detaches the cache, so it
+ * is checked again once the lock is held.
+ */
+static memcache_t *
+memcache_lock(isc__mem_t *ctx) {
+	memthread_t *thread;
+	memcache_t *cache, *victim = NULL;
+	unsigned int set, way, now;
+
+	thread = memthread_get();
+	if (thread == NULL)
+		return (NULL);
+
+	now = ++thread->clock;
+	set = ((uint32_t)((uintptr_t)ctx >> 4) * 0x9e3779b1U) >>
+		(32 - MEMCACHE_SETBITS);
+	for (way = 0; way < MEMCACHE_WAYS; way++) {
+		cache = thread->caches[set][way];
+		if (ISC_UNLIKELY(cache == NULL)) {
+			if (victim == NULL || victim->ctx != NULL) {
+				victim = memcache_new(thread, set, way);
+				if (victim == NULL)
+					return (NULL);
+			}
+			break;
+		}
+		if (ISC_LIKELY(cache->ctx == ctx)) {
+			LOCK(&cache->lock);
+			if (ISC_LIKELY(cache->ctx == ctx)) {
+				cache->lastuse = now;
+				return (cache);
+			}
+			UNLOCK(&cache->lock);
+		}
+		if (victim == NULL || cache->ctx == NULL ||
+		    (victim->ctx != NULL &&
+		     now - cache->lastuse > now - victim->lastuse))
+			victim = cache;
+	}
+
+	if (victim->ctx != NULL && now - victim->lastuse < MEMCACHE_IDLE)
+		return (NULL);
+
+	LOCK(&victim->lock);
+	memcache_release(victim);
+	LOCK(&ctx->lock);
+	victim->ctx = ctx;
+	ISC_LIST_APPEND(ctx->caches, victim, link);
+	UNLOCK(&ctx->lock);
+	victim->lastuse = now;
+
+	return (victim);
+}
+
+/*!
+ * Get a 'new_size' block through the calling thread's cache, refilling
+ * the magazine from the context when it is empty.  Returns false if the
+ * thread has no cache.
+ */
+static bool
+memcache_get(isc__mem_t *ctx, size_t new_size, void **ptrp) {
+	memcache_t *cache;
+	unsigned int i = (unsigned int)(new_size / ALIGNMENT_SIZE) - 1;
+	unsigned int n, want;
+	bool call_water = false;
+	element *e;
+
+	cache = memcache_lock(ctx);
+	if (cache == NULL)
+		return (false);
+
+	if (cache->count[i] == 0U) {
+		want = memcache_depth(new_size) / 2;
+		if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+			LOCK(&ctx->lock);
+			for (n = 0; n < want; n++) {
+				e = mem_getunlocked(ctx, new_size);
+				if (e == NULL)
+					break;
+				e->next = cache->items[i];
+				cache->items[i] = e;
+			}
+		} else {
+			for (n = 0; n < want; n++) {
+				e = mem_get(ctx, new_size);
+				if (e == NULL)
+					break;
+				e->next = cache->items[i];
+				cache->items[i] = e;
+			}
+			LOCK(&ctx->lock);
+			for (want = 0; want < n; want++)
+				mem_getstats(ctx, new_size);
+		}
+		cache->count[i] = n;
+		call_water = mem_hiwater(ctx);
+		UNLOCK(&ctx->lock);
+	}
+
+	e = cache->items[i];
+	if (e != NULL) {
+		cache->items[i] = e->next;
+		cache->count[i]--;
+	}
+	UNLOCK(&cache->lock);
+
+	if (ISC_UNLIKELY((ctx->flags & ISC_MEMFLAG_FILL) != 0) &&
+	    ISC_LIKELY(e != NULL))
+		memset(e, 0xbe, new_size); /* Mnemonic for "beef". */
+
+	if (call_water && (ctx->water != NULL))
+		(ctx->water)(ctx->water_arg, ISC_MEM_HIWATER);
+
+	*ptrp = e;
+	return (true);
+}
+
+/*!
+ * Put a block of 'size' bytes ('new_size' once quantized) into the
+ * calling thread's cache, returning half of the magazine to the context
+ * when it is full.  Returns false if the thread has no cache.
+ */
+static bool
+memcache_put(isc__mem_t *ctx, void *ptr, size_t size, size_t new_size) {
+	memcache_t *cache;
+	unsigned int i = (unsigned int)(new_size / ALIGNMENT_SIZE) - 1;
+	unsigned int n, depth;
+	bool call_water = false;
+	element *e, *list;
+
+#if ISC_MEM_CHECKOVERRUN
+	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) == 0)
+		INSIST(((unsigned char *)ptr)[new_size] == 0xbe);
+	else if ((ctx->flags & ISC_MEMFLAG_FILL) != 0)
+		check_overrun(ptr, size, new_size);
+#else
+	UNUSED(size);
+#endif
+
+	cache = memcache_lock(ctx);
+	if (cache == NULL)
+		return (false);
+
+	if (ISC_UNLIKELY((ctx->flags & ISC_MEMFLAG_FILL) != 0))
+		memset(ptr, 0xde, new_size); /* Mnemonic for "dead". */
+
+	e = ptr;
+	e->next = cache->items[i];
+	cache->items[i] = e;
+	cache->count[i]++;
+
+	depth = memcache_depth(new_size);
+	if (cache->count[i] > depth) {
+		list = NULL;
+		for (n = 0; n < depth / 2; n++) {
+			e = cache->items[i];
+			cache->items[i] = e->next;
+			e->next = list;
+			list = e;
+		}
+		cache->count[i] -= n;
+		LOCK(&ctx->lock);
+		memcache_putunlocked(ctx, list, new_size);
+		call_water = mem_lowater(ctx);
+		UNLOCK(&ctx->lock);
+	}
+	UNLOCK(&cache->lock);
+
+	if (call_water && (ctx->water != NULL))
+		(ctx->water)(ctx->water_arg, ISC_MEM_LOWATER);
+
+	return (true);
+}
+
+/*!
+ * Called from destroy(): take back every block still cached by any
+ * thread.  An owning thread that holds its cache lock is itself
+ * releasing the cache (it can't be using a context that is being
+ * destroyed), so back off until it has done so.
+ */
+static void
+memcache_destroy(isc__mem_t *ctx) {
+	memcache_t *cache;
+
+	LOCK(&ctx->lock);
+	while ((cache = ISC_LIST_HEAD(ctx->caches)) != NULL) {
+		if (isc_mutex_trylock(&cache->lock) != ISC_R_SUCCESS) {
+			UNLOCK(&ctx->lock);
+			isc_thread_yield();
+			LOCK(&ctx->lock);
+			continue;
+		}
+		memcache_drainunlocked(cache);
+		UNLOCK(&cache->lock);
+	}
+	UNLOCK(&ctx->lock);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
 /*
  * Private.
  */
@@ -856,6 +1391,10 @@ initialize_action(void) {
 	RUNTIME_CHECK(isc_mutex_init(&contextslock) == ISC_R_SUCCESS);
 	ISC_LIST_INIT(contexts);
 	totallost = 0;
+#ifdef ISC_PLATFORM_USETHREADS
+	if (isc_thread_key_create(&memcache_key, memcache_threadexit) == 0)
+		memcache_ok = true;
+#endif
 }
 
 /*
@@ -941,6 +1480,10 @@ isc_mem_createx2(size_t init_max_size, size_t target_size,
 	ctx->basic_table_size = 0;
 	ctx->lowest = NULL;
 	ctx->highest = NULL;
+#ifdef ISC_PLATFORM_USETHREADS
+	ctx->usecache = (memcache_ok && (flags & ISC_MEMFLAG_NOLOCK) == 0);
+	ISC_LIST_INIT(ctx->caches);
+#endif
 
 	ctx->stats = (memalloc)(arg,
 				(ctx->max_size+1) * sizeof(struct stats));
@@ -1017,6 +1560,11 @@ static void
 destroy(isc__mem_t *ctx) {
 	unsigned int i;
 
+#ifdef ISC_PLATFORM_USETHREADS
+	if (ctx->usecache)
+		memcache_destroy(ctx);
+#endif
+
 	LOCK(&contextslock);
 	ISC_LIST_UNLINK(contexts, ctx, link);
 	totallost += ctx->inuse;
@@ -1178,6 +1726,17 @@ isc___mem_putanddetach(isc_mem_t **ctxp, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#ifdef ISC_PLATFORM_USETHREADS
+	if (memcache_cacheable(ctx, size)) {
+#if ISC_MEM_CHECKOVERRUN
+		if (ISC_UNLIKELY((ctx->flags & ISC_MEMFLAG_FILL) != 0) &&
+		    (ctx->flags & ISC_MEMFLAG_INTERNAL) != 0)
+			check_overrun(ptr, size, quantize(size));
+#endif
+		size = quantize(size);
+	}
+#endif
+
 	MCTXLOCK(ctx, &ctx->lock);
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
@@ -1239,6 +1798,14 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 			  (ISC_MEM_DEBUGSIZE|ISC_MEM_DEBUGCTX)) != 0))
 		return (isc__mem_allocate(ctx0, size FLARG_PASS));
 
+#ifdef ISC_PLATFORM_USETHREADS
+	if (memcache_cacheable(ctx, size)) {
+		size = quantize(size);
+		if (!MEMCACHE_BYPASS && memcache_get(ctx, size, &ptr))
+			return (ptr);
+	}
+#endif
+
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		MCTXLOCK(ctx, &ctx->lock);
 		ptr = mem_getunlocked(ctx, size);
@@ -1251,18 +1818,7 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 
 	ADD_TRACE(ctx, ptr, size, file, line);
 
-	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water) {
-		ctx->is_overmem = true;
-		if (!ctx->hi_called)
-			call_water = true;
-	}
-	if (ctx->inuse > ctx->maxinuse) {
-		ctx->maxinuse = ctx->inuse;
-		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
-		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
-			fprintf(stderr, "maxinuse = %lu\n",
-				(unsigned long)ctx->inuse);
-	}
+	call_water = mem_hiwater(ctx);
 	MCTXUNLOCK(ctx, &ctx->lock);
 
 	if (call_water && (ctx->water != NULL))
@@ -1295,6 +1851,20 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#ifdef ISC_PLATFORM_USETHREADS
+	if (memcache_cacheable(ctx, size)) {
+		if (!MEMCACHE_BYPASS &&
+		    memcache_put(ctx, ptr, size, quantize(size)))
+			return;
+#if ISC_MEM_CHECKOVERRUN
+		if (ISC_UNLIKELY((ctx->flags & ISC_MEMFLAG_FILL) != 0) &&
+		    (ctx->flags & ISC_MEMFLAG_INTERNAL) != 0)
+			check_overrun(ptr, size, quantize(size));
+#endif
+		size = quantize(size);
+	}
+#endif
+
 	MCTXLOCK(ctx, &ctx->lock);
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
@@ -1306,16 +1876,7 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		mem_put(ctx, ptr, size);
 	}
 
-	/*
-	 * The check against ctx->lo_water == 0 is for the condition
-	 * when the context was pushed over hi_water but then had
-	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
-	 */
-	if ((ctx->inuse < ctx->lo_water) || (ctx->lo_water == 0U)) {
-		ctx->is_overmem = false;
-		if (ctx->hi_called)
-			call_water = true;
-	}
+	call_water = mem_lowater(ctx);
 
 	MCTXUNLOCK(ctx, &ctx->lock);
 
@@ -1384,7 +1945,7 @@ isc_mem_stats(isc_mem_t *ctx0, FILE *out) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
 	size_t i;
 	const struct stats *s;
-	const isc__mempool_t *pool;
+	isc__mempool_t *pool;
 
 	REQUIRE(VALID_CONTEXT(ctx));
 	MCTXLOCK(ctx, &ctx->lock);
@@ -1436,6 +1997,13 @@ isc_mem_stats(isc_mem_t *ctx0, FILE *out) {
 			"L");
 	}
 	while (pool != NULL) {
+		unsigned int allocated = pool->allocated;
+		unsigned int freecount = pool->freecount;
+		unsigned int gets = pool->gets;
+
+		if (pool->shards != NULL)
+			mempool_sharedcounts(pool, &allocated, &freecount,
+					     &gets);
 		fprintf(out, "%15s %10lu %10u %10u %10u %10u %10u %10u %s\n",
 #if ISC_MEMPOOL_NAMES
 			pool->name,
@@ -1443,9 +2011,10 @@ isc_mem_stats(isc_mem_t *ctx0, FILE *out) {
 			"(not tracked)",
 #endif
 			(unsigned long) pool->size, pool->maxalloc,
-			pool->allocated, pool->freecount, pool->freemax,
-			pool->fillcount, pool->gets,
-			(pool->lock == NULL ? "N" : "Y"));
+			allocated, freecount, pool->freemax,
+			pool->fillcount, gets,
+			(pool->shards != NULL ? "S" :
+			 pool->lock == NULL ? "N" : "Y"));
 		pool = ISC_LIST_NEXT(pool, link);
 	}
 
@@ -1819,6 +2388,201 @@ isc_mem_gettag(isc_mem_t *ctx0) {
  * Memory pool stuff
  */
 
+/*!
+ * Refill an empty free list with 'fillcount' items from the memory
+ * context.
+ */
+static void
+mempool_fill(isc__mempool_t *mpctx, element **itemsp,
+	     unsigned int *freecountp)
+{
+	isc__mem_t *mctx = mpctx->mctx;
+	element *item;
+	unsigned int i;
+
+	MCTXLOCK(mctx, &mctx->lock);
+	for (i = 0; i < mpctx->fillcount; i++) {
+		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+			item = mem_getunlocked(mctx, mpctx->size);
+		} else {
+			item = mem_get(mctx, mpctx->size);
+			if (item != NULL)
+				mem_getstats(mctx, mpctx->size);
+		}
+		if (ISC_UNLIKELY(item == NULL))
+			break;
+		item->next = *itemsp;
+		*itemsp = item;
+		(*freecountp)++;
+	}
+	MCTXUNLOCK(mctx, &mctx->lock);
+}
+
+/*!
+ * Return a list of items to the memory context.
+ */
+static void
+mempool_release(isc__mempool_t *mpctx, element *items) {
+	isc__mem_t *mctx = mpctx->mctx;
+	element *item;
+
+	MCTXLOCK(mctx, &mctx->lock);
+	while (items != NULL) {
+		item = items;
+		items = item->next;
+
+		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+			mem_putunlocked(mctx, item, mpctx->size);
+		} else {
+			mem_putstats(mctx, item, mpctx->size);
+			mem_put(mctx, item, mpctx->size);
+		}
+	}
+	MCTXUNLOCK(mctx, &mctx->lock);
+}
+
+/*!
+ * Lock a pool's settings: its associated lock if any, or every shard of
+ * a shared pool.
+ */
+static inline void
+mempool_lock(isc__mempool_t *mpctx) {
+	unsigned int i;
+
+	if (mpctx->lock != NULL)
+		LOCK(mpctx->lock);
+	for (i = 0; i < mpctx->nshards; i++)
+		LOCK(&MPSHARD(mpctx, i)->lock);
+}
+
+static inline void
+mempool_unlock(isc__mempool_t *mpctx) {
+	unsigned int i;
+
+	for (i = mpctx->nshards; i > 0; i--)
+		UNLOCK(&MPSHARD(mpctx, i - 1)->lock);
+	if (mpctx->lock != NULL)
+		UNLOCK(mpctx->lock);
+}
+
+/*!
+ * Return the shard of a shared pool that the calling thread uses.
+ */
+static inline mpshard_t *
+mempool_shard(isc__mempool_t *mpctx) {
+#ifdef ISC_PLATFORM_USETHREADS
+	memthread_t *thread;
+
+	if (mpctx->nshards > 1U) {
+		thread = memthread_get();
+		if (ISC_LIKELY(thread != NULL))
+			return (MPSHARD(mpctx, thread->id % mpctx->nshards));
+	}
+#endif
+	return (MPSHARD(mpctx, 0));
+}
+
+/*!
+ * Sum the counters of a shared pool's shards.
+ */
+static void
+mempool_sharedcounts(isc__mempool_t *mpctx, unsigned int *allocatedp,
+		     unsigned int *freecountp, unsigned int *getsp)
+{
+	mpshard_t *shard;
+	unsigned int i, freecount = 0, gets = 0;
+	int32_t allocated = 0;
+
+	for (i = 0; i < mpctx->nshards; i++) {
+		shard = MPSHARD(mpctx, i);
+		LOCK(&shard->lock);
+		if (i == 0U)
+			allocated = MPCOUNT_ADD(&mpctx->sharedallocated, 0);
+		freecount += shard->freecount;
+		gets += shard->gets;
+		UNLOCK(&shard->lock);
+	}
+
+	if (allocatedp != NULL)
+		*allocatedp = (unsigned int)allocated;
+	if (freecountp != NULL)
+		*freecountp = freecount;
+	if (getsp != NULL)
+		*getsp = gets;
+}
+
+static void *
+mempool_getshared(isc__mempool_t *mpctx) {
+	mpshard_t *shard = mempool_shard(mpctx);
+	element *item = NULL;
+	int32_t allocated;
+
+	LOCK(&shard->lock);
+
+	/*
+	 * Don't let the caller go over quota
+	 */
+	allocated = MPCOUNT_ADD(&mpctx->sharedallocated, 1);
+	if (ISC_UNLIKELY((unsigned int)allocated >= mpctx->maxalloc))
+		goto fail;
+
+	if (ISC_UNLIKELY(shard->items == NULL))
+		mempool_fill(mpctx, &shard->items, &shard->freecount);
+
+	item = shard->items;
+	if (ISC_UNLIKELY(item == NULL))
+		goto fail;
+
+	shard->items = item->next;
+	INSIST(shard->freecount > 0);
+	shard->freecount--;
+	shard->gets++;
+	UNLOCK(&shard->lock);
+
+	return (item);
+
+ fail:
+	(void)MPCOUNT_ADD(&mpctx->sharedallocated, -1);
+	UNLOCK(&shard->lock);
+	return (NULL);
+}
+
+static void
+mempool_putshared(isc__mempool_t *mpctx, element *item) {
+	mpshard_t *shard = mempool_shard(mpctx);
+	unsigned int freemax;
+	int32_t allocated;
+
+	LOCK(&shard->lock);
+
+	/*
+	 * 'freemax' is for the pool as a whole.
+	 */
+	freemax = mpctx->freemax / mpctx->nshards;
+	if (freemax * mpctx->nshards < mpctx->freemax)
+		freemax++;
+
+	allocated = MPCOUNT_ADD(&mpctx->sharedallocated, -1);
+	INSIST(allocated > 0);
+
+	/*
+	 * If this shard's free list is full, return the item to the mctx
+	 * directly.
+	 */
+	if (shard->freecount >= freemax) {
+		UNLOCK(&shard->lock);
+		item->next = NULL;
+		mempool_release(mpctx, item);
+		return;
+	}
+
+	shard->freecount++;
+	item->next = shard->items;
+	shard->items = item;
+
+	UNLOCK(&shard->lock);
+}
+
 isc_result_t
 isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	isc__mem_t *mctx = (isc__mem_t *)mctx0;
@@ -1854,6 +2618,9 @@ isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	mpctx->freemax = 1;
 	mpctx->fillcount = 1;
 	mpctx->gets = 0;
+	mpctx->shards = NULL;
+	mpctx->nshards = 0;
+	MPCOUNT_INIT(&mpctx->sharedallocated, 0);
 #if ISC_MEMPOOL_NAMES
 	mpctx->name[0] = 0;
 #endif
@@ -1869,6 +2636,53 @@ isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+isc__mempool_createshared(isc_mem_t *mctx0, size_t size,
+			  isc_mempool_t **mpctxp)
+{
+	isc_mempool_t *mpctx0 = NULL;
+	isc__mempool_t *mpctx;
+	mpshard_t *shard;
+	unsigned int i, nshards;
+	isc_result_t result;
+
+	result = isc__mempool_create(mctx0, size, &mpctx0);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	mpctx = (isc__mempool_t *)mpctx0;
+
+	nshards = isc_os_ncpus();
+	if (nshards > MEMPOOL_MAXSHARDS)
+		nshards = MEMPOOL_MAXSHARDS;
+	if (nshards == 0U)
+		nshards = 1;
+
+	mpctx->shards = isc_mem_get(mctx0, nshards * MPSHARD_SIZE);
+	if (mpctx->shards == NULL) {
+		isc__mempool_destroy(&mpctx0);
+		return (ISC_R_NOMEMORY);
+	}
+	for (i = 0; i < nshards; i++) {
+		shard = MPSHARD(mpctx, i);
+		result = isc_mutex_init(&shard->lock);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				DESTROYLOCK(&MPSHARD(mpctx, i)->lock);
+			isc_mem_put(mctx0, mpctx->shards,
+				    nshards * MPSHARD_SIZE);
+			isc__mempool_destroy(&mpctx0);
+			return (result);
+		}
+		shard->items = NULL;
+		shard->freecount = 0;
+		shard->gets = 0;
+	}
+	mpctx->nshards = nshards;
+
+	*mpctxp = mpctx0;
+	return (ISC_R_SUCCESS);
+}
+
 void
 isc__mempool_setname(isc_mempool_t *mpctx0, const char *name) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
@@ -1877,13 +2691,11 @@ isc__mempool_setname(isc_mempool_t *mpctx0, const char *name) {
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
 #if ISC_MEMPOOL_NAMES
-	if (mpctx->lock != NULL)
-		LOCK(mpctx->lock);
+	mempool_lock(mpctx);
 
 	strlcpy(mpctx->name, name, sizeof(mpctx->name));
 
-	if (mpctx->lock != NULL)
-		UNLOCK(mpctx->lock);
+	mempool_unlock(mpctx);
 #else
 	UNUSED(mpctx);
 	UNUSED(name);
@@ -1895,19 +2707,24 @@ isc__mempool_destroy(isc_mempool_t **mpctxp) {
 	isc__mempool_t *mpctx;
 	isc__mem_t *mctx;
 	isc_mutex_t *lock;
-	element *item;
+	mpshard_t *shard;
+	unsigned int i, allocated;
 
 	REQUIRE(mpctxp != NULL);
 	mpctx = (isc__mempool_t *)*mpctxp;
 	REQUIRE(VALID_MEMPOOL(mpctx));
+
+	allocated = mpctx->allocated;
+	if (mpctx->shards != NULL)
+		mempool_sharedcounts(mpctx, &allocated, NULL, NULL);
 #if ISC_MEMPOOL_NAMES
-	if (mpctx->allocated > 0)
+	if (allocated > 0)
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc__mempool_destroy(): mempool %s "
 				 "leaked memory",
 				 mpctx->name);
 #endif
-	REQUIRE(mpctx->allocated == 0);
+	REQUIRE(allocated == 0);
 
 	mctx = mpctx->mctx;
 
@@ -1919,21 +2736,19 @@ isc__mempool_destroy(isc_mempool_t **mpctxp) {
 	/*
 	 * Return any items on the free list
 	 */
-	MCTXLOCK(mctx, &mctx->lock);
-	while (mpctx->items != NULL) {
-		INSIST(mpctx->freecount > 0);
-		mpctx->freecount--;
-		item = mpctx->items;
-		mpctx->items = item->next;
+	mempool_release(mpctx, mpctx->items);
+	mpctx->items = NULL;
+	mpctx->freecount = 0;
 
-		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-			mem_putunlocked(mctx, item, mpctx->size);
-		} else {
-			mem_putstats(mctx, item, mpctx->size);
-			mem_put(mctx, item, mpctx->size);
+	if (mpctx->shards != NULL) {
+		for (i = 0; i < mpctx->nshards; i++) {
+			shard = MPSHARD(mpctx, i);
+			mempool_release(mpctx, shard->items);
+			DESTROYLOCK(&shard->lock);
 		}
+		isc_mem_put((isc_mem_t *)mctx, mpctx->shards,
+			    mpctx->nshards * MPSHARD_SIZE);
 	}
-	MCTXUNLOCK(mctx, &mctx->lock);
 
 	/*
 	 * Remove our linked list entry from the memory context.
@@ -1960,6 +2775,7 @@ isc__mempool_associatelock(isc_mempool_t *mpctx0, isc_mutex_t *lock) {
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 	REQUIRE(mpctx->lock == NULL);
+	REQUIRE(mpctx->shards == NULL);
 	REQUIRE(lock != NULL);
 
 	mpctx->lock = lock;
@@ -1970,12 +2786,16 @@ isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
 	element *item;
 	isc__mem_t *mctx;
-	unsigned int i;
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
 	mctx = mpctx->mctx;
 
+	if (mpctx->shards != NULL) {
+		item = mempool_getshared(mpctx);
+		goto out;
+	}
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
@@ -1992,22 +2812,7 @@ isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 		 * We need to dip into the well.  Lock the memory context
 		 * here and fill up our free list.
 		 */
-		MCTXLOCK(mctx, &mctx->lock);
-		for (i = 0; i < mpctx->fillcount; i++) {
-			if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-				item = mem_getunlocked(mctx, mpctx->size);
-			} else {
-				item = mem_get(mctx, mpctx->size);
-				if (item != NULL)
-					mem_getstats(mctx, mpctx->size);
-			}
-			if (ISC_UNLIKELY(item == NULL))
-				break;
-			item->next = mpctx->items;
-			mpctx->items = item;
-			mpctx->freecount++;
-		}
-		MCTXUNLOCK(mctx, &mctx->lock);
+		mempool_fill(mpctx, &mpctx->items, &mpctx->freecount);
 	}
 
 	/*
@@ -2051,12 +2856,7 @@ isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 	REQUIRE(mem != NULL);
 
 	mctx = mpctx->mctx;
-
-	if (mpctx->lock != NULL)
-		LOCK(mpctx->lock);
-
-	INSIST(mpctx->allocated > 0);
-	mpctx->allocated--;
+	item = (element *)mem;
 
 #if ISC_MEM_TRACKLINES
 	if (ISC_UNLIKELY((isc_mem_debugging & TRACE_OR_RECORD) != 0)) {
@@ -2066,18 +2866,23 @@ isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 	}
 #endif /* ISC_MEM_TRACKLINES */
 
+	if (mpctx->shards != NULL) {
+		mempool_putshared(mpctx, item);
+		return;
+	}
+
+	if (mpctx->lock != NULL)
+		LOCK(mpctx->lock);
+
+	INSIST(mpctx->allocated > 0);
+	mpctx->allocated--;
+
 	/*
 	 * If our free list is full, return this to the mctx directly.
 	 */
 	if (mpctx->freecount >= mpctx->freemax) {
-		MCTXLOCK(mctx, &mctx->lock);
-		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-			mem_putunlocked(mctx, mem, mpctx->size);
-		} else {
-			mem_putstats(mctx, mem, mpctx->size);
-			mem_put(mctx, mem, mpctx->size);
-		}
-		MCTXUNLOCK(mctx, &mctx->lock);
+		item->next = NULL;
+		mempool_release(mpctx, item);
 		if (mpctx->lock != NULL)
 			UNLOCK(mpctx->lock);
 		return;
@@ -2087,7 +2892,6 @@ isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 	 * Otherwise, attach it to our free list and bump the counter.
 	 */
 	mpctx->freecount++;
-	item = (element *)mem;
 	item->next = mpctx->items;
 	mpctx->items = item;
 
@@ -2105,13 +2909,11 @@ isc__mempool_setfreemax(isc_mempool_t *mpctx0, unsigned int limit) {
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
-	if (mpctx->lock != NULL)
-		LOCK(mpctx->lock);
+	mempool_lock(mpctx);
 
 	mpctx->freemax = limit;
 
-	if (mpctx->lock != NULL)
-		UNLOCK(mpctx->lock);
+	mempool_unlock(mpctx);
 }
 
 unsigned int
@@ -2121,13 +2923,11 @@ isc_mempool_getfreemax(isc_mempool_t *mpctx0) {
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
-	if (mpctx->lock != NULL)
-		LOCK(mpctx->lock);
+	mempool_lock(mpctx);
 
 	freemax = mpctx->freemax;
 
-	if (mpctx->lock != NULL)
-		UNLOCK(mpctx->lock);
+	mempool_unlock(mpctx);
 
 	return (freemax);
 }
@@ -2139,6 +2939,11 @@ isc_mempool_getfreecount(isc_mempool_t *mpctx0) {
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
+	if (mpctx->shards != NULL) {
+		mempool_sharedcounts(mpctx, NULL, &freecount, NULL);
+		return (freecount);
+	}
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
@@ -2158,13 +2963,11 @@ isc__mempool_setmaxalloc(isc_mempool_t *mpctx0, unsigned int limit) {
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
-	if (mpctx->lock != NULL)
-		LOCK(mpctx->lock);
+	mempool_lock(mpctx);
 
 	mpctx->maxalloc = limit;
 
-	if (mpctx->lock != NULL)
-		UNLOCK(mpctx->lock);
+	mempool_unlock(mpctx);
 }
 
 unsigned int
@@ -2174,13 +2977,11 @@ isc_mempool_getmaxalloc(isc_mempool_t *mpctx0) {
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
-	if (mpctx->lock != NULL)
-		LOCK(mpctx->lock);
+	mempool_lock(mpctx);
 
 	maxalloc = mpctx->maxalloc;
 
-	if (mpctx->lock != NULL)
-		UNLOCK(mpctx->lock);
+	mempool_unlock(mpctx);
 
 	return (maxalloc);
 }
@@ -2192,6 +2993,11 @@ isc__mempool_getallocated(isc_mempool_t *mpctx0) {
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
+	if (mpctx->shards != NULL) {
+		mempool_sharedcounts(mpctx, &allocated, NULL, NULL);
+		return (allocated);
+	}
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
@@ -2210,13 +3016,11 @@ isc__mempool_setfillcount(isc_mempool_t *mpctx0, unsigned int limit) {
 	REQUIRE(limit > 0);
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
-	if (mpctx->lock != NULL)
-		LOCK(mpctx->lock);
+	mempool_lock(mpctx);
 
 	mpctx->fillcount = limit;
 
-	if (mpctx->lock != NULL)
-		UNLOCK(mpctx->lock);
+	mempool_unlock(mpctx);
 }
 
 unsigned int
@@ -2227,13 +3031,11 @@ isc_mempool_getfillcount(isc_mempool_t *mpctx0) {
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
-	if (mpctx->lock != NULL)
-		LOCK(mpctx->lock);
+	mempool_lock(mpctx);
 
 	fillcount = mpctx->fillcount;
 
-	if (mpctx->lock != NULL)
-		UNLOCK(mpctx->lock);
+	mempool_unlock(mpctx);
 
 	return (fillcount);
 }
@@ -2871,6 +3673,15 @@ isc_mempool_create(isc_mem_t *mctx, size_t size, isc_mempool_t **mpctxp) {
 	return (mctx->methods->mpcreate(mctx, size, mpctxp));
 }
 
+isc_result_t
+isc_mempool_createshared(isc_mem_t *mctx, size_t size,
+			 isc_mempool_t **mpctxp)
+{
+	REQUIRE(ISCAPI_MCTX_VALID(mctx));
+
+	return (mctx->methods->mpcreateshared(mctx, size, mpctxp));
+}
+
 void
 isc_mempool_destroy(isc_mempool_t **mpctxp) {
 	REQUIRE(mpctxp != NULL && ISCAPI_MPOOL_VALID(*mpctxp));
@@ -20,10 +20,14 @@
 
 #include <isc/atomic.h>
 #include <isc/magic.h>
+#include <isc/mem.h>
 #include <isc/msgs.h>
+#include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #define RWLOCK_MAGIC		ISC_MAGIC('R', 'W', 'L', 'k')
@@ -46,11 +50,39 @@
 #if defined(ISC_RWLOCK_USEATOMIC)
 static isc_result_t
 isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type);
+
+/*%
+ * Reader slots of a reader-biased lock.  Each one is padded to a cache
+ * line of its own so that readers in different slots do not share one.
+ */
+#ifndef RWLOCK_MAX_READERS
+#define RWLOCK_MAX_READERS 64
+#endif
+
+#define RWLOCK_CACHELINE 64
+
+#if defined(ISC_RWLOCK_USESTDATOMIC)
+typedef atomic_int_fast32_t rwcount_t;
+#else
+typedef int32_t rwcount_t;
+#endif
+
+struct isc_rwreader {
+	rwcount_t		count;
+	char			pad[RWLOCK_CACHELINE - sizeof(rwcount_t)];
+};
+
+static isc_once_t		rwreader_once = ISC_ONCE_INIT;
+static isc_thread_key_t		rwreader_key;
+static bool			rwreader_keyok = false;
+static rwcount_t		rwreader_nextid;
+
+static void
+rwreader_initialize(void);
 #endif
 
 #ifdef ISC_RWLOCK_TRACE
 #include <stdio.h>		/* Required for fprintf/stderr. */
-#include <isc/thread.h>		/* Required for isc_thread_self(). */
 
 static void
 print_lock(const char *operation, isc_rwlock_t *rwl, isc_rwlocktype_t type) {
@@ -122,6 +154,9 @@ isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
 	if (write_quota == 0)
 		write_quota = RWLOCK_DEFAULT_WRITE_QUOTA;
 	rwl->write_quota = write_quota;
+	rwl->mctx = NULL;
+	rwl->nreaders = 0;
+	rwl->readers = NULL;
 #else
 	rwl->type = isc_rwlocktype_read;
 	rwl->original = isc_rwlocktype_none;
@@ -174,6 +209,51 @@ isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
 	return (result);
 }
 
+isc_result_t
+isc_rwlock_initbiased(isc_rwlock_t *rwl, isc_mem_t *mctx,
+		      unsigned int read_quota, unsigned int write_quota)
+{
+	isc_result_t result;
+#if defined(ISC_RWLOCK_USEATOMIC)
+	unsigned int nreaders, i;
+#endif
+
+	REQUIRE(mctx != NULL);
+
+	result = isc_rwlock_init(rwl, read_quota, write_quota);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+#if defined(ISC_RWLOCK_USEATOMIC)
+	RUNTIME_CHECK(isc_once_do(&rwreader_once,
+				  rwreader_initialize) == ISC_R_SUCCESS);
+	/*
+	 * Without a thread key readers could not find their slot again
+	 * when unlocking; fall back to an ordinary lock.
+	 */
+	if (!rwreader_keyok)
+		return (ISC_R_SUCCESS);
+
+	nreaders = isc_os_ncpus();
+	if (nreaders > RWLOCK_MAX_READERS)
+		nreaders = RWLOCK_MAX_READERS;
+
+	rwl->readers = isc_mem_get(mctx, nreaders * sizeof(rwl->readers[0]));
+	if (rwl->readers == NULL) {
+		isc_rwlock_destroy(rwl);
+		return (ISC_R_NOMEMORY);
+	}
+	for (i = 0; i < nreaders; i++)
+		rwl->readers[i].count = 0;
+	rwl->nreaders = nreaders;
+	isc_mem_attach(mctx, &rwl->mctx);
+#else
+	UNUSED(mctx);
+#endif
+
+	return (ISC_R_SUCCESS);
+}
+
 void
 isc_rwlock_destroy(isc_rwlock_t *rwl) {
 	REQUIRE(VALID_RWLOCK(rwl));
@@ -181,6 +261,15 @@ isc_rwlock_destroy(isc_rwlock_t *rwl) {
 #if defined(ISC_RWLOCK_USEATOMIC)
 	REQUIRE(rwl->write_requests == rwl->write_completions &&
 		rwl->cnt_and_flag == 0 && rwl->readers_waiting == 0);
+	if (rwl->readers != NULL) {
+		unsigned int i;
+
+		for (i = 0; i < rwl->nreaders; i++)
+			REQUIRE(rwl->readers[i].count == 0);
+		isc_mem_putanddetach(&rwl->mctx, rwl->readers,
+				     rwl->nreaders * sizeof(rwl->readers[0]));
+		rwl->readers = NULL;
+	}
 #else
 	LOCK(&rwl->lock);
 	REQUIRE(rwl->active == 0 &&
@@ -262,6 +351,155 @@ isc_rwlock_destroy(isc_rwlock_t *rwl) {
 #define WRITER_ACTIVE	0x1
 #define READER_INCR	0x2
 
+/*
+ * Reader-biased locks.
+ *
+ * Readers of a lock created by isc_rwlock_initbiased() never touch
+ * cnt_and_flag.  Each one instead increments the counter of its own slot
+ * in 'readers' and then checks that no writer has set WRITER_ACTIVE; if
+ * one has, the reader backs out and sleeps until the writer is done.
+ * Writers queue and set WRITER_ACTIVE exactly as above, and then wait
+ * for the counters of all the slots to drop to zero.  Since both sides
+ * modify their own variable before checking the other's, with full
+ * ordering in between, either the reader sees the writer's flag or the
+ * writer sees the reader's count.
+ *
+ * Slots are assigned to threads in the order they first use such a
+ * lock, so with no more threads than slots no two readers ever share a
+ * counter.  Threads that do share one simply add up, which is harmless.
+ */
+
+static void
+rwreader_initialize(void) {
+	if (isc_thread_key_create(&rwreader_key, NULL) == 0)
+		rwreader_keyok = true;
+}
+
+static inline struct isc_rwreader *
+rwreader_slot(isc_rwlock_t *rwl) {
+	uintptr_t id;
+	void *value;
+
+	value = isc_thread_key_getspecific(rwreader_key);
+	if (ISC_UNLIKELY(value == NULL)) {
+#if defined(ISC_RWLOCK_USESTDATOMIC)
+		id = atomic_fetch_add_explicit(&rwreader_nextid, 1,
+					       memory_order_relaxed);
+#else
+		id = isc_atomic_xadd(&rwreader_nextid, 1);
+#endif
+		(void)isc_thread_key_setspecific(rwreader_key,
+						 (void *)(id + 1));
+	} else {
+		id = (uintptr_t)value - 1;
+	}
+
+	return (&rwl->readers[id % rwl->nreaders]);
+}
+
+static inline void
+rwreader_add(struct isc_rwreader *reader, int32_t delta) {
+#if defined(ISC_RWLOCK_USESTDATOMIC)
+	atomic_fetch_add_explicit(&reader->count, delta,
+				  memory_order_seq_cst);
+#else
+	(void)isc_atomic_xadd(&reader->count, delta);
+#endif
+}
+
+/*
+ * Return the number of readers currently holding (or about to back out
+ * of) the lock.  Called by a writer after it has set WRITER_ACTIVE.
+ */
+static int32_t
+rwreader_count(isc_rwlock_t *rwl) {
+	int32_t count = 0;
+	unsigned int i;
+
+#if defined(ISC_RWLOCK_USESTDATOMIC)
+	atomic_thread_fence(memory_order_seq_cst);
+#endif
+	for (i = 0; i < rwl->nreaders; i++)
+		count += rwl->readers[i].count;
+
+	return (count);
+}
+
+/*
+ * Drop a read reference, waking up any writer waiting for the readers
+ * to drain.
+ */
+static inline void
+rwreader_release(isc_rwlock_t *rwl, struct isc_rwreader *reader) {
+	rwreader_add(reader, -1);
+	if (rwl->write_requests != rwl->write_completions) {
+		LOCK(&rwl->lock);
+		BROADCAST(&rwl->writeable);
+		UNLOCK(&rwl->lock);
+	}
+}
+
+static void
+rwreader_lock(isc_rwlock_t *rwl) {
+	struct isc_rwreader *reader = rwreader_slot(rwl);
+
+	while (1) {
+		rwreader_add(reader, 1);
+		if ((rwl->cnt_and_flag & WRITER_ACTIVE) == 0)
+			break;
+
+		/* A writer is working or waiting for readers to drain. */
+		rwreader_release(rwl, reader);
+
+		LOCK(&rwl->lock);
+		rwl->readers_waiting++;
+		if ((rwl->cnt_and_flag & WRITER_ACTIVE) != 0)
+			WAIT(&rwl->readable, &rwl->lock);
+		rwl->readers_waiting--;
+		UNLOCK(&rwl->lock);
+
+		rwl->write_granted = 0;
+	}
+}
+
+/*
+ * Try to set WRITER_ACTIVE on a reader-biased lock, and fail if another
+ * writer already has.
+ */
+static inline bool
+rwreader_revoke(isc_rwlock_t *rwl) {
+#if defined(ISC_RWLOCK_USESTDATOMIC)
+	int_fast32_t zero = 0;
+	return (atomic_compare_exchange_strong_explicit
+		(&rwl->cnt_and_flag, &zero, WRITER_ACTIVE,
+		 memory_order_relaxed, memory_order_relaxed));
+#else
+	return (isc_atomic_cmpxchg(&rwl->cnt_and_flag, 0,
+				   WRITER_ACTIVE) == 0);
+#endif
+}
+
+/*
+ * Give up a WRITER_ACTIVE flag set by rwreader_revoke() when the readers
+ * did not drain, and wake up whoever backed off because of it.
+ */
+static void
+rwreader_unrevoke(isc_rwlock_t *rwl) {
+#if defined(ISC_RWLOCK_USESTDATOMIC)
+	atomic_fetch_sub_explicit(&rwl->cnt_and_flag, WRITER_ACTIVE,
+				  memory_order_relaxed);
+#else
+	(void)isc_atomic_xadd(&rwl->cnt_and_flag, -WRITER_ACTIVE);
+#endif
+
+	LOCK(&rwl->lock);
+	if (rwl->readers_waiting > 0)
+		BROADCAST(&rwl->readable);
+	if (rwl->write_requests != rwl->write_completions)
+		BROADCAST(&rwl->writeable);
+	UNLOCK(&rwl->lock);
+}
+
 static isc_result_t
 isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	int32_t cntflag;
@@ -273,7 +511,9 @@ isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 				  ISC_MSG_PRELOCK, "prelock"), rwl, type);
 #endif
 
-	if (type == isc_rwlocktype_read) {
+	if (type == isc_rwlocktype_read && rwl->readers != NULL) {
+		rwreader_lock(rwl);
+	} else if (type == isc_rwlocktype_read) {
 		if (rwl->write_requests != rwl->write_completions) {
 			/* there is a waiting or active writer */
 			LOCK(&rwl->lock);
@@ -380,6 +620,14 @@ isc__rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 			UNLOCK(&rwl->lock);
 		}
 
+		/* Wait for the readers of a reader-biased lock to drain. */
+		while (rwl->readers != NULL && rwreader_count(rwl) != 0) {
+			LOCK(&rwl->lock);
+			if (rwreader_count(rwl) != 0)
+				WAIT(&rwl->writeable, &rwl->lock);
+			UNLOCK(&rwl->lock);
+		}
+
 		INSIST((rwl->cnt_and_flag & WRITER_ACTIVE) != 0);
 		rwl->write_granted++;
 	}
@@ -398,6 +646,13 @@ isc_rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	int32_t max_cnt = rwl->spins * 2 + 10;
 	isc_result_t result = ISC_R_SUCCESS;
 
+	/*
+	 * Spinning on trylock would have a writer repeatedly revoke and
+	 * restore the read bias, so reader-biased locks block at once.
+	 */
+	if (rwl->readers != NULL)
+		return (isc__rwlock_lock(rwl, type));
+
 	if (max_cnt > RWLOCK_MAX_ADAPTIVE_COUNT)
 		max_cnt = RWLOCK_MAX_ADAPTIVE_COUNT;
 
@@ -427,7 +682,15 @@ isc_rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 				  ISC_MSG_PRELOCK, "prelock"), rwl, type);
 #endif
 
-	if (type == isc_rwlocktype_read) {
+	if (type == isc_rwlocktype_read && rwl->readers != NULL) {
+		struct isc_rwreader *reader = rwreader_slot(rwl);
+
+		rwreader_add(reader, 1);
+		if ((rwl->cnt_and_flag & WRITER_ACTIVE) != 0) {
+			rwreader_release(rwl, reader);
+			return (ISC_R_LOCKBUSY);
+		}
+	} else if (type == isc_rwlocktype_read) {
 		/* If a writer is waiting or working, we fail. */
 		if (rwl->write_requests != rwl->write_completions)
 			return (ISC_R_LOCKBUSY);
@@ -481,6 +744,11 @@ isc_rwlock_trylock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 			return (ISC_R_LOCKBUSY);
 #endif
 
+		if (rwl->readers != NULL && rwreader_count(rwl) != 0) {
+			rwreader_unrevoke(rwl);
+			return (ISC_R_LOCKBUSY);
+		}
+
 		/*
 		 * XXXJT: jump into the queue, possibly breaking the writer
 		 * order.
@@ -507,6 +775,28 @@ isc_result_t
 isc_rwlock_tryupgrade(isc_rwlock_t *rwl) {
 	REQUIRE(VALID_RWLOCK(rwl));
 
+	if (rwl->readers != NULL) {
+		struct isc_rwreader *reader = rwreader_slot(rwl);
+
+		if (!rwreader_revoke(rwl))
+			return (ISC_R_LOCKBUSY);
+		/*
+		 * Upgrade only if we are the sole reader.
+		 */
+		if (rwreader_count(rwl) != 1) {
+			rwreader_unrevoke(rwl);
+			return (ISC_R_LOCKBUSY);
+		}
+		rwreader_add(reader, -1);
+#if defined(ISC_RWLOCK_USESTDATOMIC)
+		atomic_fetch_sub_explicit(&rwl->write_completions, 1,
+					  memory_order_relaxed);
+#else
+		(void)isc_atomic_xadd(&rwl->write_completions, -1);
+#endif
+		return (ISC_R_SUCCESS);
+	}
+
 #if defined(ISC_RWLOCK_USESTDATOMIC)
 	{
 		int_fast32_t reader_incr = READER_INCR;
@@ -568,7 +858,17 @@ isc_rwlock_downgrade(isc_rwlock_t *rwl) {
 	REQUIRE(VALID_RWLOCK(rwl));
 
 #if defined(ISC_RWLOCK_USESTDATOMIC)
-	{
+	if (rwl->readers != NULL) {
+		/* We must have been a writer. */
+		INSIST((rwl->cnt_and_flag & WRITER_ACTIVE) != 0);
+
+		/* Become an active reader, then complete write. */
+		rwreader_add(rwreader_slot(rwl), 1);
+		atomic_fetch_sub_explicit(&rwl->cnt_and_flag, WRITER_ACTIVE,
+					  memory_order_relaxed);
+		atomic_fetch_add_explicit(&rwl->write_completions, 1,
+					  memory_order_relaxed);
+	} else {
 		/* Become an active reader. */
 		prev_readers = atomic_fetch_add_explicit(&rwl->cnt_and_flag,
 							 READER_INCR,
@@ -583,7 +883,15 @@ isc_rwlock_downgrade(isc_rwlock_t *rwl) {
 					  memory_order_relaxed);
 	}
 #else
-	{
+	if (rwl->readers != NULL) {
+		/* We must have been a writer. */
+		INSIST((rwl->cnt_and_flag & WRITER_ACTIVE) != 0);
+
+		/* Become an active reader, then complete write. */
+		rwreader_add(rwreader_slot(rwl), 1);
+		(void)isc_atomic_xadd(&rwl->cnt_and_flag, -WRITER_ACTIVE);
+		(void)isc_atomic_xadd(&rwl->write_completions, 1);
+	} else {
 		/* Become an active reader. */
 		prev_readers = isc_atomic_xadd(&rwl->cnt_and_flag, READER_INCR);
 		/* We must have been a writer. */
@@ -613,7 +921,9 @@ isc_rwlock_unlock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 				  ISC_MSG_PREUNLOCK, "preunlock"), rwl, type);
 #endif
 
-	if (type == isc_rwlocktype_read) {
+	if (type == isc_rwlocktype_read && rwl->readers != NULL) {
+		rwreader_release(rwl, rwreader_slot(rwl));
+	} else if (type == isc_rwlocktype_read) {
 #if defined(ISC_RWLOCK_USESTDATOMIC)
 		prev_cnt = atomic_fetch_sub_explicit(&rwl->cnt_and_flag,
 						     READER_INCR,
@@ -910,6 +1220,17 @@ isc_rwlock_init(isc_rwlock_t *rwl, unsigned int read_quota,
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+isc_rwlock_initbiased(isc_rwlock_t *rwl, isc_mem_t *mctx,
+		      unsigned int read_quota, unsigned int write_quota)
+{
+	REQUIRE(mctx != NULL);
+
+	UNUSED(mctx);
+
+	return (isc_rwlock_init(rwl, read_quota, write_quota));
+}
+
 isc_result_t
 isc_rwlock_lock(isc_rwlock_t *rwl, isc_rwlocktype_t type) {
 	REQUIRE(VALID_RWLOCK(rwl));
@@ -18,6 +18,7 @@
 
 #include <config.h>
 
+#include <inttypes.h>
 #include <stdbool.h>
 
 #include <isc/app.h>
@@ -92,11 +93,13 @@ static const char *statenames[] = {
 
 typedef struct isc__task isc__task_t;
 typedef struct isc__taskmgr isc__taskmgr_t;
+typedef struct isc__taskqueue isc__taskqueue_t;
 
 struct isc__task {
 	/* Not locked. */
 	isc_task_t			common;
 	isc__taskmgr_t *		manager;
+	unsigned int			threadid;
 	isc_mutex_t			lock;
 	/* Locked by task lock. */
 	task_state_t			state;
@@ -112,6 +115,7 @@ struct isc__task {
 	void *				tag;
 	/* Locked by task manager lock. */
 	LINK(isc__task_t)		link;
+	/* Locked by the lock of the ready queue 'threadid'. */
 	LINK(isc__task_t)		ready_link;
 	LINK(isc__task_t)		ready_priority_link;
 };
@@ -127,6 +131,32 @@ struct isc__task {
 
 typedef ISC_LIST(isc__task_t)	isc__tasklist_t;
 
+/*%
+ * Each worker thread has its own ready queues.  A task is always queued
+ * on the queue of the worker it was assigned to when it was created,
+ * and normally runs there; a worker with nothing to do takes ready
+ * tasks from the other workers' queues.
+ */
+struct isc__taskqueue {
+	/* Not locked. */
+	isc__taskmgr_t *		manager;
+	unsigned int			threadid;
+	isc_mutex_t			lock;
+	/* Locked by queue lock. */
+	isc__tasklist_t			ready_tasks;
+	isc__tasklist_t			ready_priority_tasks;
+	unsigned int			tasks_ready;
+	unsigned int			tasks_running;
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_condition_t			work_available;
+	bool				idle;
+#endif /* ISC_PLATFORM_USETHREADS */
+	/* Statistics, locked by queue lock. */
+	uint64_t			executed;
+	uint64_t			stolen;
+	unsigned int			maxready;
+};
+
 struct isc__taskmgr {
 	/* Not locked. */
 	isc_taskmgr_t			common;
@@ -136,22 +166,26 @@ struct isc__taskmgr {
 	unsigned int			workers;
 	isc_thread_t *			threads;
 #endif /* ISC_PLATFORM_USETHREADS */
+	unsigned int			nqueues;
+	unsigned int			maxqueues;
+	isc__taskqueue_t *		queues;
 	/* Locked by task manager lock. */
 	unsigned int			default_quantum;
+	unsigned int			nextqueue;
 	LIST(isc__task_t)		tasks;
-	isc__tasklist_t			ready_tasks;
-	isc__tasklist_t			ready_priority_tasks;
-	isc_taskmgrmode_t		mode;
 #ifdef ISC_PLATFORM_USETHREADS
-	isc_condition_t			work_available;
 	isc_condition_t			exclusive_granted;
 	isc_condition_t			paused;
 #endif /* ISC_PLATFORM_USETHREADS */
-	unsigned int			tasks_running;
-	unsigned int			tasks_ready;
+	bool			exiting;
+	/*
+	 * Written with the task manager lock and all queue locks held,
+	 * so that workers can read them holding only their own queue lock.
+	 */
+	isc_taskmgrmode_t		mode;
 	bool			pause_requested;
 	bool			exclusive_requested;
-	bool			exiting;
+	bool			finished;
 
 	/*
 	 * Multiple threads can read/write 'excl' at the same time, so we need
@@ -245,13 +279,27 @@ isc_taskmgrmode_t
 isc__taskmgr_mode(isc_taskmgr_t *manager0);
 
 static inline bool
-empty_readyq(isc__taskmgr_t *manager);
+empty_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
 
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager);
+pop_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
 
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task);
+push_readyq(isc__taskqueue_t *queue, isc__task_t *task);
+
+static void
+lock_queues(isc__taskmgr_t *manager);
+
+static void
+unlock_queues(isc__taskmgr_t *manager);
+
+#ifdef USE_WORKER_THREADS
+static void
+wakeup_queues(isc__taskmgr_t *manager);
+
+static void
+wakeup_idle(isc__taskmgr_t *manager, isc__taskqueue_t *queue);
+#endif /* USE_WORKER_THREADS */
 
 static struct isc__taskmethods {
 	isc_taskmethods_t methods;
@@ -314,7 +362,6 @@ task_finished(isc__task_t *task) {
 
 	LOCK(&manager->lock);
 	UNLINK(manager->tasks, task, link);
-#ifdef USE_WORKER_THREADS
 	if (FINISHED(manager)) {
 		/*
 		 * All tasks have completed and the
@@ -322,9 +369,13 @@ task_finished(isc__task_t *task) {
 		 * any idle worker threads so they
 		 * can exit.
 		 */
-		BROADCAST(&manager->work_available);
-	}
+		lock_queues(manager);
+		manager->finished = true;
+#ifdef USE_WORKER_THREADS
+		wakeup_queues(manager);
 #endif /* USE_WORKER_THREADS */
+		unlock_queues(manager);
+	}
 	UNLOCK(&manager->lock);
 
 	DESTROYLOCK(&task->lock);
@@ -375,6 +426,7 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	if (!manager->exiting) {
 		if (task->quantum == 0)
 			task->quantum = manager->default_quantum;
+		task->threadid = manager->nextqueue++ % manager->nqueues;
 		APPEND(manager->tasks, task, link);
 	} else
 		exiting = true;
@@ -461,8 +513,10 @@ task_shutdown(isc__task_t *task) {
 static inline void
 task_ready(isc__task_t *task) {
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue;
 #ifdef USE_WORKER_THREADS
 	bool has_privilege = isc__task_privilege((isc_task_t *) task);
+	bool wakeup_other = false;
 #endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
@@ -470,13 +524,26 @@ task_ready(isc__task_t *task) {
 
 	XTRACE("task_ready");
 
-	LOCK(&manager->lock);
-	push_readyq(manager, task);
+	queue = &manager->queues[task->threadid];
+	LOCK(&queue->lock);
+	push_readyq(queue, task);
 #ifdef USE_WORKER_THREADS
-	if (manager->mode == isc_taskmgrmode_normal || has_privilege)
-		SIGNAL(&manager->work_available);
+	if (manager->mode == isc_taskmgrmode_normal || has_privilege) {
+		if (queue->idle)
+			SIGNAL(&queue->work_available);
+		else
+			wakeup_other = true;
+	}
+#endif /* USE_WORKER_THREADS */
+	UNLOCK(&queue->lock);
+
+#ifdef USE_WORKER_THREADS
+	/*
+	 * The queue's own worker is busy; let an idle one steal the task.
+	 */
+	if (wakeup_other)
+		wakeup_idle(manager, queue);
 #endif /* USE_WORKER_THREADS */
-	UNLOCK(&manager->lock);
 }
 
 static inline bool
@@ -938,46 +1005,47 @@ isc__task_getcurrenttimex(isc_task_t *task0, isc_time_t *t) {
  ***/
 
 /*
- * Return true if the current ready list for the manager, which is
+ * Return true if the current ready list for 'queue', which is
  * either ready_tasks or the ready_priority_tasks, depending on whether
  * the manager is currently in normal or privileged execution mode.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline bool
-empty_readyq(isc__taskmgr_t *manager) {
-	isc__tasklist_t queue;
+empty_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__tasklist_t tasks;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		queue = manager->ready_tasks;
+		tasks = queue->ready_tasks;
 	else
-		queue = manager->ready_priority_tasks;
+		tasks = queue->ready_priority_tasks;
 
-	return (EMPTY(queue));
+	return (EMPTY(tasks));
 }
 
 /*
  * Dequeue and return a pointer to the first task on the current ready
- * list for the manager.
+ * list of 'queue'.
  * If the task is privileged, dequeue it from the other ready list
  * as well.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline isc__task_t *
-pop_readyq(isc__taskmgr_t *manager) {
+pop_readyq(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
 	isc__task_t *task;
 
 	if (manager->mode == isc_taskmgrmode_normal)
-		task = HEAD(manager->ready_tasks);
+		task = HEAD(queue->ready_tasks);
 	else
-		task = HEAD(manager->ready_priority_tasks);
+		task = HEAD(queue->ready_priority_tasks);
 
 	if (task != NULL) {
-		DEQUEUE(manager->ready_tasks, task, ready_link);
+		DEQUEUE(queue->ready_tasks, task, ready_link);
 		if (ISC_LINK_LINKED(task, ready_priority_link))
-			DEQUEUE(manager->ready_priority_tasks, task,
+			DEQUEUE(queue->ready_priority_tasks, task,
 				ready_priority_link);
+		queue->tasks_ready--;
 	}
 
 	return (task);
@@ -987,26 +1055,420 @@ pop_readyq(isc__taskmgr_t *manager) {
  * Push 'task' onto the ready_tasks queue.  If 'task' has the privilege
  * flag set, then also push it onto the ready_priority_tasks queue.
  *
- * Caller must hold the task manager lock.
+ * Caller must hold the queue lock.
  */
 static inline void
-push_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
-	ENQUEUE(manager->ready_tasks, task, ready_link);
+push_readyq(isc__taskqueue_t *queue, isc__task_t *task) {
+	ENQUEUE(queue->ready_tasks, task, ready_link);
 	if ((task->flags & TASK_F_PRIVILEGED) != 0)
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	manager->tasks_ready++;
+	queue->tasks_ready++;
+	if (queue->tasks_ready > queue->maxready)
+		queue->maxready = queue->tasks_ready;
+}
+
+/*
+ * Lock (unlock) all the ready queues, in order.
+ *
+ * Caller must hold the task manager lock.
+ */
+static void
+lock_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++)
+		LOCK(&manager->queues[i].lock);
+}
+
+static void
+unlock_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = manager->nqueues; i > 0; i--)
+		UNLOCK(&manager->queues[i - 1].lock);
+}
+
+/*
+ * Return the number of tasks currently being run by any worker.
+ *
+ * Caller must hold the task manager lock, and no queue lock.
+ */
+static unsigned int
+count_running(isc__taskmgr_t *manager) {
+	unsigned int i, running = 0;
+
+	for (i = 0; i < manager->nqueues; i++) {
+		LOCK(&manager->queues[i].lock);
+		running += manager->queues[i].tasks_running;
+		UNLOCK(&manager->queues[i].lock);
+	}
+
+	return (running);
+}
+
+#ifdef USE_WORKER_THREADS
+/*
+ * Wake up every worker.
+ *
+ * Caller must hold all the queue locks.
+ */
+static void
+wakeup_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++)
+		BROADCAST(&manager->queues[i].work_available);
+}
+
+/*
+ * Wake up one idle worker other than the owner of 'queue', so that it
+ * can steal work from 'queue'.  The idle flags are checked without
+ * locking first; a wakeup missed here only means the task waits for
+ * its own worker.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+wakeup_idle(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__taskqueue_t *q;
+	unsigned int i, n = manager->nqueues;
+	bool found = false;
+
+	for (i = 1; i < n && !found; i++) {
+		q = &manager->queues[(queue->threadid + i) % n];
+		if (!q->idle)
+			continue;
+		LOCK(&q->lock);
+		if (q->idle) {
+			q->idle = false;
+			SIGNAL(&q->work_available);
+			found = true;
+		}
+		UNLOCK(&q->lock);
+	}
+}
+
+/*
+ * Take a ready task from another worker's queue, or return NULL if
+ * there is none.  The task is accounted as running on its own queue.
+ *
+ * Caller must not hold any queue lock.
+ */
+static isc__task_t *
+steal_task(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__taskqueue_t *victim;
+	isc__task_t *task = NULL;
+	unsigned int i, n = manager->nqueues;
+
+	for (i = 1; i < n && task == NULL; i++) {
+		victim = &manager->queues[(queue->threadid + i) % n];
+		if (victim->tasks_ready == 0)
+			continue;
+		LOCK(&victim->lock);
+		if (!manager->pause_requested &&
+		    !manager->exclusive_requested)
+		{
+			task = pop_readyq(manager, victim);
+			if (task != NULL) {
+				victim->tasks_running++;
+				victim->stolen++;
+			}
+		}
+		UNLOCK(&victim->lock);
+	}
+
+	return (task);
+}
+
+/*
+ * If we are in privileged execution mode and there are no tasks
+ * remaining on any privileged ready queue, then we're stuck.
+ * Automatically drop privileges at that point and continue with the
+ * regular ready queues.
+ *
+ * Caller must not hold any queue lock.
+ */
+static void
+check_privilege_drop(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *q;
+	unsigned int i;
+
+	LOCK(&manager->lock);
+	lock_queues(manager);
+	if (manager->mode != isc_taskmgrmode_normal) {
+		for (i = 0; i < manager->nqueues; i++) {
+			q = &manager->queues[i];
+			if (q->tasks_running != 0 ||
+			    !EMPTY(q->ready_priority_tasks))
+				break;
+		}
+		if (i == manager->nqueues) {
+			manager->mode = isc_taskmgrmode_normal;
+			wakeup_queues(manager);
+		}
+	}
+	unlock_queues(manager);
+	UNLOCK(&manager->lock);
+}
+#endif /* USE_WORKER_THREADS */
+
+/*
+ * Run the events of 'task', up to its quantum.  Returns the number of
+ * events dispatched; '*requeuep' is set if the task has to go back on
+ * the ready queue, and '*finishedp' if the task is done.
+ */
+static unsigned int
+run_task(isc__task_t *task, bool *requeuep, bool *finishedp) {
+	unsigned int dispatch_count = 0;
+	bool done = false;
+	bool requeue = false;
+	bool finished = false;
+	isc_event_t *event;
+
+	LOCK(&task->lock);
+	INSIST(task->state == task_state_ready);
+	task->state = task_state_running;
+	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+			      ISC_MSG_RUNNING, "running"));
+	TIME_NOW(&task->tnow);
+	task->now = isc_time_seconds(&task->tnow);
+	do {
+		if (!EMPTY(task->events)) {
+			event = HEAD(task->events);
+			DEQUEUE(task->events, event, ev_link);
+			task->nevents--;
+
+			/*
+			 * Execute the event action.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					    ISC_MSGSET_TASK,
+					    ISC_MSG_EXECUTE,
+					    "execute action"));
+			if (event->ev_action != NULL) {
+				UNLOCK(&task->lock);
+				(event->ev_action)(
+					(isc_task_t *)task,
+					event);
+				LOCK(&task->lock);
+			}
+			dispatch_count++;
+		}
+
+		if (task->references == 0 &&
+		    EMPTY(task->events) &&
+		    !TASK_SHUTTINGDOWN(task)) {
+			bool was_idle;
+
+			/*
+			 * There are no references and no
+			 * pending events for this task,
+			 * which means it will not become
+			 * runnable again via an external
+			 * action (such as sending an event
+			 * or detaching).
+			 *
+			 * We initiate shutdown to prevent
+			 * it from becoming a zombie.
+			 *
+			 * We do this here instead of in
+			 * the "if EMPTY(task->events)" block
+			 * below because:
+			 *
+			 *	If we post no shutdown events,
+			 *	we want the task to finish.
+			 *
+			 *	If we did post shutdown events,
+			 *	will still want the task's
+			 *	quantum to be applied.
+			 */
+			was_idle = task_shutdown(task);
+			INSIST(!was_idle);
+		}
+
+		if (EMPTY(task->events)) {
+			/*
+			 * Nothing else to do for this task
+			 * right now.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_EMPTY,
+					      "empty"));
+			if (task->references == 0 &&
+			    TASK_SHUTTINGDOWN(task)) {
+				/*
+				 * The task is done.
+				 */
+				XTRACE(isc_msgcat_get(
+					       isc_msgcat,
+					       ISC_MSGSET_TASK,
+					       ISC_MSG_DONE,
+					       "done"));
+				finished = true;
+				task->state = task_state_done;
+			} else
+				task->state = task_state_idle;
+			done = true;
+		} else if (dispatch_count >= task->quantum) {
+			/*
+			 * Our quantum has expired, but
+			 * there is more work to be done.
+			 * We'll requeue it to the ready
+			 * queue later.
+			 *
+			 * We don't check quantum until
+			 * dispatching at least one event,
+			 * so the minimum quantum is one.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat,
+					      ISC_MSGSET_TASK,
+					      ISC_MSG_QUANTUM,
+					      "quantum"));
+			task->state = task_state_ready;
+			requeue = true;
+			done = true;
+		}
+	} while (!done);
+	UNLOCK(&task->lock);
+
+	*requeuep = requeue;
+	*finishedp = finished;
+	return (dispatch_count);
 }
 
+#ifdef USE_WORKER_THREADS
+/*
+ * The worker loop.  Tasks are taken from the worker's own 'queue'
+ * first, then from the other workers' queues.
+ */
 static void
-dispatch(isc__taskmgr_t *manager) {
+dispatch(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
+	isc__taskqueue_t *taskq;
+	isc__task_t *task;
+
+	REQUIRE(VALID_MANAGER(manager));
+
+	/*
+	 * The queue lock is held when the loop condition is tested; see
+	 * the comment in the non-threaded dispatch() below about why.
+	 */
+	LOCK(&queue->lock);
+	while (!manager->finished) {
+		bool wakeup_other = false;
+		bool privileged;
+		bool halted;
+		bool requeue, finished;
+
+		/*
+		 * For reasons similar to those given in the comment in
+		 * isc_task_send() above, it is safe for us to dequeue
+		 * the task while only holding the queue lock, and then
+		 * change the task to running state while only holding the
+		 * task lock.
+		 *
+		 * If a pause has been requested, don't do any work
+		 * until it's been released.
+		 */
+		task = NULL;
+		privileged = (manager->mode != isc_taskmgrmode_normal);
+		halted = (manager->pause_requested ||
+			  manager->exclusive_requested);
+		if (!halted) {
+			task = pop_readyq(manager, queue);
+			if (task != NULL) {
+				queue->tasks_running++;
+				wakeup_other = !empty_readyq(manager, queue);
+			}
+		}
+		UNLOCK(&queue->lock);
+
+		if (task == NULL && !halted)
+			task = steal_task(manager, queue);
+		else if (wakeup_other)
+			wakeup_idle(manager, queue);
+
+		if (task == NULL) {
+			if (privileged && !halted)
+				check_privilege_drop(manager);
+
+			/*
+			 * Our queue may have been refilled while it was
+			 * unlocked; only sleep if it is still empty.
+			 */
+			LOCK(&queue->lock);
+			if (!manager->finished &&
+			    (manager->pause_requested ||
+			     manager->exclusive_requested ||
+			     empty_readyq(manager, queue)))
+			{
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_GENERAL,
+							    ISC_MSG_WAIT,
+							    "wait"));
+				queue->idle = true;
+				WAIT(&queue->work_available, &queue->lock);
+				queue->idle = false;
+				XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+							    ISC_MSGSET_TASK,
+							    ISC_MSG_AWAKE,
+							    "awake"));
+			}
+			continue;
+		}
+
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					    ISC_MSG_WORKING, "working"));
+		INSIST(VALID_TASK(task));
+
+		/*
+		 * The task is accounted as running on its own queue,
+		 * which isn't ours if it was stolen.  Look it up now, as
+		 * a finished task is freed.
+		 */
+		taskq = &manager->queues[task->threadid];
+
+		(void)run_task(task, &requeue, &finished);
+		if (finished)
+			task_finished(task);
+
+		LOCK(&taskq->lock);
+		taskq->tasks_running--;
+		taskq->executed++;
+		halted = (manager->pause_requested ||
+			  manager->exclusive_requested);
+		if (requeue) {
+			/*
+			 * We know we're awake, so we don't have to wake
+			 * up any sleeping threads: if nobody else gets
+			 * to the task first, we will.
+			 */
+			push_readyq(taskq, task);
+		}
+		UNLOCK(&taskq->lock);
+
+		if (halted) {
+			LOCK(&manager->lock);
+			if (manager->exclusive_requested)
+				SIGNAL(&manager->exclusive_granted);
+			if (manager->pause_requested)
+				SIGNAL(&manager->paused);
+			UNLOCK(&manager->lock);
+		}
+
+		LOCK(&queue->lock);
+	}
+	UNLOCK(&queue->lock);
+}
+#else /* USE_WORKER_THREADS */
+static void
+dispatch(isc__taskmgr_t *manager, isc__taskqueue_t *queue) {
 	isc__task_t *task;
-#ifndef USE_WORKER_THREADS
 	unsigned int total_dispatch_count = 0;
 	isc__tasklist_t new_ready_tasks;
 	isc__tasklist_t new_priority_tasks;
 	unsigned int tasks_ready = 0;
-#endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
 
@@ -1060,244 +1522,65 @@ dispatch(isc__taskmgr_t *manager) {
 	 * unlocks.  The while expression is always protected by the lock.
 	 */
 
-#ifndef USE_WORKER_THREADS
 	ISC_LIST_INIT(new_ready_tasks);
 	ISC_LIST_INIT(new_priority_tasks);
-#endif
-	LOCK(&manager->lock);
+	LOCK(&queue->lock);
 
-	while (!FINISHED(manager)) {
-#ifdef USE_WORKER_THREADS
-		/*
-		 * For reasons similar to those given in the comment in
-		 * isc_task_send() above, it is safe for us to dequeue
-		 * the task while only holding the manager lock, and then
-		 * change the task to running state while only holding the
-		 * task lock.
-		 *
-		 * If a pause has been requested, don't do any work
-		 * until it's been released.
-		 */
-		while ((empty_readyq(manager) || manager->pause_requested ||
-			manager->exclusive_requested) && !FINISHED(manager))
-		{
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_GENERAL,
-						    ISC_MSG_WAIT, "wait"));
-			WAIT(&manager->work_available, &manager->lock);
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_TASK,
-						    ISC_MSG_AWAKE, "awake"));
-		}
-#else /* USE_WORKER_THREADS */
+	while (!manager->finished) {
 		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
-		    empty_readyq(manager))
+		    empty_readyq(manager, queue))
 			break;
-#endif /* USE_WORKER_THREADS */
 		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
 					    ISC_MSG_WORKING, "working"));
 
-		task = pop_readyq(manager);
+		task = pop_readyq(manager, queue);
 		if (task != NULL) {
-			unsigned int dispatch_count = 0;
-			bool done = false;
-			bool requeue = false;
-			bool finished = false;
-			isc_event_t *event;
+			bool requeue, finished;
 
 			INSIST(VALID_TASK(task));
 
 			/*
-			 * Note we only unlock the manager lock if we actually
-			 * have a task to do.  We must reacquire the manager
+			 * Note we only unlock the queue lock if we actually
+			 * have a task to do.  We must reacquire the queue
 			 * lock before exiting the 'if (task != NULL)' block.
 			 */
-			manager->tasks_ready--;
-			manager->tasks_running++;
-			UNLOCK(&manager->lock);
-
-			LOCK(&task->lock);
-			INSIST(task->state == task_state_ready);
-			task->state = task_state_running;
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-					      ISC_MSG_RUNNING, "running"));
-			TIME_NOW(&task->tnow);
-			task->now = isc_time_seconds(&task->tnow);
-			do {
-				if (!EMPTY(task->events)) {
-					event = HEAD(task->events);
-					DEQUEUE(task->events, event, ev_link);
-					task->nevents--;
-
-					/*
-					 * Execute the event action.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							    ISC_MSGSET_TASK,
-							    ISC_MSG_EXECUTE,
-							    "execute action"));
-					if (event->ev_action != NULL) {
-						UNLOCK(&task->lock);
-						(event->ev_action)(
-							(isc_task_t *)task,
-							event);
-						LOCK(&task->lock);
-					}
-					dispatch_count++;
-#ifndef USE_WORKER_THREADS
-					total_dispatch_count++;
-#endif /* USE_WORKER_THREADS */
-				}
-
-				if (task->references == 0 &&
-				    EMPTY(task->events) &&
-				    !TASK_SHUTTINGDOWN(task)) {
-					bool was_idle;
-
-					/*
-					 * There are no references and no
-					 * pending events for this task,
-					 * which means it will not become
-					 * runnable again via an external
-					 * action (such as sending an event
-					 * or detaching).
-					 *
-					 * We initiate shutdown to prevent
-					 * it from becoming a zombie.
-					 *
-					 * We do this here instead of in
-					 * the "if EMPTY(task->events)" block
-					 * below because:
-					 *
-					 *	If we post no shutdown events,
-					 *	we want the task to finish.
-					 *
-					 *	If we did post shutdown events,
-					 *	will still want the task's
-					 *	quantum to be applied.
-					 */
-					was_idle = task_shutdown(task);
-					INSIST(!was_idle);
-				}
-
-				if (EMPTY(task->events)) {
-					/*
-					 * Nothing else to do for this task
-					 * right now.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_EMPTY,
-							      "empty"));
-					if (task->references == 0 &&
-					    TASK_SHUTTINGDOWN(task)) {
-						/*
-						 * The task is done.
-						 */
-						XTRACE(isc_msgcat_get(
-							       isc_msgcat,
-							       ISC_MSGSET_TASK,
-							       ISC_MSG_DONE,
-							       "done"));
-						finished = true;
-						task->state = task_state_done;
-					} else
-						task->state = task_state_idle;
-					done = true;
-				} else if (dispatch_count >= task->quantum) {
-					/*
-					 * Our quantum has expired, but
-					 * there is more work to be done.
-					 * We'll requeue it to the ready
-					 * queue later.
-					 *
-					 * We don't check quantum until
-					 * dispatching at least one event,
-					 * so the minimum quantum is one.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_QUANTUM,
-							      "quantum"));
-					task->state = task_state_ready;
-					requeue = true;
-					done = true;
-				}
-			} while (!done);
-			UNLOCK(&task->lock);
+			queue->tasks_running++;
+			UNLOCK(&queue->lock);
 
+			total_dispatch_count += run_task(task, &requeue,
+							 &finished);
 			if (finished)
 				task_finished(task);
 
-			LOCK(&manager->lock);
-			manager->tasks_running--;
-#ifdef USE_WORKER_THREADS
-			if (manager->exclusive_requested &&
-			    manager->tasks_running == 1) {
-				SIGNAL(&manager->exclusive_granted);
-			} else if (manager->pause_requested &&
-				   manager->tasks_running == 0) {
-				SIGNAL(&manager->paused);
-			}
-#endif /* USE_WORKER_THREADS */
+			LOCK(&queue->lock);
+			queue->tasks_running--;
+			queue->executed++;
 			if (requeue) {
-				/*
-				 * We know we're awake, so we don't have
-				 * to wakeup any sleeping threads if the
-				 * ready queue is empty before we requeue.
-				 *
-				 * A possible optimization if the queue is
-				 * empty is to 'goto' the 'if (task != NULL)'
-				 * block, avoiding the ENQUEUE of the task
-				 * and the subsequent immediate DEQUEUE
-				 * (since it is the only executable task).
-				 * We don't do this because then we'd be
-				 * skipping the exit_requested check.  The
-				 * cost of ENQUEUE is low anyway, especially
-				 * when you consider that we'd have to do
-				 * an extra EMPTY check to see if we could
-				 * do the optimization.  If the ready queue
-				 * were usually nonempty, the 'optimization'
-				 * might even hurt rather than help.
-				 */
-#ifdef USE_WORKER_THREADS
-				push_readyq(manager, task);
-#else
 				ENQUEUE(new_ready_tasks, task, ready_link);
 				if ((task->flags & TASK_F_PRIVILEGED) != 0)
 					ENQUEUE(new_priority_tasks, task,
 						ready_priority_link);
 				tasks_ready++;
-#endif
 			}
 		}
-
-#ifdef USE_WORKER_THREADS
-		/*
-		 * If we are in privileged execution mode and there are no
-		 * tasks remaining on the current ready queue, then
-		 * we're stuck.  Automatically drop privileges at that
-		 * point and continue with the regular ready queue.
-		 */
-		if (manager->tasks_running == 0 && empty_readyq(manager)) {
-			manager->mode = isc_taskmgrmode_normal;
-			if (!empty_readyq(manager))
-				BROADCAST(&manager->work_available);
-		}
-#endif
 	}
 
-#ifndef USE_WORKER_THREADS
-	ISC_LIST_APPENDLIST(manager->ready_tasks, new_ready_tasks, ready_link);
-	ISC_LIST_APPENDLIST(manager->ready_priority_tasks, new_priority_tasks,
+	ISC_LIST_APPENDLIST(queue->ready_tasks, new_ready_tasks, ready_link);
+	ISC_LIST_APPENDLIST(queue->ready_priority_tasks, new_priority_tasks,
 			    ready_priority_link);
-	manager->tasks_ready += tasks_ready;
-	if (empty_readyq(manager))
-		manager->mode = isc_taskmgrmode_normal;
-#endif
+	queue->tasks_ready += tasks_ready;
+	if (queue->tasks_ready > queue->maxready)
+		queue->maxready = queue->tasks_ready;
+	UNLOCK(&queue->lock);
 
+	LOCK(&manager->lock);
+	lock_queues(manager);
+	if (empty_readyq(manager, queue))
+		manager->mode = isc_taskmgrmode_normal;
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
 }
+#endif /* USE_WORKER_THREADS */
 
 #ifdef USE_WORKER_THREADS
 static isc_threadresult_t
@@ -1305,12 +1588,12 @@ static isc_threadresult_t
 WINAPI
 #endif
 run(void *uap) {
-	isc__taskmgr_t *manager = uap;
+	isc__taskqueue_t *queue = uap;
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_STARTING, "starting"));
 
-	dispatch(manager);
+	dispatch(queue->manager, queue);
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_EXITING, "exiting"));
@@ -1323,13 +1606,60 @@ run(void *uap) {
 }
 #endif /* USE_WORKER_THREADS */
 
+static isc_result_t
+queue_init(isc__taskmgr_t *manager, isc__taskqueue_t *queue,
+	   unsigned int threadid)
+{
+	isc_result_t result;
+
+	queue->manager = manager;
+	queue->threadid = threadid;
+	result = isc_mutex_init(&queue->lock);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#ifdef USE_WORKER_THREADS
+	if (isc_condition_init(&queue->work_available) != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		DESTROYLOCK(&queue->lock);
+		return (ISC_R_UNEXPECTED);
+	}
+	queue->idle = false;
+#endif /* USE_WORKER_THREADS */
+	INIT_LIST(queue->ready_tasks);
+	INIT_LIST(queue->ready_priority_tasks);
+	queue->tasks_ready = 0;
+	queue->tasks_running = 0;
+	queue->executed = 0;
+	queue->stolen = 0;
+	queue->maxready = 0;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+queue_destroy(isc__taskqueue_t *queue) {
+	INSIST(EMPTY(queue->ready_tasks));
+	INSIST(queue->tasks_running == 0);
+#ifdef USE_WORKER_THREADS
+	(void)isc_condition_destroy(&queue->work_available);
+#endif /* USE_WORKER_THREADS */
+	DESTROYLOCK(&queue->lock);
+}
+
 static void
 manager_free(isc__taskmgr_t *manager) {
 	isc_mem_t *mctx;
+	unsigned int i;
 
+	for (i = 0; i < manager->maxqueues; i++)
+		queue_destroy(&manager->queues[i]);
+	isc_mem_put(manager->mctx, manager->queues,
+		    manager->maxqueues * sizeof(isc__taskqueue_t));
 #ifdef USE_WORKER_THREADS
 	(void)isc_condition_destroy(&manager->exclusive_granted);
-	(void)isc_condition_destroy(&manager->work_available);
 	(void)isc_condition_destroy(&manager->paused);
 	isc_mem_free(manager->mctx, manager->threads);
 #endif /* USE_WORKER_THREADS */
@@ -1362,7 +1692,6 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	REQUIRE(managerp != NULL && *managerp == NULL);
 
 #ifndef USE_WORKER_THREADS
-	UNUSED(i);
 	UNUSED(started);
 #endif
 
@@ -1393,21 +1722,36 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		goto cleanup_mgr;
 	}
 
+	/*
+	 * One ready queue per worker thread; without threads, a single
+	 * queue is dispatched by the application's event loop.
+	 */
+#ifdef USE_WORKER_THREADS
+	manager->maxqueues = workers;
+#else
+	manager->maxqueues = 1;
+#endif
+	manager->nqueues = 0;
+	manager->queues = isc_mem_get(mctx, manager->maxqueues *
+				      sizeof(isc__taskqueue_t));
+	if (manager->queues == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_excllock;
+	}
+	for (i = 0; i < manager->maxqueues; i++) {
+		result = queue_init(manager, &manager->queues[i], i);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_queues;
+		manager->nqueues++;
+	}
+
 #ifdef USE_WORKER_THREADS
 	manager->workers = 0;
 	manager->threads = isc_mem_allocate(mctx,
 					    workers * sizeof(isc_thread_t));
 	if (manager->threads == NULL) {
 		result = ISC_R_NOMEMORY;
-		goto cleanup_lock;
-	}
-	if (isc_condition_init(&manager->work_available) != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_threads;
+		goto cleanup_queues;
 	}
 	if (isc_condition_init(&manager->exclusive_granted) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1415,7 +1759,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"));
 		result = ISC_R_UNEXPECTED;
-		goto cleanup_workavailable;
+		goto cleanup_threads;
 	}
 	if (isc_condition_init(&manager->paused) != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1429,14 +1773,12 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	if (default_quantum == 0)
 		default_quantum = DEFAULT_DEFAULT_QUANTUM;
 	manager->default_quantum = default_quantum;
+	manager->nextqueue = 0;
 	INIT_LIST(manager->tasks);
-	INIT_LIST(manager->ready_tasks);
-	INIT_LIST(manager->ready_priority_tasks);
-	manager->tasks_running = 0;
-	manager->tasks_ready = 0;
 	manager->exclusive_requested = false;
 	manager->pause_requested = false;
 	manager->exiting = false;
+	manager->finished = false;
 	manager->excl = NULL;
 
 	isc_mem_attach(mctx, &manager->mctx);
@@ -1444,10 +1786,11 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifdef USE_WORKER_THREADS
 	LOCK(&manager->lock);
 	/*
-	 * Start workers.
+	 * Start workers.  Each one gets the next unused queue, so that
+	 * the queues in use stay contiguous if a thread can't be started.
 	 */
 	for (i = 0; i < workers; i++) {
-		if (isc_thread_create(run, manager,
+		if (isc_thread_create(run, &manager->queues[manager->workers],
 				      &manager->threads[manager->workers]) ==
 		    ISC_R_SUCCESS) {
 			char name[16];	/* thread name limit on Linux */
@@ -1458,6 +1801,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 			started++;
 		}
 	}
+	manager->nqueues = manager->workers;
 	UNLOCK(&manager->lock);
 
 	if (started == 0) {
@@ -1478,13 +1822,17 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifdef USE_WORKER_THREADS
  cleanup_exclusivegranted:
 	(void)isc_condition_destroy(&manager->exclusive_granted);
- cleanup_workavailable:
-	(void)isc_condition_destroy(&manager->work_available);
  cleanup_threads:
 	isc_mem_free(mctx, manager->threads);
- cleanup_lock:
-	DESTROYLOCK(&manager->lock);
 #endif
+ cleanup_queues:
+	for (i = 0; i < manager->nqueues; i++)
+		queue_destroy(&manager->queues[i]);
+	isc_mem_put(mctx, manager->queues,
+		    manager->maxqueues * sizeof(isc__taskqueue_t));
+ cleanup_excllock:
+	DESTROYLOCK(&manager->excl_lock);
+	DESTROYLOCK(&manager->lock);
  cleanup_mgr:
 	isc_mem_put(mctx, manager, sizeof(*manager));
 	return (result);
@@ -1493,6 +1841,7 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 void
 isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	isc__taskmgr_t *manager;
+	isc__taskqueue_t *queue;
 	isc__task_t *task;
 	unsigned int i;
 
@@ -1550,11 +1899,6 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	INSIST(!manager->exiting);
 	manager->exiting = true;
 
-	/*
-	 * If privileged mode was on, turn it off.
-	 */
-	manager->mode = isc_taskmgrmode_normal;
-
 	/*
 	 * Post shutdown event(s) to every task (if they haven't already been
 	 * posted).
@@ -1563,17 +1907,29 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	     task != NULL;
 	     task = NEXT(task, link)) {
 		LOCK(&task->lock);
-		if (task_shutdown(task))
-			push_readyq(manager, task);
+		if (task_shutdown(task)) {
+			queue = &manager->queues[task->threadid];
+			LOCK(&queue->lock);
+			push_readyq(queue, task);
+			UNLOCK(&queue->lock);
+		}
 		UNLOCK(&task->lock);
 	}
+
+	lock_queues(manager);
+	/*
+	 * If privileged mode was on, turn it off.
+	 */
+	manager->mode = isc_taskmgrmode_normal;
+	manager->finished = FINISHED(manager);
 #ifdef USE_WORKER_THREADS
 	/*
 	 * Wake up any sleeping workers.  This ensures we get work done if
 	 * there's work left to do, and if there are already no tasks left
-	 * it will cause the workers to see manager->exiting.
+	 * it will cause the workers to see manager->finished.
 	 */
-	BROADCAST(&manager->work_available);
+	wakeup_queues(manager);
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
 
 	/*
@@ -1585,6 +1941,7 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	/*
 	 * Dispatch the shutdown events.
 	 */
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
 	while (isc__taskmgr_ready((isc_taskmgr_t *)manager))
 		(void)isc__taskmgr_dispatch((isc_taskmgr_t *)manager);
@@ -1614,7 +1971,13 @@ isc__taskmgr_setmode(isc_taskmgr_t *manager0, isc_taskmgrmode_t mode) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 
 	LOCK(&manager->lock);
+	lock_queues(manager);
 	manager->mode = mode;
+#ifdef USE_WORKER_THREADS
+	if (mode == isc_taskmgrmode_normal)
+		wakeup_queues(manager);
+#endif /* USE_WORKER_THREADS */
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
 }
 
@@ -1641,9 +2004,9 @@ isc__taskmgr_ready(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (false);
 
-	LOCK(&manager->lock);
-	is_ready = !empty_readyq(manager);
-	UNLOCK(&manager->lock);
+	LOCK(&manager->queues[0].lock);
+	is_ready = !empty_readyq(manager, &manager->queues[0]);
+	UNLOCK(&manager->queues[0].lock);
 
 	return (is_ready);
 }
@@ -1659,7 +2022,7 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 	if (manager == NULL)
 		return (ISC_R_NOTFOUND);
 
-	dispatch(manager);
+	dispatch(manager, &manager->queues[0]);
 
 	return (ISC_R_SUCCESS);
 }
@@ -1668,9 +2031,12 @@ isc__taskmgr_dispatch(isc_taskmgr_t *manager0) {
 void
 isc__taskmgr_pause(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
-	manager->pause_requested = true;
+
 	LOCK(&manager->lock);
-	while (manager->tasks_running > 0) {
+	lock_queues(manager);
+	manager->pause_requested = true;
+	unlock_queues(manager);
+	while (count_running(manager) > 0) {
 		WAIT(&manager->paused, &manager->lock);
 	}
 	UNLOCK(&manager->lock);
@@ -1682,8 +2048,10 @@ isc__taskmgr_resume(isc_taskmgr_t *manager0) {
 
 	LOCK(&manager->lock);
 	if (manager->pause_requested) {
+		lock_queues(manager);
 		manager->pause_requested = false;
-		BROADCAST(&manager->work_available);
+		wakeup_queues(manager);
+		unlock_queues(manager);
 	}
 	UNLOCK(&manager->lock);
 }
@@ -1738,8 +2106,10 @@ isc__task_beginexclusive(isc_task_t *task0) {
 		UNLOCK(&manager->lock);
 		return (ISC_R_LOCKBUSY);
 	}
+	lock_queues(manager);
 	manager->exclusive_requested = true;
-	while (manager->tasks_running > 1) {
+	unlock_queues(manager);
+	while (count_running(manager) > 1) {
 		WAIT(&manager->exclusive_granted, &manager->lock);
 	}
 	UNLOCK(&manager->lock);
@@ -1758,8 +2128,10 @@ isc__task_endexclusive(isc_task_t *task0) {
 	REQUIRE(task->state == task_state_running);
 	LOCK(&manager->lock);
 	REQUIRE(manager->exclusive_requested);
+	lock_queues(manager);
 	manager->exclusive_requested = false;
-	BROADCAST(&manager->work_available);
+	wakeup_queues(manager);
+	unlock_queues(manager);
 	UNLOCK(&manager->lock);
 #else
 	UNUSED(task0);
@@ -1770,6 +2142,7 @@ void
 isc__task_setprivilege(isc_task_t *task0, bool priv) {
 	isc__task_t *task = (isc__task_t *)task0;
 	isc__taskmgr_t *manager = task->manager;
+	isc__taskqueue_t *queue = &manager->queues[task->threadid];
 	bool oldpriv;
 
 	LOCK(&task->lock);
@@ -1783,14 +2156,14 @@ isc__task_setprivilege(isc_task_t *task0, bool priv) {
 	if (priv == oldpriv)
 		return;
 
-	LOCK(&manager->lock);
+	LOCK(&queue->lock);
 	if (priv && ISC_LINK_LINKED(task, ready_link))
-		ENQUEUE(manager->ready_priority_tasks, task,
+		ENQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
 	else if (!priv && ISC_LINK_LINKED(task, ready_priority_link))
-		DEQUEUE(manager->ready_priority_tasks, task,
+		DEQUEUE(queue->ready_priority_tasks, task,
 			ready_priority_link);
-	UNLOCK(&manager->lock);
+	UNLOCK(&queue->lock);
 }
 
 bool
@@ -1817,6 +2190,48 @@ isc_task_exiting(isc_task_t *t) {
 	return (TASK_SHUTTINGDOWN(task));
 }
 
+#if defined(HAVE_LIBXML2) || defined(HAVE_JSON)
+typedef struct isc__queuestats {
+	unsigned int	ready;
+	unsigned int	maxready;
+	unsigned int	running;
+	uint64_t	executed;
+	uint64_t	stolen;
+} isc__queuestats_t;
+
+/*
+ * Copy the counters of each ready queue into 'stats', and their sum
+ * into 'total'.
+ *
+ * Caller must hold the task manager lock.
+ */
+static void
+snapshot_queues(isc__taskmgr_t *mgr, isc__queuestats_t *stats,
+		isc__queuestats_t *total)
+{
+	isc__taskqueue_t *queue;
+	unsigned int i;
+
+	memset(total, 0, sizeof(*total));
+	for (i = 0; i < mgr->nqueues; i++) {
+		queue = &mgr->queues[i];
+		LOCK(&queue->lock);
+		stats[i].ready = queue->tasks_ready;
+		stats[i].maxready = queue->maxready;
+		stats[i].running = queue->tasks_running;
+		stats[i].executed = queue->executed;
+		stats[i].stolen = queue->stolen;
+		UNLOCK(&queue->lock);
+
+		total->ready += stats[i].ready;
+		total->running += stats[i].running;
+		total->executed += stats[i].executed;
+		total->stolen += stats[i].stolen;
+		if (stats[i].maxready > total->maxready)
+			total->maxready = stats[i].maxready;
+	}
+}
+#endif /* HAVE_LIBXML2 || HAVE_JSON */
 
 #ifdef HAVE_LIBXML2
 #define TRY0(a) do { xmlrc = (a); if (xmlrc < 0) goto error; } while(0)
@@ -1824,8 +2239,14 @@ int
 isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
+	isc__queuestats_t *qstats = NULL, total;
+	unsigned int i;
 	int xmlrc;
 
+	qstats = isc_mem_get(mgr->mctx, mgr->maxqueues * sizeof(*qstats));
+	if (qstats == NULL)
+		return (-1);
+
 	LOCK(&mgr->lock);
 
 	/*
@@ -1856,16 +2277,64 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 					    mgr->default_quantum));
 	TRY0(xmlTextWriterEndElement(writer)); /* default-quantum */
 
+	snapshot_queues(mgr, qstats, &total);
+
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-running"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_running));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%u", total.running));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-running */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-ready"));
-	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_ready));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%u", total.ready));
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-ready */
 
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-executed"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+					    total.executed));
+	TRY0(xmlTextWriterEndElement(writer)); /* tasks-executed */
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-stolen"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+					    total.stolen));
+	TRY0(xmlTextWriterEndElement(writer)); /* tasks-stolen */
+
 	TRY0(xmlTextWriterEndElement(writer)); /* thread-model */
 
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "queues"));
+	for (i = 0; i < mgr->nqueues; i++) {
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "queue"));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "id"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u", i));
+		TRY0(xmlTextWriterEndElement(writer)); /* id */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "tasks-ready"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+						    qstats[i].ready));
+		TRY0(xmlTextWriterEndElement(writer)); /* tasks-ready */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "max-tasks-ready"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+						    qstats[i].maxready));
+		TRY0(xmlTextWriterEndElement(writer)); /* max-tasks-ready */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "tasks-executed"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    qstats[i].executed));
+		TRY0(xmlTextWriterEndElement(writer)); /* tasks-executed */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "tasks-stolen"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    qstats[i].stolen));
+		TRY0(xmlTextWriterEndElement(writer)); /* tasks-stolen */
+
+		TRY0(xmlTextWriterEndElement(writer)); /* queue */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* queues */
+
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks"));
 	task = ISC_LIST_HEAD(mgr->tasks);
 	while (task != NULL) {
@@ -1916,6 +2385,7 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	if (task != NULL)
 		UNLOCK(&task->lock);
 	UNLOCK(&mgr->lock);
+	isc_mem_put(mgr->mctx, qstats, mgr->maxqueues * sizeof(*qstats));
 
 	return (xmlrc);
 }
@@ -1934,8 +2404,14 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc__taskmgr_t *mgr = (isc__taskmgr_t *)mgr0;
 	isc__task_t *task = NULL;
+	isc__queuestats_t *qstats = NULL, total;
+	unsigned int i;
 	json_object *obj = NULL, *array = NULL, *taskobj = NULL;
 
+	qstats = isc_mem_get(mgr->mctx, mgr->maxqueues * sizeof(*qstats));
+	if (qstats == NULL)
+		return (ISC_R_NOMEMORY);
+
 	LOCK(&mgr->lock);
 
 	/*
@@ -1964,14 +2440,55 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "default-quantum", obj);
 
-	obj = json_object_new_int(mgr->tasks_running);
+	snapshot_queues(mgr, qstats, &total);
+
+	obj = json_object_new_int(total.running);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-running", obj);
 
-	obj = json_object_new_int(mgr->tasks_ready);
+	obj = json_object_new_int(total.ready);
 	CHECKMEM(obj);
 	json_object_object_add(tasks, "tasks-ready", obj);
 
+	obj = json_object_new_int64(total.executed);
+	CHECKMEM(obj);
+	json_object_object_add(tasks, "tasks-executed", obj);
+
+	obj = json_object_new_int64(total.stolen);
+	CHECKMEM(obj);
+	json_object_object_add(tasks, "tasks-stolen", obj);
+
+	array = json_object_new_array();
+	CHECKMEM(array);
+
+	for (i = 0; i < mgr->nqueues; i++) {
+		taskobj = json_object_new_object();
+		CHECKMEM(taskobj);
+		json_object_array_add(array, taskobj);
+
+		obj = json_object_new_int(i);
+		CHECKMEM(obj);
+		json_object_object_add(taskobj, "id", obj);
+
+		obj = json_object_new_int(qstats[i].ready);
+		CHECKMEM(obj);
+		json_object_object_add(taskobj, "tasks-ready", obj);
+
+		obj = json_object_new_int(qstats[i].maxready);
+		CHECKMEM(obj);
+		json_object_object_add(taskobj, "max-tasks-ready", obj);
+
+		obj = json_object_new_int64(qstats[i].executed);
+		CHECKMEM(obj);
+		json_object_object_add(taskobj, "tasks-executed", obj);
+
+		obj = json_object_new_int64(qstats[i].stolen);
+		CHECKMEM(obj);
+		json_object_object_add(taskobj, "tasks-stolen", obj);
+	}
+
+	json_object_object_add(tasks, "queues", array);
+
 	array = json_object_new_array();
 	CHECKMEM(array);
 
@@ -2028,6 +2545,7 @@ isc_taskmgr_renderjson(isc_taskmgr_t *mgr0, json_object *tasks) {
 	if (task != NULL)
 		UNLOCK(&task->lock);
 	UNLOCK(&mgr->lock);
+	isc_mem_put(mgr->mctx, qstats, mgr->maxqueues * sizeof(*qstats));
 
 	return (result);
 }
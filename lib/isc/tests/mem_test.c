@@ -23,6 +23,7 @@
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/stdio.h>
+#include <isc/thread.h>
 
 static void *
 default_memalloc(void *arg, size_t size) {
@@ -263,6 +264,243 @@ ATF_TC_BODY(isc_mem_inuse, tc) {
 	isc_test_end();
 }
 
+#ifdef ISC_PLATFORM_USETHREADS
+#define CACHE_THREADS	4
+#define CACHE_ITEMS	64
+#define CACHE_LOOPS	20000
+
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+cache_thread(isc_threadarg_t arg) {
+	isc_mem_t *mctx2 = arg;
+	void *items[CACHE_ITEMS];
+	size_t sizes[CACHE_ITEMS];
+	unsigned int i, n;
+
+	memset(items, 0, sizeof(items));
+	for (i = 0; i < CACHE_LOOPS; i++) {
+		n = i % CACHE_ITEMS;
+		if (items[n] != NULL) {
+			isc_mem_put(mctx2, items[n], sizes[n]);
+		}
+		sizes[n] = 1 + (i * 7919) % 600;
+		items[n] = isc_mem_get(mctx2, sizes[n]);
+		if (items[n] == NULL) {
+			break;
+		}
+		memset(items[n], 0, sizes[n]);
+	}
+	for (n = 0; n < CACHE_ITEMS; n++) {
+		if (items[n] != NULL) {
+			isc_mem_put(mctx2, items[n], sizes[n]);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(isc_mem_cache);
+ATF_TC_HEAD(isc_mem_cache, tc) {
+	atf_tc_set_md_var(tc, "descr", "per-thread allocation caches");
+}
+
+ATF_TC_BODY(isc_mem_cache, tc) {
+	isc_result_t result;
+	isc_mem_t *mctx2 = NULL;
+	isc_thread_t threads[CACHE_THREADS];
+	unsigned int flags[] = { ISC_MEMFLAG_INTERNAL|ISC_MEMFLAG_FILL, 0 };
+	unsigned int f, i;
+	void *ptr;
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Recorded allocations bypass the caches. */
+	isc_mem_debugging = 0;
+
+	for (f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+		mctx2 = NULL;
+		result = isc_mem_createx2(0, 0, default_memalloc,
+					  default_memfree, NULL, &mctx2,
+					  flags[f]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		/*
+		 * Blocks cached by threads that have exited must have
+		 * been given back to the context.
+		 */
+		for (i = 0; i < CACHE_THREADS; i++) {
+			result = isc_thread_create(cache_thread, mctx2,
+						   &threads[i]);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+		for (i = 0; i < CACHE_THREADS; i++) {
+			result = isc_thread_join(threads[i], NULL);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		}
+		ATF_CHECK_EQ(isc_mem_inuse(mctx2), 0);
+
+		/*
+		 * Blocks still cached by this thread count as in use, and
+		 * destroying the context takes them back.
+		 */
+		ptr = isc_mem_get(mctx2, 24);
+		ATF_REQUIRE(ptr != NULL);
+		isc_mem_put(mctx2, ptr, 24);
+		ATF_CHECK(isc_mem_inuse(mctx2) > 0);
+
+		isc_mem_destroy(&mctx2);
+	}
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+	isc_test_end();
+}
+
+#define MANY_CONTEXTS	100
+#define MANY_ROUNDS	10
+
+ATF_TC(isc_mem_cachemany);
+ATF_TC_HEAD(isc_mem_cachemany, tc) {
+	atf_tc_set_md_var(tc, "descr", "per-thread caches for more contexts "
+			  "than a thread can cache for");
+}
+
+ATF_TC_BODY(isc_mem_cachemany, tc) {
+	isc_result_t result;
+	isc_mem_t *hot = NULL;
+	isc_mem_t *many[MANY_CONTEXTS];
+	unsigned int i, r;
+	void *ptr;
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_mem_debugging = 0;
+
+	result = isc_mem_create(0, 0, &hot);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < MANY_CONTEXTS; i++) {
+		many[i] = NULL;
+		result = isc_mem_create(0, 0, &many[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Using each of the other contexts in turn must not take the
+	 * cache of a context this thread keeps using.
+	 */
+	for (r = 0; r < MANY_ROUNDS; r++) {
+		ptr = isc_mem_get(hot, 64);
+		ATF_REQUIRE(ptr != NULL);
+		isc_mem_put(hot, ptr, 64);
+		ATF_CHECK(isc_mem_inuse(hot) > 0);
+
+		for (i = 0; i < MANY_CONTEXTS; i++) {
+			ptr = isc_mem_get(many[i], 64);
+			ATF_REQUIRE(ptr != NULL);
+			isc_mem_put(many[i], ptr, 64);
+		}
+		ATF_CHECK(isc_mem_inuse(hot) > 0);
+	}
+
+	for (i = 0; i < MANY_CONTEXTS; i++)
+		isc_mem_destroy(&many[i]);
+	isc_mem_destroy(&hot);
+
+	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+	isc_test_end();
+}
+
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+shared_thread(isc_threadarg_t arg) {
+	isc_mempool_t *mp = arg;
+	void *items[CACHE_ITEMS];
+	unsigned int i, n;
+
+	memset(items, 0, sizeof(items));
+	for (i = 0; i < CACHE_LOOPS; i++) {
+		n = (i * 7919) % CACHE_ITEMS;
+		if (items[n] != NULL) {
+			isc_mempool_put(mp, items[n]);
+		} else {
+			items[n] = isc_mempool_get(mp);
+		}
+	}
+	for (n = 0; n < CACHE_ITEMS; n++) {
+		if (items[n] != NULL) {
+			isc_mempool_put(mp, items[n]);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+ATF_TC(isc_mempool_shared);
+ATF_TC_HEAD(isc_mempool_shared, tc) {
+	atf_tc_set_md_var(tc, "descr", "shared memory pools");
+}
+
+ATF_TC_BODY(isc_mempool_shared, tc) {
+	isc_result_t result;
+	isc_mempool_t *mp = NULL;
+	isc_thread_t threads[CACHE_THREADS];
+	void *items[MP1_MAXALLOC];
+	unsigned int i;
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_mempool_createshared(mctx, 24, &mp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_mempool_setfreemax(mp, MP1_FREEMAX);
+	isc_mempool_setfillcount(mp, MP1_FILLCNT);
+	isc_mempool_setmaxalloc(mp, MP1_MAXALLOC);
+
+	/*
+	 * maxalloc is enforced exactly.
+	 */
+	for (i = 0; i < MP1_MAXALLOC; i++) {
+		items[i] = isc_mempool_get(mp);
+		ATF_REQUIRE(items[i] != NULL);
+	}
+	ATF_CHECK(isc_mempool_get(mp) == NULL);
+	ATF_CHECK_EQ(isc_mempool_getallocated(mp), MP1_MAXALLOC);
+
+	/*
+	 * freemax bounds the pool's free items.
+	 */
+	for (i = 0; i < MP1_MAXALLOC; i++) {
+		isc_mempool_put(mp, items[i]);
+	}
+	ATF_CHECK_EQ(isc_mempool_getallocated(mp), 0);
+	ATF_CHECK(isc_mempool_getfreecount(mp) <= MP1_FREEMAX);
+
+	/*
+	 * Gets and puts from several threads at once balance.
+	 */
+	isc_mempool_setmaxalloc(mp, CACHE_THREADS * CACHE_ITEMS);
+	for (i = 0; i < CACHE_THREADS; i++) {
+		result = isc_thread_create(shared_thread, mp, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < CACHE_THREADS; i++) {
+		result = isc_thread_join(threads[i], NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	ATF_CHECK_EQ(isc_mempool_getallocated(mp), 0);
+
+	isc_mempool_destroy(&mp);
+
+	isc_test_end();
+}
+#endif
+
 #if ISC_MEM_TRACKLINES
 ATF_TC(isc_mem_noflags);
 ATF_TC_HEAD(isc_mem_noflags, tc) {
@@ -431,6 +669,11 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, isc_mem);
 	ATF_TP_ADD_TC(tp, isc_mem_total);
 	ATF_TP_ADD_TC(tp, isc_mem_inuse);
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, isc_mem_cache);
+	ATF_TP_ADD_TC(tp, isc_mem_cachemany);
+	ATF_TP_ADD_TC(tp, isc_mempool_shared);
+#endif
 #if ISC_MEM_TRACKLINES
 	ATF_TP_ADD_TC(tp, isc_mem_noflags);
 	ATF_TP_ADD_TC(tp, isc_mem_recordflag);
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdbool.h>
+
+#include <isc/rwlock.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+/*
+ * Helper functions
+ */
+
+static isc_result_t
+rwlock_init(isc_rwlock_t *rwl, bool biased) {
+	if (biased)
+		return (isc_rwlock_initbiased(rwl, mctx, 0, 0));
+	return (isc_rwlock_init(rwl, 0, 0));
+}
+
+static void
+trylock_test(bool biased) {
+	isc_result_t result;
+	isc_rwlock_t rwl;
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = rwlock_init(&rwl, biased);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Readers share the lock and keep writers out. */
+	result = isc_rwlock_trylock(&rwl, isc_rwlocktype_read);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = isc_rwlock_trylock(&rwl, isc_rwlocktype_read);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = isc_rwlock_trylock(&rwl, isc_rwlocktype_write);
+	ATF_CHECK_EQ(result, ISC_R_LOCKBUSY);
+
+	/* Only a single reader can upgrade. */
+	result = isc_rwlock_tryupgrade(&rwl);
+	ATF_CHECK_EQ(result, ISC_R_LOCKBUSY);
+	result = isc_rwlock_unlock(&rwl, isc_rwlocktype_read);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = isc_rwlock_tryupgrade(&rwl);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	/* A writer keeps everybody else out. */
+	result = isc_rwlock_trylock(&rwl, isc_rwlocktype_read);
+	ATF_CHECK_EQ(result, ISC_R_LOCKBUSY);
+	result = isc_rwlock_trylock(&rwl, isc_rwlocktype_write);
+	ATF_CHECK_EQ(result, ISC_R_LOCKBUSY);
+
+	/* After downgrading, other readers get in again. */
+	isc_rwlock_downgrade(&rwl);
+	result = isc_rwlock_trylock(&rwl, isc_rwlocktype_read);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = isc_rwlock_unlock(&rwl, isc_rwlocktype_read);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = isc_rwlock_unlock(&rwl, isc_rwlocktype_read);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_rwlock_lock(&rwl, isc_rwlocktype_write);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	result = isc_rwlock_unlock(&rwl, isc_rwlocktype_write);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	isc_rwlock_destroy(&rwl);
+
+	isc_test_end();
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+#define RWLOCK_THREADS	4
+#define RWLOCK_LOOPS	20000
+
+/*
+ * Every RWLOCK_WRITEFREQ'th iteration of each thread is a write.  Writers
+ * move 'value' through an odd number and back to an even one; nobody
+ * else may see it change while they do.
+ */
+#define RWLOCK_WRITEFREQ 16
+
+static isc_rwlock_t rwlock;
+static volatile unsigned int value;
+static volatile unsigned int errors;
+
+static isc_threadresult_t
+#ifdef _WIN32
+WINAPI
+#endif
+rwlock_thread(void *arg) {
+	unsigned int i, j;
+
+	UNUSED(arg);
+
+	for (i = 0; i < RWLOCK_LOOPS; i++) {
+		if (i % RWLOCK_WRITEFREQ == 0) {
+			RWLOCK(&rwlock, isc_rwlocktype_write);
+			value++;
+			for (j = 0; j < 10; j++)
+				if ((value & 1) == 0)
+					errors++;
+			value++;
+			RWUNLOCK(&rwlock, isc_rwlocktype_write);
+		} else if (i % RWLOCK_WRITEFREQ == 1) {
+			/* Upgrade when possible, as rbtdb does. */
+			RWLOCK(&rwlock, isc_rwlocktype_read);
+			if ((value & 1) != 0)
+				errors++;
+			if (isc_rwlock_tryupgrade(&rwlock) == ISC_R_SUCCESS) {
+				value += 2;
+				isc_rwlock_downgrade(&rwlock);
+			}
+			RWUNLOCK(&rwlock, isc_rwlocktype_read);
+		} else {
+			RWLOCK(&rwlock, isc_rwlocktype_read);
+			for (j = 0; j < 10; j++)
+				if ((value & 1) != 0)
+					errors++;
+			RWUNLOCK(&rwlock, isc_rwlocktype_read);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+threads_test(bool biased) {
+	isc_result_t result;
+	isc_thread_t threads[RWLOCK_THREADS];
+	unsigned int i;
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = rwlock_init(&rwlock, biased);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	value = 0;
+	errors = 0;
+	for (i = 0; i < RWLOCK_THREADS; i++) {
+		result = isc_thread_create(rwlock_thread, NULL, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < RWLOCK_THREADS; i++) {
+		result = isc_thread_join(threads[i], NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	ATF_CHECK_EQ(errors, 0);
+	ATF_CHECK(value >= 2 * RWLOCK_THREADS *
+			   (RWLOCK_LOOPS / RWLOCK_WRITEFREQ));
+	ATF_CHECK_EQ(value & 1, 0);
+
+	isc_rwlock_destroy(&rwlock);
+
+	isc_test_end();
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(isc_rwlock_trylock);
+ATF_TC_HEAD(isc_rwlock_trylock, tc) {
+	atf_tc_set_md_var(tc, "descr", "trylock, upgrade and downgrade");
+}
+ATF_TC_BODY(isc_rwlock_trylock, tc) {
+	UNUSED(tc);
+
+	trylock_test(false);
+}
+
+ATF_TC(isc_rwlock_biased_trylock);
+ATF_TC_HEAD(isc_rwlock_biased_trylock, tc) {
+	atf_tc_set_md_var(tc, "descr", "trylock, upgrade and downgrade "
+			  "of a reader-biased lock");
+}
+ATF_TC_BODY(isc_rwlock_biased_trylock, tc) {
+	UNUSED(tc);
+
+	trylock_test(true);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+ATF_TC(isc_rwlock_threads);
+ATF_TC_HEAD(isc_rwlock_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "readers and writers exclude "
+			  "each other");
+}
+ATF_TC_BODY(isc_rwlock_threads, tc) {
+	UNUSED(tc);
+
+	threads_test(false);
+}
+
+ATF_TC(isc_rwlock_biased_threads);
+ATF_TC_HEAD(isc_rwlock_biased_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "readers and writers of a "
+			  "reader-biased lock exclude each other");
+}
+ATF_TC_BODY(isc_rwlock_biased_threads, tc) {
+	UNUSED(tc);
+
+	threads_test(true);
+}
+#endif /* ISC_PLATFORM_USETHREADS */
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, isc_rwlock_trylock);
+	ATF_TP_ADD_TC(tp, isc_rwlock_biased_trylock);
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, isc_rwlock_threads);
+	ATF_TP_ADD_TC(tp, isc_rwlock_biased_threads);
+#endif
+
+	return (atf_no_error());
+}
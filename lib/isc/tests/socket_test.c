@@ -16,6 +16,8 @@
 #include <atf-c.h>
 
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 
@@ -31,6 +33,8 @@ static bool recv_dscp;
 static unsigned int recv_dscp_value;
 static bool recv_trunc;
 
+LIBISC_EXTERNAL_DATA extern bool isc_socket_iouring;
+
 /*
  * Helper functions
  */
@@ -219,6 +223,250 @@ ATF_TC_BODY(udp_sendto, tc) {
 	isc_test_end();
 }
 
+/* Test UDP recv/sendto with the io_uring watcher */
+ATF_TC(udp_iouring);
+ATF_TC_HEAD(udp_iouring, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP recv/sendto using io_uring");
+}
+ATF_TC_BODY(udp_iouring, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf[BUFSIZ];
+	completion_t completion1, completion2;
+	isc_region_t r;
+
+	UNUSED(tc);
+
+	/*
+	 * Falls back to epoll where io_uring is unavailable, so this
+	 * must pass either way.
+	 */
+	isc_socket_iouring = true;
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+	ATF_REQUIRE(isc_sockaddr_getport(&addr1) != 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s2, &addr2);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+	ATF_REQUIRE(isc_sockaddr_getport(&addr2) != 0);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Post the receive first so that it has to wait for readiness.
+	 */
+	r.base = (void *) recvbuf;
+	r.length = BUFSIZ;
+	completion_init(&completion2);
+	result = isc_socket_recv(s2, &r, 1, task, event_done, &completion2);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	snprintf(sendbuf, sizeof(sendbuf), "Hello");
+	r.base = (void *) sendbuf;
+	r.length = strlen(sendbuf) + 1;
+	completion_init(&completion1);
+	result = isc_socket_sendto(s1, &r, task, event_done, &completion1,
+				   &addr2, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	waitfor2(&completion1, &completion2);
+	ATF_CHECK(completion1.done);
+	ATF_CHECK_EQ(completion1.result, ISC_R_SUCCESS);
+	ATF_CHECK(completion2.done);
+	ATF_CHECK_EQ(completion2.result, ISC_R_SUCCESS);
+	ATF_CHECK_STREQ(recvbuf, "Hello");
+
+	/*
+	 * Cancel a receive the kernel is waiting to complete; the
+	 * datagram that arrives afterwards goes to the next receive.
+	 */
+	r.base = (void *) recvbuf;
+	r.length = BUFSIZ;
+	completion_init(&completion2);
+	result = isc_socket_recv(s2, &r, 1, task, event_done, &completion2);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	isc_test_nap(100000);
+	isc_socket_cancel(s2, task, ISC_SOCKCANCEL_RECV);
+	waitfor(&completion2);
+	ATF_CHECK(completion2.done);
+	ATF_CHECK_EQ(completion2.result, ISC_R_CANCELED);
+
+	snprintf(sendbuf, sizeof(sendbuf), "World");
+	r.base = (void *) sendbuf;
+	r.length = strlen(sendbuf) + 1;
+	completion_init(&completion1);
+	result = isc_socket_sendto(s1, &r, task, event_done, &completion1,
+				   &addr2, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion1);
+	ATF_CHECK(completion1.done);
+	ATF_CHECK_EQ(completion1.result, ISC_R_SUCCESS);
+
+	memset(recvbuf, 0, sizeof(recvbuf));
+	r.base = (void *) recvbuf;
+	r.length = BUFSIZ;
+	completion_init(&completion2);
+	result = isc_socket_recv(s2, &r, 1, task, event_done, &completion2);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion2);
+	ATF_CHECK(completion2.done);
+	ATF_CHECK_EQ(completion2.result, ISC_R_SUCCESS);
+	ATF_CHECK_STREQ(recvbuf, "World");
+
+	/*
+	 * Leave a canceled receive in flight, so that the socket is
+	 * closed while the kernel still owns its buffer.
+	 */
+	r.base = (void *) recvbuf;
+	r.length = BUFSIZ;
+	completion_init(&completion2);
+	result = isc_socket_recv(s2, &r, 1, task, event_done, &completion2);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	isc_test_nap(100000);
+	isc_socket_cancel(s2, task, ISC_SOCKCANCEL_RECV);
+	waitfor(&completion2);
+	ATF_CHECK_EQ(completion2.result, ISC_R_CANCELED);
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+	isc_socket_iouring = false;
+}
+
+/* Test TCP accept and send/recv with the io_uring watcher */
+ATF_TC(tcp_iouring);
+ATF_TC_HEAD(tcp_iouring, tc) {
+	atf_tc_set_md_var(tc, "descr", "TCP accept/send/recv using io_uring");
+}
+ATF_TC_BODY(tcp_iouring, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL, *s3 = NULL;
+	isc_task_t *task = NULL;
+	unsigned char *sendbuf, *recvbuf;
+	completion_t completion, completion2;
+	isc_region_t r;
+	size_t i, len = 8 * 1024 * 1024;
+
+	UNUSED(tc);
+
+	isc_socket_iouring = true;
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_tcp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_listen(s1, 3);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * A connection accepted after its accept request was canceled
+	 * goes to the next accept request.
+	 */
+	completion_init(&completion2);
+	result = isc_socket_accept(s1, task, accept_done, &completion2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_test_nap(100000);
+	isc_socket_cancel(s1, task, ISC_SOCKCANCEL_ACCEPT);
+	waitfor(&completion2);
+	ATF_CHECK(completion2.done);
+	ATF_CHECK_EQ(completion2.result, ISC_R_CANCELED);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_tcp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	completion_init(&completion);
+	result = isc_socket_connect(s2, &addr1, task, event_done, &completion);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion);
+	ATF_CHECK(completion.done);
+	ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+
+	completion_init(&completion2);
+	result = isc_socket_accept(s1, task, accept_done, &completion2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion2);
+	ATF_CHECK(completion2.done);
+	ATF_REQUIRE_EQ(completion2.result, ISC_R_SUCCESS);
+	s3 = completion2.socket;
+
+	/*
+	 * Send more than the socket buffers hold, so that the send
+	 * blocks and has to be completed by the kernel.
+	 */
+	sendbuf = malloc(len);
+	recvbuf = malloc(len);
+	ATF_REQUIRE(sendbuf != NULL && recvbuf != NULL);
+	for (i = 0; i < len; i++)
+		sendbuf[i] = (unsigned char)(i * 7 + i / 4096);
+	memset(recvbuf, 0, len);
+
+	r.base = sendbuf;
+	r.length = len;
+	completion_init(&completion);
+	result = isc_socket_send(s2, &r, task, event_done, &completion);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	r.base = recvbuf;
+	r.length = len;
+	completion_init(&completion2);
+	result = isc_socket_recv(s3, &r, len, task, event_done, &completion2);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	waitfor2(&completion, &completion2);
+	ATF_CHECK(completion.done);
+	ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+	ATF_CHECK(completion2.done);
+	ATF_CHECK_EQ(completion2.result, ISC_R_SUCCESS);
+	ATF_CHECK(memcmp(sendbuf, recvbuf, len) == 0);
+
+	free(sendbuf);
+	free(recvbuf);
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+	isc_socket_detach(&s3);
+
+	isc_test_end();
+	isc_socket_iouring = false;
+}
+
 /* Test UDP sendto/recv with duplicated socket */
 ATF_TC(udp_dup);
 ATF_TC_HEAD(udp_dup, tc) {
@@ -320,6 +568,356 @@ ATF_TC_BODY(udp_dup, tc) {
 	isc_test_end();
 }
 
+/* Test binding several UDP sockets to one port with SO_REUSEPORT */
+ATF_TC(udp_reuseport);
+ATF_TC_HEAD(udp_reuseport, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP SO_REUSEPORT bind");
+}
+ATF_TC_BODY(udp_reuseport, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL, *s3 = NULL;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, ISC_SOCKET_REUSEPORT);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_socket_detach(&s1);
+		isc_test_end();
+		atf_tc_skip("SO_REUSEPORT not supported");
+	}
+	ATF_REQUIRE_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			   isc_result_totext(result));
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+	ATF_REQUIRE(isc_sockaddr_getport(&addr1) != 0);
+
+	/* A second SO_REUSEPORT socket may share the port... */
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr1,
+				 ISC_SOCKET_REUSEADDRESS |
+				 ISC_SOCKET_REUSEPORT);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+	result = isc_socket_getsockname(s2, &addr2);
+	ATF_CHECK_EQ_MSG(result, ISC_R_SUCCESS, "%s",
+			 isc_result_totext(result));
+	ATF_CHECK(isc_sockaddr_equal(&addr1, &addr2));
+
+	/* ...but one without it may not. */
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s3);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s3, &addr1, 0);
+	ATF_CHECK_EQ_MSG(result, ISC_R_ADDRINUSE, "%s",
+			 isc_result_totext(result));
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+	isc_socket_detach(&s3);
+
+	isc_test_end();
+}
+
+/* Test UDP receives through a recvmmsg() read-ahead batch */
+ATF_TC(udp_recvbatch);
+ATF_TC_HEAD(udp_recvbatch, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP batched receive");
+}
+ATF_TC_BODY(udp_recvbatch, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf[BUFSIZ];
+	completion_t completion;
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s1, &addr1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s2, &addr2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Slots of 8 bytes: "Hello-N" fits, "Hello, World" does not. */
+	result = isc_socket_setrecvbatch(s2, 4, 8);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		isc_socket_detach(&s1);
+		isc_socket_detach(&s2);
+		isc_test_end();
+		atf_tc_skip("batched receive not supported");
+	}
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Queue more datagrams than there are slots, so that the batch
+	 * has to be refilled.
+	 */
+	for (i = 0; i < 6; i++) {
+		snprintf(sendbuf, sizeof(sendbuf), "Hello-%d", i);
+		r.base = (void *) sendbuf;
+		r.length = strlen(sendbuf) + 1;
+		completion_init(&completion);
+		result = isc_socket_sendto(s1, &r, task, event_done,
+					   &completion, &addr2, NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&completion);
+		ATF_CHECK(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 6; i++) {
+		snprintf(sendbuf, sizeof(sendbuf), "Hello-%d", i);
+		r.base = (void *) recvbuf;
+		r.length = BUFSIZ;
+		completion_init(&completion);
+		result = isc_socket_recv(s2, &r, 1, task, event_done,
+					 &completion);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&completion);
+		ATF_CHECK(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf, sendbuf);
+		ATF_CHECK(!recv_trunc);
+	}
+
+	/* A datagram longer than a slot is reported as truncated. */
+	snprintf(sendbuf, sizeof(sendbuf), "Hello, World");
+	r.base = (void *) sendbuf;
+	r.length = strlen(sendbuf) + 1;
+	completion_init(&completion);
+	result = isc_socket_sendto(s1, &r, task, event_done, &completion,
+				   &addr2, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion);
+	ATF_CHECK(completion.done);
+
+	r.base = (void *) recvbuf;
+	r.length = BUFSIZ;
+	completion_init(&completion);
+	result = isc_socket_recv(s2, &r, 1, task, event_done, &completion);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion);
+	ATF_CHECK(completion.done);
+	ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+	ATF_CHECK(recv_trunc);
+	ATF_CHECK(memcmp(recvbuf, "Hello, W", 8) == 0);
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+}
+
+/* Test discarding queued UDP datagrams */
+ATF_TC(udp_purge);
+ATF_TC_HEAD(udp_purge, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP purge");
+}
+ATF_TC_BODY(udp_purge, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf[BUFSIZ];
+	completion_t completion;
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s2, &addr2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Datagrams which arrive while nothing is reading are dropped. */
+	for (i = 0; i < 3; i++) {
+		snprintf(sendbuf, sizeof(sendbuf), "Stale-%d", i);
+		r.base = (void *) sendbuf;
+		r.length = strlen(sendbuf) + 1;
+		completion_init(&completion);
+		result = isc_socket_sendto(s1, &r, task, event_done,
+					   &completion, &addr2, NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&completion);
+		ATF_CHECK(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+	}
+
+	result = isc_socket_purge(s2);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	snprintf(sendbuf, sizeof(sendbuf), "Hello");
+	r.base = (void *) sendbuf;
+	r.length = strlen(sendbuf) + 1;
+	completion_init(&completion);
+	result = isc_socket_sendto(s1, &r, task, event_done, &completion,
+				   &addr2, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion);
+	ATF_CHECK(completion.done);
+
+	r.base = (void *) recvbuf;
+	r.length = BUFSIZ;
+	completion_init(&completion);
+	result = isc_socket_recv(s2, &r, 1, task, event_done, &completion);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion);
+	ATF_CHECK(completion.done);
+	ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+	ATF_CHECK_STREQ(recvbuf, "Hello");
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+}
+
+/* Test receiving again at once after canceling a receive */
+ATF_TC(udp_recvcancel);
+ATF_TC_HEAD(udp_recvcancel, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP receive after cancel");
+}
+ATF_TC_BODY(udp_recvcancel, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf[BUFSIZ], canceledbuf[BUFSIZ];
+	completion_t completion, canceled, sent;
+	isc_region_t r;
+	int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, true, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 0);
+	isc_sockaddr_fromin(&addr2, &in, 0);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_getsockname(s2, &addr2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Each canceled receive leaves a read poke on its way to the
+	 * watcher, which may only get there after the datagram for the
+	 * next receive has been seen.  That receive must still be done
+	 * exactly once, with its own datagram.
+	 */
+	for (i = 0; i < 500; i++) {
+		r.base = (void *) canceledbuf;
+		r.length = BUFSIZ;
+		completion_init(&canceled);
+		result = isc_socket_recv(s2, &r, 1, task, event_done,
+					 &canceled);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		isc_socket_cancel(s2, task, ISC_SOCKCANCEL_RECV);
+
+		r.base = (void *) recvbuf;
+		r.length = BUFSIZ;
+		completion_init(&completion);
+		result = isc_socket_recv(s2, &r, 1, task, event_done,
+					 &completion);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		snprintf(sendbuf, sizeof(sendbuf), "Hello-%d", i);
+		r.base = (void *) sendbuf;
+		r.length = strlen(sendbuf) + 1;
+		completion_init(&sent);
+		result = isc_socket_sendto(s1, &r, task, event_done, &sent,
+					   &addr2, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		waitfor(&sent);
+		ATF_REQUIRE(sent.done);
+
+		waitfor(&completion);
+		ATF_REQUIRE(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf, sendbuf);
+
+		waitfor(&canceled);
+		ATF_REQUIRE(canceled.done);
+		ATF_CHECK_EQ(canceled.result, ISC_R_CANCELED);
+	}
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+}
+
 /* Test TCP sendto/recv (IPv4) */
 ATF_TC(udp_dscp_v4);
 ATF_TC_HEAD(udp_dscp_v4, tc) {
@@ -911,7 +1509,13 @@ ATF_TC_BODY(udp_trunc, tc) {
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, udp_sendto);
+	ATF_TP_ADD_TC(tp, udp_iouring);
+	ATF_TP_ADD_TC(tp, tcp_iouring);
 	ATF_TP_ADD_TC(tp, udp_dup);
+	ATF_TP_ADD_TC(tp, udp_reuseport);
+	ATF_TP_ADD_TC(tp, udp_recvbatch);
+	ATF_TP_ADD_TC(tp, udp_purge);
+	ATF_TP_ADD_TC(tp, udp_recvcancel);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v4);
 	ATF_TP_ADD_TC(tp, tcp_dscp_v6);
 	ATF_TP_ADD_TC(tp, udp_dscp_v4);
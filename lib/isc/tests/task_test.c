@@ -736,6 +736,136 @@ ATF_TC_BODY(manytasks, tc) {
 }
 
 
+/*
+ * Work stealing test:
+ * Each task belongs to one worker's ready queue.  While one worker is
+ * blocked running a task, the tasks queued behind it must be taken and
+ * run by the other worker.
+ */
+
+static bool blocking = false;
+static int nstolen = 0;
+
+static void
+steal_block(isc_task_t *task, isc_event_t *event) {
+	isc_interval_t interval;
+	isc_time_t when;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	UNUSED(task);
+
+	isc_interval_set(&interval, 10, 0);
+	result = isc_time_nowplusinterval(&when, &interval);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	LOCK(&lock);
+	blocking = true;
+	BROADCAST(&cv);
+	while (!done && result == ISC_R_SUCCESS)
+		result = WAITUNTIL(&cv, &lock, &when);
+	blocking = false;
+	UNLOCK(&lock);
+
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	isc_event_free(&event);
+}
+
+static void
+steal_count(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	LOCK(&lock);
+	ATF_CHECK(blocking);
+	nstolen++;
+	BROADCAST(&cv);
+	UNLOCK(&lock);
+
+	isc_event_free(&event);
+}
+
+ATF_TC(steal);
+ATF_TC_HEAD(steal, tc) {
+	atf_tc_set_md_var(tc, "descr", "idle workers steal ready tasks");
+}
+ATF_TC_BODY(steal, tc) {
+	isc_result_t result;
+	isc_task_t *blocker = NULL;
+	isc_task_t *tasks[8];
+	isc_event_t *event = NULL;
+	isc_interval_t interval;
+	isc_time_t when;
+	int i;
+
+	UNUSED(tc);
+
+	done = false;
+	blocking = false;
+	nstolen = 0;
+
+	result = isc_test_begin(NULL, true, 2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_condition_init(&cv);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Tie up one of the two workers.
+	 */
+	result = isc_task_create(taskmgr, 0, &blocker);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	event = isc_event_allocate(mctx, blocker, ISC_TASKEVENT_TEST,
+				   steal_block, NULL, sizeof(*event));
+	ATF_REQUIRE(event != NULL);
+
+	LOCK(&lock);
+	isc_task_send(blocker, &event);
+	while (!blocking)
+		WAIT(&cv, &lock);
+	UNLOCK(&lock);
+
+	/*
+	 * Tasks are spread over both queues, so about half of these
+	 * are queued behind the blocked worker.
+	 */
+	for (i = 0; i < 8; i++) {
+		tasks[i] = NULL;
+		result = isc_task_create(taskmgr, 0, &tasks[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		event = isc_event_allocate(mctx, tasks[i], ISC_TASKEVENT_TEST,
+					   steal_count, NULL, sizeof(*event));
+		ATF_REQUIRE(event != NULL);
+		isc_task_send(tasks[i], &event);
+	}
+
+	isc_interval_set(&interval, 5, 0);
+	result = isc_time_nowplusinterval(&when, &interval);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	LOCK(&lock);
+	while (nstolen < 8 && result == ISC_R_SUCCESS)
+		result = WAITUNTIL(&cv, &lock, &when);
+	ATF_CHECK_EQ(nstolen, 8);
+
+	done = true;
+	BROADCAST(&cv);
+	UNLOCK(&lock);
+
+	for (i = 0; i < 8; i++)
+		isc_task_detach(&tasks[i]);
+	isc_task_detach(&blocker);
+
+	isc_test_end();
+	DESTROYLOCK(&lock);
+	(void) isc_condition_destroy(&cv);
+}
+
+
 /*
  * Shutdown test:
  * When isc_task_shutdown() is called, shutdown events are posted
@@ -1461,6 +1591,7 @@ ATF_TP_ADD_TCS(tp) {
 
 #ifdef ISC_PLATFORM_USETHREADS
 	ATF_TP_ADD_TC(tp, manytasks);
+	ATF_TP_ADD_TC(tp, steal);
 	ATF_TP_ADD_TC(tp, shutdown);
 	ATF_TP_ADD_TC(tp, post_shutdown);
 	ATF_TP_ADD_TC(tp, purge);
@@ -564,6 +564,116 @@ ATF_TC_BODY(purge, tc) {
 
 	isc_test_end();
 }
+
+/*
+ * Many timers test:
+ * Timers spread over the timer wheels fire once each, never before
+ * they are due, and timers made inactive don't fire at all.
+ */
+
+#define NTIMERS 500
+
+static isc_timer_t *timers[NTIMERS];
+static int nfired;
+static int nearly;
+
+static void
+many_event(isc_task_t *task, isc_event_t *event) {
+	isc_timerevent_t *tevent = (isc_timerevent_t *)event;
+	isc_time_t now;
+
+	UNUSED(task);
+
+	TIME_NOW(&now);
+
+	LOCK(&mx);
+	if (event->ev_type != ISC_TIMEREVENT_LIFE ||
+	    isc_time_compare(&now, &tevent->due) < 0)
+		nearly++;
+	nfired++;
+	SIGNAL(&cv);
+	UNLOCK(&mx);
+
+	isc_event_free(&event);
+}
+
+ATF_TC(manytimers);
+ATF_TC_HEAD(manytimers, tc) {
+	atf_tc_set_md_var(tc, "descr", "many timers");
+}
+ATF_TC_BODY(manytimers, tc) {
+	isc_result_t result;
+	isc_task_t *task = NULL;
+	isc_time_t now, expires;
+	isc_interval_t interval;
+	int i, ncanceled = 0;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, true, 2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	nfired = 0;
+	nearly = 0;
+
+	result = isc_mutex_init(&mx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_condition_init(&cv);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	TIME_NOW(&now);
+	for (i = 0; i < NTIMERS; i++) {
+		isc_interval_set(&interval, 0, 100000000 +
+				 (i % 50) * 7000000 + (i * 13 % 1000) * 1000);
+		result = isc_time_add(&now, &interval, &expires);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		timers[i] = NULL;
+		result = isc_timer_create(timermgr, isc_timertype_once,
+					  &expires, NULL, task, many_event,
+					  NULL, &timers[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Cancel every fifth timer.
+	 */
+	LOCK(&mx);
+	for (i = 0; i < NTIMERS; i += 5) {
+		result = isc_timer_reset(timers[i], isc_timertype_inactive,
+					 NULL, NULL, true);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ncanceled++;
+	}
+
+	while (nfired < NTIMERS - ncanceled) {
+		result = isc_condition_wait(&cv, &mx);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	UNLOCK(&mx);
+
+	/*
+	 * Give any canceled timer a chance to fire anyway.
+	 */
+	isc_test_nap(500000);
+
+	LOCK(&mx);
+	ATF_CHECK_EQ(nfired, NTIMERS - ncanceled);
+	ATF_CHECK_EQ(nearly, 0);
+	UNLOCK(&mx);
+
+	for (i = 0; i < NTIMERS; i++)
+		isc_timer_detach(&timers[i]);
+	isc_task_detach(&task);
+	DESTROYLOCK(&mx);
+	(void) isc_condition_destroy(&cv);
+
+	isc_test_end();
+}
 #else
 ATF_TC(untested);
 ATF_TC_HEAD(untested, tc) {
@@ -585,6 +695,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, once_idle);
 	ATF_TP_ADD_TC(tp, reset);
 	ATF_TP_ADD_TC(tp, purge);
+	ATF_TP_ADD_TC(tp, manytimers);
 #else
 	ATF_TP_ADD_TC(tp, untested);
 #endif
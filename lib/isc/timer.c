@@ -14,16 +14,17 @@
 
 #include <config.h>
 
+#include <inttypes.h>
 #include <stdbool.h>
 
 #include <isc/app.h>
 #include <isc/condition.h>
-#include <isc/heap.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/msgs.h>
 #include <isc/once.h>
+#include <isc/os.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/task.h>
@@ -67,50 +68,99 @@
 #define TIMER_MAGIC			ISC_MAGIC('T', 'I', 'M', 'R')
 #define VALID_TIMER(t)			ISC_MAGIC_VALID(t, TIMER_MAGIC)
 
+/*%
+ * Scheduled timers are kept in a hierarchical timing wheel.  Each
+ * level has WHEEL_SIZE slots; a slot of level 0 holds the timers due
+ * in one tick, and a slot of level N spans WHEEL_SIZE slots of level
+ * N - 1.  When the wheel turns past the end of a level's range, the
+ * next slot of the level above is emptied into the levels below it.
+ *
+ * Due times are rounded up to the next tick, so timers never fire
+ * early; timers further out than the wheel reaches are parked in the
+ * last slot and rescheduled when they come around.
+ */
+#define WHEEL_BITS			6
+#define WHEEL_SIZE			(1 << WHEEL_BITS)
+#define WHEEL_MASK			(WHEEL_SIZE - 1)
+#define WHEEL_LEVELS			6
+#define WHEEL_MAXTICKS			(((uint64_t)1 << \
+					  (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+#define WHEEL_SHIFT(level)		((level) * WHEEL_BITS)
+
+#define NS_PER_S			1000000000
+#define NS_PER_TICK			1000000		/* 1 ms */
+#define TICKS_PER_S			(NS_PER_S / NS_PER_TICK)
+
+#define NOTICK				0xffffffffffffffffULL
+
+/*%
+ * Maximum number of timer wheels, each with its own lock and thread.
+ */
+#define TIMER_MAXWHEELS			8
+
 typedef struct isc__timer isc__timer_t;
 typedef struct isc__timermgr isc__timermgr_t;
+typedef struct isc__timerwheel isc__timerwheel_t;
+typedef ISC_LIST(isc__timer_t) isc__timerlist_t;
 
 struct isc__timer {
 	/*! Not locked. */
 	isc_timer_t			common;
 	isc__timermgr_t *		manager;
+	isc__timerwheel_t *		wheel;
 	isc_mutex_t			lock;
 	/*! Locked by timer lock. */
 	unsigned int			references;
 	isc_time_t			idle;
-	/*! Locked by manager lock. */
+	/*! Locked by wheel lock. */
 	isc_timertype_t			type;
 	isc_time_t			expires;
 	isc_interval_t			interval;
 	isc_task_t *			task;
 	isc_taskaction_t		action;
 	void *				arg;
-	unsigned int			index;
 	isc_time_t			due;
+	uint64_t			tick;
+	isc__timerlist_t *		slot;
+	LINK(isc__timer_t)		slotlink;
 	LINK(isc__timer_t)		link;
 };
 
 #define TIMER_MANAGER_MAGIC		ISC_MAGIC('T', 'I', 'M', 'M')
 #define VALID_MANAGER(m)		ISC_MAGIC_VALID(m, TIMER_MANAGER_MAGIC)
 
-struct isc__timermgr {
+struct isc__timerwheel {
 	/* Not locked. */
-	isc_timermgr_t			common;
-	isc_mem_t *			mctx;
+	isc__timermgr_t *		manager;
+	unsigned int			id;
 	isc_mutex_t			lock;
-	/* Locked by manager lock. */
-	bool			done;
+	/* Locked by wheel lock. */
 	LIST(isc__timer_t)		timers;
 	unsigned int			nscheduled;
+	uint64_t			curtick;
+	uint64_t			duetick;
 	isc_time_t			due;
+	uint64_t			bitmap[WHEEL_LEVELS];
+	isc__timerlist_t		slots[WHEEL_LEVELS][WHEEL_SIZE];
 #ifdef USE_TIMER_THREAD
 	isc_condition_t			wakeup;
 	isc_thread_t			thread;
 #endif	/* USE_TIMER_THREAD */
+};
+
+struct isc__timermgr {
+	/* Not locked. */
+	isc_timermgr_t			common;
+	isc_mem_t *			mctx;
+	isc_mutex_t			lock;
+	unsigned int			nwheels;
+	isc__timerwheel_t *		wheels;
+	/* Written with all wheel locks held. */
+	bool			done;
 #ifdef USE_SHARED_MANAGER
+	/* Locked by manager lock. */
 	unsigned int			refs;
 #endif /* USE_SHARED_MANAGER */
-	isc_heap_t *			heap;
 };
 
 /*%
@@ -178,12 +228,210 @@ static struct isc__timermgrmethods {
 static isc__timermgr_t *timermgr = NULL;
 #endif /* USE_SHARED_MANAGER */
 
+/*
+ * Convert between times and wheel ticks.  time_to_tick() rounds up,
+ * so that the tick of a due time is never before it.
+ */
+static inline uint64_t
+time_to_tick(const isc_time_t *t) {
+	uint64_t ns;
+
+	ns = (uint64_t)isc_time_seconds(t) * NS_PER_S +
+		isc_time_nanoseconds(t);
+	return ((ns + NS_PER_TICK - 1) / NS_PER_TICK);
+}
+
+static inline uint64_t
+now_to_tick(const isc_time_t *t) {
+	return ((uint64_t)isc_time_seconds(t) * TICKS_PER_S +
+		isc_time_nanoseconds(t) / NS_PER_TICK);
+}
+
+static inline void
+tick_to_time(uint64_t tick, isc_time_t *t) {
+	isc_time_set(t, (unsigned int)(tick / TICKS_PER_S),
+		     (unsigned int)(tick % TICKS_PER_S) * NS_PER_TICK);
+}
+
+/*
+ * Return the index of the first non-empty slot in 'bitmap' at or
+ * after 'start', wrapping around, or -1 if all slots are empty.
+ */
+static inline int
+first_slot(uint64_t bitmap, unsigned int start) {
+	uint64_t rotated;
+	unsigned int i;
+
+	if (bitmap == 0)
+		return (-1);
+	rotated = (start == 0) ? bitmap :
+		  ((bitmap >> start) | (bitmap << (WHEEL_SIZE - start)));
+	for (i = 0; (rotated & 1) == 0; i++)
+		rotated >>= 1;
+	return ((int)((start + i) & WHEEL_MASK));
+}
+
+/*
+ * Put 'timer' in the slot for its tick.
+ *
+ * Caller must hold the wheel lock.
+ */
+static void
+wheel_insert(isc__timerwheel_t *wheel, isc__timer_t *timer) {
+	uint64_t tick, delta;
+	unsigned int level, slot;
+
+	tick = timer->tick;
+	if (tick < wheel->curtick)
+		tick = wheel->curtick;
+	delta = tick - wheel->curtick;
+	if (delta > WHEEL_MAXTICKS) {
+		delta = WHEEL_MAXTICKS;
+		tick = wheel->curtick + WHEEL_MAXTICKS;
+	}
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++)
+		if (delta < ((uint64_t)1 << WHEEL_SHIFT(level + 1)))
+			break;
+	slot = (tick >> WHEEL_SHIFT(level)) & WHEEL_MASK;
+
+	timer->slot = &wheel->slots[level][slot];
+	APPEND(*timer->slot, timer, slotlink);
+	wheel->bitmap[level] |= (uint64_t)1 << slot;
+}
+
+/*
+ * Take 'timer' out of its slot.
+ *
+ * Caller must hold the wheel lock.
+ */
+static void
+wheel_remove(isc__timerwheel_t *wheel, isc__timer_t *timer) {
+	unsigned int n;
+
+	UNLINK(*timer->slot, timer, slotlink);
+	if (EMPTY(*timer->slot)) {
+		n = (unsigned int)(timer->slot - &wheel->slots[0][0]);
+		wheel->bitmap[n / WHEEL_SIZE] &=
+			~((uint64_t)1 << (n % WHEEL_SIZE));
+	}
+	timer->slot = NULL;
+}
+
+/*
+ * Return the first tick, not before the current one, at which the
+ * wheel has something to do: either run the timers of a level 0 slot,
+ * or empty a slot of a higher level into the levels below.
+ *
+ * Caller must hold the wheel lock.
+ */
+static uint64_t
+wheel_next(isc__timerwheel_t *wheel) {
+	uint64_t next = NOTICK, block, tick;
+	unsigned int level;
+	int slot;
+
+	slot = first_slot(wheel->bitmap[0], wheel->curtick & WHEEL_MASK);
+	if (slot >= 0)
+		next = wheel->curtick +
+			((slot - wheel->curtick) & WHEEL_MASK);
+
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		/*
+		 * The slots of this level are emptied at the start of
+		 * each of its blocks.  If the current tick is past the
+		 * start of its block, that block's slot has been emptied
+		 * already.
+		 */
+		block = wheel->curtick >> WHEEL_SHIFT(level);
+		if ((wheel->curtick &
+		     (((uint64_t)1 << WHEEL_SHIFT(level)) - 1)) != 0)
+			block++;
+		slot = first_slot(wheel->bitmap[level], block & WHEEL_MASK);
+		if (slot < 0)
+			continue;
+		block += (slot - block) & WHEEL_MASK;
+		tick = block << WHEEL_SHIFT(level);
+		if (tick < next)
+			next = tick;
+	}
+
+	return (next);
+}
+
+/*
+ * Turn the wheel up to and including 'tick', moving the timers that
+ * are due onto 'expired'.
+ *
+ * Caller must hold the wheel lock.
+ */
+static void
+wheel_advance(isc__timerwheel_t *wheel, uint64_t tick,
+	      isc__timerlist_t *expired)
+{
+	isc__timerlist_t cascade;
+	isc__timer_t *timer;
+	unsigned int level, slot;
+	uint64_t next;
+
+	while ((next = wheel_next(wheel)) <= tick) {
+		wheel->curtick = next;
+
+		/*
+		 * At the start of a block, empty the next slot of each
+		 * level whose block starts here too.
+		 */
+		for (level = 1; level < WHEEL_LEVELS; level++) {
+			if (((next >> WHEEL_SHIFT(level - 1)) & WHEEL_MASK) != 0)
+				break;
+			slot = (next >> WHEEL_SHIFT(level)) & WHEEL_MASK;
+			cascade = wheel->slots[level][slot];
+			INIT_LIST(wheel->slots[level][slot]);
+			wheel->bitmap[level] &= ~((uint64_t)1 << slot);
+			while ((timer = HEAD(cascade)) != NULL) {
+				UNLINK(cascade, timer, slotlink);
+				wheel_insert(wheel, timer);
+			}
+		}
+
+		slot = next & WHEEL_MASK;
+		while ((timer = HEAD(wheel->slots[0][slot])) != NULL) {
+			wheel_remove(wheel, timer);
+			APPEND(*expired, timer, slotlink);
+		}
+
+		wheel->curtick = next + 1;
+	}
+
+	/*
+	 * Nothing else is due up to 'tick'.  The wheel never turns back,
+	 * should the clock do so.
+	 */
+	if (tick >= wheel->curtick)
+		wheel->curtick = tick + 1;
+}
+
+/*
+ * Set the time the wheel's thread has to wake up for its next timer.
+ *
+ * Caller must hold the wheel lock.
+ */
+static inline void
+wheel_setdue(isc__timerwheel_t *wheel) {
+	if (wheel->nscheduled == 0) {
+		wheel->duetick = NOTICK;
+		isc_time_settoepoch(&wheel->due);
+		return;
+	}
+	wheel->duetick = wheel_next(wheel);
+	tick_to_time(wheel->duetick, &wheel->due);
+}
+
 static inline isc_result_t
 schedule(isc__timer_t *timer, isc_time_t *now, bool signal_ok) {
 	isc_result_t result;
-	isc__timermgr_t *manager;
+	isc__timerwheel_t *wheel;
 	isc_time_t due;
-	int cmp;
 #ifdef USE_TIMER_THREAD
 	bool timedwait;
 #endif
@@ -198,15 +446,15 @@ schedule(isc__timer_t *timer, isc_time_t *now, bool signal_ok) {
 	UNUSED(signal_ok);
 #endif /* USE_TIMER_THREAD */
 
-	manager = timer->manager;
+	wheel = timer->wheel;
 
 #ifdef USE_TIMER_THREAD
 	/*!
-	 * If the manager was timed wait, we may need to signal the
-	 * manager to force a wakeup.
+	 * If the wheel's thread was timed wait, we may need to signal it
+	 * to force a wakeup.
 	 */
-	timedwait = (manager->nscheduled > 0 &&
-		     isc_time_seconds(&manager->due) != 0);
+	timedwait = (wheel->nscheduled > 0 &&
+		     isc_time_seconds(&wheel->due) != 0);
 #endif
 
 	/*
@@ -234,41 +482,25 @@ schedule(isc__timer_t *timer, isc_time_t *now, bool signal_ok) {
 	 * Schedule the timer.
 	 */
 
-	if (timer->index > 0) {
+	if (timer->slot != NULL) {
 		/*
 		 * Already scheduled.
 		 */
-		cmp = isc_time_compare(&due, &timer->due);
-		timer->due = due;
-		switch (cmp) {
-		case -1:
-			isc_heap_increased(manager->heap, timer->index);
-			break;
-		case 1:
-			isc_heap_decreased(manager->heap, timer->index);
-			break;
-		case 0:
-			/* Nothing to do. */
-			break;
-		}
-	} else {
-		timer->due = due;
-		result = isc_heap_insert(manager->heap, timer);
-		if (result != ISC_R_SUCCESS) {
-			INSIST(result == ISC_R_NOMEMORY);
-			return (ISC_R_NOMEMORY);
-		}
-		manager->nscheduled++;
-	}
+		wheel_remove(wheel, timer);
+	} else
+		wheel->nscheduled++;
+	timer->due = due;
+	timer->tick = time_to_tick(&due);
+	wheel_insert(wheel, timer);
 
 	XTRACETIMER(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 				   ISC_MSG_SCHEDULE, "schedule"), timer, due);
 
 	/*
-	 * If this timer is at the head of the queue, we need to ensure
-	 * that we won't miss it if it has a more recent due time than
-	 * the current "next" timer.  We do this either by waking up the
-	 * run thread, or explicitly setting the value in the manager.
+	 * If this timer is due before the time the wheel is waiting for,
+	 * we need to ensure that we won't miss it.  We do this either by
+	 * waking up the run thread, or explicitly setting the value in
+	 * the wheel.
 	 */
 #ifdef USE_TIMER_THREAD
 
@@ -285,11 +517,11 @@ schedule(isc__timer_t *timer, isc_time_t *now, bool signal_ok) {
 		isc_time_t then;
 
 		isc_interval_set(&fifteen, 15, 0);
-		result = isc_time_add(&manager->due, &fifteen, &then);
+		result = isc_time_add(&wheel->due, &fifteen, &then);
 
 		if (result == ISC_R_SUCCESS &&
 		    isc_time_compare(&then, now) < 0) {
-			SIGNAL(&manager->wakeup);
+			SIGNAL(&wheel->wakeup);
 			signal_ok = false;
 			isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL,
 				      ISC_LOGMODULE_TIMER, ISC_LOG_WARNING,
@@ -297,16 +529,18 @@ schedule(isc__timer_t *timer, isc_time_t *now, bool signal_ok) {
 		}
 	}
 
-	if (timer->index == 1 && signal_ok) {
+	if (timer->tick < wheel->duetick && signal_ok) {
 		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 				      ISC_MSG_SIGNALSCHED,
 				      "signal (schedule)"));
-		SIGNAL(&manager->wakeup);
+		wheel->duetick = timer->tick;
+		SIGNAL(&wheel->wakeup);
 	}
 #else /* USE_TIMER_THREAD */
-	if (timer->index == 1 &&
-	    isc_time_compare(&timer->due, &manager->due) < 0)
-		manager->due = timer->due;
+	if (timer->tick < wheel->duetick) {
+		wheel->duetick = timer->tick;
+		tick_to_time(wheel->duetick, &wheel->due);
+	}
 #endif /* USE_TIMER_THREAD */
 
 	return (ISC_R_SUCCESS);
@@ -314,45 +548,33 @@ schedule(isc__timer_t *timer, isc_time_t *now, bool signal_ok) {
 
 static inline void
 deschedule(isc__timer_t *timer) {
-#ifdef USE_TIMER_THREAD
-	bool need_wakeup = false;
-#endif
-	isc__timermgr_t *manager;
+	isc__timerwheel_t *wheel;
 
 	/*
 	 * The caller must ensure locking.
+	 *
+	 * There is no need to wake up the wheel's thread: if it was
+	 * waiting for this timer, it will find nothing to do.
 	 */
 
-	manager = timer->manager;
-	if (timer->index > 0) {
-#ifdef USE_TIMER_THREAD
-		if (timer->index == 1)
-			need_wakeup = true;
-#endif
-		isc_heap_delete(manager->heap, timer->index);
-		timer->index = 0;
-		INSIST(manager->nscheduled > 0);
-		manager->nscheduled--;
-#ifdef USE_TIMER_THREAD
-		if (need_wakeup) {
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
-					      ISC_MSG_SIGNALDESCHED,
-					      "signal (deschedule)"));
-			SIGNAL(&manager->wakeup);
-		}
-#endif /* USE_TIMER_THREAD */
+	wheel = timer->wheel;
+	if (timer->slot != NULL) {
+		wheel_remove(wheel, timer);
+		INSIST(wheel->nscheduled > 0);
+		wheel->nscheduled--;
 	}
 }
 
 static void
 destroy(isc__timer_t *timer) {
 	isc__timermgr_t *manager = timer->manager;
+	isc__timerwheel_t *wheel = timer->wheel;
 
 	/*
 	 * The caller must ensure it is safe to destroy the timer.
 	 */
 
-	LOCK(&manager->lock);
+	LOCK(&wheel->lock);
 
 	(void)isc_task_purgerange(timer->task,
 				  timer,
@@ -360,9 +582,9 @@ destroy(isc__timer_t *timer) {
 				  ISC_TIMEREVENT_LASTEVENT,
 				  NULL);
 	deschedule(timer);
-	UNLINK(manager->timers, timer, link);
+	UNLINK(wheel->timers, timer, link);
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&wheel->lock);
 
 	isc_task_detach(&timer->task);
 	DESTROYLOCK(&timer->lock);
@@ -423,6 +645,12 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 		return (ISC_R_NOMEMORY);
 
 	timer->manager = manager;
+	/*
+	 * Spread timers over the wheels by address, which is as good as
+	 * round robin and doesn't need a shared counter.
+	 */
+	timer->wheel = &manager->wheels[((uintptr_t)timer / sizeof(*timer)) %
+					manager->nwheels];
 	timer->references = 1;
 
 	if (type == isc_timertype_once && !isc_interval_iszero(interval)) {
@@ -451,7 +679,9 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	 * keep track of whether arg started as a true const.
 	 */
 	DE_CONST(arg, timer->arg);
-	timer->index = 0;
+	timer->tick = 0;
+	timer->slot = NULL;
+	ISC_LINK_INIT(timer, slotlink);
 	result = isc_mutex_init(&timer->lock);
 	if (result != ISC_R_SUCCESS) {
 		isc_task_detach(&timer->task);
@@ -463,7 +693,7 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	timer->common.magic = ISCAPI_TIMER_MAGIC;
 	timer->common.methods = (isc_timermethods_t *)&timermethods;
 
-	LOCK(&manager->lock);
+	LOCK(&timer->wheel->lock);
 
 	/*
 	 * Note we don't have to lock the timer like we normally would because
@@ -475,9 +705,9 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	else
 		result = ISC_R_SUCCESS;
 	if (result == ISC_R_SUCCESS)
-		APPEND(manager->timers, timer, link);
+		APPEND(timer->wheel->timers, timer, link);
 
-	UNLOCK(&manager->lock);
+	UNLOCK(&timer->wheel->lock);
 
 	if (result != ISC_R_SUCCESS) {
 		timer->common.impmagic = 0;
@@ -536,7 +766,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 		isc_time_settoepoch(&now);
 	}
 
-	LOCK(&manager->lock);
+	LOCK(&timer->wheel->lock);
 	LOCK(&timer->lock);
 
 	if (purge)
@@ -564,7 +794,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 	}
 
 	UNLOCK(&timer->lock);
-	UNLOCK(&manager->lock);
+	UNLOCK(&timer->wheel->lock);
 
 	return (result);
 }
@@ -659,122 +889,132 @@ isc__timer_detach(isc_timer_t **timerp) {
 }
 
 static void
-dispatch(isc__timermgr_t *manager, isc_time_t *now) {
-	bool done = false, post_event, need_schedule;
+dispatch(isc__timerwheel_t *wheel, isc_time_t *now) {
+	bool post_event, need_schedule;
 	isc_timerevent_t *event;
 	isc_eventtype_t type = 0;
 	isc__timer_t *timer;
+	isc__timerlist_t expired;
 	isc_result_t result;
 	bool idle;
 
 	/*!
-	 * The caller must be holding the manager lock.
+	 * The caller must be holding the wheel lock.
 	 */
 
-	while (manager->nscheduled > 0 && !done) {
-		timer = isc_heap_element(manager->heap, 1);
-		INSIST(timer != NULL && timer->type != isc_timertype_inactive);
-		if (isc_time_compare(now, &timer->due) >= 0) {
-			if (timer->type == isc_timertype_ticker) {
-				type = ISC_TIMEREVENT_TICK;
-				post_event = true;
-				need_schedule = true;
-			} else if (timer->type == isc_timertype_limited) {
-				int cmp;
-				cmp = isc_time_compare(now, &timer->expires);
-				if (cmp >= 0) {
-					type = ISC_TIMEREVENT_LIFE;
-					post_event = true;
-					need_schedule = false;
-				} else {
-					type = ISC_TIMEREVENT_TICK;
-					post_event = true;
-					need_schedule = true;
-				}
-			} else if (!isc_time_isepoch(&timer->expires) &&
-				   isc_time_compare(now,
-						    &timer->expires) >= 0) {
+	INIT_LIST(expired);
+	if (wheel->nscheduled > 0)
+		wheel_advance(wheel, now_to_tick(now), &expired);
+
+	while ((timer = HEAD(expired)) != NULL) {
+		UNLINK(expired, timer, slotlink);
+		wheel->nscheduled--;
+		INSIST(timer->type != isc_timertype_inactive);
+
+		if (isc_time_compare(now, &timer->due) < 0) {
+			/*
+			 * Due beyond the reach of the wheel; put it
+			 * back for another turn.
+			 */
+			wheel_insert(wheel, timer);
+			wheel->nscheduled++;
+			continue;
+		}
+
+		if (timer->type == isc_timertype_ticker) {
+			type = ISC_TIMEREVENT_TICK;
+			post_event = true;
+			need_schedule = true;
+		} else if (timer->type == isc_timertype_limited) {
+			int cmp;
+			cmp = isc_time_compare(now, &timer->expires);
+			if (cmp >= 0) {
 				type = ISC_TIMEREVENT_LIFE;
 				post_event = true;
 				need_schedule = false;
 			} else {
-				idle = false;
-
-				LOCK(&timer->lock);
-				if (!isc_time_isepoch(&timer->idle) &&
-				    isc_time_compare(now,
-						     &timer->idle) >= 0) {
-					idle = true;
-				}
-				UNLOCK(&timer->lock);
-				if (idle) {
-					type = ISC_TIMEREVENT_IDLE;
-					post_event = true;
-					need_schedule = false;
-				} else {
-					/*
-					 * Idle timer has been touched;
-					 * reschedule.
-					 */
-					XTRACEID(isc_msgcat_get(isc_msgcat,
-								ISC_MSGSET_TIMER,
-								ISC_MSG_IDLERESCHED,
-								"idle reschedule"),
-						 timer);
-					post_event = false;
-					need_schedule = true;
-				}
+				type = ISC_TIMEREVENT_TICK;
+				post_event = true;
+				need_schedule = true;
 			}
+		} else if (!isc_time_isepoch(&timer->expires) &&
+			   isc_time_compare(now,
+					    &timer->expires) >= 0) {
+			type = ISC_TIMEREVENT_LIFE;
+			post_event = true;
+			need_schedule = false;
+		} else {
+			idle = false;
 
-			if (post_event) {
-				XTRACEID(isc_msgcat_get(isc_msgcat,
-							ISC_MSGSET_TIMER,
-							ISC_MSG_POSTING,
-							"posting"), timer);
+			LOCK(&timer->lock);
+			if (!isc_time_isepoch(&timer->idle) &&
+			    isc_time_compare(now,
+					     &timer->idle) >= 0) {
+				idle = true;
+			}
+			UNLOCK(&timer->lock);
+			if (idle) {
+				type = ISC_TIMEREVENT_IDLE;
+				post_event = true;
+				need_schedule = false;
+			} else {
 				/*
-				 * XXX We could preallocate this event.
+				 * Idle timer has been touched;
+				 * reschedule.
 				 */
-				event = (isc_timerevent_t *)isc_event_allocate(manager->mctx,
-							   timer,
-							   type,
-							   timer->action,
-							   timer->arg,
-							   sizeof(*event));
-
-				if (event != NULL) {
-					event->due = timer->due;
-					isc_task_send(timer->task,
-						      ISC_EVENT_PTR(&event));
-				} else
-					UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
-						 isc_msgcat_get(isc_msgcat,
-							 ISC_MSGSET_TIMER,
-							 ISC_MSG_EVENTNOTALLOC,
-							 "couldn't "
-							 "allocate event"));
+				XTRACEID(isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_TIMER,
+							ISC_MSG_IDLERESCHED,
+							"idle reschedule"),
+					 timer);
+				post_event = false;
+				need_schedule = true;
 			}
+		}
 
-			timer->index = 0;
-			isc_heap_delete(manager->heap, 1);
-			manager->nscheduled--;
+		if (post_event) {
+			XTRACEID(isc_msgcat_get(isc_msgcat,
+						ISC_MSGSET_TIMER,
+						ISC_MSG_POSTING,
+						"posting"), timer);
+			/*
+			 * XXX We could preallocate this event.
+			 */
+			event = (isc_timerevent_t *)isc_event_allocate(wheel->manager->mctx,
+						   timer,
+						   type,
+						   timer->action,
+						   timer->arg,
+						   sizeof(*event));
+
+			if (event != NULL) {
+				event->due = timer->due;
+				isc_task_send(timer->task,
+					      ISC_EVENT_PTR(&event));
+			} else
+				UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
+					 isc_msgcat_get(isc_msgcat,
+						 ISC_MSGSET_TIMER,
+						 ISC_MSG_EVENTNOTALLOC,
+						 "couldn't "
+						 "allocate event"));
+		}
 
-			if (need_schedule) {
-				result = schedule(timer, now, false);
-				if (result != ISC_R_SUCCESS)
-					UNEXPECTED_ERROR(__FILE__, __LINE__,
-							 "%s: %u",
-						isc_msgcat_get(isc_msgcat,
-							ISC_MSGSET_TIMER,
-							ISC_MSG_SCHEDFAIL,
-							"couldn't schedule "
-							"timer"),
-							 result);
-			}
-		} else {
-			manager->due = timer->due;
-			done = true;
+		if (need_schedule) {
+			result = schedule(timer, now, false);
+			if (result != ISC_R_SUCCESS)
+				UNEXPECTED_ERROR(__FILE__, __LINE__,
+						 "%s: %u",
+					isc_msgcat_get(isc_msgcat,
+						ISC_MSGSET_TIMER,
+						ISC_MSG_SCHEDFAIL,
+						"couldn't schedule "
+						"timer"),
+						 result);
 		}
 	}
+
+	wheel_setdue(wheel);
 }
 
 #ifdef USE_TIMER_THREAD
@@ -783,11 +1023,12 @@ static isc_threadresult_t
 WINAPI
 #endif
 run(void *uap) {
-	isc__timermgr_t *manager = uap;
+	isc__timerwheel_t *wheel = uap;
+	isc__timermgr_t *manager = wheel->manager;
 	isc_time_t now;
 	isc_result_t result;
 
-	LOCK(&manager->lock);
+	LOCK(&wheel->lock);
 	while (!manager->done) {
 		TIME_NOW(&now);
 
@@ -795,26 +1036,26 @@ run(void *uap) {
 					  ISC_MSG_RUNNING,
 					  "running"), now);
 
-		dispatch(manager, &now);
+		dispatch(wheel, &now);
 
-		if (manager->nscheduled > 0) {
+		if (wheel->nscheduled > 0) {
 			XTRACETIME2(isc_msgcat_get(isc_msgcat,
 						   ISC_MSGSET_GENERAL,
 						   ISC_MSG_WAITUNTIL,
 						   "waituntil"),
-				    manager->due, now);
-			result = WAITUNTIL(&manager->wakeup, &manager->lock, &manager->due);
+				    wheel->due, now);
+			result = WAITUNTIL(&wheel->wakeup, &wheel->lock, &wheel->due);
 			INSIST(result == ISC_R_SUCCESS ||
 			       result == ISC_R_TIMEDOUT);
 		} else {
 			XTRACETIME(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						  ISC_MSG_WAIT, "wait"), now);
-			WAIT(&manager->wakeup, &manager->lock);
+			WAIT(&wheel->wakeup, &wheel->lock);
 		}
 		XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 				      ISC_MSG_WAKEUP, "wakeup"));
 	}
-	UNLOCK(&manager->lock);
+	UNLOCK(&wheel->lock);
 
 #ifdef OPENSSL_LEAKS
 	ERR_remove_state(0);
@@ -824,34 +1065,75 @@ run(void *uap) {
 }
 #endif /* USE_TIMER_THREAD */
 
-static bool
-sooner(void *v1, void *v2) {
-	isc__timer_t *t1, *t2;
+static isc_result_t
+wheel_init(isc__timermgr_t *manager, isc__timerwheel_t *wheel,
+	   unsigned int id)
+{
+	isc_result_t result;
+	isc_time_t now;
+	unsigned int level, slot;
 
-	t1 = v1;
-	t2 = v2;
-	REQUIRE(VALID_TIMER(t1));
-	REQUIRE(VALID_TIMER(t2));
+	wheel->manager = manager;
+	wheel->id = id;
+	result = isc_mutex_init(&wheel->lock);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+#ifdef USE_TIMER_THREAD
+	if (isc_condition_init(&wheel->wakeup) != ISC_R_SUCCESS) {
+		DESTROYLOCK(&wheel->lock);
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_condition_init() %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+		return (ISC_R_UNEXPECTED);
+	}
+#endif /* USE_TIMER_THREAD */
+	INIT_LIST(wheel->timers);
+	wheel->nscheduled = 0;
+	TIME_NOW(&now);
+	wheel->curtick = now_to_tick(&now);
+	wheel->duetick = NOTICK;
+	isc_time_settoepoch(&wheel->due);
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		wheel->bitmap[level] = 0;
+		for (slot = 0; slot < WHEEL_SIZE; slot++)
+			INIT_LIST(wheel->slots[level][slot]);
+	}
 
-	if (isc_time_compare(&t1->due, &t2->due) < 0)
-		return (true);
-	return (false);
+	return (ISC_R_SUCCESS);
 }
 
 static void
-set_index(void *what, unsigned int index) {
-	isc__timer_t *timer;
-
-	timer = what;
-	REQUIRE(VALID_TIMER(timer));
+wheel_destroy(isc__timerwheel_t *wheel) {
+	REQUIRE(EMPTY(wheel->timers));
+	INSIST(wheel->nscheduled == 0);
+#ifdef USE_TIMER_THREAD
+	(void)isc_condition_destroy(&wheel->wakeup);
+#endif /* USE_TIMER_THREAD */
+	DESTROYLOCK(&wheel->lock);
+}
 
-	timer->index = index;
+static void
+manager_free(isc__timermgr_t *manager, unsigned int nwheels) {
+	isc_mem_t *mctx = manager->mctx;
+	unsigned int i;
+
+	for (i = 0; i < nwheels; i++)
+		wheel_destroy(&manager->wheels[i]);
+	isc_mem_put(mctx, manager->wheels,
+		    manager->nwheels * sizeof(isc__timerwheel_t));
+	DESTROYLOCK(&manager->lock);
+	manager->common.impmagic = 0;
+	manager->common.magic = 0;
+	isc_mem_put(mctx, manager, sizeof(*manager));
+	isc_mem_detach(&mctx);
 }
 
 isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	isc__timermgr_t *manager;
 	isc_result_t result;
+	unsigned int i;
 
 	/*
 	 * Create a timer manager.
@@ -876,50 +1158,77 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	manager->common.methods = (isc_timermgrmethods_t *)&timermgrmethods;
 	manager->mctx = NULL;
 	manager->done = false;
-	INIT_LIST(manager->timers);
-	manager->nscheduled = 0;
-	isc_time_settoepoch(&manager->due);
-	manager->heap = NULL;
-	result = isc_heap_create(mctx, sooner, set_index, 0, &manager->heap);
-	if (result != ISC_R_SUCCESS) {
-		INSIST(result == ISC_R_NOMEMORY);
+
+	/*
+	 * One wheel per CPU, each run by its own thread, so that timers
+	 * set by different workers rarely contend on a lock.
+	 */
+#ifdef USE_TIMER_THREAD
+	manager->nwheels = isc_os_ncpus();
+	if (manager->nwheels > TIMER_MAXWHEELS)
+		manager->nwheels = TIMER_MAXWHEELS;
+	if (manager->nwheels == 0)
+		manager->nwheels = 1;
+#else
+	manager->nwheels = 1;
+#endif /* USE_TIMER_THREAD */
+	manager->wheels = isc_mem_get(mctx, manager->nwheels *
+				      sizeof(isc__timerwheel_t));
+	if (manager->wheels == NULL) {
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		return (ISC_R_NOMEMORY);
 	}
 	result = isc_mutex_init(&manager->lock);
 	if (result != ISC_R_SUCCESS) {
-		isc_heap_destroy(&manager->heap);
+		isc_mem_put(mctx, manager->wheels,
+			    manager->nwheels * sizeof(isc__timerwheel_t));
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		return (result);
 	}
 	isc_mem_attach(mctx, &manager->mctx);
+	for (i = 0; i < manager->nwheels; i++) {
+		result = wheel_init(manager, &manager->wheels[i], i);
+		if (result != ISC_R_SUCCESS) {
+			manager_free(manager, i);
+			return (result);
+		}
+	}
 #ifdef USE_TIMER_THREAD
-	if (isc_condition_init(&manager->wakeup) != ISC_R_SUCCESS) {
-		isc_mem_detach(&manager->mctx);
-		DESTROYLOCK(&manager->lock);
-		isc_heap_destroy(&manager->heap);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_condition_init() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		return (ISC_R_UNEXPECTED);
+	for (i = 0; i < manager->nwheels; i++) {
+		isc__timerwheel_t *wheel = &manager->wheels[i];
+		char name[16];	/* thread name limit on Linux */
+
+		if (isc_thread_create(run, wheel, &wheel->thread) !=
+		    ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_create() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			break;
+		}
+		/* i < TIMER_MAXWHEELS; the modulus tells the compiler so. */
+		snprintf(name, sizeof(name), "isc-timer%04u",
+			 i % TIMER_MAXWHEELS);
+		isc_thread_setname(wheel->thread, name);
 	}
-	if (isc_thread_create(run, manager, &manager->thread) !=
-	    ISC_R_SUCCESS) {
-		isc_mem_detach(&manager->mctx);
-		(void)isc_condition_destroy(&manager->wakeup);
-		DESTROYLOCK(&manager->lock);
-		isc_heap_destroy(&manager->heap);
-		isc_mem_put(mctx, manager, sizeof(*manager));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	if (i < manager->nwheels) {
+		unsigned int started = i;
+
+		for (i = 0; i < manager->nwheels; i++)
+			LOCK(&manager->wheels[i].lock);
+		manager->done = true;
+		for (i = 0; i < manager->nwheels; i++) {
+			SIGNAL(&manager->wheels[i].wakeup);
+			UNLOCK(&manager->wheels[i].lock);
+		}
+		for (i = 0; i < started; i++)
+			(void)isc_thread_join(manager->wheels[i].thread, NULL);
+		manager_free(manager, manager->nwheels);
 		return (ISC_R_UNEXPECTED);
 	}
-	isc_thread_setname(manager->thread, "isc-timer");
-#endif
+#endif /* USE_TIMER_THREAD */
 #ifdef USE_SHARED_MANAGER
 	manager->refs = 1;
 	timermgr = manager;
@@ -934,10 +1243,12 @@ void
 isc_timermgr_poke(isc_timermgr_t *manager0) {
 #ifdef USE_TIMER_THREAD
 	isc__timermgr_t *manager = (isc__timermgr_t *)manager0;
+	unsigned int i;
 
 	REQUIRE(VALID_MANAGER(manager));
 
-	SIGNAL(&manager->wakeup);
+	for (i = 0; i < manager->nwheels; i++)
+		SIGNAL(&manager->wheels[i].wakeup);
 #else
 	UNUSED(manager0);
 #endif
@@ -946,7 +1257,7 @@ isc_timermgr_poke(isc_timermgr_t *manager0) {
 void
 isc__timermgr_destroy(isc_timermgr_t **managerp) {
 	isc__timermgr_t *manager;
-	isc_mem_t *mctx;
+	unsigned int i;
 
 	/*
 	 * Destroy a timer manager.
@@ -956,9 +1267,8 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 	manager = (isc__timermgr_t *)*managerp;
 	REQUIRE(VALID_MANAGER(manager));
 
-	LOCK(&manager->lock);
-
 #ifdef USE_SHARED_MANAGER
+	LOCK(&manager->lock);
 	manager->refs--;
 	if (manager->refs > 0) {
 		UNLOCK(&manager->lock);
@@ -966,47 +1276,48 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 		return;
 	}
 	timermgr = NULL;
+	UNLOCK(&manager->lock);
 #endif /* USE_SHARED_MANAGER */
 
 #ifndef USE_TIMER_THREAD
 	isc__timermgr_dispatch((isc_timermgr_t *)manager);
 #endif
 
-	REQUIRE(EMPTY(manager->timers));
+	for (i = 0; i < manager->nwheels; i++) {
+		LOCK(&manager->wheels[i].lock);
+		REQUIRE(EMPTY(manager->wheels[i].timers));
+	}
 	manager->done = true;
 
 #ifdef USE_TIMER_THREAD
 	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
 			      ISC_MSG_SIGNALDESTROY, "signal (destroy)"));
-	SIGNAL(&manager->wakeup);
+	for (i = 0; i < manager->nwheels; i++)
+		SIGNAL(&manager->wheels[i].wakeup);
 #endif /* USE_TIMER_THREAD */
 
-	UNLOCK(&manager->lock);
+	for (i = manager->nwheels; i > 0; i--)
+		UNLOCK(&manager->wheels[i - 1].lock);
 
 #ifdef USE_TIMER_THREAD
 	/*
-	 * Wait for thread to exit.
+	 * Wait for the threads to exit.
 	 */
-	if (isc_thread_join(manager->thread, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	for (i = 0; i < manager->nwheels; i++)
+		if (isc_thread_join(manager->wheels[i].thread, NULL) !=
+		    ISC_R_SUCCESS)
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
 #endif /* USE_TIMER_THREAD */
 
 	/*
 	 * Clean up.
 	 */
-#ifdef USE_TIMER_THREAD
-	(void)isc_condition_destroy(&manager->wakeup);
-#endif /* USE_TIMER_THREAD */
-	DESTROYLOCK(&manager->lock);
-	isc_heap_destroy(&manager->heap);
-	manager->common.impmagic = 0;
-	manager->common.magic = 0;
-	mctx = manager->mctx;
-	isc_mem_put(mctx, manager, sizeof(*manager));
-	isc_mem_detach(&mctx);
+	manager_free(manager, manager->nwheels);
 
 	*managerp = NULL;
 
@@ -1019,14 +1330,18 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 isc_result_t
 isc__timermgr_nextevent(isc_timermgr_t *manager0, isc_time_t *when) {
 	isc__timermgr_t *manager = (isc__timermgr_t *)manager0;
+	isc__timerwheel_t *wheel;
 
 #ifdef USE_SHARED_MANAGER
 	if (manager == NULL)
 		manager = timermgr;
 #endif
-	if (manager == NULL || manager->nscheduled == 0)
+	if (manager == NULL)
+		return (ISC_R_NOTFOUND);
+	wheel = &manager->wheels[0];
+	if (wheel->nscheduled == 0)
 		return (ISC_R_NOTFOUND);
-	*when = manager->due;
+	*when = wheel->due;
 	return (ISC_R_SUCCESS);
 }
 
@@ -1042,7 +1357,7 @@ isc__timermgr_dispatch(isc_timermgr_t *manager0) {
 	if (manager == NULL)
 		return;
 	TIME_NOW(&now);
-	dispatch(manager, &now);
+	dispatch(&manager->wheels[0], &now);
 }
 #endif /* USE_TIMER_THREAD */
 
@@ -71,6 +71,12 @@
 #endif
 #ifdef ISC_PLATFORM_HAVEEPOLL
 #include <sys/epoll.h>
+#if defined(HAVE_LINUX_IO_URING_H) && defined(ISC_PLATFORM_USETHREADS)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <linux/io_uring.h>
+#endif
 #endif
 #ifdef ISC_PLATFORM_HAVEDEVPOLL
 #if defined(HAVE_SYS_DEVPOLL_H)
@@ -120,6 +126,17 @@ typedef struct {
 #define USE_SELECT
 #endif	/* ISC_PLATFORM_HAVEKQUEUE */
 
+/*%
+ * On Linux the epoll watcher can optionally be replaced at run time by
+ * an io_uring submission/completion ring (see isc_socket_iouring), which
+ * also performs UDP receives, accepts and blocked sends itself.
+ */
+#if defined(USE_EPOLL) && defined(USE_WATCHER_THREAD) && \
+    defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && \
+    defined(__NR_io_uring_enter)
+#define USE_IOURING
+#endif
+
 #ifndef USE_WATCHER_THREAD
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
 struct isc_socketwait {
@@ -142,6 +159,13 @@ struct isc_socketwait {
  */
 int isc_dscp_check_value = -1;
 
+/*
+ * Set by the -T iouring option on the command line.  If true, socket
+ * managers created afterwards use io_uring rather than epoll for socket
+ * events and I/O, falling back to epoll if the ring can't be set up.
+ */
+bool isc_socket_iouring = false;
+
 /*%
  * Maximum number of allowable open sockets.  This is also the maximum
  * allowable socket file descriptor.
@@ -307,6 +331,19 @@ typedef isc_event_t intev_t;
 #endif
 #endif
 
+/*%
+ * Batched UDP I/O: recvmmsg() reads ahead several datagrams for sockets
+ * which asked for it with isc_socket_setrecvbatch(), and sendmmsg()
+ * flushes queued sends in one call.
+ */
+#if defined(HAVE_RECVMMSG) && defined(ISC_NET_BSD44MSGHDR)
+#define USE_RECVMMSG	1
+#endif
+#if defined(HAVE_SENDMMSG) && defined(ISC_NET_BSD44MSGHDR)
+#define USE_SENDMMSG	1
+#define SENDBATCH	16	/* Max. datagrams per sendmmsg() call */
+#endif
+
 /*%
  * The size to raise the receive buffer to (from BIND 8).
  */
@@ -354,8 +391,112 @@ typedef isc_event_t intev_t;
  */
 #define NRETRIES 10
 
+#ifdef USE_RECVMMSG
+/*%
+ * Datagrams read ahead by recvmmsg() which have not yet been handed to
+ * a receive request.  Slots [next, avail) hold unconsumed datagrams.
+ */
+typedef struct isc__recvbatch {
+	unsigned int		count;		/* number of slots */
+	unsigned int		size;		/* bytes per slot */
+	unsigned int		next;
+	unsigned int		avail;
+	struct mmsghdr		*msgs;
+	struct iovec		*iov;
+	isc_sockaddr_t		*addrs;
+	char			*cmsgbufs;	/* count * RECVCMSGBUFLEN */
+	unsigned char		*data;		/* count * size */
+} isc__recvbatch_t;
+#endif
+
+#ifdef USE_IOURING
+/*%
+ * An I/O operation the kernel performs for a descriptor instead of
+ * reporting readiness: IORING_OP_RECVMSG on UDP sockets, IORING_OP_ACCEPT
+ * on listeners and IORING_OP_SENDMSG on sockets whose sends would have
+ * blocked.  Data is received into, or sent from a copy in, a buffer
+ * owned by the operation rather than by the request, so canceling the
+ * request never frees memory the kernel may still be using; a datagram
+ * or connection that arrives for a canceled request is kept for the
+ * next one.
+ *
+ * Operations belong to the watcher and are indexed by descriptor.  One
+ * that is still in flight when its descriptor is closed is canceled and
+ * orphaned ('fd' is -1) until its completion has been reaped.
+ */
+typedef struct isc__uringop isc__uringop_t;
+
+struct isc__uringop {
+	int			fd;
+	unsigned int		opcode;
+	unsigned int		state;
+	int			res;		/* result of the completion */
+	isc_socketevent_t	*dev;		/* SENDMSG: request being sent */
+	struct msghdr		msg;
+	struct iovec		iov;
+	isc_sockaddr_t		addr;
+	socklen_t		addrlen;	/* ACCEPT */
+	char			cmsgbuf[ISC_MAX(RECVCMSGBUFLEN,
+						SENDCMSGBUFLEN)];
+	unsigned char		*data;
+	size_t			size;
+	ISC_LINK(isc__uringop_t) link;
+};
+
+#define URING_IDLE	0	/* nothing outstanding */
+#define URING_INFLIGHT	1	/* submitted, not yet completed */
+#define URING_READY	2	/* completed, result not yet consumed */
+
+/*%
+ * A watcher's io_uring.  Readiness is requested with one-shot
+ * IORING_OP_POLL_ADD entries, and socket I/O is submitted as operations
+ * (see above); the entries queued since the last wait are submitted with
+ * the wait itself, in a single io_uring_enter() call.  'fd' is -1 when
+ * the watcher uses epoll.
+ */
+typedef struct {
+	int			fd;
+	isc_mutex_t		lock;		/* protects the SQ and ops */
+	unsigned int		pending;	/* queued, not yet submitted */
+	isc__uringop_t		**ops;		/* two per descriptor */
+	ISC_LIST(isc__uringop_t) orphans;
+	void			*sqring;
+	size_t			sqringsize;
+	void			*cqring;
+	size_t			cqringsize;
+	struct io_uring_sqe	*sqes;
+	size_t			sqessize;
+	unsigned int		sqentries;
+	unsigned int		*sqhead;
+	unsigned int		*sqtail;
+	unsigned int		*sqmask;
+	unsigned int		*sqarray;
+	unsigned int		*cqhead;
+	unsigned int		*cqtail;
+	unsigned int		*cqmask;
+	struct io_uring_cqe	*cqes;
+} isc__uring_t;
+
+/*
+ * user_data of a POLL_ADD entry is (fd << 1 | write), and that of an
+ * operation its address tagged with URING_OP; entries that don't report
+ * on a descriptor (POLL_REMOVE, ASYNC_CANCEL) are tagged with
+ * URING_NOTIFY.
+ */
+#define URING_DATA(fd, msg) \
+	(((uint64_t)(fd) << 1) | ((msg) == SELECT_POKE_WRITE ? 1 : 0))
+#define URING_NOTIFY	(UINT64_C(1) << 63)
+#define URING_OP	(UINT64_C(1) << 62)
+#define URING_OPDATA(op) (URING_OP | (uint64_t)(uintptr_t)(op))
+#define URING_OPPTR(data) \
+	((isc__uringop_t *)(uintptr_t)((data) & ~URING_OP))
+#define URING_OPINDEX(fd, msg) \
+	((fd) * 2 + ((msg) == SELECT_POKE_WRITE ? 1 : 0))
+#endif	/* USE_IOURING */
+
 typedef struct isc__socket isc__socket_t;
 typedef struct isc__socketmgr isc__socketmgr_t;
+typedef struct isc__socketthread isc__socketthread_t;
 
 #define NEWCONNSOCK(ev) ((isc__socket_t *)(ev)->newsocket)
 
@@ -371,6 +512,7 @@ struct isc__socket {
 	ISC_LINK(isc__socket_t)	link;
 	unsigned int		references;
 	int			fd;
+	int			threadid;
 	int			pf;
 	char				name[16];
 	void *				tag;
@@ -410,6 +552,9 @@ struct isc__socket {
 	int			fdwatchflags;
 	isc_task_t		*fdwatchtask;
 	unsigned int		dscp;
+#ifdef USE_RECVMMSG
+	isc__recvbatch_t	*recvbatch;
+#endif
 };
 
 #define SOCKET_MANAGER_MAGIC	ISC_MAGIC('I', 'O', 'm', 'g')
@@ -420,8 +565,31 @@ struct isc__socketmgr {
 	isc_socketmgr_t		common;
 	isc_mem_t	       *mctx;
 	isc_mutex_t		lock;
-	isc_mutex_t		*fdlock;
 	isc_stats_t		*stats;
+	int			nthreads;
+	isc__socketthread_t	*threads;
+	unsigned int		maxsocks;
+
+	/* Locked by manager lock. */
+	ISC_LIST(isc__socket_t)	socklist;
+	int			reserved;	/* unlocked */
+#ifdef USE_WATCHER_THREAD
+	isc_condition_t		shutdown_ok;
+#else /* USE_WATCHER_THREAD */
+	unsigned int		refs;
+#endif /* USE_WATCHER_THREAD */
+	int			maxudp;
+};
+
+/*%
+ * Each watcher thread owns its own multiplexing descriptor and the
+ * subset of the file descriptors assigned to it by gen_threadid().
+ */
+struct isc__socketthread {
+	/* Not locked. */
+	isc__socketmgr_t	*manager;
+	int			threadid;
+	isc_mutex_t		*fdlock;
 #ifdef USE_KQUEUE
 	int			kqueue_fd;
 	int			nevents;
@@ -432,6 +600,9 @@ struct isc__socketmgr {
 	int			nevents;
 	struct epoll_event	*events;
 #endif	/* USE_EPOLL */
+#ifdef USE_IOURING
+	isc__uring_t		uring;
+#endif	/* USE_IOURING */
 #ifdef USE_DEVPOLL
 	int			devpoll_fd;
 	isc_resourcevalue_t	open_max;
@@ -442,7 +613,6 @@ struct isc__socketmgr {
 #ifdef USE_SELECT
 	int			fd_bufsize;
 #endif	/* USE_SELECT */
-	unsigned int		maxsocks;
 #ifdef ISC_PLATFORM_USETHREADS
 	int			pipe_fds[2];
 #endif
@@ -458,7 +628,6 @@ struct isc__socketmgr {
 #endif
 
 	/* Locked by manager lock. */
-	ISC_LIST(isc__socket_t)	socklist;
 #ifdef USE_SELECT
 	fd_set			*read_fds;
 	fd_set			*read_fds_copy;
@@ -466,14 +635,16 @@ struct isc__socketmgr {
 	fd_set			*write_fds_copy;
 	int			maxfd;
 #endif	/* USE_SELECT */
-	int			reserved;	/* unlocked */
+
+	/*
+	 * Updated only by the watcher itself; read without locking
+	 * for statistics.
+	 */
+	uint64_t		waits;
+	uint64_t		fdevents;
 #ifdef USE_WATCHER_THREAD
-	isc_thread_t		watcher;
-	isc_condition_t		shutdown_ok;
-#else /* USE_WATCHER_THREAD */
-	unsigned int		refs;
+	isc_thread_t		thread;
 #endif /* USE_WATCHER_THREAD */
-	int			maxudp;
 };
 
 #ifdef USE_SHARED_MANAGER
@@ -517,9 +688,14 @@ static void build_msghdr_send(isc__socket_t *, char *, isc_socketevent_t *,
 static void build_msghdr_recv(isc__socket_t *, char *, isc_socketevent_t *,
 			      struct msghdr *, struct iovec *, size_t *);
 #ifdef USE_WATCHER_THREAD
-static bool process_ctlfd(isc__socketmgr_t *manager);
+static bool process_ctlfd(isc__socketthread_t *thread);
 #endif
 static void setdscp(isc__socket_t *sock, isc_dscp_t dscp);
+#ifdef USE_IOURING
+static void dispatch_recv(isc__socket_t *sock);
+static void dispatch_send(isc__socket_t *sock);
+static void dispatch_accept(isc__socket_t *sock);
+#endif
 
 /*%
  * The following are intended for internal use (indicated by "isc__"
@@ -627,7 +803,7 @@ isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks);
+		       unsigned int maxsocks, int nthreads);
 isc_result_t
 isc_socketmgr_getmaxsockets(isc_socketmgr_t *manager0, unsigned int *nsockp);
 void
@@ -924,8 +1100,411 @@ dec_stats(isc_stats_t *stats, isc_statscounter_t counterid) {
 		isc_stats_decrement(stats, counterid);
 }
 
+#ifdef USE_IOURING
+/*
+ * Submit the entries queued so far.  The caller must hold uring->lock.
+ */
+static isc_result_t
+uring_submit(isc__uring_t *uring) {
+	int ret;
+
+	while (uring->pending > 0) {
+		ret = syscall(__NR_io_uring_enter, uring->fd, uring->pending,
+			      0, 0, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return (isc__errno2result(errno));
+		}
+		if (ret == 0)
+			return (ISC_R_NORESOURCES);
+		uring->pending -= ret;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Get the next free submission queue entry, submitting what has been
+ * queued if the ring is full.  The caller must hold uring->lock, fill in
+ * the entry and call uring_queue().
+ */
+static struct io_uring_sqe *
+uring_getsqe(isc__uring_t *uring) {
+	struct io_uring_sqe *sqe;
+	unsigned int head, tail, idx;
+
+	head = __atomic_load_n(uring->sqhead, __ATOMIC_ACQUIRE);
+	tail = *uring->sqtail;
+	if (tail - head == uring->sqentries) {
+		if (uring_submit(uring) != ISC_R_SUCCESS)
+			return (NULL);
+		head = __atomic_load_n(uring->sqhead, __ATOMIC_ACQUIRE);
+		if (tail - head == uring->sqentries)
+			return (NULL);
+	}
+
+	idx = tail & *uring->sqmask;
+	sqe = &uring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	uring->sqarray[idx] = idx;
+
+	return (sqe);
+}
+
+static void
+uring_queue(isc__uring_t *uring) {
+	__atomic_store_n(uring->sqtail, *uring->sqtail + 1, __ATOMIC_RELEASE);
+	uring->pending++;
+}
+
+static void
+uring_freeop(isc__socketthread_t *thread, isc__uringop_t *op) {
+	isc_mem_t *mctx = thread->manager->mctx;
+
+	/*
+	 * Nobody is going to take this connection.
+	 */
+	if (op->opcode == IORING_OP_ACCEPT && op->state == URING_READY &&
+	    op->res >= 0)
+		(void)close(op->res);
+	if (op->data != NULL)
+		isc_mem_put(mctx, op->data, op->size);
+	isc_mem_put(mctx, op, sizeof(*op));
+}
+
+/*
+ * Find the operation for 'fd' in the direction of 'msg', creating it if
+ * needed.  The caller must hold uring->lock.
+ */
+static isc__uringop_t *
+uring_getop(isc__socketthread_t *thread, int fd, int msg) {
+	isc__uring_t *uring = &thread->uring;
+	isc__uringop_t *op;
+	int idx = URING_OPINDEX(fd, msg);
+
+	op = uring->ops[idx];
+	if (op == NULL) {
+		op = isc_mem_get(thread->manager->mctx, sizeof(*op));
+		if (op == NULL)
+			return (NULL);
+		memset(op, 0, sizeof(*op));
+		op->fd = fd;
+		op->state = URING_IDLE;
+		ISC_LINK_INIT(op, link);
+		uring->ops[idx] = op;
+	}
+
+	return (op);
+}
+
+/*
+ * Make sure an idle operation's buffer holds at least 'size' bytes.
+ */
+static bool
+uring_reserve(isc__socketthread_t *thread, isc__uringop_t *op, size_t size) {
+	isc_mem_t *mctx = thread->manager->mctx;
+
+	INSIST(op->state == URING_IDLE);
+
+	if (size == 0U)
+		size = 1;
+	if (op->size >= size)
+		return (true);
+
+	if (op->data != NULL)
+		isc_mem_put(mctx, op->data, op->size);
+	op->size = 0;
+	op->data = isc_mem_get(mctx, size);
+	if (op->data == NULL)
+		return (false);
+	op->size = size;
+
+	return (true);
+}
+
+/*
+ * Ask the kernel to cancel an operation.  The caller must hold
+ * uring->lock.  If the submission queue is full the operation is left
+ * to complete, or to be canceled when the watcher exits.
+ */
+static void
+uring_cancel(isc__uring_t *uring, isc__uringop_t *op) {
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_getsqe(uring);
+	if (sqe == NULL)
+		return;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = URING_OPDATA(op);
+	sqe->user_data = URING_NOTIFY;
+	uring_queue(uring);
+}
+
+/*
+ * Give up the operations of a descriptor that is being closed.  Those
+ * still in flight are canceled, and freed once their completions have
+ * been reaped.
+ */
+static void
+uring_release(isc__socketthread_t *thread, int fd) {
+	isc__uring_t *uring = &thread->uring;
+	isc__uringop_t *op;
+	int idx;
+
+	LOCK(&uring->lock);
+	for (idx = URING_OPINDEX(fd, SELECT_POKE_READ);
+	     idx <= URING_OPINDEX(fd, SELECT_POKE_WRITE);
+	     idx++)
+	{
+		op = uring->ops[idx];
+		if (op == NULL)
+			continue;
+		uring->ops[idx] = NULL;
+		if (op->state != URING_INFLIGHT) {
+			uring_freeop(thread, op);
+			continue;
+		}
+		op->fd = -1;
+		op->dev = NULL;
+		ISC_LIST_APPEND(uring->orphans, op, link);
+		uring_cancel(uring, op);
+	}
+	UNLOCK(&uring->lock);
+}
+
+/*
+ * Have the kernel do the I/O a watch on 'fd' is waiting for rather than
+ * report readiness: receive the next datagram, accept the next
+ * connection, or send the request at the head of the send queue.
+ * Returns false if the descriptor is to be polled instead.
+ *
+ * If the operation has completed but its result hasn't been consumed
+ * yet, the socket is dispatched as if it had just completed.
+ */
+static bool
+uring_startio(isc__socketthread_t *thread, int fd, int msg,
+	      isc_result_t *resultp)
+{
+	isc__uring_t *uring = &thread->uring;
+	isc__socket_t *sock;
+	isc_socketevent_t *dev = NULL;
+	isc__uringop_t *op;
+	struct io_uring_sqe *sqe;
+	struct msghdr msghdr;
+	struct iovec iov[ISC_MAX(MAXSCATTERGATHER_SEND,
+				 MAXSCATTERGATHER_RECV)];
+	char cmsgbuf[RECVCMSGBUFLEN];
+	unsigned int opcode, state = URING_IDLE;
+	size_t count, n;
+	int i, lockid = FDLOCK_ID(fd);
+	bool wanted, busy;
+
+	LOCK(&thread->fdlock[lockid]);
+	sock = thread->fds[fd];
+	if (sock == NULL || thread->fdstate[fd] != MANAGED) {
+		UNLOCK(&thread->fdlock[lockid]);
+		return (false);
+	}
+
+	LOCK(&sock->lock);
+	if (msg == SELECT_POKE_READ && sock->listener) {
+		opcode = IORING_OP_ACCEPT;
+		wanted = !ISC_LIST_EMPTY(sock->accept_list);
+		busy = sock->pending_accept;
+	} else if (msg == SELECT_POKE_READ &&
+		   sock->type == isc_sockettype_udp)
+	{
+		opcode = IORING_OP_RECVMSG;
+		dev = ISC_LIST_HEAD(sock->recv_list);
+		wanted = (dev != NULL);
+		busy = sock->pending_recv;
+	} else if (msg == SELECT_POKE_WRITE && !sock->connecting &&
+		   (sock->type == isc_sockettype_tcp ||
+		    (sock->type == isc_sockettype_udp &&
+		     sock->manager->maxudp == 0)))
+	{
+		opcode = IORING_OP_SENDMSG;
+		dev = ISC_LIST_HEAD(sock->send_list);
+		wanted = (dev != NULL);
+		busy = sock->pending_send;
+	} else {
+		UNLOCK(&sock->lock);
+		UNLOCK(&thread->fdlock[lockid]);
+		return (false);
+	}
+
+	*resultp = ISC_R_SUCCESS;
+
+	LOCK(&uring->lock);
+	op = uring_getop(thread, fd, msg);
+	if (op == NULL) {
+		*resultp = ISC_R_NOMEMORY;
+		goto unlock;
+	}
+	state = op->state;
+	if (state != URING_IDLE || !wanted)
+		goto unlock;
+
+	op->opcode = opcode;
+	switch (opcode) {
+	case IORING_OP_ACCEPT:
+		memset(&op->addr, 0, sizeof(op->addr));
+		op->addrlen = sizeof(op->addr.type);
+		break;
+
+	case IORING_OP_RECVMSG:
+		/*
+		 * Room for what the request can take; a longer datagram
+		 * is truncated as if it had been read into the request.
+		 */
+		build_msghdr_recv(sock, cmsgbuf, dev, &msghdr, iov, &count);
+		if (!uring_reserve(thread, op, count)) {
+			*resultp = ISC_R_NOMEMORY;
+			goto unlock;
+		}
+		memset(&op->addr, 0, sizeof(op->addr));
+		op->iov.iov_base = op->data;
+		op->iov.iov_len = count;
+		memset(&op->msg, 0, sizeof(op->msg));
+		op->msg.msg_name = (void *)&op->addr.type.sa;
+		op->msg.msg_namelen = sizeof(op->addr.type);
+		op->msg.msg_iov = &op->iov;
+		op->msg.msg_iovlen = 1;
+#if defined(USE_CMSG)
+		op->msg.msg_control = op->cmsgbuf;
+		op->msg.msg_controllen = RECVCMSGBUFLEN;
+#endif
+		break;
+
+	case IORING_OP_SENDMSG:
+		build_msghdr_send(sock, op->cmsgbuf, dev, &msghdr, iov,
+				  &count);
+		if (!uring_reserve(thread, op, count)) {
+			*resultp = ISC_R_NOMEMORY;
+			goto unlock;
+		}
+		for (i = 0, n = 0; i < (int)msghdr.msg_iovlen; i++) {
+			memmove(op->data + n, iov[i].iov_base,
+				iov[i].iov_len);
+			n += iov[i].iov_len;
+		}
+		op->msg = msghdr;
+		if (msghdr.msg_name != NULL) {
+			op->addr = dev->address;
+			op->msg.msg_name = (void *)&op->addr.type.sa;
+		}
+		op->iov.iov_base = op->data;
+		op->iov.iov_len = count;
+		op->msg.msg_iov = &op->iov;
+		op->msg.msg_iovlen = 1;
+		op->dev = dev;
+		break;
+	}
+
+	sqe = uring_getsqe(uring);
+	if (sqe == NULL) {
+		op->dev = NULL;
+		*resultp = ISC_R_NORESOURCES;
+		goto unlock;
+	}
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	if (opcode == IORING_OP_ACCEPT) {
+		sqe->addr = (uint64_t)(uintptr_t)&op->addr.type.sa;
+		sqe->addr2 = (uint64_t)(uintptr_t)&op->addrlen;
+	} else {
+		sqe->addr = (uint64_t)(uintptr_t)&op->msg;
+		sqe->len = 1;
+	}
+	sqe->user_data = URING_OPDATA(op);
+	uring_queue(uring);
+	op->state = URING_INFLIGHT;
+
+ unlock:
+	UNLOCK(&uring->lock);
+
+	if (state == URING_READY && wanted && !busy) {
+		if (opcode == IORING_OP_ACCEPT)
+			dispatch_accept(sock);
+		else if (opcode == IORING_OP_RECVMSG)
+			dispatch_recv(sock);
+		else
+			dispatch_send(sock);
+	}
+
+	UNLOCK(&sock->lock);
+	UNLOCK(&thread->fdlock[lockid]);
+
+	return (true);
+}
+
+static isc_result_t
+uring_watch(isc__socketthread_t *thread, int fd, int msg) {
+	isc__uring_t *uring = &thread->uring;
+	struct io_uring_sqe *sqe;
+	uint32_t bit = (msg == SELECT_POKE_READ) ? EPOLLIN : EPOLLOUT;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	if (fd != thread->pipe_fds[0] &&
+	    uring_startio(thread, fd, msg, &result))
+		return (result);
+
+	/*
+	 * epoll_events[] records which one-shot polls are armed.
+	 */
+	LOCK(&uring->lock);
+	if ((thread->epoll_events[fd] & bit) == 0) {
+		sqe = uring_getsqe(uring);
+		if (sqe == NULL) {
+			result = ISC_R_NORESOURCES;
+		} else {
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->fd = fd;
+			sqe->poll_events = (bit == EPOLLIN) ? POLLIN : POLLOUT;
+			sqe->user_data = URING_DATA(fd, msg);
+			uring_queue(uring);
+			thread->epoll_events[fd] |= bit;
+		}
+	}
+	UNLOCK(&uring->lock);
+
+	return (result);
+}
+
+static isc_result_t
+uring_unwatch(isc__socketthread_t *thread, int fd, int msg) {
+	isc__uring_t *uring = &thread->uring;
+	struct io_uring_sqe *sqe;
+	uint32_t bit = (msg == SELECT_POKE_READ) ? EPOLLIN : EPOLLOUT;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	LOCK(&uring->lock);
+	if ((thread->epoll_events[fd] & bit) != 0) {
+		thread->epoll_events[fd] &= ~bit;
+		sqe = uring_getsqe(uring);
+		if (sqe == NULL) {
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "io_uring POLL_REMOVE, %d: "
+					 "submission queue full", fd);
+			result = ISC_R_UNEXPECTED;
+		} else {
+			sqe->opcode = IORING_OP_POLL_REMOVE;
+			sqe->fd = -1;
+			sqe->addr = URING_DATA(fd, msg);
+			sqe->user_data = URING_NOTIFY;
+			uring_queue(uring);
+		}
+	}
+	UNLOCK(&uring->lock);
+
+	return (result);
+}
+#endif	/* USE_IOURING */
+
 static inline isc_result_t
-watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+watch_fd(isc__socketthread_t *thread, int fd, int msg) {
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
@@ -938,7 +1517,7 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_ADD;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -948,18 +1527,23 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	int ret;
 	int op;
 
-	oldevents = manager->epoll_events[fd];
+#ifdef USE_IOURING
+	if (thread->uring.fd != -1)
+		return (uring_watch(thread, fd, msg));
+#endif
+
+	oldevents = thread->epoll_events[fd];
 	if (msg == SELECT_POKE_READ)
-		manager->epoll_events[fd] |= EPOLLIN;
+		thread->epoll_events[fd] |= EPOLLIN;
 	else
-		manager->epoll_events[fd] |= EPOLLOUT;
+		thread->epoll_events[fd] |= EPOLLOUT;
 
-	event.events = manager->epoll_events[fd];
+	event.events = thread->epoll_events[fd];
 	memset(&event.data, 0, sizeof(event.data));
 	event.data.fd = fd;
 
 	op = (oldevents == 0U) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1) {
 		if (errno == EEXIST)
 			UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -980,32 +1564,32 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		pfd.events = POLLOUT;
 	pfd.fd = fd;
 	pfd.revents = 0;
-	LOCK(&manager->fdlock[lockid]);
-	if (write(manager->devpoll_fd, &pfd, sizeof(pfd)) == -1)
+	LOCK(&thread->fdlock[lockid]);
+	if (write(thread->devpoll_fd, &pfd, sizeof(pfd)) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
-			manager->fdpollinfo[fd].want_read = 1;
+			thread->fdpollinfo[fd].want_read = 1;
 		else
-			manager->fdpollinfo[fd].want_write = 1;
+			thread->fdpollinfo[fd].want_write = 1;
 	}
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 
 	return (result);
 #elif defined(USE_SELECT)
-	LOCK(&manager->lock);
+	LOCK(&thread->manager->lock);
 	if (msg == SELECT_POKE_READ)
-		FD_SET(fd, manager->read_fds);
+		FD_SET(fd, thread->read_fds);
 	if (msg == SELECT_POKE_WRITE)
-		FD_SET(fd, manager->write_fds);
-	UNLOCK(&manager->lock);
+		FD_SET(fd, thread->write_fds);
+	UNLOCK(&thread->manager->lock);
 
 	return (result);
 #endif
 }
 
 static inline isc_result_t
-unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
+unwatch_fd(isc__socketthread_t *thread, int fd, int msg) {
 	isc_result_t result = ISC_R_SUCCESS;
 
 #ifdef USE_KQUEUE
@@ -1018,7 +1602,7 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		evchange.filter = EVFILT_WRITE;
 	evchange.flags = EV_DELETE;
 	evchange.ident = fd;
-	if (kevent(manager->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
+	if (kevent(thread->kqueue_fd, &evchange, 1, NULL, 0, NULL) != 0)
 		result = isc__errno2result(errno);
 
 	return (result);
@@ -1027,17 +1611,22 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	int ret;
 	int op;
 
+#ifdef USE_IOURING
+	if (thread->uring.fd != -1)
+		return (uring_unwatch(thread, fd, msg));
+#endif
+
 	if (msg == SELECT_POKE_READ)
-		manager->epoll_events[fd] &= ~(EPOLLIN);
+		thread->epoll_events[fd] &= ~(EPOLLIN);
 	else
-		manager->epoll_events[fd] &= ~(EPOLLOUT);
+		thread->epoll_events[fd] &= ~(EPOLLOUT);
 
-	event.events = manager->epoll_events[fd];
+	event.events = thread->epoll_events[fd];
 	memset(&event.data, 0, sizeof(event.data));
 	event.data.fd = fd;
 
 	op = (event.events == 0U) ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
-	ret = epoll_ctl(manager->epoll_fd, op, fd, &event);
+	ret = epoll_ctl(thread->epoll_fd, op, fd, &event);
 	if (ret == -1 && errno != ENOENT) {
 		char strbuf[ISC_STRERRORSIZE];
 		isc__strerror(errno, strbuf, sizeof(strbuf));
@@ -1060,47 +1649,51 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 	 * only provides a way of canceling per FD, we may need to re-poll the
 	 * socket for the other operation.
 	 */
-	LOCK(&manager->fdlock[lockid]);
+	LOCK(&thread->fdlock[lockid]);
 	if (msg == SELECT_POKE_READ &&
-	    manager->fdpollinfo[fd].want_write == 1) {
+	    thread->fdpollinfo[fd].want_write == 1) {
 		pfds[1].events = POLLOUT;
 		pfds[1].fd = fd;
 		writelen += sizeof(pfds[1]);
 	}
 	if (msg == SELECT_POKE_WRITE &&
-	    manager->fdpollinfo[fd].want_read == 1) {
+	    thread->fdpollinfo[fd].want_read == 1) {
 		pfds[1].events = POLLIN;
 		pfds[1].fd = fd;
 		writelen += sizeof(pfds[1]);
 	}
 
-	if (write(manager->devpoll_fd, pfds, writelen) == -1)
+	if (write(thread->devpoll_fd, pfds, writelen) == -1)
 		result = isc__errno2result(errno);
 	else {
 		if (msg == SELECT_POKE_READ)
-			manager->fdpollinfo[fd].want_read = 0;
+			thread->fdpollinfo[fd].want_read = 0;
 		else
-			manager->fdpollinfo[fd].want_write = 0;
+			thread->fdpollinfo[fd].want_write = 0;
 	}
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 
 	return (result);
 #elif defined(USE_SELECT)
-	LOCK(&manager->lock);
+	LOCK(&thread->manager->lock);
 	if (msg == SELECT_POKE_READ)
-		FD_CLR(fd, manager->read_fds);
+		FD_CLR(fd, thread->read_fds);
 	else if (msg == SELECT_POKE_WRITE)
-		FD_CLR(fd, manager->write_fds);
-	UNLOCK(&manager->lock);
+		FD_CLR(fd, thread->write_fds);
+	UNLOCK(&thread->manager->lock);
 
 	return (result);
 #endif
 }
 
 static void
-wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
+wakeup_socket(isc__socketthread_t *thread, int fd, int msg) {
 	isc_result_t result;
 	int lockid = FDLOCK_ID(fd);
+#ifdef USE_WATCHER_THREAD
+	isc__socket_t *sock;
+	bool busy;
+#endif
 
 	/*
 	 * This is a wakeup on a socket.  If the socket is not in the
@@ -1108,21 +1701,25 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 	 * or writes.
 	 */
 
-	INSIST(fd >= 0 && fd < (int)manager->maxsocks);
+	INSIST(fd >= 0 && fd < (int)thread->manager->maxsocks);
 
 	if (msg == SELECT_POKE_CLOSE) {
 		/* No one should be updating fdstate, so no need to lock it */
-		INSIST(manager->fdstate[fd] == CLOSE_PENDING);
-		manager->fdstate[fd] = CLOSED;
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		INSIST(thread->fdstate[fd] == CLOSE_PENDING);
+		thread->fdstate[fd] = CLOSED;
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
+#ifdef USE_IOURING
+		if (thread->uring.fd != -1)
+			uring_release(thread, fd);
+#endif
 		(void)close(fd);
 		return;
 	}
 
-	LOCK(&manager->fdlock[lockid]);
-	if (manager->fdstate[fd] == CLOSE_PENDING) {
-		UNLOCK(&manager->fdlock[lockid]);
+	LOCK(&thread->fdlock[lockid]);
+	if (thread->fdstate[fd] == CLOSE_PENDING) {
+		UNLOCK(&thread->fdlock[lockid]);
 
 		/*
 		 * We accept (and ignore) any error from unwatch_fd() as we are
@@ -1132,20 +1729,43 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 		 * fdlock; otherwise it could cause deadlock due to a lock order
 		 * reversal.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
-	if (manager->fdstate[fd] != MANAGED) {
-		UNLOCK(&manager->fdlock[lockid]);
+	if (thread->fdstate[fd] != MANAGED) {
+		UNLOCK(&thread->fdlock[lockid]);
 		return;
 	}
-	UNLOCK(&manager->fdlock[lockid]);
+#ifdef USE_WATCHER_THREAD
+	/*
+	 * Pokes reach us through the pipe, so a poke for a request that
+	 * has since been canceled can arrive after the internal event of a
+	 * later request on the same socket has already been dispatched.
+	 * Watching the socket then would dispatch a second internal event
+	 * for the same direction.  The internal event pokes again when it
+	 * is done if there is more to do, so the poke can be dropped.
+	 */
+	sock = thread->fds[fd];
+	if (sock != NULL) {
+		LOCK(&sock->lock);
+		if (msg == SELECT_POKE_READ)
+			busy = (sock->pending_recv || sock->pending_accept);
+		else
+			busy = sock->pending_send;
+		UNLOCK(&sock->lock);
+		if (busy) {
+			UNLOCK(&thread->fdlock[lockid]);
+			return;
+		}
+	}
+#endif
+	UNLOCK(&thread->fdlock[lockid]);
 
 	/*
 	 * Set requested bit.
 	 */
-	result = watch_fd(manager, fd, msg);
+	result = watch_fd(thread, fd, msg);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * XXXJT: what should we do?  Ignoring the failure of watching
@@ -1166,16 +1786,20 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
  * will not get partial writes.
  */
 static void
-select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+select_poke(isc__socketmgr_t *mgr, int threadid, int fd, int msg) {
+	isc__socketthread_t *thread;
 	int cc;
 	int buf[2];
 	char strbuf[ISC_STRERRORSIZE];
 
+	REQUIRE(threadid >= 0 && threadid < mgr->nthreads);
+
+	thread = &mgr->threads[threadid];
 	buf[0] = fd;
 	buf[1] = msg;
 
 	do {
-		cc = write(mgr->pipe_fds[1], buf, sizeof(buf));
+		cc = write(thread->pipe_fds[1], buf, sizeof(buf));
 #ifdef ENOSR
 		/*
 		 * Treat ENOSR as EAGAIN but loop slowly as it is
@@ -1205,12 +1829,12 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
  * Read a message on the internal fd.
  */
 static void
-select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
+select_readmsg(isc__socketthread_t *thread, int *fd, int *msg) {
 	int buf[2];
 	int cc;
 	char strbuf[ISC_STRERRORSIZE];
 
-	cc = read(mgr->pipe_fds[0], buf, sizeof(buf));
+	cc = read(thread->pipe_fds[0], buf, sizeof(buf));
 	if (cc < 0) {
 		*msg = SELECT_POKE_NOTHING;
 		*fd = -1;	/* Silence compiler. */
@@ -1235,11 +1859,13 @@ select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
  * Update the state of the socketmgr when something changes.
  */
 static void
-select_poke(isc__socketmgr_t *manager, int fd, int msg) {
+select_poke(isc__socketmgr_t *manager, int threadid, int fd, int msg) {
+	REQUIRE(threadid >= 0 && threadid < manager->nthreads);
+
 	if (msg == SELECT_POKE_SHUTDOWN)
 		return;
 	else if (fd >= 0)
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(&manager->threads[threadid], fd, msg);
 	return;
 }
 #endif /* USE_WATCHER_THREAD */
@@ -1889,43 +2515,25 @@ dump_msg(struct msghdr *msg) {
 #define DOIO_HARD		2	/* i/o error, event sent */
 #define DOIO_EOF		3	/* EOF, no event sent */
 
+/*
+ * Classify a failed receive.  Returns DOIO_SOFT if the error should be
+ * ignored, or DOIO_HARD with dev->result set otherwise.
+ */
 static int
-doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_RECV];
-	size_t read_count;
-	size_t actual_count;
-	struct msghdr msghdr;
-	isc_buffer_t *buffer;
-	int recv_errno;
+recv_error(isc__socket_t *sock, isc_socketevent_t *dev, int recv_errno) {
 	char strbuf[ISC_STRERRORSIZE];
-	char cmsgbuf[RECVCMSGBUFLEN] = {0};
-
-	build_msghdr_recv(sock, cmsgbuf, dev, &msghdr, iov, &read_count);
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
 
-	cc = recvmsg(sock->fd, &msghdr, 0);
-	recv_errno = errno;
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
-	if (cc < 0) {
-		if (SOFT_ERROR(recv_errno))
-			return (DOIO_SOFT);
+	if (SOFT_ERROR(recv_errno))
+		return (DOIO_SOFT);
 
-		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
-			isc__strerror(recv_errno, strbuf, sizeof(strbuf));
-			socket_log(sock, NULL, IOEVENT,
-				   isc_msgcat, ISC_MSGSET_SOCKET,
-				   ISC_MSG_DOIORECV,
-				  "doio_recv: recvmsg(%d) %d bytes, err %d/%s",
-				   sock->fd, cc, recv_errno, strbuf);
-		}
+	if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
+		isc__strerror(recv_errno, strbuf, sizeof(strbuf));
+		socket_log(sock, NULL, IOEVENT,
+			   isc_msgcat, ISC_MSGSET_SOCKET,
+			   ISC_MSG_DOIORECV,
+			  "doio_recv: recvmsg(%d) err %d/%s",
+			   sock->fd, recv_errno, strbuf);
+	}
 
 #define SOFT_OR_HARD(_system, _isc) \
 	if (recv_errno == _system) { \
@@ -1945,34 +2553,505 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 		return (DOIO_HARD); \
 	}
 
-		SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
-		SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
-		SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
-		SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
-		/* HPUX 11.11 can return EADDRNOTAVAIL. */
-		SOFT_OR_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
-		SOFT_OR_HARD(ENOBUFS, ISC_R_NORESOURCES);
-		/* Should never get this one but it was seen. */
+	SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
+	SOFT_OR_HARD(ENETUNREACH, ISC_R_NETUNREACH);
+	SOFT_OR_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EHOSTDOWN, ISC_R_HOSTDOWN);
+	/* HPUX 11.11 can return EADDRNOTAVAIL. */
+	SOFT_OR_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
+	SOFT_OR_HARD(ENOBUFS, ISC_R_NORESOURCES);
+	/* Should never get this one but it was seen. */
 #ifdef ENOPROTOOPT
-		SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(ENOPROTOOPT, ISC_R_HOSTUNREACH);
 #endif
-		/*
-		 * HPUX returns EPROTO and EINVAL on receiving some ICMP/ICMPv6
-		 * errors.
-		 */
+	/*
+	 * HPUX returns EPROTO and EINVAL on receiving some ICMP/ICMPv6
+	 * errors.
+	 */
 #ifdef EPROTO
-		SOFT_OR_HARD(EPROTO, ISC_R_HOSTUNREACH);
+	SOFT_OR_HARD(EPROTO, ISC_R_HOSTUNREACH);
+#endif
+	SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
+
+#undef SOFT_OR_HARD
+#undef ALWAYS_HARD
+
+	dev->result = isc__errno2result(recv_errno);
+	inc_stats(sock->manager->stats,
+		  sock->statsindex[STATID_RECVFAIL]);
+	return (DOIO_HARD);
+}
+
+/*
+ * Classify a failed send.  Returns DOIO_SOFT if the request should be
+ * retried, or DOIO_HARD with dev->result set otherwise.
+ */
+static int
+send_error(isc__socket_t *sock, isc_socketevent_t *dev, int send_errno) {
+	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+	char strbuf[ISC_STRERRORSIZE];
+
+	if (SOFT_ERROR(send_errno)) {
+		if (send_errno == EWOULDBLOCK || send_errno == EAGAIN)
+			dev->result = ISC_R_WOULDBLOCK;
+		return (DOIO_SOFT);
+	}
+
+#define SOFT_OR_HARD(_system, _isc) \
+	if (send_errno == _system) { \
+		if (sock->connected) { \
+			dev->result = _isc; \
+			inc_stats(sock->manager->stats, \
+				  sock->statsindex[STATID_SENDFAIL]); \
+			return (DOIO_HARD); \
+		} \
+		return (DOIO_SOFT); \
+	}
+#define ALWAYS_HARD(_system, _isc) \
+	if (send_errno == _system) { \
+		dev->result = _isc; \
+		inc_stats(sock->manager->stats, \
+			  sock->statsindex[STATID_SENDFAIL]); \
+		return (DOIO_HARD); \
+	}
+
+	SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
+	ALWAYS_HARD(EACCES, ISC_R_NOPERM);
+	ALWAYS_HARD(EAFNOSUPPORT, ISC_R_ADDRNOTAVAIL);
+	ALWAYS_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
+	ALWAYS_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
+#ifdef EHOSTDOWN
+	ALWAYS_HARD(EHOSTDOWN, ISC_R_HOSTUNREACH);
 #endif
-		SOFT_OR_HARD(EINVAL, ISC_R_HOSTUNREACH);
+	ALWAYS_HARD(ENETUNREACH, ISC_R_NETUNREACH);
+	SOFT_OR_HARD(ENOBUFS, ISC_R_NORESOURCES);
+	ALWAYS_HARD(EPERM, ISC_R_HOSTUNREACH);
+	ALWAYS_HARD(EPIPE, ISC_R_NOTCONNECTED);
+	ALWAYS_HARD(ECONNRESET, ISC_R_CONNECTIONRESET);
 
 #undef SOFT_OR_HARD
 #undef ALWAYS_HARD
 
-		dev->result = isc__errno2result(recv_errno);
-		inc_stats(sock->manager->stats,
-			  sock->statsindex[STATID_RECVFAIL]);
-		return (DOIO_HARD);
-	}
+	/*
+	 * The other error types depend on whether or not the
+	 * socket is UDP or TCP.  If it is UDP, some errors
+	 * that we expect to be fatal under TCP are merely
+	 * annoying, and are really soft errors.
+	 *
+	 * However, these soft errors are still returned as
+	 * a status.
+	 */
+	isc_sockaddr_format(&dev->address, addrbuf, sizeof(addrbuf));
+	isc__strerror(send_errno, strbuf, sizeof(strbuf));
+	UNEXPECTED_ERROR(__FILE__, __LINE__, "internal_send: %s: %s",
+			 addrbuf, strbuf);
+	dev->result = isc__errno2result(send_errno);
+	inc_stats(sock->manager->stats,
+		  sock->statsindex[STATID_SENDFAIL]);
+	return (DOIO_HARD);
+}
+
+#if defined(USE_RECVMMSG) || defined(USE_IOURING)
+/*
+ * Complete 'dev' with a datagram that has already been read from the
+ * socket into 'data', from 'from'.  Returns DOIO_SOFT without touching
+ * 'dev' if doio_recv() would have discarded the datagram.
+ */
+static int
+recv_datagram(isc__socket_t *sock, isc_socketevent_t *dev,
+	      isc_sockaddr_t *from, struct msghdr *msg, unsigned char *data,
+	      size_t cc)
+{
+	isc_buffer_t *buffer;
+	isc_region_t available;
+	size_t read_count, n;
+
+	if (isc_sockaddr_getport(from) == 0) {
+		if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
+			socket_log(sock, from, IOEVENT,
+				   isc_msgcat, ISC_MSGSET_SOCKET,
+				   ISC_MSG_ZEROPORT,
+				   "dropping source port zero packet");
+		}
+		return (DOIO_SOFT);
+	}
+	/*
+	 * Simulate a firewall blocking UDP responses bigger than
+	 * 'maxudp' bytes.
+	 */
+	if (sock->manager->maxudp != 0 &&
+	    cc > (size_t)sock->manager->maxudp)
+		return (DOIO_SOFT);
+	if (dev->n + cc < dev->minimum)
+		return (DOIO_SOFT);
+
+	dev->address = *from;
+
+	socket_log(sock, &dev->address, IOEVENT,
+		   isc_msgcat, ISC_MSGSET_SOCKET, ISC_MSG_PKTRECV,
+		   "packet received correctly");
+
+	process_cmsg(sock, msg, dev);
+
+	/*
+	 * Copy the datagram into the request.  Whatever does not fit is
+	 * lost, exactly as if recvmsg() had been called with the request's
+	 * own buffers.
+	 */
+	buffer = ISC_LIST_HEAD(dev->bufferlist);
+	if (buffer == NULL) {
+		read_count = dev->region.length - dev->n;
+		if (cc > read_count) {
+			dev->attributes |= ISC_SOCKEVENTATTR_TRUNC;
+			cc = read_count;
+		}
+		memmove(dev->region.base + dev->n, data, cc);
+		dev->n += cc;
+	} else {
+		while (buffer != NULL && cc > 0U) {
+			REQUIRE(ISC_BUFFER_VALID(buffer));
+			isc_buffer_availableregion(buffer, &available);
+			n = ISC_MIN(available.length, cc);
+			memmove(available.base, data, n);
+			isc_buffer_add(buffer, n);
+			dev->n += n;
+			data += n;
+			cc -= n;
+			buffer = ISC_LIST_NEXT(buffer, link);
+		}
+		if (cc > 0U)
+			dev->attributes |= ISC_SOCKEVENTATTR_TRUNC;
+	}
+
+	dev->result = ISC_R_SUCCESS;
+	return (DOIO_SUCCESS);
+}
+#endif
+
+#ifdef USE_RECVMMSG
+static void
+free_recvbatch(isc__socket_t *sock) {
+	isc__recvbatch_t *batch = sock->recvbatch;
+	isc_mem_t *mctx = sock->manager->mctx;
+
+	if (batch == NULL)
+		return;
+
+	if (batch->msgs != NULL)
+		isc_mem_put(mctx, batch->msgs,
+			    batch->count * sizeof(batch->msgs[0]));
+	if (batch->iov != NULL)
+		isc_mem_put(mctx, batch->iov,
+			    batch->count * sizeof(batch->iov[0]));
+	if (batch->addrs != NULL)
+		isc_mem_put(mctx, batch->addrs,
+			    batch->count * sizeof(batch->addrs[0]));
+	if (batch->cmsgbufs != NULL)
+		isc_mem_put(mctx, batch->cmsgbufs,
+			    batch->count * RECVCMSGBUFLEN);
+	if (batch->data != NULL)
+		isc_mem_put(mctx, batch->data, batch->count * batch->size);
+	isc_mem_put(mctx, batch, sizeof(*batch));
+	sock->recvbatch = NULL;
+}
+
+/*
+ * Read as many datagrams as are queued, up to the batch size, with a
+ * single recvmmsg() call.  Returns the number of datagrams read, or -1
+ * with errno set.
+ */
+static int
+recvbatch_fill(isc__socket_t *sock) {
+	isc__recvbatch_t *batch = sock->recvbatch;
+	struct msghdr *msg;
+	unsigned int i;
+	int cc;
+
+	for (i = 0; i < batch->count; i++) {
+		memset(&batch->addrs[i], 0, sizeof(batch->addrs[i]));
+		batch->iov[i].iov_base = batch->data + i * batch->size;
+		batch->iov[i].iov_len = batch->size;
+
+		msg = &batch->msgs[i].msg_hdr;
+		memset(msg, 0, sizeof(*msg));
+		msg->msg_name = (void *)&batch->addrs[i].type.sa;
+		msg->msg_namelen = sizeof(batch->addrs[i].type);
+		msg->msg_iov = &batch->iov[i];
+		msg->msg_iovlen = 1;
+#if defined(USE_CMSG)
+		msg->msg_control = batch->cmsgbufs + i * RECVCMSGBUFLEN;
+		msg->msg_controllen = RECVCMSGBUFLEN;
+#endif
+		batch->msgs[i].msg_len = 0;
+	}
+
+	batch->next = 0;
+	batch->avail = 0;
+
+	cc = recvmmsg(sock->fd, batch->msgs, batch->count, 0, NULL);
+	if (cc > 0)
+		batch->avail = cc;
+
+	return (cc);
+}
+
+/*
+ * Hand the next read ahead datagram to 'dev', refilling the batch from
+ * the socket when it runs dry.  Datagrams doio_recv() would discard are
+ * skipped here, so that the caller never waits for the descriptor to
+ * become readable while datagrams are still buffered.
+ */
+static int
+doio_recvbatch(isc__socket_t *sock, isc_socketevent_t *dev) {
+	isc__recvbatch_t *batch = sock->recvbatch;
+	struct mmsghdr *mmsg;
+	int nrecv;
+
+	INSIST(sock->type == isc_sockettype_udp);
+
+	for (;;) {
+		if (batch->next == batch->avail) {
+			nrecv = recvbatch_fill(sock);
+			if (nrecv < 0)
+				return (recv_error(sock, dev, errno));
+			if (nrecv == 0)
+				return (DOIO_SOFT);
+		}
+
+		mmsg = &batch->msgs[batch->next];
+		batch->addrs[batch->next].length = mmsg->msg_hdr.msg_namelen;
+		if (recv_datagram(sock, dev, &batch->addrs[batch->next],
+				  &mmsg->msg_hdr,
+				  batch->iov[batch->next].iov_base,
+				  mmsg->msg_len) == DOIO_SUCCESS)
+		{
+			batch->next++;
+			return (DOIO_SUCCESS);
+		}
+		batch->next++;
+	}
+}
+#endif /* USE_RECVMMSG */
+
+#ifdef USE_IOURING
+/*
+ * The following take the result of a completed operation for a request.
+ * They return the state the operation was in: with URING_IDLE nothing
+ * was outstanding and the caller does the I/O itself; with
+ * URING_INFLIGHT the request has to wait for the completion.
+ */
+
+static unsigned int
+uring_state(isc__socket_t *sock, int msg) {
+	isc__socketthread_t *thread = &sock->manager->threads[sock->threadid];
+	isc__uring_t *uring = &thread->uring;
+	isc__uringop_t *op;
+	unsigned int state;
+
+	if (uring->fd == -1)
+		return (URING_IDLE);
+
+	LOCK(&uring->lock);
+	op = uring->ops[URING_OPINDEX(sock->fd, msg)];
+	state = (op != NULL) ? op->state : URING_IDLE;
+	UNLOCK(&uring->lock);
+
+	return (state);
+}
+
+/*
+ * Complete 'dev' with the datagram an IORING_OP_RECVMSG has read.
+ */
+static unsigned int
+uring_recv(isc__socket_t *sock, isc_socketevent_t *dev, int *doiop) {
+	isc__socketthread_t *thread = &sock->manager->threads[sock->threadid];
+	isc__uring_t *uring = &thread->uring;
+	isc__uringop_t *op;
+	unsigned int state;
+
+	if (uring->fd == -1)
+		return (URING_IDLE);
+
+	LOCK(&uring->lock);
+	op = uring->ops[URING_OPINDEX(sock->fd, SELECT_POKE_READ)];
+	state = (op != NULL) ? op->state : URING_IDLE;
+	if (state == URING_INFLIGHT) {
+		*doiop = DOIO_SOFT;
+	} else if (state == URING_READY) {
+		op->state = URING_IDLE;
+		if (op->res < 0) {
+			*doiop = recv_error(sock, dev, -op->res);
+		} else {
+			op->addr.length = op->msg.msg_namelen;
+			*doiop = recv_datagram(sock, dev, &op->addr, &op->msg,
+					       op->data, op->res);
+		}
+	}
+	UNLOCK(&uring->lock);
+
+	return (state);
+}
+
+/*
+ * Complete 'dev' with the result of the IORING_OP_SENDMSG that sent it.
+ * The result of a send whose request has since been canceled is
+ * discarded.
+ */
+static unsigned int
+uring_send(isc__socket_t *sock, isc_socketevent_t *dev, int *doiop) {
+	isc__socketthread_t *thread = &sock->manager->threads[sock->threadid];
+	isc__uring_t *uring = &thread->uring;
+	isc__uringop_t *op;
+	unsigned int state;
+
+	if (uring->fd == -1)
+		return (URING_IDLE);
+
+	LOCK(&uring->lock);
+	op = uring->ops[URING_OPINDEX(sock->fd, SELECT_POKE_WRITE)];
+	state = (op != NULL) ? op->state : URING_IDLE;
+	if (state == URING_INFLIGHT) {
+		*doiop = DOIO_SOFT;
+	} else if (state == URING_READY && op->dev == NULL) {
+		op->state = URING_IDLE;
+		state = URING_IDLE;
+	} else if (state == URING_READY && op->dev != dev) {
+		/* The head of the queue goes first. */
+		*doiop = DOIO_SOFT;
+	} else if (state == URING_READY) {
+		op->state = URING_IDLE;
+		op->dev = NULL;
+		if (op->res < 0) {
+			*doiop = send_error(sock, dev, -op->res);
+		} else {
+			dev->n += op->res;
+			if ((size_t)op->res != op->iov.iov_len) {
+				*doiop = DOIO_SOFT;
+			} else {
+				dev->result = ISC_R_SUCCESS;
+				*doiop = DOIO_SUCCESS;
+			}
+		}
+	}
+	UNLOCK(&uring->lock);
+
+	return (state);
+}
+
+/*
+ * Forget that an IORING_OP_SENDMSG is sending 'dev', which is being
+ * taken off the send queue.
+ */
+static void
+uring_unsend(isc__socket_t *sock, isc_socketevent_t *dev) {
+	isc__socketthread_t *thread = &sock->manager->threads[sock->threadid];
+	isc__uring_t *uring = &thread->uring;
+	isc__uringop_t *op;
+
+	if (uring->fd == -1 || sock->fd == -1)
+		return;
+
+	LOCK(&uring->lock);
+	op = uring->ops[URING_OPINDEX(sock->fd, SELECT_POKE_WRITE)];
+	if (op != NULL && op->dev == dev)
+		op->dev = NULL;
+	UNLOCK(&uring->lock);
+}
+
+/*
+ * Take the connection an IORING_OP_ACCEPT has accepted.  '*fdp' is -1,
+ * with errno set, if the accept failed.
+ */
+static unsigned int
+uring_accept(isc__socket_t *sock, isc_sockaddr_t *addr,
+	     ISC_SOCKADDR_LEN_T *addrlenp, int *fdp)
+{
+	isc__socketthread_t *thread = &sock->manager->threads[sock->threadid];
+	isc__uring_t *uring = &thread->uring;
+	isc__uringop_t *op;
+	unsigned int state;
+
+	if (uring->fd == -1)
+		return (URING_IDLE);
+
+	LOCK(&uring->lock);
+	op = uring->ops[URING_OPINDEX(sock->fd, SELECT_POKE_READ)];
+	state = (op != NULL) ? op->state : URING_IDLE;
+	if (state == URING_READY) {
+		op->state = URING_IDLE;
+		*fdp = op->res;
+		if (op->res < 0) {
+			*fdp = -1;
+			errno = -op->res;
+		} else {
+			*addrlenp = op->addrlen;
+			memmove(&addr->type, &op->addr.type,
+				ISC_MIN(op->addrlen, sizeof(addr->type)));
+		}
+	}
+	UNLOCK(&uring->lock);
+
+	return (state);
+}
+
+/*
+ * Discard a datagram that has been received but not yet consumed.
+ */
+static void
+uring_purge(isc__socket_t *sock) {
+	isc__socketthread_t *thread = &sock->manager->threads[sock->threadid];
+	isc__uring_t *uring = &thread->uring;
+	isc__uringop_t *op;
+
+	if (uring->fd == -1)
+		return;
+
+	LOCK(&uring->lock);
+	op = uring->ops[URING_OPINDEX(sock->fd, SELECT_POKE_READ)];
+	if (op != NULL && op->state == URING_READY)
+		op->state = URING_IDLE;
+	UNLOCK(&uring->lock);
+}
+#endif	/* USE_IOURING */
+
+static int
+doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_RECV];
+	size_t read_count;
+	size_t actual_count;
+	struct msghdr msghdr;
+	isc_buffer_t *buffer;
+	int recv_errno;
+	char cmsgbuf[RECVCMSGBUFLEN] = {0};
+#ifdef USE_IOURING
+	int io_state = DOIO_SOFT;
+
+	if (sock->type == isc_sockettype_udp &&
+	    uring_recv(sock, dev, &io_state) != URING_IDLE)
+		return (io_state);
+#endif
+
+#ifdef USE_RECVMMSG
+	if (sock->recvbatch != NULL)
+		return (doio_recvbatch(sock, dev));
+#endif
+
+	build_msghdr_recv(sock, cmsgbuf, dev, &msghdr, iov, &read_count);
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	cc = recvmsg(sock->fd, &msghdr, 0);
+	recv_errno = errno;
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	if (cc < 0)
+		return (recv_error(sock, dev, recv_errno));
 
 	/*
 	 * On TCP and UNIX sockets, zero length reads indicate EOF,
@@ -2091,11 +3170,15 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 	struct iovec iov[MAXSCATTERGATHER_SEND];
 	size_t write_count;
 	struct msghdr msghdr;
-	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
 	int attempts = 0;
 	int send_errno;
-	char strbuf[ISC_STRERRORSIZE];
 	char cmsgbuf[SENDCMSGBUFLEN] = {0};
+#ifdef USE_IOURING
+	int io_state = DOIO_SOFT;
+
+	if (uring_send(sock, dev, &io_state) != URING_IDLE)
+		return (io_state);
+#endif
 
 	build_msghdr_send(sock, cmsgbuf, dev, &msghdr, iov, &write_count);
 
@@ -2115,64 +3198,7 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 		if (send_errno == EINTR && ++attempts < NRETRIES)
 			goto resend;
 
-		if (SOFT_ERROR(send_errno)) {
-			if (errno == EWOULDBLOCK || errno == EAGAIN)
-				dev->result = ISC_R_WOULDBLOCK;
-			return (DOIO_SOFT);
-		}
-
-#define SOFT_OR_HARD(_system, _isc) \
-	if (send_errno == _system) { \
-		if (sock->connected) { \
-			dev->result = _isc; \
-			inc_stats(sock->manager->stats, \
-				  sock->statsindex[STATID_SENDFAIL]); \
-			return (DOIO_HARD); \
-		} \
-		return (DOIO_SOFT); \
-	}
-#define ALWAYS_HARD(_system, _isc) \
-	if (send_errno == _system) { \
-		dev->result = _isc; \
-		inc_stats(sock->manager->stats, \
-			  sock->statsindex[STATID_SENDFAIL]); \
-		return (DOIO_HARD); \
-	}
-
-		SOFT_OR_HARD(ECONNREFUSED, ISC_R_CONNREFUSED);
-		ALWAYS_HARD(EACCES, ISC_R_NOPERM);
-		ALWAYS_HARD(EAFNOSUPPORT, ISC_R_ADDRNOTAVAIL);
-		ALWAYS_HARD(EADDRNOTAVAIL, ISC_R_ADDRNOTAVAIL);
-		ALWAYS_HARD(EHOSTUNREACH, ISC_R_HOSTUNREACH);
-#ifdef EHOSTDOWN
-		ALWAYS_HARD(EHOSTDOWN, ISC_R_HOSTUNREACH);
-#endif
-		ALWAYS_HARD(ENETUNREACH, ISC_R_NETUNREACH);
-		SOFT_OR_HARD(ENOBUFS, ISC_R_NORESOURCES);
-		ALWAYS_HARD(EPERM, ISC_R_HOSTUNREACH);
-		ALWAYS_HARD(EPIPE, ISC_R_NOTCONNECTED);
-		ALWAYS_HARD(ECONNRESET, ISC_R_CONNECTIONRESET);
-
-#undef SOFT_OR_HARD
-#undef ALWAYS_HARD
-
-		/*
-		 * The other error types depend on whether or not the
-		 * socket is UDP or TCP.  If it is UDP, some errors
-		 * that we expect to be fatal under TCP are merely
-		 * annoying, and are really soft errors.
-		 *
-		 * However, these soft errors are still returned as
-		 * a status.
-		 */
-		isc_sockaddr_format(&dev->address, addrbuf, sizeof(addrbuf));
-		isc__strerror(send_errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__, "internal_send: %s: %s",
-				 addrbuf, strbuf);
-		dev->result = isc__errno2result(send_errno);
-		inc_stats(sock->manager->stats,
-			  sock->statsindex[STATID_SENDFAIL]);
-		return (DOIO_HARD);
+		return (send_error(sock, dev, send_errno));
 	}
 
 	if (cc == 0) {
@@ -2199,6 +3225,71 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+#ifdef USE_SENDMMSG
+/*
+ * Flush up to SENDBATCH queued UDP send requests with one sendmmsg()
+ * call, posting their completion events.  Returns the number of requests
+ * completed; 0 means the caller should fall back to doio_send() for the
+ * request at the head of the queue, which also takes care of reporting
+ * any error.
+ */
+static unsigned int
+doio_sendbatch(isc__socket_t *sock) {
+	struct mmsghdr msgs[SENDBATCH];
+	struct iovec iov[SENDBATCH][MAXSCATTERGATHER_SEND];
+	char cmsgbuf[SENDBATCH][SENDCMSGBUFLEN];
+	isc_socketevent_t *dev, *devs[SENDBATCH];
+	unsigned int i, n = 0;
+	int cc;
+
+	if (sock->type != isc_sockettype_udp || sock->manager->maxudp != 0)
+		return (0);
+#ifdef USE_IOURING
+	/*
+	 * Let doio_send() deal with a send the kernel has been given.
+	 */
+	if (uring_state(sock, SELECT_POKE_WRITE) != URING_IDLE)
+		return (0);
+#endif
+
+	for (dev = ISC_LIST_HEAD(sock->send_list);
+	     dev != NULL && n < SENDBATCH;
+	     dev = ISC_LIST_NEXT(dev, ev_link))
+	{
+		/*
+		 * Without per packet DSCP, build_msghdr_send() sets the
+		 * DSCP value on the socket, which would apply to the
+		 * whole batch.  Leave such requests to doio_send().
+		 */
+		if ((dev->attributes & ISC_SOCKEVENTATTR_DSCP) != 0 &&
+		    !sock->pktdscp)
+			break;
+
+		memset(cmsgbuf[n], 0, sizeof(cmsgbuf[n]));
+		build_msghdr_send(sock, cmsgbuf[n], dev, &msgs[n].msg_hdr,
+				  iov[n], NULL);
+		msgs[n].msg_len = 0;
+		devs[n++] = dev;
+	}
+
+	if (n < 2)
+		return (0);
+
+	cc = sendmmsg(sock->fd, msgs, n, 0);
+	if (cc <= 0)
+		return (0);
+
+	for (i = 0; i < (unsigned int)cc; i++) {
+		dev = devs[i];
+		dev->n += msgs[i].msg_len;
+		dev->result = ISC_R_SUCCESS;
+		send_senddone_event(sock, &dev);
+	}
+
+	return (cc);
+}
+#endif /* USE_SENDMMSG */
+
 /*
  * Kill.
  *
@@ -2206,7 +3297,8 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
  * references exist.
  */
 static void
-socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
+socketclose(isc__socketthread_t *thread, isc__socket_t *sock, int fd) {
+	isc__socketmgr_t *manager = thread->manager;
 	isc_sockettype_t type = sock->type;
 	int lockid = FDLOCK_ID(fd);
 
@@ -2214,13 +3306,13 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 	 * No one has this socket open, so the watcher doesn't have to be
 	 * poked, and the socket doesn't have to be locked.
 	 */
-	LOCK(&manager->fdlock[lockid]);
-	manager->fds[fd] = NULL;
+	LOCK(&thread->fdlock[lockid]);
+	thread->fds[fd] = NULL;
 	if (type == isc_sockettype_fdwatch)
-		manager->fdstate[fd] = CLOSED;
+		thread->fdstate[fd] = CLOSED;
 	else
-		manager->fdstate[fd] = CLOSE_PENDING;
-	UNLOCK(&manager->fdlock[lockid]);
+		thread->fdstate[fd] = CLOSE_PENDING;
+	UNLOCK(&thread->fdlock[lockid]);
 	if (type == isc_sockettype_fdwatch) {
 		/*
 		 * The caller may close the socket once this function returns,
@@ -2231,10 +3323,21 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 		 * solve this would be to dup() the watched descriptor, but we
 		 * take a simpler approach at this moment.
 		 */
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
+#ifdef USE_IOURING
+		/*
+		 * The watcher may be blocked in io_uring_enter() and won't
+		 * submit the removals on our behalf until it wakes up.
+		 */
+		if (thread->uring.fd != -1) {
+			LOCK(&thread->uring.lock);
+			(void)uring_submit(&thread->uring);
+			UNLOCK(&thread->uring.lock);
+		}
+#endif
 	} else
-		select_poke(manager, fd, SELECT_POKE_CLOSE);
+		select_poke(manager, thread->threadid, fd, SELECT_POKE_CLOSE);
 
 	inc_stats(manager->stats, sock->statsindex[STATID_CLOSE]);
 	if (sock->active == 1) {
@@ -2243,29 +3346,29 @@ socketclose(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 	}
 
 	/*
-	 * update manager->maxfd here (XXX: this should be implemented more
+	 * update thread->maxfd here (XXX: this should be implemented more
 	 * efficiently)
 	 */
 #ifdef USE_SELECT
 	LOCK(&manager->lock);
-	if (manager->maxfd == fd) {
+	if (thread->maxfd == fd) {
 		int i;
 
-		manager->maxfd = 0;
+		thread->maxfd = 0;
 		for (i = fd - 1; i >= 0; i--) {
 			lockid = FDLOCK_ID(i);
 
-			LOCK(&manager->fdlock[lockid]);
-			if (manager->fdstate[i] == MANAGED) {
-				manager->maxfd = i;
-				UNLOCK(&manager->fdlock[lockid]);
+			LOCK(&thread->fdlock[lockid]);
+			if (thread->fdstate[i] == MANAGED) {
+				thread->maxfd = i;
+				UNLOCK(&thread->fdlock[lockid]);
 				break;
 			}
-			UNLOCK(&manager->fdlock[lockid]);
+			UNLOCK(&thread->fdlock[lockid]);
 		}
 #ifdef ISC_PLATFORM_USETHREADS
-		if (manager->maxfd < manager->pipe_fds[0])
-			manager->maxfd = manager->pipe_fds[0];
+		if (thread->maxfd < thread->pipe_fds[0])
+			thread->maxfd = thread->pipe_fds[0];
 #endif
 	}
 
@@ -2291,7 +3394,7 @@ destroy(isc__socket_t **sockp) {
 	if (sock->fd >= 0) {
 		fd = sock->fd;
 		sock->fd = -1;
-		socketclose(manager, sock, fd);
+		socketclose(&manager->threads[sock->threadid], sock, fd);
 	}
 
 	LOCK(&manager->lock);
@@ -2309,6 +3412,17 @@ destroy(isc__socket_t **sockp) {
 	UNLOCK(&manager->lock);
 }
 
+/*
+ * Choose the watcher thread for a newly opened descriptor.  Descriptors
+ * are striped across the threads so that each watcher's fds[] and
+ * fdstate[] entries, and the fdlock buckets protecting them, are only
+ * ever touched by one watcher.
+ */
+static inline int
+gen_threadid(isc__socket_t *sock) {
+	return (sock->fd % sock->manager->nthreads);
+}
+
 static isc_result_t
 allocate_socket(isc__socketmgr_t *manager, isc_sockettype_t type,
 		isc__socket_t **socketp)
@@ -2328,10 +3442,14 @@ allocate_socket(isc__socketmgr_t *manager, isc_sockettype_t type,
 	sock->manager = manager;
 	sock->type = type;
 	sock->fd = -1;
+	sock->threadid = -1;
 	sock->dscp = 0;		/* TOS/TCLASS is zero until set. */
 	sock->dupped = 0;
 	sock->statsindex = NULL;
 	sock->active = 0;
+#ifdef USE_RECVMMSG
+	sock->recvbatch = NULL;
+#endif
 
 	ISC_LINK_INIT(sock, link);
 
@@ -2413,6 +3531,10 @@ free_socket(isc__socket_t **socketp) {
 	sock->common.magic = 0;
 	sock->common.impmagic = 0;
 
+#ifdef USE_RECVMMSG
+	free_recvbatch(sock);
+#endif
+
 	DESTROYLOCK(&sock->lock);
 
 	isc_mem_put(sock->manager->mctx, sock, sizeof(*sock));
@@ -2932,6 +4054,7 @@ socket_create(isc_socketmgr_t *manager0, int pf, isc_sockettype_t type,
 {
 	isc__socket_t *sock = NULL;
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 	isc_result_t result;
 	int lockid;
 
@@ -2974,6 +4097,8 @@ socket_create(isc_socketmgr_t *manager0, int pf, isc_sockettype_t type,
 
 	sock->common.methods = (isc_socketmethods_t *)&socketmethods;
 	sock->references = 1;
+	sock->threadid = gen_threadid(sock);
+	thread = &manager->threads[sock->threadid];
 	*socketp = (isc_socket_t *)sock;
 
 	/*
@@ -2982,23 +4107,23 @@ socket_create(isc_socketmgr_t *manager0, int pf, isc_sockettype_t type,
 	 */
 
 	lockid = FDLOCK_ID(sock->fd);
-	LOCK(&manager->fdlock[lockid]);
-	manager->fds[sock->fd] = sock;
-	manager->fdstate[sock->fd] = MANAGED;
+	LOCK(&thread->fdlock[lockid]);
+	thread->fds[sock->fd] = sock;
+	thread->fdstate[sock->fd] = MANAGED;
 #if defined(USE_EPOLL)
-	manager->epoll_events[sock->fd] = 0;
+	thread->epoll_events[sock->fd] = 0;
 #endif
 #ifdef USE_DEVPOLL
-	INSIST(sock->manager->fdpollinfo[sock->fd].want_read == 0 &&
-	       sock->manager->fdpollinfo[sock->fd].want_write == 0);
+	INSIST(thread->fdpollinfo[sock->fd].want_read == 0 &&
+	       thread->fdpollinfo[sock->fd].want_write == 0);
 #endif
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 
 	LOCK(&manager->lock);
 	ISC_LIST_APPEND(manager->socklist, sock, link);
 #ifdef USE_SELECT
-	if (manager->maxfd < sock->fd)
-		manager->maxfd = sock->fd;
+	if (thread->maxfd < sock->fd)
+		thread->maxfd = sock->fd;
 #endif
 	UNLOCK(&manager->lock);
 
@@ -3060,23 +4185,27 @@ isc__socket_open(isc_socket_t *sock0) {
 
 	if (result == ISC_R_SUCCESS) {
 		int lockid = FDLOCK_ID(sock->fd);
+		isc__socketthread_t *thread;
+
+		sock->threadid = gen_threadid(sock);
+		thread = &sock->manager->threads[sock->threadid];
 
-		LOCK(&sock->manager->fdlock[lockid]);
-		sock->manager->fds[sock->fd] = sock;
-		sock->manager->fdstate[sock->fd] = MANAGED;
+		LOCK(&thread->fdlock[lockid]);
+		thread->fds[sock->fd] = sock;
+		thread->fdstate[sock->fd] = MANAGED;
 #if defined(USE_EPOLL)
-		sock->manager->epoll_events[sock->fd] = 0;
+		thread->epoll_events[sock->fd] = 0;
 #endif
 #ifdef USE_DEVPOLL
-		INSIST(sock->manager->fdpollinfo[sock->fd].want_read == 0 &&
-		       sock->manager->fdpollinfo[sock->fd].want_write == 0);
+		INSIST(thread->fdpollinfo[sock->fd].want_read == 0 &&
+		       thread->fdpollinfo[sock->fd].want_write == 0);
 #endif
-		UNLOCK(&sock->manager->fdlock[lockid]);
+		UNLOCK(&thread->fdlock[lockid]);
 
 #ifdef USE_SELECT
 		LOCK(&sock->manager->lock);
-		if (sock->manager->maxfd < sock->fd)
-			sock->manager->maxfd = sock->fd;
+		if (thread->maxfd < sock->fd)
+			thread->maxfd = sock->fd;
 		UNLOCK(&sock->manager->lock);
 #endif
 	}
@@ -3096,6 +4225,7 @@ isc__socket_fdwatchcreate(isc_socketmgr_t *manager0, int fd, int flags,
 			  isc_task_t *task, isc_socket_t **socketp)
 {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 	isc__socket_t *sock = NULL;
 	isc_result_t result;
 	int lockid;
@@ -3119,6 +4249,8 @@ isc__socket_fdwatchcreate(isc_socketmgr_t *manager0, int fd, int flags,
 
 	sock->common.methods = (isc_socketmethods_t *)&socketmethods;
 	sock->references = 1;
+	sock->threadid = gen_threadid(sock);
+	thread = &manager->threads[sock->threadid];
 	*socketp = (isc_socket_t *)sock;
 
 	/*
@@ -3127,26 +4259,28 @@ isc__socket_fdwatchcreate(isc_socketmgr_t *manager0, int fd, int flags,
 	 */
 
 	lockid = FDLOCK_ID(sock->fd);
-	LOCK(&manager->fdlock[lockid]);
-	manager->fds[sock->fd] = sock;
-	manager->fdstate[sock->fd] = MANAGED;
+	LOCK(&thread->fdlock[lockid]);
+	thread->fds[sock->fd] = sock;
+	thread->fdstate[sock->fd] = MANAGED;
 #if defined(USE_EPOLL)
-	manager->epoll_events[sock->fd] = 0;
+	thread->epoll_events[sock->fd] = 0;
 #endif
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 
 	LOCK(&manager->lock);
 	ISC_LIST_APPEND(manager->socklist, sock, link);
 #ifdef USE_SELECT
-	if (manager->maxfd < sock->fd)
-		manager->maxfd = sock->fd;
+	if (thread->maxfd < sock->fd)
+		thread->maxfd = sock->fd;
 #endif
 	UNLOCK(&manager->lock);
 
 	if (flags & ISC_SOCKFDWATCH_READ)
-		select_poke(sock->manager, sock->fd, SELECT_POKE_READ);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_READ);
 	if (flags & ISC_SOCKFDWATCH_WRITE)
-		select_poke(sock->manager, sock->fd, SELECT_POKE_WRITE);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_WRITE);
 
 	socket_log(sock, NULL, CREATION, isc_msgcat, ISC_MSGSET_SOCKET,
 		   ISC_MSG_CREATED, "fdwatch-created");
@@ -3177,11 +4311,11 @@ isc__socket_fdwatchpoke(isc_socket_t *sock0, int flags)
 		LOCK(&sock->lock);
 		if (((flags & ISC_SOCKFDWATCH_READ) != 0) &&
 		    !sock->pending_recv)
-			select_poke(sock->manager, sock->fd,
+			select_poke(sock->manager, sock->threadid, sock->fd,
 				    SELECT_POKE_READ);
 		if (((flags & ISC_SOCKFDWATCH_WRITE) != 0) &&
 		    !sock->pending_send)
-			select_poke(sock->manager, sock->fd,
+			select_poke(sock->manager, sock->threadid, sock->fd,
 				    SELECT_POKE_WRITE);
 		UNLOCK(&sock->lock);
 	}
@@ -3270,10 +4404,13 @@ isc__socket_close(isc_socket_t *sock0) {
 	sock->connecting = 0;
 	sock->bound = 0;
 	isc_sockaddr_any(&sock->peer_address);
+#ifdef USE_RECVMMSG
+	free_recvbatch(sock);
+#endif
 
 	UNLOCK(&sock->lock);
 
-	socketclose(manager, sock, fd);
+	socketclose(&manager->threads[sock->threadid], sock, fd);
 
 	return (ISC_R_SUCCESS);
 }
@@ -3445,8 +4582,12 @@ send_senddone_event(isc__socket_t *sock, isc_socketevent_t **dev) {
 	task = (*dev)->ev_sender;
 	(*dev)->ev_sender = sock;
 
-	if (ISC_LINK_LINKED(*dev, ev_link))
+	if (ISC_LINK_LINKED(*dev, ev_link)) {
+#ifdef USE_IOURING
+		uring_unsend(sock, *dev);
+#endif
 		ISC_LIST_DEQUEUE(sock->send_list, *dev, ev_link);
+	}
 
 	if (((*dev)->attributes & ISC_SOCKEVENTATTR_ATTACHED)
 	    == ISC_SOCKEVENTATTR_ATTACHED)
@@ -3546,8 +4687,23 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 
 	addrlen = sizeof(NEWCONNSOCK(dev)->peer_address.type);
 	memset(&NEWCONNSOCK(dev)->peer_address.type, 0, addrlen);
+#ifdef USE_IOURING
+	switch (uring_accept(sock, &NEWCONNSOCK(dev)->peer_address, &addrlen,
+			     &fd))
+	{
+	case URING_INFLIGHT:
+		/* We'll be dispatched again when it completes. */
+		UNLOCK(&sock->lock);
+		return;
+	case URING_READY:
+		break;
+	default:
+#endif
 	fd = accept(sock->fd, &NEWCONNSOCK(dev)->peer_address.type.sa,
 		    (void *)&addrlen);
+#ifdef USE_IOURING
+	}
+#endif
 
 #ifdef F_DUPFD
 	/*
@@ -3655,7 +4811,8 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 	 * Poke watcher if there are more pending accepts.
 	 */
 	if (!ISC_LIST_EMPTY(sock->accept_list))
-		select_poke(sock->manager, sock->fd, SELECT_POKE_ACCEPT);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_ACCEPT);
 
 	UNLOCK(&sock->lock);
 
@@ -3672,10 +4829,13 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 	 */
 	if (fd != -1) {
 		int lockid = FDLOCK_ID(fd);
+		isc__socketthread_t *thread;
 
 		NEWCONNSOCK(dev)->fd = fd;
+		NEWCONNSOCK(dev)->threadid = gen_threadid(NEWCONNSOCK(dev));
 		NEWCONNSOCK(dev)->bound = 1;
 		NEWCONNSOCK(dev)->connected = 1;
+		thread = &manager->threads[NEWCONNSOCK(dev)->threadid];
 
 		/*
 		 * Use minimum mtu if possible.
@@ -3699,19 +4859,19 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 			NEWCONNSOCK(dev)->active = 1;
 		}
 
-		LOCK(&manager->fdlock[lockid]);
-		manager->fds[fd] = NEWCONNSOCK(dev);
-		manager->fdstate[fd] = MANAGED;
+		LOCK(&thread->fdlock[lockid]);
+		thread->fds[fd] = NEWCONNSOCK(dev);
+		thread->fdstate[fd] = MANAGED;
 #if defined(USE_EPOLL)
-		manager->epoll_events[fd] = 0;
+		thread->epoll_events[fd] = 0;
 #endif
-		UNLOCK(&manager->fdlock[lockid]);
+		UNLOCK(&thread->fdlock[lockid]);
 
 		LOCK(&manager->lock);
 
 #ifdef USE_SELECT
-		if (manager->maxfd < fd)
-			manager->maxfd = fd;
+		if (thread->maxfd < fd)
+			thread->maxfd = fd;
 #endif
 
 		socket_log(sock, &NEWCONNSOCK(dev)->peer_address, CREATION,
@@ -3741,7 +4901,8 @@ internal_accept(isc_task_t *me, isc_event_t *ev) {
 	return;
 
  soft_error:
-	select_poke(sock->manager, sock->fd, SELECT_POKE_ACCEPT);
+	select_poke(sock->manager, sock->threadid, sock->fd,
+		    SELECT_POKE_ACCEPT);
 	UNLOCK(&sock->lock);
 
 	inc_stats(manager->stats, sock->statsindex[STATID_ACCEPTFAIL]);
@@ -3808,7 +4969,8 @@ internal_recv(isc_task_t *me, isc_event_t *ev) {
 
  poke:
 	if (!ISC_LIST_EMPTY(sock->recv_list))
-		select_poke(sock->manager, sock->fd, SELECT_POKE_READ);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_READ);
 
 	UNLOCK(&sock->lock);
 }
@@ -3848,6 +5010,12 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 	 */
 	dev = ISC_LIST_HEAD(sock->send_list);
 	while (dev != NULL) {
+#ifdef USE_SENDMMSG
+		if (doio_sendbatch(sock) != 0) {
+			dev = ISC_LIST_HEAD(sock->send_list);
+			continue;
+		}
+#endif
 		switch (doio_send(sock, dev)) {
 		case DOIO_SOFT:
 			goto poke;
@@ -3863,7 +5031,8 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 
  poke:
 	if (!ISC_LIST_EMPTY(sock->send_list))
-		select_poke(sock->manager, sock->fd, SELECT_POKE_WRITE);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_WRITE);
 
 	UNLOCK(&sock->lock);
 }
@@ -3904,7 +5073,8 @@ internal_fdwatch_write(isc_task_t *me, isc_event_t *ev) {
 	}
 
 	if (more_data)
-		select_poke(sock->manager, sock->fd, SELECT_POKE_WRITE);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_WRITE);
 
 	UNLOCK(&sock->lock);
 }
@@ -3945,7 +5115,8 @@ internal_fdwatch_read(isc_task_t *me, isc_event_t *ev) {
 	}
 
 	if (more_data)
-		select_poke(sock->manager, sock->fd, SELECT_POKE_READ);
+		select_poke(sock->manager, sock->threadid, sock->fd,
+			    SELECT_POKE_READ);
 
 	UNLOCK(&sock->lock);
 }
@@ -3955,7 +5126,7 @@ internal_fdwatch_read(isc_task_t *me, isc_event_t *ev) {
  * and unlocking twice if both reads and writes are possible.
  */
 static void
-process_fd(isc__socketmgr_t *manager, int fd, bool readable,
+process_fd(isc__socketthread_t *thread, int fd, bool readable,
 	   bool writeable)
 {
 	isc__socket_t *sock;
@@ -3963,19 +5134,22 @@ process_fd(isc__socketmgr_t *manager, int fd, bool readable,
 	bool unwatch_read = false, unwatch_write = false;
 	int lockid = FDLOCK_ID(fd);
 
+	if (readable || writeable)
+		thread->fdevents++;
+
 	/*
 	 * If the socket is going to be closed, don't do more I/O.
 	 */
-	LOCK(&manager->fdlock[lockid]);
-	if (manager->fdstate[fd] == CLOSE_PENDING) {
-		UNLOCK(&manager->fdlock[lockid]);
+	LOCK(&thread->fdlock[lockid]);
+	if (thread->fdstate[fd] == CLOSE_PENDING) {
+		UNLOCK(&thread->fdlock[lockid]);
 
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 		return;
 	}
 
-	sock = manager->fds[fd];
+	sock = thread->fds[fd];
 	unlock_sock = false;
 	if (readable) {
 		if (sock == NULL) {
@@ -4014,17 +5188,17 @@ check_write:
 		UNLOCK(&sock->lock);
 
  unlock_fd:
-	UNLOCK(&manager->fdlock[lockid]);
+	UNLOCK(&thread->fdlock[lockid]);
 	if (unwatch_read)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_READ);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_READ);
 	if (unwatch_write)
-		(void)unwatch_fd(manager, fd, SELECT_POKE_WRITE);
+		(void)unwatch_fd(thread, fd, SELECT_POKE_WRITE);
 
 }
 
 #ifdef USE_KQUEUE
 static bool
-process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct kevent *events, int nevents) {
 	int i;
 	bool readable, writable;
 	bool done = false;
@@ -4032,41 +5206,42 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	bool have_ctlevent = false;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == thread->nevents) {
 		/*
 		 * This is not an error, but something unexpected.  If this
 		 * happens, it may indicate the need for increasing
 		 * ISC_SOCKET_MAXEVENTS.
 		 */
-		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
+		manager_log(thread->manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
 			    nevents);
 	}
 
 	for (i = 0; i < nevents; i++) {
-		REQUIRE(events[i].ident < manager->maxsocks);
+		REQUIRE(events[i].ident < thread->manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].ident == (uintptr_t)manager->pipe_fds[0]) {
+		if (events[i].ident == (uintptr_t)thread->pipe_fds[0]) {
 			have_ctlevent = true;
 			continue;
 		}
 #endif
 		readable = (events[i].filter == EVFILT_READ);
 		writable = (events[i].filter == EVFILT_WRITE);
-		process_fd(manager, events[i].ident, readable, writable);
+		process_fd(thread, events[i].ident, readable, writable);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_EPOLL)
 static bool
-process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
+process_fds(isc__socketthread_t *thread, struct epoll_event *events,
+	    int nevents)
 {
 	int i;
 	bool done = false;
@@ -4074,17 +5249,17 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 	bool have_ctlevent = false;
 #endif
 
-	if (nevents == manager->nevents) {
-		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
+	if (nevents == thread->nevents) {
+		manager_log(thread->manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
 			    nevents);
 	}
 
 	for (i = 0; i < nevents; i++) {
-		REQUIRE(events[i].data.fd < (int)manager->maxsocks);
+		REQUIRE(events[i].data.fd < (int)thread->manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].data.fd == manager->pipe_fds[0]) {
+		if (events[i].data.fd == thread->pipe_fds[0]) {
 			have_ctlevent = true;
 			continue;
 		}
@@ -4099,71 +5274,184 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 			 * won't block because we use non-blocking sockets.
 			 */
 			int fd = events[i].data.fd;
-			events[i].events |= manager->epoll_events[fd];
+			events[i].events |= thread->epoll_events[fd];
 		}
-		process_fd(manager, events[i].data.fd,
+		process_fd(thread, events[i].data.fd,
 			   (events[i].events & EPOLLIN) != 0,
 			   (events[i].events & EPOLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
+#ifdef USE_IOURING
+/*
+ * Submit the queued poll requests and wait for at least one completion.
+ */
+static int
+uring_wait(isc__socketthread_t *thread) {
+	isc__uring_t *uring = &thread->uring;
+	unsigned int to_submit;
+	int ret, saved_errno;
+
+	LOCK(&uring->lock);
+	to_submit = uring->pending;
+	uring->pending = 0;
+	UNLOCK(&uring->lock);
+
+	ret = syscall(__NR_io_uring_enter, uring->fd, to_submit, 1,
+		      IORING_ENTER_GETEVENTS, NULL, 0);
+	if (ret < 0 || (unsigned int)ret < to_submit) {
+		saved_errno = errno;
+		LOCK(&uring->lock);
+		uring->pending += to_submit - (ret < 0 ? 0 : ret);
+		UNLOCK(&uring->lock);
+		/*
+		 * EBUSY means the completion queue must be drained first.
+		 */
+		if (ret < 0 && saved_errno == EBUSY)
+			return (0);
+		errno = saved_errno;
+	}
+
+	return (ret < 0 ? -1 : 0);
+}
+
+static bool
+uring_process(isc__socketthread_t *thread) {
+	isc__uring_t *uring = &thread->uring;
+	struct io_uring_cqe *cqe;
+	unsigned int head, tail;
+	isc__uringop_t *op;
+	uint64_t data;
+	uint32_t bit;
+	bool armed, write, done = false, have_ctlevent = false;
+	int fd, msg;
+
+	head = *uring->cqhead;
+	tail = __atomic_load_n(uring->cqtail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++) {
+		cqe = &uring->cqes[head & *uring->cqmask];
+		data = cqe->user_data;
+		if ((data & URING_NOTIFY) != 0)
+			continue;
+
+		if ((data & URING_OP) != 0) {
+			op = URING_OPPTR(data);
+			LOCK(&uring->lock);
+			INSIST(op->state == URING_INFLIGHT);
+			op->res = cqe->res;
+			if (op->fd == -1) {
+				op->state = URING_READY;
+				ISC_LIST_UNLINK(uring->orphans, op, link);
+				uring_freeop(thread, op);
+				UNLOCK(&uring->lock);
+				continue;
+			}
+			fd = op->fd;
+			write = (op->opcode == IORING_OP_SENDMSG);
+			op->state = (cqe->res == -ECANCELED) ? URING_IDLE
+							      : URING_READY;
+			armed = (op->state == URING_READY);
+			UNLOCK(&uring->lock);
+			if (armed)
+				process_fd(thread, fd, !write, write);
+			continue;
+		}
+
+		if (cqe->res == -ECANCELED)
+			continue;
+
+		fd = (int)(data >> 1);
+		msg = ((data & 1) != 0) ? SELECT_POKE_WRITE : SELECT_POKE_READ;
+		bit = (msg == SELECT_POKE_READ) ? EPOLLIN : EPOLLOUT;
+		REQUIRE(fd < (int)thread->manager->maxsocks);
+
+		/*
+		 * The poll is one-shot, so it is no longer armed.  Skip
+		 * completions that raced with an unwatch_fd().
+		 */
+		LOCK(&uring->lock);
+		armed = ((thread->epoll_events[fd] & bit) != 0);
+		thread->epoll_events[fd] &= ~bit;
+		UNLOCK(&uring->lock);
+		if (!armed)
+			continue;
+
+		if (fd == thread->pipe_fds[0]) {
+			have_ctlevent = true;
+			continue;
+		}
+		process_fd(thread, fd, msg == SELECT_POKE_READ,
+			   msg == SELECT_POKE_WRITE);
+	}
+	__atomic_store_n(uring->cqhead, head, __ATOMIC_RELEASE);
+
+	if (have_ctlevent) {
+		done = process_ctlfd(thread);
+		if (!done)
+			(void)watch_fd(thread, thread->pipe_fds[0],
+				       SELECT_POKE_READ);
+	}
+
+	return (done);
+}
+#endif	/* USE_IOURING */
 #elif defined(USE_DEVPOLL)
 static bool
-process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
+process_fds(isc__socketthread_t *thread, struct pollfd *events, int nevents) {
 	int i;
 	bool done = false;
 #ifdef USE_WATCHER_THREAD
 	bool have_ctlevent = false;
 #endif
 
-	if (nevents == manager->nevents) {
-		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
+	if (nevents == thread->nevents) {
+		manager_log(thread->manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
 			    nevents);
 	}
 
 	for (i = 0; i < nevents; i++) {
-		REQUIRE(events[i].fd < (int)manager->maxsocks);
+		REQUIRE(events[i].fd < (int)thread->manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].fd == manager->pipe_fds[0]) {
+		if (events[i].fd == thread->pipe_fds[0]) {
 			have_ctlevent = true;
 			continue;
 		}
 #endif
-		process_fd(manager, events[i].fd,
+		process_fd(thread, events[i].fd,
 			   (events[i].events & POLLIN) != 0,
 			   (events[i].events & POLLOUT) != 0);
 	}
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(thread);
 #endif
 
 	return (done);
 }
 #elif defined(USE_SELECT)
 static void
-process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
+process_fds(isc__socketthread_t *thread, int maxfd, fd_set *readfds,
 	    fd_set *writefds)
 {
 	int i;
 
-	REQUIRE(maxfd <= (int)manager->maxsocks);
+	REQUIRE(maxfd <= (int)thread->manager->maxsocks);
 
 	for (i = 0; i < maxfd; i++) {
 #ifdef USE_WATCHER_THREAD
-		if (i == manager->pipe_fds[0] || i == manager->pipe_fds[1])
+		if (i == thread->pipe_fds[0] || i == thread->pipe_fds[1])
 			continue;
 #endif /* USE_WATCHER_THREAD */
-		process_fd(manager, i, FD_ISSET(i, readfds),
+		process_fd(thread, i, FD_ISSET(i, readfds),
 			   FD_ISSET(i, writefds));
 	}
 }
@@ -4171,13 +5459,13 @@ process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
 
 #ifdef USE_WATCHER_THREAD
 static bool
-process_ctlfd(isc__socketmgr_t *manager) {
+process_ctlfd(isc__socketthread_t *thread) {
 	int msg, fd;
 
 	for (;;) {
-		select_readmsg(manager, &fd, &msg);
+		select_readmsg(thread, &fd, &msg);
 
-		manager_log(manager, IOEVENT,
+		manager_log(thread->manager, IOEVENT,
 			    isc_msgcat_get(isc_msgcat, ISC_MSGSET_SOCKET,
 					   ISC_MSG_WATCHERMSG,
 					   "watcher got message %d "
@@ -4204,7 +5492,7 @@ process_ctlfd(isc__socketmgr_t *manager) {
 		 * and decide if we need to watch on it now
 		 * or not.
 		 */
-		wakeup_socket(manager, fd, msg);
+		wakeup_socket(thread, fd, msg);
 	}
 
 	return (false);
@@ -4219,7 +5507,7 @@ process_ctlfd(isc__socketmgr_t *manager) {
  */
 static isc_threadresult_t
 watcher(void *uap) {
-	isc__socketmgr_t *manager = uap;
+	isc__socketthread_t *thread = uap;
 	bool done;
 	int cc;
 #ifdef USE_KQUEUE
@@ -4241,38 +5529,47 @@ watcher(void *uap) {
 #endif
 	char strbuf[ISC_STRERRORSIZE];
 
+#ifdef USE_IOURING
+	if (thread->uring.fd != -1)
+		fnname = "io_uring_enter()";
+#endif
 #if defined (USE_SELECT)
 	/*
 	 * Get the control fd here.  This will never change.
 	 */
-	ctlfd = manager->pipe_fds[0];
+	ctlfd = thread->pipe_fds[0];
 #endif
 	done = false;
 	while (!done) {
 		do {
 #ifdef USE_KQUEUE
-			cc = kevent(manager->kqueue_fd, NULL, 0,
-				    manager->events, manager->nevents, NULL);
+			cc = kevent(thread->kqueue_fd, NULL, 0,
+				    thread->events, thread->nevents, NULL);
 #elif defined(USE_EPOLL)
-			cc = epoll_wait(manager->epoll_fd, manager->events,
-					manager->nevents, -1);
+#ifdef USE_IOURING
+			if (thread->uring.fd != -1)
+				cc = uring_wait(thread);
+			else
+#endif
+			cc = epoll_wait(thread->epoll_fd, thread->events,
+					thread->nevents, -1);
 #elif defined(USE_DEVPOLL)
 			/*
 			 * Re-probe every thousand calls.
 			 */
-			if (manager->calls++ > 1000U) {
+			if (thread->calls++ > 1000U) {
 				result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 				if (result != ISC_R_SUCCESS)
-					manager->open_max = 64;
-				manager->calls = 0;
+					thread->open_max = 64;
+				thread->calls = 0;
 			}
 			for (pass = 0; pass < 2; pass++) {
-				dvp.dp_fds = manager->events;
-				dvp.dp_nfds = manager->nevents;
-				if (dvp.dp_nfds >= manager->open_max)
-					dvp.dp_nfds = manager->open_max - 1;
+				dvp.dp_fds = thread->events;
+				dvp.dp_nfds = thread->nevents;
+				if (dvp.dp_nfds >= thread->open_max)
+					dvp.dp_nfds = thread->open_max - 1;
 #ifndef ISC_SOCKET_USE_POLLWATCH
 				dvp.dp_timeout = -1;
 #else
@@ -4282,7 +5579,7 @@ watcher(void *uap) {
 					dvp.dp_timeout =
 						 ISC_SOCKET_POLLWATCH_TIMEOUT;
 #endif	/* ISC_SOCKET_USE_POLLWATCH */
-				cc = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+				cc = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 				if (cc == -1 && errno == EINVAL) {
 					/*
 					 * {OPEN_MAX} may have dropped.  Look
@@ -4290,23 +5587,23 @@ watcher(void *uap) {
 					 */
 					result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 					if (result != ISC_R_SUCCESS)
-						manager->open_max = 64;
+						thread->open_max = 64;
 				} else
 					break;
 			}
 #elif defined(USE_SELECT)
-			LOCK(&manager->lock);
-			memmove(manager->read_fds_copy, manager->read_fds,
-				manager->fd_bufsize);
-			memmove(manager->write_fds_copy, manager->write_fds,
-				manager->fd_bufsize);
-			maxfd = manager->maxfd + 1;
-			UNLOCK(&manager->lock);
-
-			cc = select(maxfd, manager->read_fds_copy,
-				    manager->write_fds_copy, NULL, NULL);
+			LOCK(&thread->manager->lock);
+			memmove(thread->read_fds_copy, thread->read_fds,
+				thread->fd_bufsize);
+			memmove(thread->write_fds_copy, thread->write_fds,
+				thread->fd_bufsize);
+			maxfd = thread->maxfd + 1;
+			UNLOCK(&thread->manager->lock);
+
+			cc = select(maxfd, thread->read_fds_copy,
+				    thread->write_fds_copy, NULL, NULL);
 #endif	/* USE_KQUEUE */
 
 			if (cc < 0 && !SOFT_ERROR(errno)) {
@@ -4335,7 +5632,7 @@ watcher(void *uap) {
 					 * (and it can also be a false positive)
 					 * so it would be just too noisy.
 					 */
-					manager_log(manager,
+					manager_log(thread->manager,
 						    ISC_LOGCATEGORY_GENERAL,
 						    ISC_LOGMODULE_SOCKET,
 						    ISC_LOG_DEBUG(1),
@@ -4346,21 +5643,28 @@ watcher(void *uap) {
 #endif
 		} while (cc < 0);
 
+		thread->waits++;
+#ifdef USE_IOURING
+		if (thread->uring.fd != -1) {
+			done = uring_process(thread);
+			continue;
+		}
+#endif
 #if defined(USE_KQUEUE) || defined (USE_EPOLL) || defined (USE_DEVPOLL)
-		done = process_fds(manager, manager->events, cc);
+		done = process_fds(thread, thread->events, cc);
 #elif defined(USE_SELECT)
-		process_fds(manager, maxfd, manager->read_fds_copy,
-			    manager->write_fds_copy);
+		process_fds(thread, maxfd, thread->read_fds_copy,
+			    thread->write_fds_copy);
 
 		/*
 		 * Process reads on internal, control fd.
 		 */
-		if (FD_ISSET(ctlfd, manager->read_fds_copy))
-			done = process_ctlfd(manager);
+		if (FD_ISSET(ctlfd, thread->read_fds_copy))
+			done = process_ctlfd(thread);
 #endif
 	}
 
-	manager_log(manager, TRACE, "%s",
+	manager_log(thread->manager, TRACE, "%s",
 		    isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				   ISC_MSG_EXITING, "watcher exiting"));
 
@@ -4386,25 +5690,224 @@ isc__socketmgr_maxudp(isc_socketmgr_t *manager0, int maxudp) {
 	manager->maxudp = maxudp;
 }
 
+#ifdef USE_IOURING
+/*
+ * Wait for the completions of the operations still in flight, so that
+ * the kernel is done with their buffers before they are freed.  Those
+ * the watcher submitted were canceled when it exited.
+ */
+static void
+uring_drain(isc__socketthread_t *thread) {
+	isc__uring_t *uring = &thread->uring;
+	isc__uringop_t *op;
+	struct io_uring_cqe *cqe;
+	unsigned int head, tail;
+	unsigned int idx, nops = 2 * thread->manager->maxsocks;
+	int ret;
+
+	LOCK(&uring->lock);
+	for (idx = 0; idx < nops; idx++) {
+		op = uring->ops[idx];
+		if (op == NULL)
+			continue;
+		uring->ops[idx] = NULL;
+		if (op->state != URING_INFLIGHT) {
+			uring_freeop(thread, op);
+			continue;
+		}
+		op->fd = -1;
+		ISC_LIST_APPEND(uring->orphans, op, link);
+		uring_cancel(uring, op);
+	}
+	(void)uring_submit(uring);
+
+	for (;;) {
+		head = *uring->cqhead;
+		tail = __atomic_load_n(uring->cqtail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++) {
+			cqe = &uring->cqes[head & *uring->cqmask];
+			if ((cqe->user_data & URING_NOTIFY) != 0 ||
+			    (cqe->user_data & URING_OP) == 0)
+				continue;
+			op = URING_OPPTR(cqe->user_data);
+			INSIST(op->fd == -1);
+			op->res = cqe->res;
+			op->state = URING_READY;
+			ISC_LIST_UNLINK(uring->orphans, op, link);
+			uring_freeop(thread, op);
+		}
+		__atomic_store_n(uring->cqhead, head, __ATOMIC_RELEASE);
+
+		if (ISC_LIST_EMPTY(uring->orphans))
+			break;
+		ret = syscall(__NR_io_uring_enter, uring->fd, 0, 1,
+			      IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0 && errno != EINTR && errno != EBUSY)
+			break;
+	}
+	UNLOCK(&uring->lock);
+}
+
+static void
+uring_cleanup(isc__socketthread_t *thread) {
+	isc__uring_t *uring = &thread->uring;
+
+	if (uring->ops != NULL) {
+		if (uring->sqes != NULL && uring->cqring != NULL)
+			uring_drain(thread);
+		isc_mem_put(thread->manager->mctx, uring->ops,
+			    2 * thread->manager->maxsocks *
+			    sizeof(uring->ops[0]));
+	}
+	if (uring->sqes != NULL)
+		(void)munmap(uring->sqes, uring->sqessize);
+	if (uring->cqring != NULL)
+		(void)munmap(uring->cqring, uring->cqringsize);
+	if (uring->sqring != NULL)
+		(void)munmap(uring->sqring, uring->sqringsize);
+	(void)close(uring->fd);
+	DESTROYLOCK(&uring->lock);
+	uring->fd = -1;
+}
+
+/*
+ * Set up an io_uring for the watcher.  On failure the watcher keeps
+ * using epoll.
+ */
+static isc_result_t
+uring_setup(isc__socketthread_t *thread) {
+	isc__uring_t *uring = &thread->uring;
+	struct io_uring_params params;
+	char strbuf[ISC_STRERRORSIZE];
+	const char *what;
+	isc_result_t result;
+	unsigned char *cq;
+
+	memset(uring, 0, sizeof(*uring));
+	memset(&params, 0, sizeof(params));
+
+	/*
+	 * Every watched descriptor can have a read and a write poll
+	 * outstanding; size the completion queue so they all fit.
+	 */
+#if defined(IORING_SETUP_CQSIZE) && defined(IORING_SETUP_CLAMP)
+	params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+	params.cq_entries = 2 * thread->manager->maxsocks;
+#endif
+
+	what = "io_uring_setup";
+	uring->fd = syscall(__NR_io_uring_setup, thread->nevents, &params);
+	if (uring->fd < 0)
+		goto fail;
+
+	result = isc_mutex_init(&uring->lock);
+	if (result != ISC_R_SUCCESS) {
+		(void)close(uring->fd);
+		uring->fd = -1;
+		return (result);
+	}
+	ISC_LIST_INIT(uring->orphans);
+
+	what = "mmap";
+	uring->sqringsize = params.sq_off.array +
+			    params.sq_entries * sizeof(unsigned int);
+	uring->sqring = mmap(NULL, uring->sqringsize, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, uring->fd,
+			     IORING_OFF_SQ_RING);
+	if (uring->sqring == MAP_FAILED) {
+		uring->sqring = NULL;
+		goto cleanup;
+	}
+	uring->cqringsize = params.cq_off.cqes +
+			    params.cq_entries * sizeof(struct io_uring_cqe);
+	uring->cqring = mmap(NULL, uring->cqringsize, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, uring->fd,
+			     IORING_OFF_CQ_RING);
+	if (uring->cqring == MAP_FAILED) {
+		uring->cqring = NULL;
+		goto cleanup;
+	}
+	uring->sqessize = params.sq_entries * sizeof(struct io_uring_sqe);
+	uring->sqes = mmap(NULL, uring->sqessize, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, uring->fd,
+			   IORING_OFF_SQES);
+	if (uring->sqes == MAP_FAILED) {
+		uring->sqes = NULL;
+		goto cleanup;
+	}
+
+	uring->sqentries = params.sq_entries;
+	uring->sqhead = (unsigned int *)((unsigned char *)uring->sqring +
+					 params.sq_off.head);
+	uring->sqtail = (unsigned int *)((unsigned char *)uring->sqring +
+					 params.sq_off.tail);
+	uring->sqmask = (unsigned int *)((unsigned char *)uring->sqring +
+					 params.sq_off.ring_mask);
+	uring->sqarray = (unsigned int *)((unsigned char *)uring->sqring +
+					  params.sq_off.array);
+	cq = uring->cqring;
+	uring->cqhead = (unsigned int *)(cq + params.cq_off.head);
+	uring->cqtail = (unsigned int *)(cq + params.cq_off.tail);
+	uring->cqmask = (unsigned int *)(cq + params.cq_off.ring_mask);
+	uring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+	uring->pending = 0;
+
+	what = "isc_mem_get";
+	uring->ops = isc_mem_get(thread->manager->mctx,
+				 2 * thread->manager->maxsocks *
+				 sizeof(uring->ops[0]));
+	if (uring->ops == NULL) {
+		errno = ENOMEM;
+		goto cleanup;
+	}
+	memset(uring->ops, 0,
+	       2 * thread->manager->maxsocks * sizeof(uring->ops[0]));
+
+	manager_log(thread->manager, ISC_LOGCATEGORY_GENERAL,
+		    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
+		    "watcher %d using io_uring (%u/%u entries)",
+		    thread->threadid, params.sq_entries, params.cq_entries);
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	isc__strerror(errno, strbuf, sizeof(strbuf));
+	result = isc__errno2result(errno);
+	uring_cleanup(thread);
+	goto log;
+
+ fail:
+	isc__strerror(errno, strbuf, sizeof(strbuf));
+	result = isc__errno2result(errno);
+	uring->fd = -1;
+
+ log:
+	manager_log(thread->manager, ISC_LOGCATEGORY_GENERAL,
+		    ISC_LOGMODULE_SOCKET, ISC_LOG_WARNING,
+		    "%s: %s; watcher %d falling back to epoll",
+		    what, strbuf, thread->threadid);
+	return (result);
+}
+#endif	/* USE_IOURING */
+
 /*
  * Create a new socket manager.
  */
 
 static isc_result_t
-setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+setup_watcher(isc_mem_t *mctx, isc__socketthread_t *thread) {
 	isc_result_t result;
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
 	char strbuf[ISC_STRERRORSIZE];
 #endif
 
 #ifdef USE_KQUEUE
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct kevent) *
-				      manager->nevents);
-	if (manager->events == NULL)
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct kevent) *
+				      thread->nevents);
+	if (thread->events == NULL)
 		return (ISC_R_NOMEMORY);
-	manager->kqueue_fd = kqueue();
-	if (manager->kqueue_fd == -1) {
+	thread->kqueue_fd = kqueue();
+	if (thread->kqueue_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4412,28 +5915,28 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
 		return (result);
 	}
 
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->kqueue_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
+		close(thread->kqueue_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct kevent) * thread->nevents);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_EPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
-				      manager->nevents);
-	if (manager->events == NULL)
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
+				      thread->nevents);
+	if (thread->events == NULL)
 		return (ISC_R_NOMEMORY);
-	manager->epoll_fd = epoll_create(manager->nevents);
-	if (manager->epoll_fd == -1) {
+	thread->epoll_fd = epoll_create(thread->nevents);
+	if (thread->epoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4441,44 +5944,54 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
 		return (result);
 	}
+#ifdef USE_IOURING
+	thread->uring.fd = -1;
+	if (isc_socket_iouring)
+		(void)uring_setup(thread);
+#endif
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->epoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
+#ifdef USE_IOURING
+		if (thread->uring.fd != -1)
+			uring_cleanup(thread);
+#endif
+		close(thread->epoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct epoll_event) * thread->nevents);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
 #elif defined(USE_DEVPOLL)
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
+	thread->nevents = ISC_SOCKET_MAXEVENTS;
 	result = isc_resource_getcurlimit(isc_resource_openfiles,
-					  &manager->open_max);
+					  &thread->open_max);
 	if (result != ISC_R_SUCCESS)
-		manager->open_max = 64;
-	manager->calls = 0;
-	manager->events = isc_mem_get(mctx, sizeof(struct pollfd) *
-				      manager->nevents);
-	if (manager->events == NULL)
+		thread->open_max = 64;
+	thread->calls = 0;
+	thread->events = isc_mem_get(mctx, sizeof(struct pollfd) *
+				      thread->nevents);
+	if (thread->events == NULL)
 		return (ISC_R_NOMEMORY);
 	/*
 	 * Note: fdpollinfo should be able to support all possible FDs, so
 	 * it must have maxsocks entries (not nevents).
 	 */
-	manager->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
-					  manager->maxsocks);
-	if (manager->fdpollinfo == NULL) {
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
+	thread->fdpollinfo = isc_mem_get(mctx, sizeof(pollinfo_t) *
+					  thread->manager->maxsocks);
+	if (thread->fdpollinfo == NULL) {
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
 		return (ISC_R_NOMEMORY);
 	}
-	memset(manager->fdpollinfo, 0, sizeof(pollinfo_t) * manager->maxsocks);
-	manager->devpoll_fd = open("/dev/poll", O_RDWR);
-	if (manager->devpoll_fd == -1) {
+	memset(thread->fdpollinfo, 0,
+	       sizeof(pollinfo_t) * thread->manager->maxsocks);
+	thread->devpoll_fd = open("/dev/poll", O_RDWR);
+	if (thread->devpoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -4486,20 +5999,20 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
+		isc_mem_put(mctx, thread->fdpollinfo,
+			    sizeof(pollinfo_t) * thread->manager->maxsocks);
 		return (result);
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->devpoll_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct pollfd) * manager->nevents);
-		isc_mem_put(mctx, manager->fdpollinfo,
-			    sizeof(pollinfo_t) * manager->maxsocks);
+		close(thread->devpoll_fd);
+		isc_mem_put(mctx, thread->events,
+			    sizeof(struct pollfd) * thread->nevents);
+		isc_mem_put(mctx, thread->fdpollinfo,
+			    sizeof(pollinfo_t) * thread->manager->maxsocks);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
@@ -4512,109 +6025,258 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 	 * FD_SETSIZE, but we separate the cases to avoid possible portability
 	 * issues regarding howmany() and the actual representation of fd_set.
 	 */
-	manager->fd_bufsize = howmany(manager->maxsocks, NFDBITS) *
+	thread->fd_bufsize = howmany(thread->manager->maxsocks, NFDBITS) *
 		sizeof(fd_mask);
 #else
-	manager->fd_bufsize = sizeof(fd_set);
-#endif
-
-	manager->read_fds = NULL;
-	manager->read_fds_copy = NULL;
-	manager->write_fds = NULL;
-	manager->write_fds_copy = NULL;
-
-	manager->read_fds = isc_mem_get(mctx, manager->fd_bufsize);
-	if (manager->read_fds != NULL)
-		manager->read_fds_copy = isc_mem_get(mctx, manager->fd_bufsize);
-	if (manager->read_fds_copy != NULL)
-		manager->write_fds = isc_mem_get(mctx, manager->fd_bufsize);
-	if (manager->write_fds != NULL) {
-		manager->write_fds_copy = isc_mem_get(mctx,
-						      manager->fd_bufsize);
-	}
-	if (manager->write_fds_copy == NULL) {
-		if (manager->write_fds != NULL) {
-			isc_mem_put(mctx, manager->write_fds,
-				    manager->fd_bufsize);
+	thread->fd_bufsize = sizeof(fd_set);
+#endif
+
+	thread->read_fds = NULL;
+	thread->read_fds_copy = NULL;
+	thread->write_fds = NULL;
+	thread->write_fds_copy = NULL;
+
+	thread->read_fds = isc_mem_get(mctx, thread->fd_bufsize);
+	if (thread->read_fds != NULL)
+		thread->read_fds_copy = isc_mem_get(mctx, thread->fd_bufsize);
+	if (thread->read_fds_copy != NULL)
+		thread->write_fds = isc_mem_get(mctx, thread->fd_bufsize);
+	if (thread->write_fds != NULL) {
+		thread->write_fds_copy = isc_mem_get(mctx,
+						      thread->fd_bufsize);
+	}
+	if (thread->write_fds_copy == NULL) {
+		if (thread->write_fds != NULL) {
+			isc_mem_put(mctx, thread->write_fds,
+				    thread->fd_bufsize);
 		}
-		if (manager->read_fds_copy != NULL) {
-			isc_mem_put(mctx, manager->read_fds_copy,
-				    manager->fd_bufsize);
+		if (thread->read_fds_copy != NULL) {
+			isc_mem_put(mctx, thread->read_fds_copy,
+				    thread->fd_bufsize);
 		}
-		if (manager->read_fds != NULL) {
-			isc_mem_put(mctx, manager->read_fds,
-				    manager->fd_bufsize);
+		if (thread->read_fds != NULL) {
+			isc_mem_put(mctx, thread->read_fds,
+				    thread->fd_bufsize);
 		}
 		return (ISC_R_NOMEMORY);
 	}
-	memset(manager->read_fds, 0, manager->fd_bufsize);
-	memset(manager->write_fds, 0, manager->fd_bufsize);
+	memset(thread->read_fds, 0, thread->fd_bufsize);
+	memset(thread->write_fds, 0, thread->fd_bufsize);
+
+#ifdef USE_WATCHER_THREAD
+	(void)watch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	thread->maxfd = thread->pipe_fds[0];
+#else /* USE_WATCHER_THREAD */
+	thread->maxfd = 0;
+#endif /* USE_WATCHER_THREAD */
+#endif	/* USE_KQUEUE */
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+cleanup_watcher(isc_mem_t *mctx, isc__socketthread_t *thread) {
+#ifdef USE_WATCHER_THREAD
+	isc_result_t result;
+
+	result = unwatch_fd(thread, thread->pipe_fds[0], SELECT_POKE_READ);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "epoll_ctl(DEL) %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"));
+	}
+#endif	/* USE_WATCHER_THREAD */
+
+#ifdef USE_KQUEUE
+	close(thread->kqueue_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct kevent) * thread->nevents);
+#elif defined(USE_EPOLL)
+#ifdef USE_IOURING
+	if (thread->uring.fd != -1)
+		uring_cleanup(thread);
+#endif
+	close(thread->epoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct epoll_event) * thread->nevents);
+#elif defined(USE_DEVPOLL)
+	close(thread->devpoll_fd);
+	isc_mem_put(mctx, thread->events,
+		    sizeof(struct pollfd) * thread->nevents);
+	isc_mem_put(mctx, thread->fdpollinfo,
+		    sizeof(pollinfo_t) * thread->manager->maxsocks);
+#elif defined(USE_SELECT)
+	if (thread->read_fds != NULL)
+		isc_mem_put(mctx, thread->read_fds, thread->fd_bufsize);
+	if (thread->read_fds_copy != NULL)
+		isc_mem_put(mctx, thread->read_fds_copy, thread->fd_bufsize);
+	if (thread->write_fds != NULL)
+		isc_mem_put(mctx, thread->write_fds, thread->fd_bufsize);
+	if (thread->write_fds_copy != NULL)
+		isc_mem_put(mctx, thread->write_fds_copy, thread->fd_bufsize);
+#endif	/* USE_KQUEUE */
+}
+
+/*
+ * Set up the per-thread state: the descriptor tables, the fd lock
+ * buckets, the control pipe and the multiplexing descriptor.
+ */
+static isc_result_t
+setup_thread(isc__socketthread_t *thread) {
+	isc__socketmgr_t *manager = thread->manager;
+	isc_mem_t *mctx = manager->mctx;
+	isc_result_t result = ISC_R_SUCCESS;
+	int i;
+#ifdef USE_WATCHER_THREAD
+	char strbuf[ISC_STRERRORSIZE];
+#endif
+
+	thread->fds = isc_mem_get(mctx,
+				  manager->maxsocks * sizeof(isc__socket_t *));
+	if (thread->fds == NULL)
+		return (ISC_R_NOMEMORY);
+	memset(thread->fds, 0, manager->maxsocks * sizeof(isc__socket_t *));
+
+	thread->fdstate = isc_mem_get(mctx, manager->maxsocks * sizeof(int));
+	if (thread->fdstate == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto free_fds;
+	}
+	memset(thread->fdstate, 0, manager->maxsocks * sizeof(int));
+
+#if defined(USE_EPOLL)
+	thread->epoll_events = isc_mem_get(mctx, (manager->maxsocks *
+						  sizeof(uint32_t)));
+	if (thread->epoll_events == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto free_fdstate;
+	}
+	memset(thread->epoll_events, 0, manager->maxsocks * sizeof(uint32_t));
+#endif
+
+	thread->fdlock = isc_mem_get(mctx, FDLOCK_COUNT * sizeof(isc_mutex_t));
+	if (thread->fdlock == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto free_events;
+	}
+	for (i = 0; i < FDLOCK_COUNT; i++) {
+		result = isc_mutex_init(&thread->fdlock[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (--i >= 0)
+				DESTROYLOCK(&thread->fdlock[i]);
+			goto free_fdlock;
+		}
+	}
+
+#ifdef USE_WATCHER_THREAD
+	/*
+	 * Create the special fds that will be used to wake up the
+	 * select/poll loop when something internal needs to be done.
+	 */
+	if (pipe(thread->pipe_fds) != 0) {
+		isc__strerror(errno, strbuf, sizeof(strbuf));
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "pipe() %s: %s",
+				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+						ISC_MSG_FAILED, "failed"),
+				 strbuf);
+		result = ISC_R_UNEXPECTED;
+		goto destroy_fdlock;
+	}
 
-#ifdef USE_WATCHER_THREAD
-	(void)watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	manager->maxfd = manager->pipe_fds[0];
-#else /* USE_WATCHER_THREAD */
-	manager->maxfd = 0;
-#endif /* USE_WATCHER_THREAD */
-#endif	/* USE_KQUEUE */
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[0]) == ISC_R_SUCCESS);
+#if 0
+	RUNTIME_CHECK(make_nonblock(thread->pipe_fds[1]) == ISC_R_SUCCESS);
+#endif
+#endif	/* USE_WATCHER_THREAD */
+
+	/*
+	 * Set up initial state for the select loop
+	 */
+	result = setup_watcher(mctx, thread);
+	if (result != ISC_R_SUCCESS)
+		goto close_pipe;
 
 	return (ISC_R_SUCCESS);
+
+ close_pipe:
+#ifdef USE_WATCHER_THREAD
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+
+ destroy_fdlock:
+#endif	/* USE_WATCHER_THREAD */
+	for (i = 0; i < FDLOCK_COUNT; i++)
+		DESTROYLOCK(&thread->fdlock[i]);
+
+ free_fdlock:
+	isc_mem_put(mctx, thread->fdlock, FDLOCK_COUNT * sizeof(isc_mutex_t));
+	thread->fdlock = NULL;
+
+ free_events:
+#if defined(USE_EPOLL)
+	isc_mem_put(mctx, thread->epoll_events,
+		    manager->maxsocks * sizeof(uint32_t));
+	thread->epoll_events = NULL;
+
+ free_fdstate:
+#endif
+	isc_mem_put(mctx, thread->fdstate, manager->maxsocks * sizeof(int));
+	thread->fdstate = NULL;
+
+ free_fds:
+	isc_mem_put(mctx, thread->fds,
+		    manager->maxsocks * sizeof(isc__socket_t *));
+	thread->fds = NULL;
+
+	return (result);
 }
 
+/*
+ * Undo setup_thread().  The watcher, if any, must already have exited.
+ */
 static void
-cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+cleanup_thread(isc__socketthread_t *thread) {
+	isc__socketmgr_t *manager = thread->manager;
+	isc_mem_t *mctx = manager->mctx;
+	int i;
+
+	cleanup_watcher(mctx, thread);
+
 #ifdef USE_WATCHER_THREAD
-	isc_result_t result;
+	(void)close(thread->pipe_fds[0]);
+	(void)close(thread->pipe_fds[1]);
+#endif /* USE_WATCHER_THREAD */
 
-	result = unwatch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	if (result != ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "epoll_ctl(DEL) %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-	}
-#endif	/* USE_WATCHER_THREAD */
+	for (i = 0; i < (int)manager->maxsocks; i++)
+		if (thread->fdstate[i] == CLOSE_PENDING) /* no need to lock */
+			(void)close(i);
 
-#ifdef USE_KQUEUE
-	close(manager->kqueue_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct kevent) * manager->nevents);
-#elif defined(USE_EPOLL)
-	close(manager->epoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct epoll_event) * manager->nevents);
-#elif defined(USE_DEVPOLL)
-	close(manager->devpoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct pollfd) * manager->nevents);
-	isc_mem_put(mctx, manager->fdpollinfo,
-		    sizeof(pollinfo_t) * manager->maxsocks);
-#elif defined(USE_SELECT)
-	if (manager->read_fds != NULL)
-		isc_mem_put(mctx, manager->read_fds, manager->fd_bufsize);
-	if (manager->read_fds_copy != NULL)
-		isc_mem_put(mctx, manager->read_fds_copy, manager->fd_bufsize);
-	if (manager->write_fds != NULL)
-		isc_mem_put(mctx, manager->write_fds, manager->fd_bufsize);
-	if (manager->write_fds_copy != NULL)
-		isc_mem_put(mctx, manager->write_fds_copy, manager->fd_bufsize);
-#endif	/* USE_KQUEUE */
+#if defined(USE_EPOLL)
+	isc_mem_put(mctx, thread->epoll_events,
+		    manager->maxsocks * sizeof(uint32_t));
+#endif
+	isc_mem_put(mctx, thread->fds,
+		    manager->maxsocks * sizeof(isc__socket_t *));
+	isc_mem_put(mctx, thread->fdstate, manager->maxsocks * sizeof(int));
+
+	for (i = 0; i < FDLOCK_COUNT; i++)
+		DESTROYLOCK(&thread->fdlock[i]);
+	isc_mem_put(mctx, thread->fdlock, FDLOCK_COUNT * sizeof(isc_mutex_t));
 }
 
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc__socketmgr_create2(mctx, managerp, 0));
+	return (isc__socketmgr_create2(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks)
+		       unsigned int maxsocks, int nthreads)
 {
 	int i;
 	isc__socketmgr_t *manager;
-#ifdef USE_WATCHER_THREAD
-	char strbuf[ISC_STRERRORSIZE];
-#endif
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
@@ -4633,6 +6295,13 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 	if (maxsocks == 0)
 		maxsocks = ISC_SOCKET_MAXSOCKETS;
+#ifdef USE_WATCHER_THREAD
+	if (nthreads <= 0)
+		nthreads = 1;
+#else
+	/* The application drives a single event loop. */
+	nthreads = 1;
+#endif /* USE_WATCHER_THREAD */
 
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
@@ -4643,53 +6312,18 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	manager->maxsocks = maxsocks;
 	manager->reserved = 0;
 	manager->maxudp = 0;
-	manager->fds = isc_mem_get(mctx,
-				   manager->maxsocks * sizeof(isc__socket_t *));
-	if (manager->fds == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto free_manager;
-	}
-	manager->fdstate = isc_mem_get(mctx, manager->maxsocks * sizeof(int));
-	if (manager->fdstate == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto free_manager;
-	}
-#if defined(USE_EPOLL)
-	manager->epoll_events = isc_mem_get(mctx, (manager->maxsocks *
-						   sizeof(uint32_t)));
-	if (manager->epoll_events == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto free_manager;
-	}
-	memset(manager->epoll_events, 0, manager->maxsocks * sizeof(uint32_t));
-#endif
+	manager->nthreads = nthreads;
 	manager->stats = NULL;
 
 	manager->common.methods = &socketmgrmethods;
 	manager->common.magic = ISCAPI_SOCKETMGR_MAGIC;
 	manager->common.impmagic = SOCKET_MANAGER_MAGIC;
 	manager->mctx = NULL;
-	memset(manager->fds, 0, manager->maxsocks * sizeof(isc_socket_t *));
+	isc_mem_attach(mctx, &manager->mctx);
 	ISC_LIST_INIT(manager->socklist);
 	result = isc_mutex_init(&manager->lock);
 	if (result != ISC_R_SUCCESS)
 		goto free_manager;
-	manager->fdlock = isc_mem_get(mctx, FDLOCK_COUNT * sizeof(isc_mutex_t));
-	if (manager->fdlock == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto cleanup_lock;
-	}
-	for (i = 0; i < FDLOCK_COUNT; i++) {
-		result = isc_mutex_init(&manager->fdlock[i]);
-		if (result != ISC_R_SUCCESS) {
-			while (--i >= 0)
-				DESTROYLOCK(&manager->fdlock[i]);
-			isc_mem_put(mctx, manager->fdlock,
-				    FDLOCK_COUNT * sizeof(isc_mutex_t));
-			manager->fdlock = NULL;
-			goto cleanup_lock;
-		}
-	}
 
 #ifdef USE_WATCHER_THREAD
 	if (isc_condition_init(&manager->shutdown_ok) != ISC_R_SUCCESS) {
@@ -4700,58 +6334,49 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_lock;
 	}
-
-	/*
-	 * Create the special fds that will be used to wake up the
-	 * select/poll loop when something internal needs to be done.
-	 */
-	if (pipe(manager->pipe_fds) != 0) {
-		isc__strerror(errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "pipe() %s: %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"),
-				 strbuf);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_condition;
-	}
-
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[0]) == ISC_R_SUCCESS);
-#if 0
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[1]) == ISC_R_SUCCESS);
-#endif
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_SHARED_MANAGER
 	manager->refs = 1;
 #endif /* USE_SHARED_MANAGER */
 
-	/*
-	 * Set up initial state for the select loop
-	 */
-	result = setup_watcher(mctx, manager);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
+	manager->threads = isc_mem_get(mctx, manager->nthreads *
+				       sizeof(isc__socketthread_t));
+	if (manager->threads == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_condition;
+	}
+	memset(manager->threads, 0,
+	       manager->nthreads * sizeof(isc__socketthread_t));
+
+	for (i = 0; i < manager->nthreads; i++) {
+		isc__socketthread_t *thread = &manager->threads[i];
 
-	memset(manager->fdstate, 0, manager->maxsocks * sizeof(int));
+		thread->manager = manager;
+		thread->threadid = i;
+		result = setup_thread(thread);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_threads;
 
 #ifdef USE_WATCHER_THREAD
-	/*
-	 * Start up the select/poll thread.
-	 */
-	if (isc_thread_create(watcher, manager, &manager->watcher) !=
-	    ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		cleanup_watcher(mctx, manager);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup;
-	}
-	isc_thread_setname(manager->watcher, "isc-socket");
+		/*
+		 * Start up the select/poll thread.
+		 */
+		if (isc_thread_create(watcher, thread, &thread->thread) !=
+		    ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_create() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			cleanup_thread(thread);
+			result = ISC_R_UNEXPECTED;
+			goto cleanup_threads;
+		}
+		isc_thread_setname(thread->thread, "isc-socket");
 #endif /* USE_WATCHER_THREAD */
-	isc_mem_attach(mctx, &manager->mctx);
+	}
 
 #ifdef USE_SHARED_MANAGER
 	socketmgr = manager;
@@ -4760,44 +6385,27 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 	return (ISC_R_SUCCESS);
 
-cleanup:
+ cleanup_threads:
+	while (--i >= 0) {
+		select_poke(manager, i, 0, SELECT_POKE_SHUTDOWN);
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
-#endif	/* USE_WATCHER_THREAD */
+		(void)isc_thread_join(manager->threads[i].thread, NULL);
+#endif /* USE_WATCHER_THREAD */
+		cleanup_thread(&manager->threads[i]);
+	}
+	isc_mem_put(mctx, manager->threads,
+		    manager->nthreads * sizeof(isc__socketthread_t));
 
+ cleanup_condition:
 #ifdef USE_WATCHER_THREAD
-cleanup_condition:
 	(void)isc_condition_destroy(&manager->shutdown_ok);
-#endif	/* USE_WATCHER_THREAD */
-
 
-cleanup_lock:
-	if (manager->fdlock != NULL) {
-		for (i = 0; i < FDLOCK_COUNT; i++)
-			DESTROYLOCK(&manager->fdlock[i]);
-	}
+ cleanup_lock:
+#endif	/* USE_WATCHER_THREAD */
 	DESTROYLOCK(&manager->lock);
 
-free_manager:
-	if (manager->fdlock != NULL) {
-		isc_mem_put(mctx, manager->fdlock,
-			    FDLOCK_COUNT * sizeof(isc_mutex_t));
-	}
-#if defined(USE_EPOLL)
-	if (manager->epoll_events != NULL) {
-		isc_mem_put(mctx, manager->epoll_events,
-			    manager->maxsocks * sizeof(uint32_t));
-	}
-#endif
-	if (manager->fdstate != NULL) {
-		isc_mem_put(mctx, manager->fdstate,
-			    manager->maxsocks * sizeof(int));
-	}
-	if (manager->fds != NULL) {
-		isc_mem_put(mctx, manager->fds,
-			    manager->maxsocks * sizeof(isc_socket_t *));
-	}
+ free_manager:
+	isc_mem_detach(&manager->mctx);
 	isc_mem_put(mctx, manager, sizeof(*manager));
 
 	return (result);
@@ -4871,56 +6479,46 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 	UNLOCK(&manager->lock);
 
 	/*
-	 * Here, poke our select/poll thread.  Do this by closing the write
-	 * half of the pipe, which will send EOF to the read half.
+	 * Here, poke our select/poll threads.  Do this by writing a
+	 * shutdown message to each of their control pipes.
 	 * This is currently a no-op in the non-threaded case.
 	 */
-	select_poke(manager, 0, SELECT_POKE_SHUTDOWN);
+	for (i = 0; i < manager->nthreads; i++)
+		select_poke(manager, i, 0, SELECT_POKE_SHUTDOWN);
 
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Wait for thread to exit.
+	 * Wait for threads to exit.
 	 */
-	if (isc_thread_join(manager->watcher, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	for (i = 0; i < manager->nthreads; i++) {
+		if (isc_thread_join(manager->threads[i].thread, NULL) !=
+		    ISC_R_SUCCESS)
+		{
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+		}
+	}
 #endif /* USE_WATCHER_THREAD */
 
 	/*
 	 * Clean up.
 	 */
-	cleanup_watcher(manager->mctx, manager);
+	for (i = 0; i < manager->nthreads; i++)
+		cleanup_thread(&manager->threads[i]);
+	isc_mem_put(manager->mctx, manager->threads,
+		    manager->nthreads * sizeof(isc__socketthread_t));
 
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif /* USE_WATCHER_THREAD */
 
-	for (i = 0; i < (int)manager->maxsocks; i++)
-		if (manager->fdstate[i] == CLOSE_PENDING) /* no need to lock */
-			(void)close(i);
-
-#if defined(USE_EPOLL)
-	isc_mem_put(manager->mctx, manager->epoll_events,
-		    manager->maxsocks * sizeof(uint32_t));
-#endif
-	isc_mem_put(manager->mctx, manager->fds,
-		    manager->maxsocks * sizeof(isc__socket_t *));
-	isc_mem_put(manager->mctx, manager->fdstate,
-		    manager->maxsocks * sizeof(int));
-
 	if (manager->stats != NULL)
 		isc_stats_detach(&manager->stats);
 
-	if (manager->fdlock != NULL) {
-		for (i = 0; i < FDLOCK_COUNT; i++)
-			DESTROYLOCK(&manager->fdlock[i]);
-		isc_mem_put(manager->mctx, manager->fdlock,
-			    FDLOCK_COUNT * sizeof(isc_mutex_t));
-	}
 	DESTROYLOCK(&manager->lock);
 	manager->common.magic = 0;
 	manager->common.impmagic = 0;
@@ -4980,7 +6578,8 @@ socket_recv(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 		 * watched, poke the watcher to start paying attention to it.
 		 */
 		if (ISC_LIST_EMPTY(sock->recv_list) && !sock->pending_recv)
-			select_poke(sock->manager, sock->fd, SELECT_POKE_READ);
+			select_poke(sock->manager, sock->threadid, sock->fd,
+				    SELECT_POKE_READ);
 		ISC_LIST_ENQUEUE(sock->recv_list, dev, ev_link);
 
 		socket_log(sock, NULL, EVENT, NULL, 0, 0,
@@ -5184,8 +6783,8 @@ socket_send(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 			 */
 			if (ISC_LIST_EMPTY(sock->send_list) &&
 			    !sock->pending_send)
-				select_poke(sock->manager, sock->fd,
-					    SELECT_POKE_WRITE);
+				select_poke(sock->manager, sock->threadid,
+					    sock->fd, SELECT_POKE_WRITE);
 			ISC_LIST_ENQUEUE(sock->send_list, dev, ev_link);
 
 			socket_log(sock, NULL, EVENT, NULL, 0, 0,
@@ -5557,6 +7156,28 @@ isc__socket_bind(isc_socket_t *sock0, const isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+#ifdef SO_REUSEPORT
+		if (setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT,
+			       (void *)&on, sizeof(on)) < 0)
+		{
+			isc__strerror(errno, strbuf, sizeof(strbuf));
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "setsockopt(%d, SO_REUSEPORT) %s: %s",
+					 sock->fd,
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"),
+					 strbuf);
+			UNLOCK(&sock->lock);
+			return (ISC_R_UNEXPECTED);
+		}
+#else
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+#endif
+	}
 #ifdef AF_UNIX
  bind_socket:
 #endif
@@ -5806,7 +7427,8 @@ isc__socket_accept(isc_socket_t *sock0,
 	ISC_LIST_ENQUEUE(sock->accept_list, dev, ev_link);
 
 	if (do_poke)
-		select_poke(manager, sock->fd, SELECT_POKE_ACCEPT);
+		select_poke(manager, sock->threadid, sock->fd,
+			    SELECT_POKE_ACCEPT);
 
 	UNLOCK(&sock->lock);
 	return (ISC_R_SUCCESS);
@@ -5957,7 +7579,8 @@ isc__socket_connect(isc_socket_t *sock0, const isc_sockaddr_t *addr,
 	 * bit of time waking it up now or later won't matter all that much.
 	 */
 	if (ISC_LIST_EMPTY(sock->connect_list) && !sock->connecting)
-		select_poke(manager, sock->fd, SELECT_POKE_CONNECT);
+		select_poke(manager, sock->threadid, sock->fd,
+			    SELECT_POKE_CONNECT);
 
 	sock->connecting = 1;
 
@@ -6031,7 +7654,7 @@ internal_connect(isc_task_t *me, isc_event_t *ev) {
 		 */
 		if (SOFT_ERROR(errno) || errno == EINPROGRESS) {
 			sock->connecting = 1;
-			select_poke(sock->manager, sock->fd,
+			select_poke(sock->manager, sock->threadid, sock->fd,
 				    SELECT_POKE_CONNECT);
 			UNLOCK(&sock->lock);
 
@@ -6402,6 +8025,116 @@ isc_socket_socketevent(isc_mem_t *mctx, void *sender,
 	return (allocate_socketevent(mctx, sender, eventtype, action, arg));
 }
 
+isc_result_t
+isc_socket_setrecvbatch(isc_socket_t *sock0, unsigned int count,
+			unsigned int size)
+{
+	isc__socket_t *sock = (isc__socket_t *)sock0;
+#ifdef USE_RECVMMSG
+	isc__recvbatch_t *batch;
+	isc_mem_t *mctx;
+#endif
+
+	REQUIRE(VALID_SOCKET(sock));
+	REQUIRE(sock->type == isc_sockettype_udp);
+	REQUIRE(count <= 1 || size > 0);
+
+#ifdef USE_RECVMMSG
+	mctx = sock->manager->mctx;
+
+	LOCK(&sock->lock);
+	free_recvbatch(sock);
+	if (count <= 1) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_SUCCESS);
+	}
+
+	batch = isc_mem_get(mctx, sizeof(*batch));
+	if (batch == NULL) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOMEMORY);
+	}
+	memset(batch, 0, sizeof(*batch));
+	batch->count = count;
+	batch->size = size;
+	sock->recvbatch = batch;
+
+	batch->msgs = isc_mem_get(mctx, count * sizeof(batch->msgs[0]));
+	batch->iov = isc_mem_get(mctx, count * sizeof(batch->iov[0]));
+	batch->addrs = isc_mem_get(mctx, count * sizeof(batch->addrs[0]));
+	batch->cmsgbufs = isc_mem_get(mctx, count * RECVCMSGBUFLEN);
+	batch->data = isc_mem_get(mctx, count * size);
+	if (batch->msgs == NULL || batch->iov == NULL ||
+	    batch->addrs == NULL || batch->cmsgbufs == NULL ||
+	    batch->data == NULL)
+	{
+		free_recvbatch(sock);
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOMEMORY);
+	}
+	UNLOCK(&sock->lock);
+
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(count);
+	UNUSED(size);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
+/*%
+ * The most datagrams isc_socket_purge() reads before giving up on a
+ * socket that is being flooded.
+ */
+#define PURGE_MAX	256
+
+isc_result_t
+isc_socket_purge(isc_socket_t *sock0) {
+	isc__socket_t *sock = (isc__socket_t *)sock0;
+	char buf[1];
+	unsigned int i;
+	isc_result_t result = ISC_R_QUOTA;
+
+	REQUIRE(VALID_SOCKET(sock));
+	REQUIRE(sock->type == isc_sockettype_udp);
+
+	LOCK(&sock->lock);
+	REQUIRE(sock->fd >= 0);
+	/*
+	 * An internal receive event may still be queued for a canceled
+	 * request; with nothing on recv_list it will do no I/O.
+	 */
+	INSIST(ISC_LIST_EMPTY(sock->recv_list));
+
+#ifdef USE_RECVMMSG
+	if (sock->recvbatch != NULL) {
+		sock->recvbatch->next = 0;
+		sock->recvbatch->avail = 0;
+	}
+#endif
+#ifdef USE_IOURING
+	uring_purge(sock);
+#endif
+
+	/*
+	 * The descriptor is non-blocking; reading a datagram into a
+	 * short buffer discards the rest of it.
+	 */
+	for (i = 0; i < PURGE_MAX; i++) {
+		if (recv(sock->fd, buf, sizeof(buf), 0) >= 0)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			result = ISC_R_SUCCESS;
+			break;
+		}
+		/* Pending ICMP errors and EINTR: try again. */
+	}
+	UNLOCK(&sock->lock);
+
+	return (result);
+}
+
 #ifndef USE_WATCHER_THREAD
 /*
  * In our assumed scenario, we can simply use a single static object.
@@ -6415,6 +8148,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			  isc_socketwait_t **swaitp)
 {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 	int n;
 #ifdef USE_KQUEUE
 	struct timespec ts, *tsp;
@@ -6436,6 +8170,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 #endif
 	if (manager == NULL)
 		return (0);
+	thread = &manager->threads[0];
 
 #ifdef USE_KQUEUE
 	if (tvp != NULL) {
@@ -6444,8 +8179,8 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		tsp = &ts;
 	} else
 		tsp = NULL;
-	swait_private.nevents = kevent(manager->kqueue_fd, NULL, 0,
-				       manager->events, manager->nevents,
+	swait_private.nevents = kevent(thread->kqueue_fd, NULL, 0,
+				       thread->events, thread->nevents,
 				       tsp);
 	n = swait_private.nevents;
 #elif defined(USE_EPOLL)
@@ -6453,32 +8188,32 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		timeout = tvp->tv_sec * 1000 + (tvp->tv_usec + 999) / 1000;
 	else
 		timeout = -1;
-	swait_private.nevents = epoll_wait(manager->epoll_fd,
-					   manager->events,
-					   manager->nevents, timeout);
+	swait_private.nevents = epoll_wait(thread->epoll_fd,
+					   thread->events,
+					   thread->nevents, timeout);
 	n = swait_private.nevents;
 #elif defined(USE_DEVPOLL)
 	/*
 	 * Re-probe every thousand calls.
 	 */
-	if (manager->calls++ > 1000U) {
+	if (thread->calls++ > 1000U) {
 		result = isc_resource_getcurlimit(isc_resource_openfiles,
-						  &manager->open_max);
+						  &thread->open_max);
 		if (result != ISC_R_SUCCESS)
-			manager->open_max = 64;
-		manager->calls = 0;
+			thread->open_max = 64;
+		thread->calls = 0;
 	}
 	for (pass = 0; pass < 2; pass++) {
-		dvp.dp_fds = manager->events;
-		dvp.dp_nfds = manager->nevents;
-		if (dvp.dp_nfds >= manager->open_max)
-			dvp.dp_nfds = manager->open_max - 1;
+		dvp.dp_fds = thread->events;
+		dvp.dp_nfds = thread->nevents;
+		if (dvp.dp_nfds >= thread->open_max)
+			dvp.dp_nfds = thread->open_max - 1;
 		if (tvp != NULL) {
 			dvp.dp_timeout = tvp->tv_sec * 1000 +
 				(tvp->tv_usec + 999) / 1000;
 		} else
 			dvp.dp_timeout = -1;
-		n = ioctl(manager->devpoll_fd, DP_POLL, &dvp);
+		n = ioctl(thread->devpoll_fd, DP_POLL, &dvp);
 		if (n == -1 && errno == EINVAL) {
 			/*
 			 * {OPEN_MAX} may have dropped.  Look
@@ -6486,26 +8221,27 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 			 */
 			result = isc_resource_getcurlimit(
 							isc_resource_openfiles,
-							&manager->open_max);
+							&thread->open_max);
 			if (result != ISC_R_SUCCESS)
-				manager->open_max = 64;
+				thread->open_max = 64;
 		} else
 			break;
 	}
 	swait_private.nevents = n;
 #elif defined(USE_SELECT)
-	memmove(manager->read_fds_copy, manager->read_fds, manager->fd_bufsize);
-	memmove(manager->write_fds_copy, manager->write_fds,
-		manager->fd_bufsize);
+	memmove(thread->read_fds_copy, thread->read_fds, thread->fd_bufsize);
+	memmove(thread->write_fds_copy, thread->write_fds,
+		thread->fd_bufsize);
 
-	swait_private.readset = manager->read_fds_copy;
-	swait_private.writeset = manager->write_fds_copy;
-	swait_private.maxfd = manager->maxfd + 1;
+	swait_private.readset = thread->read_fds_copy;
+	swait_private.writeset = thread->write_fds_copy;
+	swait_private.maxfd = thread->maxfd + 1;
 
 	n = select(swait_private.maxfd, swait_private.readset,
 		   swait_private.writeset, NULL, tvp);
 #endif
 
+	thread->waits++;
 	*swaitp = &swait_private;
 	return (n);
 }
@@ -6513,6 +8249,7 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 isc_result_t
 isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 	isc__socketmgr_t *manager = (isc__socketmgr_t *)manager0;
+	isc__socketthread_t *thread;
 
 	REQUIRE(swait == &swait_private);
 
@@ -6522,12 +8259,13 @@ isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 #endif
 	if (manager == NULL)
 		return (ISC_R_NOTFOUND);
+	thread = &manager->threads[0];
 
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
-	(void)process_fds(manager, manager->events, swait->nevents);
+	(void)process_fds(thread, thread->events, swait->nevents);
 	return (ISC_R_SUCCESS);
 #elif defined(USE_SELECT)
-	process_fds(manager, swait->maxfd, swait->readset, swait->writeset);
+	process_fds(thread, swait->maxfd, swait->readset, swait->writeset);
 	return (ISC_R_SUCCESS);
 #endif
 }
@@ -6602,6 +8340,7 @@ isc_socketmgr_renderxml(isc_socketmgr_t *mgr0, xmlTextWriterPtr writer) {
 	isc_sockaddr_t addr;
 	ISC_SOCKADDR_LEN_T len;
 	int xmlrc;
+	int i;
 
 	LOCK(&mgr->lock);
 
@@ -6611,6 +8350,31 @@ isc_socketmgr_renderxml(isc_socketmgr_t *mgr0, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterEndElement(writer));
 #endif	/* USE_SHARED_MANAGER */
 
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "socketthreads"));
+	for (i = 0; i < mgr->nthreads; i++) {
+		isc__socketthread_t *thread = &mgr->threads[i];
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "socketthread"));
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "id"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%d",
+						    thread->threadid));
+		TRY0(xmlTextWriterEndElement(writer));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "waits"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    thread->waits));
+		TRY0(xmlTextWriterEndElement(writer));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "events"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    thread->fdevents));
+		TRY0(xmlTextWriterEndElement(writer));
+
+		TRY0(xmlTextWriterEndElement(writer)); /* socketthread */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* socketthreads */
+
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "sockets"));
 	sock = ISC_LIST_HEAD(mgr->socklist);
 	while (sock != NULL) {
@@ -6719,7 +8483,8 @@ isc_socketmgr_renderjson(isc_socketmgr_t *mgr0, json_object *stats) {
 	char peerbuf[ISC_SOCKADDR_FORMATSIZE];
 	isc_sockaddr_t addr;
 	ISC_SOCKADDR_LEN_T len;
-	json_object *obj, *array = json_object_new_array();
+	json_object *obj, *threads, *array = json_object_new_array();
+	int i;
 
 	CHECKMEM(array);
 
@@ -6731,6 +8496,29 @@ isc_socketmgr_renderjson(isc_socketmgr_t *mgr0, json_object *stats) {
 	json_object_object_add(stats, "references", obj);
 #endif	/* USE_SHARED_MANAGER */
 
+	threads = json_object_new_array();
+	CHECKMEM(threads);
+	json_object_object_add(stats, "socketthreads", threads);
+	for (i = 0; i < mgr->nthreads; i++) {
+		isc__socketthread_t *thread = &mgr->threads[i];
+		json_object *entry = json_object_new_object();
+
+		CHECKMEM(entry);
+		json_object_array_add(threads, entry);
+
+		obj = json_object_new_int(thread->threadid);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "id", obj);
+
+		obj = json_object_new_int64(thread->waits);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "waits", obj);
+
+		obj = json_object_new_int64(thread->fdevents);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "events", obj);
+	}
+
 	sock = ISC_LIST_HEAD(mgr->socklist);
 	while (sock != NULL) {
 		json_object *states, *entry = json_object_new_object();
@@ -81,6 +81,12 @@
  */
 LIBISC_EXTERNAL_DATA int isc_dscp_check_value = -1;
 
+/*
+ * Set by the -T iouring option on the command line.  io_uring is
+ * not available on Windows; this is here so that named links.
+ */
+LIBISC_EXTERNAL_DATA bool isc_socket_iouring = false;
+
 /*
  * How in the world can Microsoft exist with APIs like this?
  * We can't actually call this directly, because it turns out
@@ -2652,18 +2658,21 @@ SocketIoThread(LPVOID ThreadContext) {
  */
 isc_result_t
 isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
-	return (isc_socketmgr_create2(mctx, managerp, 0));
+	return (isc_socketmgr_create2(mctx, managerp, 0, 1));
 }
 
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
-		       unsigned int maxsocks)
+		       unsigned int maxsocks, int nthreads)
 {
 	isc_socketmgr_t *manager;
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
 
+	/* The I/O completion port has its own pool of worker threads. */
+	UNUSED(nthreads);
+
 	if (maxsocks != 0)
 		return (ISC_R_NOTIMPLEMENTED);
 
@@ -3272,6 +3281,13 @@ isc__socket_bind(isc_socket_t *sock, const isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	/*
+	 * Windows has no equivalent of SO_REUSEPORT load balancing.
+	 */
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+	}
 	if (bind(sock->fd, &sockaddr->type.sa, sockaddr->length) < 0) {
 		bind_errno = WSAGetLastError();
 		UNLOCK(&sock->lock);
@@ -3988,6 +4004,24 @@ isc_socket_socketevent(isc_mem_t *mctx, void *sender,
 	return (allocate_socketevent(mctx, sender, eventtype, action, arg));
 }
 
+isc_result_t
+isc_socket_setrecvbatch(isc_socket_t *sock, unsigned int count,
+			unsigned int size)
+{
+	UNUSED(sock);
+	UNUSED(count);
+	UNUSED(size);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+isc_socket_purge(isc_socket_t *sock) {
+	UNUSED(sock);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 #ifdef HAVE_LIBXML2
 
 static const char *
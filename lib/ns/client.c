@@ -1056,6 +1056,170 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	ns_client_next(client, result);
 }
 
+isc_result_t
+ns_client_sendcached(ns_client_t *client, const isc_region_t *response) {
+	isc_result_t result;
+	unsigned char *data;
+	isc_buffer_t buffer;
+	isc_buffer_t tcpbuffer;
+	isc_region_t r;
+	dns_compress_t cctx;
+	dns_rdataset_t *opt = NULL;
+	unsigned char sendbuf[SEND_BUFFER_SIZE];
+	unsigned int count;
+	dns_rcode_t rcode;
+	size_t respsize;
+#ifdef HAVE_DNSTAP
+	dns_dtmsgtype_t dtmsgtype;
+	isc_region_t zr;
+#endif /* HAVE_DNSTAP */
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(response != NULL && response->length >= DNS_MESSAGE_HEADERLEN);
+
+	CTRACE("sendcached");
+
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		result = ns_client_addopt(client, client->message, &opt);
+		if (result != ISC_R_SUCCESS)
+			goto done;
+	}
+
+	result = client_allocsendbuf(client, &buffer, &tcpbuffer, 0,
+				     sendbuf, &data);
+	if (result != ISC_R_SUCCESS)
+		goto done;
+
+	/*
+	 * Copy the response and fixup id.  The OPT record is rendered
+	 * again for this client.
+	 */
+	isc_buffer_availableregion(&buffer, &r);
+	result = isc_buffer_copyregion(&buffer, response);
+	if (result != ISC_R_SUCCESS)
+		goto done;
+	r.base[0] = (client->message->id >> 8) & 0xff;
+	r.base[1] = client->message->id & 0xff;
+	rcode = r.base[3] & 0x0f;
+
+	if (opt != NULL) {
+		result = dns_compress_init(&cctx, -1, client->mctx);
+		if (result != ISC_R_SUCCESS)
+			goto done;
+		count = 0;
+		result = dns_rdataset_towire(opt, dns_rootname, &cctx,
+					     &buffer, 0, &count);
+		dns_compress_invalidate(&cctx);
+		if (result != ISC_R_SUCCESS)
+			goto done;
+		count += (r.base[10] << 8) | r.base[11];
+		r.base[10] = (count >> 8) & 0xff;
+		r.base[11] = count & 0xff;
+	}
+
+#ifdef HAVE_DNSTAP
+	memset(&zr, 0, sizeof(zr));
+	if ((r.base[2] & 0x04) != 0 && client->query.authzone != NULL) {
+		dns_name_toregion(dns_zone_getorigin(client->query.authzone),
+				  &zr);
+	}
+
+	if ((client->message->flags & DNS_MESSAGEFLAG_RD) != 0)
+		dtmsgtype = DNS_DTTYPE_CR;
+	else
+		dtmsgtype = DNS_DTTYPE_AR;
+#endif /* HAVE_DNSTAP */
+
+	if (client->sendcb != NULL) {
+		client->sendcb(&buffer);
+	} else if (TCP_CLIENT(client)) {
+		isc_buffer_usedregion(&buffer, &r);
+		isc_buffer_putuint16(&tcpbuffer, (uint16_t) r.length);
+		isc_buffer_add(&tcpbuffer, r.length);
+#ifdef HAVE_DNSTAP
+		if (client->view != NULL) {
+			dns_dt_send(client->view, dtmsgtype,
+				    &client->peeraddr, &client->destsockaddr,
+				    true, &zr, &client->requesttime, NULL,
+				    &buffer);
+		}
+#endif /* HAVE_DNSTAP */
+
+		/* don't count the 2-octet length header */
+		respsize = isc_buffer_usedlength(&tcpbuffer) - 2;
+		result = client_sendpkg(client, &tcpbuffer);
+
+		switch (isc_sockaddr_pf(&client->peeraddr)) {
+		case AF_INET:
+			isc_stats_increment(client->sctx->tcpoutstats4,
+					    ISC_MIN((int)respsize / 16, 256));
+			break;
+		case AF_INET6:
+			isc_stats_increment(client->sctx->tcpoutstats6,
+					    ISC_MIN((int)respsize / 16, 256));
+			break;
+		default:
+			INSIST(0);
+			break;
+		}
+	} else {
+		respsize = isc_buffer_usedlength(&buffer);
+		result = client_sendpkg(client, &buffer);
+#ifdef HAVE_DNSTAP
+		if (client->view != NULL) {
+			dns_dt_send(client->view, dtmsgtype,
+				    &client->peeraddr,
+				    &client->destsockaddr,
+				    false, &zr,
+				    &client->requesttime, NULL, &buffer);
+		}
+#endif /* HAVE_DNSTAP */
+
+		switch (isc_sockaddr_pf(&client->peeraddr)) {
+		case AF_INET:
+			isc_stats_increment(client->sctx->udpoutstats4,
+					    ISC_MIN((int)respsize / 16, 256));
+			break;
+		case AF_INET6:
+			isc_stats_increment(client->sctx->udpoutstats6,
+					    ISC_MIN((int)respsize / 16, 256));
+			break;
+		default:
+			INSIST(0);
+			break;
+		}
+	}
+
+	ns_stats_increment(client->sctx->nsstats, ns_statscounter_response);
+	dns_rcodestats_increment(client->sctx->rcodestats, rcode);
+	if (opt != NULL) {
+		ns_stats_increment(client->sctx->nsstats,
+				   ns_statscounter_edns0out);
+		dns_rdataset_disassociate(opt);
+		dns_message_puttemprdataset(client->message, &opt);
+	}
+
+	if (result == ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+
+ done:
+	if (opt != NULL) {
+		dns_rdataset_disassociate(opt);
+		dns_message_puttemprdataset(client->message, &opt);
+	}
+
+	if (client->tcpbuf != NULL) {
+		isc_mem_put(client->mctx, client->tcpbuf, TCP_BUFFER_SIZE);
+		client->tcpbuf = NULL;
+	}
+
+	if (result == ISC_R_NOSPACE)
+		return (result);
+
+	ns_client_next(client, result);
+	return (ISC_R_SUCCESS);
+}
+
 static void
 client_send(ns_client_t *client) {
 	isc_result_t result;
@@ -1070,6 +1234,7 @@ client_send(ns_client_t *client) {
 	unsigned int preferred_glue;
 	bool opt_included = false;
 	size_t respsize;
+	unsigned int bodylen;
 	dns_aclenv_t *env = ns_interfacemgr_getaclenv(client->interface->mgr);
 #ifdef HAVE_DNSTAP
 	unsigned char zone[DNS_NAME_MAXWIRE];
@@ -1142,6 +1307,8 @@ client_send(ns_client_t *client) {
 	result = dns_compress_init(&cctx, -1, client->mctx);
 	if (result != ISC_R_SUCCESS)
 		goto done;
+	if ((client->sctx->options & NS_SERVER_LEGACYCOMPRESS) != 0)
+		dns_compress_setlegacy(&cctx, true);
 	if (client->peeraddr_valid && client->view != NULL) {
 		isc_netaddr_t netaddr;
 		dns_name_t *name = NULL;
@@ -1213,10 +1380,14 @@ client_send(ns_client_t *client) {
 	if (result != ISC_R_SUCCESS && result != ISC_R_NOSPACE)
 		goto done;
  renderend:
+	bodylen = isc_buffer_usedlength(&buffer);
 	result = dns_message_renderend(client->message);
 	if (result != ISC_R_SUCCESS)
 		goto done;
 
+	if ((client->query.attributes & NS_QUERYATTR_RESPCACHE) != 0)
+		ns__query_cacheresponse(client, &buffer, bodylen);
+
 #ifdef HAVE_DNSTAP
 	memset(&zr, 0, sizeof(zr));
 	if (((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) &&
@@ -2472,9 +2643,11 @@ ns__client_request(isc_task_t *task, isc_event_t *event) {
 	}
 
 	/*
-	 * It's a request.  Parse it.
+	 * It's a request.  Parse it.  The buffer is not reused until the
+	 * request is finished, so the message can refer to it.
 	 */
-	result = dns_message_parse(client->message, buffer, 0);
+	result = dns_message_parse(client->message, buffer,
+				   DNS_MESSAGEPARSE_NOCOPY);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * Parsing the request failed.  Send a response
@@ -3710,6 +3883,19 @@ ns_clientmgr_createclients(ns_clientmgr_t *manager, unsigned int n,
 	return (result);
 }
 
+isc_result_t
+ns_clientmgr_createdispclient(ns_clientmgr_t *manager, ns_interface_t *ifp,
+			      unsigned int disp)
+{
+	REQUIRE(VALID_MANAGER(manager));
+	REQUIRE(disp < (unsigned int)ifp->nudpdispatch);
+	REQUIRE(ifp->udpdispatch[disp] != NULL);
+
+	MTRACE("createdispclient");
+
+	return (get_client(manager, ifp, ifp->udpdispatch[disp], false));
+}
+
 isc_sockaddr_t *
 ns_client_getsockaddr(ns_client_t *client) {
 	return (&client->peeraddr);
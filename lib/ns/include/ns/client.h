@@ -233,6 +233,21 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+isc_result_t
+ns_client_sendcached(ns_client_t *client, const isc_region_t *response);
+/*%<
+ * Finish processing the current client request by sending 'response',
+ * a response from the response cache, with client->message->id for the
+ * id, and an OPT record built for this client if it wants one.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	the request is finished, whether or not the
+ *			response could be sent
+ *\li	ISC_R_NOSPACE	nothing was sent because the response does not
+ *			fit in the client's buffer; the request remains to
+ *			be answered
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%<
@@ -303,6 +318,15 @@ ns_clientmgr_createclients(ns_clientmgr_t *manager, unsigned int n,
  * otherwise for UDP requests.
  */
 
+isc_result_t
+ns_clientmgr_createdispclient(ns_clientmgr_t *manager, ns_interface_t *ifp,
+			      unsigned int disp);
+/*%<
+ * Create a client listening for UDP requests on the single dispatch
+ * 'ifp->udpdispatch[disp]'.  Used when each dispatch of an interface
+ * has a socket and client manager of its own.
+ */
+
 isc_sockaddr_t *
 ns_client_getsockaddr(ns_client_t *client);
 /*%<
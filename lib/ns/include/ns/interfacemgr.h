@@ -81,6 +81,9 @@ struct ns_interface {
 	int			ntcpcurrent;	/*%< Current ditto, locked */
 	int			nudpdispatch;	/*%< Number of UDP dispatches */
 	ns_clientmgr_t *	clientmgr;	/*%< Client manager. */
+	ns_clientmgr_t *	udpclientmgr[MAX_UDP_DISPATCH];
+						/*%< Per-dispatch client
+						     managers ("reuseport") */
 	ISC_LINK(ns_interface_t) link;
 };
 
@@ -122,6 +125,16 @@ ns_interfacemgr_setbacklog(ns_interfacemgr_t *mgr, int backlog);
  * Set the size of the listen() backlog queue.
  */
 
+void
+ns_interfacemgr_setreuseport(ns_interfacemgr_t *mgr, bool reuseport);
+/*%<
+ * If 'reuseport' is true, interfaces created after this call open one
+ * UDP socket per dispatch, bound with SO_REUSEPORT, each served by its
+ * own client manager.  Otherwise all the UDP dispatches of an interface
+ * share one socket.  Falls back to the shared socket if the system
+ * does not support SO_REUSEPORT.
+ */
+
 bool
 ns_interfacemgr_islistening(ns_interfacemgr_t *mgr);
 /*%<
@@ -93,6 +93,19 @@ struct ns_query {
 
 	ns_query_recparam_t		recparam;
 
+	/*
+	 * The response cache key options and zone serial for a query
+	 * whose response may be cached, and the name and kind of
+	 * response that RRL accounted it against.
+	 */
+	struct {
+		uint32_t		options;
+		uint32_t		serial;
+		dns_name_t *		rrlname;
+		dns_fixedname_t		rrlfixed;
+		isc_result_t		rrlresult;
+	} respcache;
+
 	dns_keytag_t root_key_sentinel_keyid;
 	bool root_key_sentinel_is_ta;
 	bool root_key_sentinel_not_ta;
@@ -115,6 +128,7 @@ struct ns_query {
 #define NS_QUERYATTR_DNS64EXCLUDE	0x8000
 #define NS_QUERYATTR_RRL_CHECKED	0x10000
 #define NS_QUERYATTR_REDIRECT		0x20000
+#define NS_QUERYATTR_RESPCACHE		0x40000
 
 /* query context structure */
 
@@ -191,4 +205,16 @@ ns__query_sfcache(query_ctx_t *qctx);
 isc_result_t
 ns__query_start(query_ctx_t *qctx);
 
+void
+ns__query_cacheresponse(ns_client_t *client, isc_buffer_t *buffer,
+			unsigned int length);
+/*%
+ * Add the response just rendered to 'buffer' to the view's response
+ * cache, if the query was marked as cacheable when it started and the
+ * response qualifies.  'length' is the length of the response before
+ * its OPT record.
+ *
+ * (Must not be used outside this library.)
+ */
+
 #endif /* NS_QUERY_H */
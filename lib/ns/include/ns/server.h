@@ -44,6 +44,7 @@
 #define NS_SERVER_DISABLE6	0x00000200U	/*%< -4 */
 #define NS_SERVER_FIXEDLOCAL	0x00000400U	/*%< -T fixedlocal */
 #define NS_SERVER_SIGVALINSECS	0x00000800U	/*%< -T sigvalinsecs */
+#define NS_SERVER_LEGACYCOMPRESS 0x00001000U	/*%< -T legacycompression */
 
 /*%
  * Type for callback function to get hostname.
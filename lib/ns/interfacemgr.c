@@ -18,6 +18,7 @@
 #include <isc/interfaceiter.h>
 #include <isc/os.h>
 #include <isc/random.h>
+#include <isc/socket.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/util.h>
@@ -57,6 +58,13 @@
 #define UDPBUFFERS 1000
 #endif /* TUNE_LARGE */
 
+/*%
+ * Datagrams read per system call on a "reuseport" UDP listener, and
+ * the size of each; the latter matches the clients' receive buffers.
+ */
+#define UDPRECVBATCH 16
+#define UDPRECVSIZE 4096
+
 #define IFMGR_MAGIC			ISC_MAGIC('I', 'F', 'M', 'G')
 #define NS_INTERFACEMGR_VALID(t)	ISC_MAGIC_VALID(t, IFMGR_MAGIC)
 
@@ -83,6 +91,7 @@ struct ns_interfacemgr {
 	ISC_LIST(isc_sockaddr_t) listenon;
 	int			backlog;	/*%< Listen queue size */
 	unsigned int		udpdisp;	/*%< UDP dispatch count */
+	bool			reuseport;	/*%< Per-dispatch UDP sockets */
 #ifdef USE_ROUTE_SOCKET
 	isc_task_t *		task;
 	isc_socket_t *		route;
@@ -219,6 +228,7 @@ ns_interfacemgr_create(isc_mem_t *mctx,
 	mgr->listenon4 = NULL;
 	mgr->listenon6 = NULL;
 	mgr->udpdisp = udpdisp;
+	mgr->reuseport = false;
 
 	ISC_LIST_INIT(mgr->interfaces);
 	ISC_LIST_INIT(mgr->listenon);
@@ -326,6 +336,14 @@ ns_interfacemgr_setbacklog(ns_interfacemgr_t *mgr, int backlog) {
 
 }
 
+void
+ns_interfacemgr_setreuseport(ns_interfacemgr_t *mgr, bool reuseport) {
+	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
+	LOCK(&mgr->lock);
+	mgr->reuseport = reuseport;
+	UNLOCK(&mgr->lock);
+}
+
 dns_aclenv_t *
 ns_interfacemgr_getaclenv(ns_interfacemgr_t *mgr) {
 	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
@@ -418,8 +436,10 @@ ns_interface_create(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr,
 		goto clientmgr_create_failure;
 	}
 
-	for (disp = 0; disp < MAX_UDP_DISPATCH; disp++)
+	for (disp = 0; disp < MAX_UDP_DISPATCH; disp++) {
 		ifp->udpdispatch[disp] = NULL;
+		ifp->udpclientmgr[disp] = NULL;
+	}
 
 	ifp->tcpsocket = NULL;
 
@@ -462,6 +482,7 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	unsigned int attrs;
 	unsigned int attrmask;
 	int disp, i;
+	bool reuseport;
 
 	attrs = 0;
 	attrs |= DNS_DISPATCHATTR_UDP;
@@ -474,6 +495,17 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	attrmask |= DNS_DISPATCHATTR_UDP | DNS_DISPATCHATTR_TCP;
 	attrmask |= DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_IPV6;
 
+	/*
+	 * With "reuseport", every dispatch gets its own socket bound
+	 * with SO_REUSEPORT and its own client manager, so the kernel
+	 * spreads the incoming queries over the listeners and each
+	 * query is received and answered by the same client.
+	 * Otherwise the dispatches share dup()ed copies of one socket.
+	 */
+	reuseport = ifp->mgr->reuseport;
+	if (reuseport)
+		attrs |= DNS_DISPATCHATTR_REUSEPORT;
+
 	ifp->nudpdispatch = ISC_MIN(ifp->mgr->udpdisp, MAX_UDP_DISPATCH);
 	for (disp = 0; disp < ifp->nudpdispatch; disp++) {
 		result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
@@ -483,9 +515,18 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 						 32768, 8219, 8237,
 						 attrs, attrmask,
 						 &ifp->udpdispatch[disp],
-						 disp == 0
+						 (disp == 0 || reuseport)
 						    ? NULL
 						    : ifp->udpdispatch[0]);
+		if (result == ISC_R_NOTIMPLEMENTED && reuseport && disp == 0) {
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_WARNING,
+				      "SO_REUSEPORT is not supported; "
+				      "sharing one UDP socket instead");
+			reuseport = false;
+			attrs &= ~DNS_DISPATCHATTR_REUSEPORT;
+			disp--;
+			continue;
+		}
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				      "could not listen on UDP socket: %s",
@@ -495,6 +536,39 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 
 	}
 
+	if (reuseport) {
+		for (i = 0; i < ifp->nudpdispatch; i++) {
+			result = ns_clientmgr_create(ifp->mgr->mctx,
+						     ifp->mgr->sctx,
+						     ifp->mgr->taskmgr,
+						     ifp->mgr->timermgr,
+						     &ifp->udpclientmgr[i]);
+			if (result != ISC_R_SUCCESS) {
+				UNEXPECTED_ERROR(__FILE__, __LINE__,
+						 "ns_clientmgr_create(): %s",
+						 isc_result_totext(result));
+				goto addtodispatch_failure;
+			}
+			/*
+			 * The socket has a single reader, so it can safely
+			 * read ahead several queries at once.
+			 */
+			(void)isc_socket_setrecvbatch(
+				dns_dispatch_getsocket(ifp->udpdispatch[i]),
+				UDPRECVBATCH, UDPRECVSIZE);
+			result = ns_clientmgr_createdispclient(
+					ifp->udpclientmgr[i], ifp, i);
+			if (result != ISC_R_SUCCESS) {
+				UNEXPECTED_ERROR(__FILE__, __LINE__,
+						 "UDP ns_clientmgr_"
+						 "createdispclient(): %s",
+						 isc_result_totext(result));
+				goto addtodispatch_failure;
+			}
+		}
+		return (ISC_R_SUCCESS);
+	}
+
 	result = ns_clientmgr_createclients(ifp->clientmgr, ifp->nudpdispatch,
 					    ifp, false);
 	if (result != ISC_R_SUCCESS) {
@@ -507,6 +581,10 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	return (ISC_R_SUCCESS);
 
  addtodispatch_failure:
+	for (i = 0; i < ifp->nudpdispatch; i++) {
+		if (ifp->udpclientmgr[i] != NULL)
+			ns_clientmgr_destroy(&ifp->udpclientmgr[i]);
+	}
 	for (i = disp - 1; i >= 0; i--) {
 		dns_dispatch_changeattributes(ifp->udpdispatch[i], 0,
 					      DNS_DISPATCHATTR_NOLISTEN);
@@ -637,8 +715,13 @@ ns_interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr,
 
 void
 ns_interface_shutdown(ns_interface_t *ifp) {
+	int disp;
+
 	if (ifp->clientmgr != NULL)
 		ns_clientmgr_destroy(&ifp->clientmgr);
+	for (disp = 0; disp < ifp->nudpdispatch; disp++)
+		if (ifp->udpclientmgr[disp] != NULL)
+			ns_clientmgr_destroy(&ifp->udpclientmgr[disp]);
 }
 
 static void
@@ -1299,8 +1382,14 @@ ns_interfacemgr_dumprecursing(FILE *f, ns_interfacemgr_t *mgr) {
 	LOCK(&mgr->lock);
 	interface = ISC_LIST_HEAD(mgr->interfaces);
 	while (interface != NULL) {
+		int disp;
+
 		if (interface->clientmgr != NULL)
 			ns_client_dumprecursing(f, interface->clientmgr);
+		for (disp = 0; disp < interface->nudpdispatch; disp++)
+			if (interface->udpclientmgr[disp] != NULL)
+				ns_client_dumprecursing(f,
+						interface->udpclientmgr[disp]);
 		interface = ISC_LIST_NEXT(interface, link);
 	}
 	UNLOCK(&mgr->lock);
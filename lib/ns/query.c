@@ -52,6 +52,7 @@
 #include <dns/rdatastruct.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
@@ -154,6 +155,24 @@ do { \
 #define REDIRECT(c)		(((c)->query.attributes & \
 				  NS_QUERYATTR_REDIRECT) != 0)
 
+/*% May the response be added to the response cache? */
+#define RESPCACHE(c)		(((c)->query.attributes & \
+				  NS_QUERYATTR_RESPCACHE) != 0)
+
+/*%
+ * The client attributes which change a response, and further options
+ * which are part of the response cache key.
+ */
+#define RESPCACHE_CLIENTATTRS	(NS_CLIENTATTR_TCP | NS_CLIENTATTR_RA | \
+				 NS_CLIENTATTR_WANTDNSSEC | \
+				 NS_CLIENTATTR_WANTNSID | NS_CLIENTATTR_WANTAD | \
+				 NS_CLIENTATTR_WANTCOOKIE | \
+				 NS_CLIENTATTR_HAVECOOKIE | \
+				 NS_CLIENTATTR_WANTOPT | \
+				 NS_CLIENTATTR_USEKEEPALIVE)
+#define RESPCACHE_RD		0x20000000
+#define RESPCACHE_CD		0x40000000
+
 /*% Does the rdataset 'r' have an attached 'No QNAME Proof'? */
 #define NOQNAME(r)		(((r)->attributes & \
 				  DNS_RDATASETATTR_NOQNAME) != 0)
@@ -343,6 +362,9 @@ query_setup(ns_client_t *client, dns_rdatatype_t qtype);
 static isc_result_t
 query_lookup(query_ctx_t *qctx);
 
+static isc_result_t
+query_respcache(query_ctx_t *qctx);
+
 static void
 fetch_callback(isc_task_t *task, isc_event_t *event);
 
@@ -708,6 +730,7 @@ query_reset(ns_client_t *client, bool everything) {
 	client->query.root_key_sentinel_keyid = 0;
 	client->query.root_key_sentinel_is_ta = false;
 	client->query.root_key_sentinel_not_ta = false;
+	client->query.respcache.rrlresult = ISC_R_NOTFOUND;
 }
 
 static void
@@ -955,6 +978,8 @@ ns_query_init(ns_client_t *client) {
 	client->query.redirect.is_zone = false;
 	client->query.redirect.fname =
 		dns_fixedname_initname(&client->query.redirect.fixed);
+	client->query.respcache.rrlname =
+		dns_fixedname_initname(&client->query.respcache.rrlfixed);
 	query_reset(client, false);
 	result = query_newdbversion(client, 3);
 	if (result != ISC_R_SUCCESS) {
@@ -1745,6 +1770,12 @@ query_addadditional(void *arg, const dns_name_t *name, dns_rdatatype_t qtype) {
 	if (!client->view->recursion)
 		goto try_glue;
 
+	/*
+	 * What the cache holds, and whether this client may see it,
+	 * differs from one query to the next.
+	 */
+	client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 	additionaltype = dns_rdatasetadditional_fromcache;
 	result = query_getcachedb(client, name, qtype, &db, DNS_GETDB_NOLOG);
 	if (result != ISC_R_SUCCESS) {
@@ -5419,6 +5450,11 @@ ns__query_start(query_ctx_t *qctx) {
 		}
 	}
 
+	result = query_respcache(qctx);
+	if (result != ISC_R_COMPLETE) {
+		return (result);
+	}
+
 	return (query_lookup(qctx));
 }
 
@@ -5716,6 +5752,8 @@ query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 
 	recparam_update(&client->query.recparam, qtype, qname, qdomain);
 
+	client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 	if (!resuming)
 		inc_stats(client, ns_statscounter_recursion);
 
@@ -6115,6 +6153,148 @@ ns__query_sfcache(query_ctx_t *qctx) {
 	return (ISC_R_COMPLETE);
 }
 
+/*%
+ * Find the name that RRL accounts a response to 'result' against, and
+ * the kind of response it is.  'fixed' may be used to hold the name.
+ */
+static const dns_name_t *
+query_rrlname(query_ctx_t *qctx, isc_result_t result, dns_fixedname_t *fixed,
+	      isc_result_t *resp_resultp)
+{
+	dns_rdataset_t nc_rdataset;
+	const dns_name_t *constname;
+	isc_result_t nc_result;
+
+	constname = qctx->fname;
+	if (result == DNS_R_NXDOMAIN) {
+		/*
+		 * Use the database origin name to rate limit NXDOMAIN
+		 */
+		if (qctx->db != NULL)
+			constname = dns_db_origin(qctx->db);
+		*resp_resultp = result;
+	} else if (result == DNS_R_NCACHENXDOMAIN &&
+		   qctx->rdataset != NULL &&
+		   dns_rdataset_isassociated(qctx->rdataset) &&
+		   (qctx->rdataset->attributes &
+		    DNS_RDATASETATTR_NEGATIVE) != 0) {
+		/*
+		 * Try to use owner name in the negative cache SOA.
+		 */
+		dns_fixedname_init(fixed);
+		dns_rdataset_init(&nc_rdataset);
+		for (nc_result = dns_rdataset_first(qctx->rdataset);
+		     nc_result == ISC_R_SUCCESS;
+		     nc_result = dns_rdataset_next(qctx->rdataset))
+		{
+			dns_ncache_current(qctx->rdataset,
+					   dns_fixedname_name(fixed),
+					   &nc_rdataset);
+			if (nc_rdataset.type == dns_rdatatype_soa) {
+				dns_rdataset_disassociate(&nc_rdataset);
+				constname = dns_fixedname_name(fixed);
+				break;
+			}
+			dns_rdataset_disassociate(&nc_rdataset);
+		}
+		*resp_resultp = DNS_R_NXDOMAIN;
+	} else if (result == DNS_R_NXRRSET ||
+		   result == DNS_R_EMPTYNAME) {
+		*resp_resultp = DNS_R_NXRRSET;
+	} else if (result == DNS_R_DELEGATION) {
+		*resp_resultp = result;
+	} else if (result == ISC_R_NOTFOUND) {
+		/*
+		 * Handle referral to ".", including when recursion
+		 * is off or not requested and the hints have not
+		 * been loaded or we have "additional-from-cache no".
+		 */
+		constname = dns_rootname;
+		*resp_resultp = DNS_R_DELEGATION;
+	} else {
+		*resp_resultp = ISC_R_SUCCESS;
+	}
+
+	return (constname);
+}
+
+/*%
+ * Rate limit a response of kind 'resp_result' accounted against
+ * 'constname' to this client.
+ */
+static isc_result_t
+query_rrl(query_ctx_t *qctx, const dns_name_t *constname,
+	  isc_result_t resp_result)
+{
+	bool wouldlog;
+	char log_buf[DNS_RRL_LOG_BUF_LEN];
+	dns_rrl_result_t rrl_result;
+
+	wouldlog = isc_log_wouldlog(ns_lctx, DNS_RRL_LOG_DROP);
+	rrl_result = dns_rrl(qctx->client->view,
+			     &qctx->client->peeraddr,
+			     TCP(qctx->client),
+			     qctx->client->message->rdclass,
+			     qctx->qtype, constname,
+			     resp_result, qctx->client->now,
+			     wouldlog, log_buf, sizeof(log_buf));
+	if (rrl_result != DNS_RRL_RESULT_OK) {
+		/*
+		 * Log dropped or slipped responses in the query
+		 * category so that requests are not silently lost.
+		 * Starts of rate-limited bursts are logged in
+		 * DNS_LOGCATEGORY_RRL.
+		 *
+		 * Dropped responses are counted with dropped queries
+		 * in QryDropped while slipped responses are counted
+		 * with other truncated responses in RespTruncated.
+		 */
+		if (wouldlog) {
+			ns_client_log(qctx->client, DNS_LOGCATEGORY_RRL,
+				      NS_LOGMODULE_QUERY,
+				      DNS_RRL_LOG_DROP,
+				      "%s", log_buf);
+		}
+
+		if (!qctx->client->view->rrl->log_only) {
+			if (rrl_result == DNS_RRL_RESULT_DROP) {
+				/*
+				 * These will also be counted in
+				 * ns_statscounter_dropped
+				 */
+				inc_stats(qctx->client,
+					ns_statscounter_ratedropped);
+				QUERY_ERROR(qctx, DNS_R_DROP);
+			} else {
+				/*
+				 * These will also be counted in
+				 * ns_statscounter_truncatedresp
+				 */
+				inc_stats(qctx->client,
+					ns_statscounter_rateslipped);
+				if (WANTCOOKIE(qctx->client)) {
+					qctx->client->message->flags &=
+						~DNS_MESSAGEFLAG_AA;
+					qctx->client->message->flags &=
+						~DNS_MESSAGEFLAG_AD;
+					qctx->client->message->rcode =
+						   dns_rcode_badcookie;
+				} else {
+					qctx->client->message->flags |=
+						DNS_MESSAGEFLAG_TC;
+					if (resp_result == DNS_R_NXDOMAIN) {
+						qctx->client->message->rcode =
+							dns_rcode_nxdomain;
+					}
+				}
+			}
+			return (DNS_R_DROP);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 /*%
  * Handle response rate limiting (RRL).
  */
@@ -6140,129 +6320,14 @@ query_checkrrl(query_ctx_t *qctx, isc_result_t result) {
 	     (qctx->client->query.rpz_st->state & DNS_RPZ_REWRITTEN) == 0) &&
 	    (qctx->client->query.attributes & NS_QUERYATTR_RRL_CHECKED) == 0)
 	{
-		dns_rdataset_t nc_rdataset;
-		bool wouldlog;
 		dns_fixedname_t fixed;
 		const dns_name_t *constname;
-		char log_buf[DNS_RRL_LOG_BUF_LEN];
-		isc_result_t nc_result, resp_result;
-		dns_rrl_result_t rrl_result;
+		isc_result_t resp_result;
 
 		qctx->client->query.attributes |= NS_QUERYATTR_RRL_CHECKED;
 
-		wouldlog = isc_log_wouldlog(ns_lctx, DNS_RRL_LOG_DROP);
-		constname = qctx->fname;
-		if (result == DNS_R_NXDOMAIN) {
-			/*
-			 * Use the database origin name to rate limit NXDOMAIN
-			 */
-			if (qctx->db != NULL)
-				constname = dns_db_origin(qctx->db);
-			resp_result = result;
-		} else if (result == DNS_R_NCACHENXDOMAIN &&
-			   qctx->rdataset != NULL &&
-			   dns_rdataset_isassociated(qctx->rdataset) &&
-			   (qctx->rdataset->attributes &
-			    DNS_RDATASETATTR_NEGATIVE) != 0) {
-			/*
-			 * Try to use owner name in the negative cache SOA.
-			 */
-			dns_fixedname_init(&fixed);
-			dns_rdataset_init(&nc_rdataset);
-			for (nc_result = dns_rdataset_first(qctx->rdataset);
-			     nc_result == ISC_R_SUCCESS;
-			     nc_result = dns_rdataset_next(qctx->rdataset))
-			{
-				dns_ncache_current(qctx->rdataset,
-						   dns_fixedname_name(&fixed),
-						   &nc_rdataset);
-				if (nc_rdataset.type == dns_rdatatype_soa) {
-					dns_rdataset_disassociate(&nc_rdataset);
-					constname = dns_fixedname_name(&fixed);
-					break;
-				}
-				dns_rdataset_disassociate(&nc_rdataset);
-			}
-			resp_result = DNS_R_NXDOMAIN;
-		} else if (result == DNS_R_NXRRSET ||
-			   result == DNS_R_EMPTYNAME) {
-			resp_result = DNS_R_NXRRSET;
-		} else if (result == DNS_R_DELEGATION) {
-			resp_result = result;
-		} else if (result == ISC_R_NOTFOUND) {
-			/*
-			 * Handle referral to ".", including when recursion
-			 * is off or not requested and the hints have not
-			 * been loaded or we have "additional-from-cache no".
-			 */
-			constname = dns_rootname;
-			resp_result = DNS_R_DELEGATION;
-		} else {
-			resp_result = ISC_R_SUCCESS;
-		}
-
-		rrl_result = dns_rrl(qctx->client->view,
-				     &qctx->client->peeraddr,
-				     TCP(qctx->client),
-				     qctx->client->message->rdclass,
-				     qctx->qtype, constname,
-				     resp_result, qctx->client->now,
-				     wouldlog, log_buf, sizeof(log_buf));
-		if (rrl_result != DNS_RRL_RESULT_OK) {
-			/*
-			 * Log dropped or slipped responses in the query
-			 * category so that requests are not silently lost.
-			 * Starts of rate-limited bursts are logged in
-			 * DNS_LOGCATEGORY_RRL.
-			 *
-			 * Dropped responses are counted with dropped queries
-			 * in QryDropped while slipped responses are counted
-			 * with other truncated responses in RespTruncated.
-			 */
-			if (wouldlog) {
-				ns_client_log(qctx->client, DNS_LOGCATEGORY_RRL,
-					      NS_LOGMODULE_QUERY,
-					      DNS_RRL_LOG_DROP,
-					      "%s", log_buf);
-			}
-
-			if (!qctx->client->view->rrl->log_only) {
-				if (rrl_result == DNS_RRL_RESULT_DROP) {
-					/*
-					 * These will also be counted in
-					 * ns_statscounter_dropped
-					 */
-					inc_stats(qctx->client,
-						ns_statscounter_ratedropped);
-					QUERY_ERROR(qctx, DNS_R_DROP);
-				} else {
-					/*
-					 * These will also be counted in
-					 * ns_statscounter_truncatedresp
-					 */
-					inc_stats(qctx->client,
-						ns_statscounter_rateslipped);
-					if (WANTCOOKIE(qctx->client)) {
-						qctx->client->message->flags &=
-							~DNS_MESSAGEFLAG_AA;
-						qctx->client->message->flags &=
-							~DNS_MESSAGEFLAG_AD;
-						qctx->client->message->rcode =
-							   dns_rcode_badcookie;
-					} else {
-						qctx->client->message->flags |=
-							DNS_MESSAGEFLAG_TC;
-						if (resp_result ==
-						    DNS_R_NXDOMAIN)
-						{
-						  qctx->client->message->rcode =
-							  dns_rcode_nxdomain;
-						}
-					}
-				}
-				return (DNS_R_DROP);
-			}
-		}
+		constname = query_rrlname(qctx, result, &fixed, &resp_result);
+		return (query_rrl(qctx, constname, resp_result));
 	} else if (!TCP(qctx->client) &&
 		   qctx->client->view->requireservercookie &&
 		   WANTCOOKIE(qctx->client) && !HAVECOOKIE(qctx->client))
@@ -6276,6 +6341,232 @@ query_checkrrl(query_ctx_t *qctx, isc_result_t result) {
 	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * Make the response cache key for the query in 'qctx', if its response
+ * can be cached: an authoritative answer from a zone, that depends on
+ * nothing but the query, the zone version and the client attributes
+ * and flags in the key.
+ */
+static bool
+query_respcache_key(query_ctx_t *qctx, dns_respcachekey_t *key) {
+	ns_client_t *client = qctx->client;
+	dns_view_t *view = client->view;
+	uint32_t options, serial;
+
+	if (view->respcache == NULL || client->query.restarts != 0 ||
+	    !qctx->is_zone || !qctx->authoritative || qctx->zone == NULL ||
+	    qctx->is_staticstub_zone)
+	{
+		return (false);
+	}
+
+	if (client->message->tsigkey != NULL ||
+	    client->message->sig0key != NULL ||
+	    (client->attributes & (NS_CLIENTATTR_WANTEXPIRE |
+				   NS_CLIENTATTR_HAVEECS |
+				   NS_CLIENTATTR_WANTPAD |
+				   NS_CLIENTATTR_FILTER_AAAA)) != 0 ||
+	    client->filter_aaaa != dns_aaaa_ok ||
+	    client->query.root_key_sentinel_is_ta ||
+	    client->query.root_key_sentinel_not_ta)
+	{
+		return (false);
+	}
+
+	if (view->sortlist != NULL || view->nocasecompress != NULL ||
+	    (view->rpzs != NULL && view->rpzs->p.num_zones != 0) ||
+	    !ISC_LIST_EMPTY(view->dns64))
+	{
+		return (false);
+	}
+
+	if (dns_db_getsoaserial(qctx->db, qctx->version,
+				&serial) != ISC_R_SUCCESS)
+	{
+		return (false);
+	}
+
+	options = client->attributes & RESPCACHE_CLIENTATTRS;
+	if ((client->message->flags & DNS_MESSAGEFLAG_RD) != 0) {
+		options |= RESPCACHE_RD;
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_CD) != 0) {
+		options |= RESPCACHE_CD;
+	}
+
+	key->qname = client->query.qname;
+	key->qtype = qctx->qtype;
+	key->options = options;
+	key->size = TCP(client) ? 0 : client->udpsize;
+	key->db = qctx->db;
+	key->serial = serial;
+
+	return (true);
+}
+
+/*%
+ * Look for the response to this query in the view's response cache,
+ * and send it if found.  Otherwise, mark the query so that its response
+ * is added to the cache when it is sent.
+ *
+ * Returns ISC_R_COMPLETE if the query must be answered by a lookup.
+ */
+static isc_result_t
+query_respcache(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	dns_respcachekey_t key;
+	unsigned char data[DNS_RESPCACHE_MAXRESPONSE];
+	dns_fixedname_t fixed;
+	dns_name_t *rrlname;
+	isc_result_t result, rrlresult;
+	isc_buffer_t b;
+	isc_region_t r;
+
+	if (!query_respcache_key(qctx, &key)) {
+		return (ISC_R_COMPLETE);
+	}
+
+	rrlname = dns_fixedname_initname(&fixed);
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_respcache_find(client->view->respcache, &key, &b,
+				    rrlname, &rrlresult);
+	if (result != ISC_R_SUCCESS) {
+		ns_stats_increment(client->sctx->nsstats,
+				   ns_statscounter_respcachemiss);
+		client->query.attributes |= NS_QUERYATTR_RESPCACHE;
+		client->query.respcache.options = key.options;
+		client->query.respcache.serial = key.serial;
+		return (ISC_R_COMPLETE);
+	}
+
+	/*
+	 * Rate limit the response as it was when it was first sent.
+	 */
+	if (client->view->rrl != NULL && !HAVECOOKIE(client) &&
+	    rrlresult != ISC_R_NOTFOUND)
+	{
+		client->query.attributes |= NS_QUERYATTR_RRL_CHECKED;
+		if (query_rrl(qctx, rrlname, rrlresult) != ISC_R_SUCCESS) {
+			return (query_done(qctx));
+		}
+	}
+
+	isc_buffer_usedregion(&b, &r);
+	result = ns_client_sendcached(client, &r);
+	if (result == ISC_R_NOSPACE) {
+		return (ISC_R_COMPLETE);
+	}
+
+	inc_stats(client, ns_statscounter_authans);
+	if ((r.base[3] & 0x0f) == dns_rcode_nxdomain) {
+		inc_stats(client, ns_statscounter_nxdomain);
+	} else if (r.base[6] == 0 && r.base[7] == 0) {
+		inc_stats(client, ns_statscounter_nxrrset);
+	} else {
+		inc_stats(client, ns_statscounter_success);
+	}
+	ns_stats_increment(client->sctx->nsstats,
+			   ns_statscounter_respcachehit);
+
+	qctx_clean(qctx);
+	qctx_freedata(qctx);
+	ns_client_detach(&qctx->client);
+	return (ISC_R_SUCCESS);
+}
+
+void
+ns__query_cacheresponse(ns_client_t *client, isc_buffer_t *buffer,
+			unsigned int length)
+{
+	dns_message_t *msg = client->message;
+	dns_respcachekey_t key;
+	unsigned char data[DNS_RESPCACHE_MAXRESPONSE];
+	const dns_name_t *rrlname = NULL;
+	dns_section_t section;
+	dns_name_t *name;
+	dns_rdataset_t *rdataset;
+	unsigned int arcount;
+	isc_region_t r;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(RESPCACHE(client));
+
+	/*
+	 * Only complete, authoritative answers to the original question,
+	 * that are not ordered differently from one response to the
+	 * next, are cached.
+	 */
+	if (client->query.restarts != 0 || REDIRECT(client) ||
+	    client->view == NULL || client->view->respcache == NULL ||
+	    client->query.authdb == NULL ||
+	    (msg->flags & DNS_MESSAGEFLAG_AA) == 0 ||
+	    (msg->flags & DNS_MESSAGEFLAG_TC) != 0 ||
+	    (msg->rcode != dns_rcode_noerror &&
+	     msg->rcode != dns_rcode_nxdomain) ||
+	    msg->tsigkey != NULL || msg->sig0key != NULL ||
+	    msg->order != NULL || length > sizeof(data))
+	{
+		return;
+	}
+
+	if (client->view->rrl != NULL) {
+		if (client->query.respcache.rrlresult == ISC_R_NOTFOUND) {
+			return;
+		}
+		rrlname = client->query.respcache.rrlname;
+	}
+
+	for (section = DNS_SECTION_ANSWER;
+	     section <= DNS_SECTION_ADDITIONAL;
+	     section++)
+	{
+		for (name = ISC_LIST_HEAD(msg->sections[section]);
+		     name != NULL;
+		     name = ISC_LIST_NEXT(name, link))
+		{
+			for (rdataset = ISC_LIST_HEAD(name->list);
+			     rdataset != NULL;
+			     rdataset = ISC_LIST_NEXT(rdataset, link))
+			{
+				if ((rdataset->attributes &
+				     (DNS_RDATASETATTR_RANDOMIZE |
+				      DNS_RDATASETATTR_CYCLIC)) != 0 &&
+				    rdataset->type != dns_rdatatype_rrsig &&
+				    dns_rdataset_count(rdataset) > 1)
+				{
+					return;
+				}
+			}
+		}
+	}
+
+	/*
+	 * Cache the response without its OPT record, which is built
+	 * again for each client.
+	 */
+	isc_buffer_usedregion(buffer, &r);
+	INSIST(length <= r.length);
+	memmove(data, r.base, length);
+	arcount = msg->counts[DNS_SECTION_ADDITIONAL];
+	if (msg->opt != NULL) {
+		arcount--;
+	}
+	data[10] = (arcount >> 8) & 0xff;
+	data[11] = arcount & 0xff;
+	r.base = data;
+	r.length = length;
+
+	key.qname = client->query.qname;
+	key.qtype = client->query.qtype;
+	key.options = client->query.respcache.options;
+	key.size = TCP(client) ? 0 : client->udpsize;
+	key.db = client->query.authdb;
+	key.serial = client->query.respcache.serial;
+
+	(void)dns_respcache_add(client->view->respcache, &key, &r,
+				rrlname, client->query.respcache.rrlresult);
+}
+
 /*%
  * Do any RPZ rewriting that may be needed for this query.
  */
@@ -6619,6 +6910,26 @@ query_gotanswer(query_ctx_t *qctx, isc_result_t result) {
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_gotanswer");
 
+	if (RESPCACHE(qctx->client) && qctx->client->view->rrl != NULL) {
+		/*
+		 * Remember what RRL accounts this response against, so
+		 * that the same can be done when it is served from the
+		 * response cache.
+		 */
+		ns_client_t *client = qctx->client;
+		dns_fixedname_t fixed;
+		const dns_name_t *constname;
+
+		constname = query_rrlname(qctx, result, &fixed,
+					  &client->query.respcache.rrlresult);
+		if (constname != NULL && dns_name_isabsolute(constname)) {
+			dns_name_copy(constname,
+				      client->query.respcache.rrlname, NULL);
+		} else {
+			client->query.respcache.rrlresult = ISC_R_NOTFOUND;
+		}
+	}
+
 	if (query_checkrrl(qctx, result) != ISC_R_SUCCESS) {
 		return (query_done(qctx));
 	}
@@ -7830,6 +8141,13 @@ query_zone_delegation(query_ctx_t *qctx) {
 			RESTORE(qctx->zone, tzone);
 			qctx->authoritative = true;
 
+			/*
+			 * The answer no longer comes from the database
+			 * the response cache key was made for.
+			 */
+			qctx->client->query.attributes &=
+				~NS_QUERYATTR_RESPCACHE;
+
 			return (query_lookup(qctx));
 		}
 	}
@@ -7838,6 +8156,8 @@ query_zone_delegation(query_ctx_t *qctx) {
 	    (RECURSIONOK(qctx->client) ||
 	     (qctx->zone != NULL && dns_zone_ismirror(qctx->zone))))
 	{
+		qctx->client->query.attributes &= ~NS_QUERYATTR_RESPCACHE;
+
 		/*
 		 * We might have a better answer or delegation in the
 		 * cache.  We'll remember the current values of fname,
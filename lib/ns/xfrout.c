@@ -1497,6 +1497,11 @@ sendstream(xfrout_ctx_t *xfr) {
 	if (is_tcp) {
 		CHECK(dns_compress_init(&cctx, -1, xfr->mctx));
 		dns_compress_setsensitive(&cctx, true);
+		if ((xfr->client->sctx->options &
+		     NS_SERVER_LEGACYCOMPRESS) != 0)
+		{
+			dns_compress_setlegacy(&cctx, true);
+		}
 		cleanup_cctx = true;
 		CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
 		CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));